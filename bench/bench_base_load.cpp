@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "md5_calculator.h"
+#include "csv_base_loader.h"
+#include "bench_utils.h"
+#include <fstream>
+#include <memory>
+#include <random>
+
+namespace {
+
+const char* const VERDICTS[] = {"Exploit", "Dropper", "Downloader", "Trojan", "Worm"};
+
+// CSV-база заданного размера и ее двоичная версия; строится одна за раз
+struct BaseFiles {
+    size_t size = 0;
+    bench_utils::TempDir dir;
+    std::string csvPath;
+    std::string compiledPath;
+
+    static BaseFiles& get(size_t size) {
+        static std::unique_ptr<BaseFiles> files;
+        if (!files || files->size != size) {
+            files.reset();
+            files.reset(new BaseFiles());
+            files->build(size);
+        }
+        return *files;
+    }
+
+    void build(size_t count) {
+        size = count;
+        csvPath = (dir.path() / "base.csv").string();
+        compiledPath = (dir.path() / "base.sigdb").string();
+
+        std::ofstream csv(csvPath, std::ios::binary);
+        std::mt19937_64 rng(count);
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t words[2] = {rng(), rng()};
+            csv << MD5Calculator::bytesToHexString(reinterpret_cast<const unsigned char*>(words), 16)
+                << ';' << VERDICTS[i % 5] << '\n';
+        }
+        csv.close();
+
+        IScannerCore* scanner = createScanner();
+        scanner->loadMalwareBase(csvPath);
+        scanner->compileMalwareBase(compiledPath);
+        destroyScanner(scanner);
+    }
+};
+
+// Время от создания сканера до готовности к поиску
+void loadBase(benchmark::State& state, bool compiled) {
+    BaseFiles& files = BaseFiles::get(static_cast<size_t>(state.range(0)));
+    const std::string& path = compiled ? files.compiledPath : files.csvPath;
+
+    for (auto _ : state) {
+        IScannerCore* scanner = createScanner();
+        if (!scanner->loadMalwareBase(path)) {
+            state.SkipWithError("failed to load base");
+        }
+        state.PauseTiming();
+        destroyScanner(scanner);
+        state.ResumeTiming();
+    }
+    state.counters["signatures"] = static_cast<double>(files.size);
+}
+
+void BM_LoadCsvBase(benchmark::State& state) { loadBase(state, false); }
+void BM_LoadCompiledBase(benchmark::State& state) { loadBase(state, true); }
+
+// Прежний загрузчик: getline, поиск ';' и строка вердикта на каждую сигнатуру
+void BM_CsvGetlineBaseline(benchmark::State& state) {
+    BaseFiles& files = BaseFiles::get(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        SignatureIndex index;
+        index.reserve(files.size);
+        std::ifstream file(files.csvPath, std::ios::binary);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t delimiterPos = line.find(';');
+            MD5Digest digest;
+            if (delimiterPos != std::string::npos && SignatureIndex::parseHex(line.data(), delimiterPos, digest)) {
+                index.insert(digest, line.substr(delimiterPos + 1));
+            }
+        }
+        benchmark::DoNotOptimize(index.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(std::filesystem::file_size(files.csvPath)));
+}
+
+// Параллельный загрузчик; второй аргумент - число потоков разбора
+void BM_CsvParallelLoader(benchmark::State& state) {
+    BaseFiles& files = BaseFiles::get(static_cast<size_t>(state.range(0)));
+    CsvLoadOptions options;
+    options.threads = static_cast<size_t>(state.range(1));
+    for (auto _ : state) {
+        SignatureIndex index;
+        if (!CsvBaseLoader::load(files.csvPath, index, options)) {
+            state.SkipWithError("failed to load base");
+        }
+        benchmark::DoNotOptimize(index.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(std::filesystem::file_size(files.csvPath)));
+}
+
+BENCHMARK(BM_LoadCsvBase)->Arg(1000000)->Arg(10000000)->Unit(benchmark::kMillisecond)->Iterations(3)->UseRealTime();
+BENCHMARK(BM_LoadCompiledBase)->Arg(1000000)->Arg(10000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CsvGetlineBaseline)->Arg(1000000)->Arg(10000000)->Unit(benchmark::kMillisecond)->Iterations(3)->UseRealTime();
+BENCHMARK(BM_CsvParallelLoader)
+    ->ArgsProduct({{1000000, 10000000}, {1, 4, 16}})
+    ->Unit(benchmark::kMillisecond)->Iterations(3)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,207 @@
+#include <benchmark/benchmark.h>
+#include "signature_base.h"
+#include "csv_base_loader.h"
+#include "md5_calculator.h"
+#include "bench_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t SIGNATURES = 500 * 1000;
+constexpr size_t PROBES = 1 << 16;
+// Столько поисков читатель делает на одном снимке - как пачка файлов сканера
+constexpr size_t BATCH = 256;
+constexpr size_t DELTA = 1000;
+constexpr auto WINDOW = std::chrono::milliseconds(100);
+constexpr int WINDOWS = 50;
+
+enum Mode {
+    Idle = 0,           // база не меняется
+    Reload = 1,         // раз в секунду база загружается заново и подменяется
+    Delta = 2,          // раз в секунду дельта: DELTA добавлений и DELTA удалений
+    LockedReload = 3    // для сравнения: читатели под shared_mutex, база грузится под эксклюзивным
+};
+
+MD5Digest randomDigest(std::mt19937_64& rng) {
+    MD5Digest digest;
+    uint64_t a = rng(), b = rng();
+    std::memcpy(digest.data(), &a, 8);
+    std::memcpy(digest.data() + 8, &b, 8);
+    return digest;
+}
+
+// CSV-база и запросы к ней: каждый 16-й запрос попадает
+struct ReloadFixture {
+    bench_utils::TempDir dir;
+    std::string csvPath;
+    std::vector<MD5Digest> signatures;
+    std::vector<MD5Digest> probes;
+
+    static ReloadFixture& get() {
+        static ReloadFixture fixture;
+        return fixture;
+    }
+
+    ReloadFixture() {
+        std::mt19937_64 rng(42);
+        csvPath = (dir.path() / "base.csv").string();
+        std::ofstream csv(csvPath, std::ios::binary);
+        for (size_t i = 0; i < SIGNATURES; ++i) {
+            signatures.push_back(randomDigest(rng));
+            csv << MD5Calculator::bytesToHexString(signatures.back().data(), 16) << ";Bench.Family" << i % 100 << '\n';
+        }
+        for (size_t i = 0; i < PROBES; ++i) {
+            probes.push_back(i % 16 == 0 ? signatures[rng() % SIGNATURES] : randomDigest(rng));
+        }
+    }
+
+    SignatureIndex load() const {
+        SignatureIndex index;
+        CsvLoadOptions options;
+        options.threads = 1;
+        CsvBaseLoader::load(csvPath, index, options);
+        return index;
+    }
+};
+
+struct alignas(64) ReaderCounter {
+    std::atomic<uint64_t> lookups{0};
+};
+
+// Поисков в секунду у читателей, пока писатель раз в секунду обновляет базу.
+// Считается по окнам в WINDOW: среднее и худшее окно относительно среднего
+void BM_LookupDuringUpdates(benchmark::State& state) {
+    const Mode mode = static_cast<Mode>(state.range(0));
+    const size_t readers = std::max(1u, std::thread::hardware_concurrency());
+    ReloadFixture& fixture = ReloadFixture::get();
+
+    SignatureBase base;
+    base.replace(fixture.load());
+    std::shared_mutex lockedMutex;
+    SignatureIndex locked = mode == LockedReload ? fixture.load() : SignatureIndex();
+
+    double meanRate = 0.0;
+    double worstRatio = 0.0;
+    double updateMs = 0.0;
+    uint64_t updates = 0;
+    for (auto _ : state) {
+        std::atomic<bool> stop{false};
+        std::vector<ReaderCounter> counters(readers);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < readers; ++t) {
+            threads.emplace_back([&, t]() {
+                size_t position = t * (PROBES / readers);
+                size_t hits = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    if (mode == LockedReload) {
+                        std::shared_lock<std::shared_mutex> lock(lockedMutex);
+                        for (size_t i = 0; i < BATCH; ++i) {
+                            hits += locked.find(fixture.probes[(position + i) % PROBES]) != nullptr;
+                        }
+                    } else {
+                        SignatureBase::Reader snapshot = base.acquire();
+                        for (size_t i = 0; i < BATCH; ++i) {
+                            hits += snapshot->find(fixture.probes[(position + i) % PROBES]) != nullptr;
+                        }
+                    }
+                    position += BATCH;
+                    counters[t].lookups.fetch_add(BATCH, std::memory_order_relaxed);
+                }
+                benchmark::DoNotOptimize(hits);
+            });
+        }
+
+        std::thread writer([&]() {
+            std::mt19937_64 rng(7);
+            auto next = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (!stop) {
+                if (mode == Idle || std::chrono::steady_clock::now() < next) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                next += std::chrono::seconds(1);
+                auto start = std::chrono::steady_clock::now();
+                if (mode == Reload) {
+                    base.replace(fixture.load());
+                } else if (mode == Delta) {
+                    SignatureIndex added;
+                    std::vector<MD5Digest> removed;
+                    for (size_t i = 0; i < DELTA; ++i) {
+                        added.insert(randomDigest(rng), "Bench.Delta");
+                        removed.push_back(fixture.signatures[rng() % SIGNATURES]);
+                    }
+                    base.applyDelta(added, removed);
+                } else {
+                    std::unique_lock<std::shared_mutex> lock(lockedMutex);
+                    locked.clear();
+                    CsvLoadOptions options;
+                    options.threads = 1;
+                    CsvBaseLoader::load(fixture.csvPath, locked, options);
+                }
+                updateMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                updates++;
+            }
+        });
+
+        auto total = [&]() {
+            uint64_t sum = 0;
+            for (const auto& counter : counters) {
+                sum += counter.lookups.load(std::memory_order_relaxed);
+            }
+            return sum;
+        };
+        std::vector<double> rates;
+        uint64_t last = total();
+        auto windowStart = std::chrono::steady_clock::now();
+        for (int w = 0; w < WINDOWS; ++w) {
+            std::this_thread::sleep_until(windowStart + WINDOW);
+            auto now = std::chrono::steady_clock::now();
+            uint64_t current = total();
+            rates.push_back(static_cast<double>(current - last) / std::chrono::duration<double>(now - windowStart).count());
+            last = current;
+            windowStart = now;
+        }
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        writer.join();
+
+        double sum = 0.0;
+        for (double rate : rates) {
+            sum += rate;
+        }
+        meanRate = sum / static_cast<double>(rates.size());
+        worstRatio = *std::min_element(rates.begin(), rates.end()) / meanRate;
+    }
+
+    state.counters["lookups_per_second"] = meanRate;
+    state.counters["worst_window"] = worstRatio;
+    state.counters["updates"] = static_cast<double>(updates);
+    state.counters["update_ms"] = updates ? updateMs / static_cast<double>(updates) : 0.0;
+    state.counters["readers"] = static_cast<double>(readers);
+}
+
+BENCHMARK(BM_LookupDuringUpdates)
+    ->ArgName("mode")
+    ->Arg(Idle)
+    ->Arg(Reload)
+    ->Arg(Delta)
+    ->Arg(LockedReload)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,103 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Много маленьких корней, как у оркестратора: 1-4 файла по 64-512 байт в каждом
+struct TinyRoots {
+    static constexpr int ROOTS = 10000;
+    static constexpr int SIGNATURES = 1000;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::vector<ScanTarget> targets;
+    std::string base;
+    std::string log;
+    int files = 0;
+
+    TinyRoots() {
+        std::mt19937_64 rng(19);
+        base = (work.path() / "base.csv").string();
+        std::ofstream csv(base);
+        for (int s = 0; s < SIGNATURES; ++s) {
+            char hash[33];
+            std::snprintf(hash, sizeof(hash), "%016llx%016llx",
+                          static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+            csv << hash << ";Malware" << s << "\n";
+        }
+
+        for (int r = 0; r < ROOTS; ++r) {
+            fs::path root = dir.path() / ("root" + std::to_string(r));
+            int count = 1 + static_cast<int>(rng() % 4);
+            for (int f = 0; f < count; ++f) {
+                bench_utils::writeFile(root / ("f" + std::to_string(f)), 64 + static_cast<size_t>(rng() % 449),
+                                       static_cast<unsigned int>(files++));
+            }
+            ScanTarget target;
+            target.root = root.string();
+            targets.push_back(std::move(target));
+        }
+        log = (work.path() / "scan.log").string();
+    }
+
+    static TinyRoots& instance() {
+        static TinyRoots roots;
+        return roots;
+    }
+};
+
+// Прежний способ: scanDirectory на каждый корень, лог и пул открываются заново
+void BM_ScanDirectoryPerRoot(benchmark::State& state) {
+    TinyRoots& roots = TinyRoots::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(roots.base);
+
+    for (auto _ : state) {
+        int files = 0;
+        for (const ScanTarget& target : roots.targets) {
+            files += scanner->scanDirectory(target.root, roots.log).totalFiles;
+        }
+        if (files != roots.files) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.counters["roots_per_second"] =
+        benchmark::Counter(TinyRoots::ROOTS, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["files_per_second"] =
+        benchmark::Counter(roots.files, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Все корни одним пакетом: общий пул, обходы вперемешку, один лог
+void BM_ScanBatch(benchmark::State& state) {
+    TinyRoots& roots = TinyRoots::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(roots.base);
+
+    for (auto _ : state) {
+        BatchScanResult result = scanner->scanBatch(roots.targets, roots.log);
+        if (result.total.totalFiles != roots.files) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.counters["roots_per_second"] =
+        benchmark::Counter(TinyRoots::ROOTS, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["files_per_second"] =
+        benchmark::Counter(roots.files, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_ScanDirectoryPerRoot)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(3);
+BENCHMARK(BM_ScanBatch)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(3);
+
+}
+
+BENCHMARK_MAIN();
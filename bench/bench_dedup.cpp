@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include "corpus_generator.h"
+#include <memory>
+
+namespace {
+
+// Резервные копии: 8 деревьев (оригинал и 7 копий) из жестких ссылок на одни файлы
+bench_utils::CorpusSpec linkedSnapshots() {
+    bench_utils::CorpusSpec spec;
+    spec.seed = 20;
+    spec.files = 1000;
+    spec.directories = 40;
+    spec.depth = 2;
+    spec.minSize = 1024;
+    spec.maxSize = 1024 * 1024;
+    spec.linkCopies = 7;
+    return spec;
+}
+
+// Мелкие файлы без ссылок: цена stat, который нужен для поиска ссылок
+bench_utils::CorpusSpec smallFiles() {
+    bench_utils::CorpusSpec spec;
+    spec.seed = 21;
+    spec.files = 20000;
+    spec.directories = 200;
+    spec.sizes = bench_utils::SizeDistribution::Uniform;
+    spec.minSize = 512;
+    spec.maxSize = 4096;
+    return spec;
+}
+
+struct PreparedCorpus {
+    bench_utils::TempDir dir;
+    bench_utils::Corpus corpus;
+    std::string log;
+
+    explicit PreparedCorpus(const bench_utils::CorpusSpec& spec)
+        : corpus(bench_utils::generateCorpus(spec, dir.path())),
+          log((dir.path() / "scan.log").string()) {}
+};
+
+PreparedCorpus& corpusOf(int profile) {
+    static std::unique_ptr<PreparedCorpus> corpora[2];
+    if (!corpora[profile]) {
+        corpora[profile].reset(new PreparedCorpus(profile == 0 ? linkedSnapshots() : smallFiles()));
+    }
+    return *corpora[profile];
+}
+
+void scanCorpus(benchmark::State& state, int profile, bool dedup) {
+    PreparedCorpus& prepared = corpusOf(profile);
+    const bench_utils::Corpus& corpus = prepared.corpus;
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(corpus.base);
+    ScanOptions options;
+    options.dedupHardLinks = dedup;
+    scanner->setScanOptions(options);
+
+    ScanResult result;
+    for (auto _ : state) {
+        result = scanner->scanDirectory(corpus.root, prepared.log);
+        if (result.totalFiles != corpus.files || result.malwareFiles != corpus.malwareFiles) {
+            state.SkipWithError("scan result does not match the corpus");
+        }
+    }
+    destroyScanner(scanner);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.bytes));
+    state.counters["files_per_second"] =
+        benchmark::Counter(corpus.files, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["bytes_read"] = static_cast<double>(result.metrics.bytesHashed);
+    state.counters["linked_files"] = result.linkedFiles;
+}
+
+void BM_LinkedSnapshotsEveryPath(benchmark::State& state) {
+    scanCorpus(state, 0, false);
+}
+void BM_LinkedSnapshotsDedup(benchmark::State& state) {
+    scanCorpus(state, 0, true);
+}
+void BM_SmallFilesNoDedup(benchmark::State& state) {
+    scanCorpus(state, 1, false);
+}
+void BM_SmallFilesDedup(benchmark::State& state) {
+    scanCorpus(state, 1, true);
+}
+
+BENCHMARK(BM_LinkedSnapshotsEveryPath)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LinkedSnapshotsDedup)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SmallFilesNoDedup)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SmallFilesDedup)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
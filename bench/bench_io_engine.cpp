@@ -0,0 +1,120 @@
+#include <benchmark/benchmark.h>
+#include "uring_file_hasher.h"
+#include "work_stealing_pool.h"
+#include "bench_utils.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+
+namespace {
+
+// Набор файлов одного размера; строится один раз на размер
+struct FileSet {
+    bench_utils::TempDir dir;
+    std::vector<std::string> paths;
+    uint64_t bytes = 0;
+
+    static FileSet& get(size_t count, size_t size) {
+        static std::unique_ptr<FileSet> set;
+        static size_t builtCount = 0, builtSize = 0;
+        if (!set || builtCount != count || builtSize != size) {
+            set.reset();
+            set.reset(new FileSet());
+            for (size_t i = 0; i < count; ++i) {
+                set->paths.push_back(bench_utils::writeFile(
+                    set->dir.path() / ("d" + std::to_string(i % 64)) / ("f" + std::to_string(i)),
+                    size, static_cast<unsigned int>(i)));
+            }
+            set->bytes = static_cast<uint64_t>(count) * size;
+            builtCount = count;
+            builtSize = size;
+        }
+        return *set;
+    }
+};
+
+// Пачки файлов раздаются задачами пула; каждый поток хеширует своим хешером.
+// Blocking - прежний путь: поток стоит на каждом open/read.
+template <typename Hasher>
+void hashAll(benchmark::State& state, size_t count, size_t size, size_t batchSize, bool cold) {
+    FileSet& files = FileSet::get(count, size);
+    size_t threads = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            bench_utils::dropCache(files.paths);
+            state.ResumeTiming();
+        }
+        std::atomic<uint64_t> hashed{0};
+        WorkStealingPool pool(threads);
+        for (size_t first = 0; first < files.paths.size(); first += batchSize) {
+            size_t n = std::min(batchSize, files.paths.size() - first);
+            pool.PushTask([&, first, n]() {
+                thread_local Hasher hasher;
+                hasher.hashFiles(files.paths.data() + first, n, [&](size_t, const MD5Digest* digest) {
+                    if (digest) hashed++;
+                });
+            });
+        }
+        pool.Terminate(true);
+        if (hashed != files.paths.size()) {
+            state.SkipWithError("not all files hashed");
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * files.bytes));
+    state.counters["files_per_second"] = benchmark::Counter(static_cast<double>(files.paths.size()),
+                                                            benchmark::Counter::kIsIterationInvariantRate);
+}
+
+const size_t SMALL_COUNT = 8192;
+const size_t SMALL_SIZE = 4096;
+const size_t LARGE_COUNT = 8;
+const size_t LARGE_SIZE = 128 << 20;
+
+size_t blockingBatch() { return MD5MultiBuffer::best().lanes * 4; }
+size_t uringBatch() { return UringFileHasher::DEFAULT_QUEUE_DEPTH * 2; }
+
+void BM_SmallColdBlocking(benchmark::State& state) {
+    hashAll<MultiBufferFileHasher>(state, SMALL_COUNT, SMALL_SIZE, blockingBatch(), true);
+}
+void BM_SmallColdUring(benchmark::State& state) {
+    if (!UringFileHasher::supported()) {
+        state.SkipWithError("io_uring is not available");
+        return;
+    }
+    hashAll<UringFileHasher>(state, SMALL_COUNT, SMALL_SIZE, uringBatch(), true);
+}
+void BM_SmallWarmBlocking(benchmark::State& state) {
+    hashAll<MultiBufferFileHasher>(state, SMALL_COUNT, SMALL_SIZE, blockingBatch(), false);
+}
+void BM_SmallWarmUring(benchmark::State& state) {
+    if (!UringFileHasher::supported()) {
+        state.SkipWithError("io_uring is not available");
+        return;
+    }
+    hashAll<UringFileHasher>(state, SMALL_COUNT, SMALL_SIZE, uringBatch(), false);
+}
+// Крупные файлы: пачка - по файлу на дорожку, иначе все достанется одному потоку
+void BM_LargeColdBlocking(benchmark::State& state) {
+    hashAll<MultiBufferFileHasher>(state, LARGE_COUNT, LARGE_SIZE, 1, true);
+}
+void BM_LargeColdUring(benchmark::State& state) {
+    if (!UringFileHasher::supported()) {
+        state.SkipWithError("io_uring is not available");
+        return;
+    }
+    hashAll<UringFileHasher>(state, LARGE_COUNT, LARGE_SIZE, LARGE_COUNT, true);
+}
+
+// Аргумент - число потоков пула
+BENCHMARK(BM_SmallColdBlocking)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SmallColdUring)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SmallWarmBlocking)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SmallWarmUring)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LargeColdBlocking)->Arg(1)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(2);
+BENCHMARK(BM_LargeColdUring)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(2);
+
+}
+
+BENCHMARK_MAIN();
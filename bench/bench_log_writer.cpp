@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+#include "scan_log_writer.h"
+#include "bench_utils.h"
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int TOTAL_LINES = 1000000;
+const char* const HASH = "5d41402abc4b2a76b9719d911017c592";
+const char* const VERDICT = "Trojan.Generic";
+
+// Запускает threads потоков, каждый пишет свою долю TOTAL_LINES строк через write(path)
+template <typename Write>
+void runThreads(int threads, Write write) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            std::string path = "/scan/root/dir" + std::to_string(t) + "/file_000000.bin";
+            for (int i = t; i < TOTAL_LINES; i += threads) {
+                // Номер файла меняется, длина пути - нет
+                for (int n = i, p = static_cast<int>(path.size()) - 5; p > static_cast<int>(path.size()) - 11; --p, n /= 10) {
+                    path[p] = static_cast<char>('0' + n % 10);
+                }
+                write(path);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void setCounters(benchmark::State& state) {
+    state.counters["lines_per_second"] =
+        benchmark::Counter(TOTAL_LINES, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Прежний путь: общий ofstream под мьютексом и std::endl на каждую строку
+void BM_LogMutexEndl(benchmark::State& state) {
+    bench_utils::TempDir dir;
+    std::string path = (dir.path() / "scan.log").string();
+    for (auto _ : state) {
+        std::ofstream log(path, std::ios::trunc);
+        std::mutex mutex;
+        runThreads(static_cast<int>(state.range(0)), [&](const std::string& file) {
+            std::lock_guard<std::mutex> lock(mutex);
+            log << file << ";" << HASH << ";" << VERDICT << std::endl;
+        });
+    }
+    setCounters(state);
+}
+
+// Тот же мьютекс, но без сброса на каждой строке: вклад одной только сериализации
+void BM_LogMutexNoFlush(benchmark::State& state) {
+    bench_utils::TempDir dir;
+    std::string path = (dir.path() / "scan.log").string();
+    for (auto _ : state) {
+        std::ofstream log(path, std::ios::trunc);
+        std::mutex mutex;
+        runThreads(static_cast<int>(state.range(0)), [&](const std::string& file) {
+            std::lock_guard<std::mutex> lock(mutex);
+            log << file << ";" << HASH << ";" << VERDICT << '\n';
+        });
+    }
+    setCounters(state);
+}
+
+// Буферы потоков, MPSC-очередь и поток-писатель с writev
+void logWriter(benchmark::State& state, LogDurability durability) {
+    bench_utils::TempDir dir;
+    std::string path = (dir.path() / "scan.log").string();
+    LogWriterOptions options;
+    options.durability = durability;
+    uint64_t writes = 0;
+    for (auto _ : state) {
+        ScanLogWriter log(options);
+        log.open(path, "file_path;hash;verdict\n");
+        runThreads(static_cast<int>(state.range(0)), [&](const std::string& file) {
+            log.appendLine({file, HASH, VERDICT});
+        });
+        if (!log.close()) {
+            state.SkipWithError("log write failed");
+        }
+        writes = log.stats().writes;
+    }
+    setCounters(state);
+    state.counters["writes"] = static_cast<double>(writes);
+}
+
+void BM_LogWriterBuffered(benchmark::State& state) {
+    logWriter(state, LogDurability::Buffered);
+}
+void BM_LogWriterInterval(benchmark::State& state) {
+    logWriter(state, LogDurability::Interval);
+}
+
+// Аргумент - число пишущих потоков
+BENCHMARK(BM_LogMutexEndl)->Arg(1)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LogMutexNoFlush)->Arg(1)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LogWriterBuffered)->Arg(1)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_LogWriterInterval)->Arg(32)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
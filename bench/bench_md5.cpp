@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+#include "md5_calculator.h"
+#include "bench_utils.h"
+
+#ifdef _WIN32
+#include <wincrypt.h>
+#endif
+
+namespace {
+
+// Накладные расходы на один файл: открытие, чтение, хеширование, закрытие
+void BM_CalculateFileMD5(benchmark::State& state) {
+    bench_utils::TempDir dir;
+    std::string path = bench_utils::writeFile(dir.path() / "file.bin", static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MD5Calculator::calculateFileMD5(path));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalculateFileMD5)->Arg(0)->Arg(4096)->Arg(1 << 20);
+
+// Чистая скорость ядра MD5 на данных в памяти
+void BM_MD5Update(benchmark::State& state) {
+    std::string data(static_cast<size_t>(state.range(0)), 'x');
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MD5::hash(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MD5Update)->Arg(64)->Arg(4096)->Arg(1 << 20);
+
+#ifdef _WIN32
+// Прежняя реализация: контекст CryptoAPI создается на каждый файл
+std::string cryptoApiFileMD5(const std::string& filePath) {
+    HCRYPTPROV hProv = 0;
+    HCRYPTHASH hHash = 0;
+    HANDLE hFile = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
+    CryptCreateHash(hProv, CALG_MD5, 0, 0, &hHash);
+
+    BYTE buffer[MD5Calculator::BUFFER_SIZE];
+    DWORD bytesRead = 0;
+    while (ReadFile(hFile, buffer, sizeof(buffer), &bytesRead, NULL) && bytesRead > 0) {
+        CryptHashData(hHash, buffer, bytesRead, 0);
+    }
+
+    BYTE hash[16];
+    DWORD hashLength = sizeof(hash);
+    CryptGetHashParam(hHash, HP_HASHVAL, hash, &hashLength, 0);
+
+    CryptDestroyHash(hHash);
+    CryptReleaseContext(hProv, 0);
+    CloseHandle(hFile);
+    return MD5Calculator::bytesToHexString(hash, hashLength);
+}
+
+void BM_CryptoApiFileMD5(benchmark::State& state) {
+    bench_utils::TempDir dir;
+    std::string path = bench_utils::writeFile(dir.path() / "file.bin", static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cryptoApiFileMD5(path));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CryptoApiFileMD5)->Arg(0)->Arg(4096)->Arg(1 << 20);
+#endif
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+#include "md5_multibuffer.h"
+#include "bench_utils.h"
+#include <cmath>
+#include <random>
+
+namespace {
+
+// Дерево файлов смешанного размера: от 64 байт до 256 КиБ, лог-равномерно
+struct MixedCorpus {
+    bench_utils::TempDir dir;
+    std::vector<std::string> paths;
+    int64_t totalBytes = 0;
+
+    MixedCorpus() {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<double> logSize(6.0, 18.0);
+        for (int i = 0; i < 512; ++i) {
+            size_t size = static_cast<size_t>(std::pow(2.0, logSize(rng)));
+            auto path = dir.path() / ("d" + std::to_string(i % 16)) / ("f" + std::to_string(i) + ".bin");
+            paths.push_back(bench_utils::writeFile(path, size, static_cast<unsigned int>(i)));
+            totalBytes += static_cast<int64_t>(size);
+        }
+    }
+
+    static MixedCorpus& instance() {
+        static MixedCorpus corpus;
+        return corpus;
+    }
+};
+
+// Пропускная способность одного ядра: каждое ISA против скалярного пути
+void BM_HashMixedTree(benchmark::State& state) {
+    auto isa = static_cast<MD5MultiBuffer::Isa>(state.range(0));
+    if (!MD5MultiBuffer::supported(isa)) {
+        state.SkipWithError("ISA is not supported by this CPU");
+        return;
+    }
+
+    MixedCorpus& corpus = MixedCorpus::instance();
+    MultiBufferFileHasher hasher(MD5MultiBuffer::get(isa));
+    state.SetLabel(hasher.kernel().name);
+
+    for (auto _ : state) {
+        size_t errors = 0;
+        hasher.hashFiles(corpus.paths, [&](size_t, const MD5Digest* digest) {
+            if (!digest) errors++;
+            benchmark::DoNotOptimize(digest);
+        });
+        benchmark::DoNotOptimize(errors);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(corpus.paths.size()));
+    state.SetBytesProcessed(state.iterations() * corpus.totalBytes);
+}
+BENCHMARK(BM_HashMixedTree)
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::Scalar))
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::SSE2))
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::AVX2))
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::AVX512))
+    ->Unit(benchmark::kMillisecond);
+
+// Чистое ядро на данных в памяти, без файлового ввода-вывода
+void BM_MultiBlockKernel(benchmark::State& state) {
+    auto isa = static_cast<MD5MultiBuffer::Isa>(state.range(0));
+    MD5MultiBufferKernel kernel = MD5MultiBuffer::get(isa);
+    if (!kernel.isVector()) {
+        state.SkipWithError("ISA is not supported by this CPU");
+        return;
+    }
+    state.SetLabel(kernel.name);
+
+    const size_t blocks = 256;
+    std::vector<uint8_t> data(kernel.lanes * blocks * MD5::BLOCK_SIZE, 0x5a);
+    std::vector<const uint8_t*> pointers;
+    for (size_t l = 0; l < kernel.lanes; ++l) {
+        pointers.push_back(data.data() + l * blocks * MD5::BLOCK_SIZE);
+    }
+    std::vector<uint32_t> digestState(4 * kernel.lanes, 0);
+
+    for (auto _ : state) {
+        kernel.process(digestState.data(), pointers.data(), blocks);
+        benchmark::DoNotOptimize(digestState.data());
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+}
+BENCHMARK(BM_MultiBlockKernel)
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::SSE2))
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::AVX2))
+    ->Arg(static_cast<int>(MD5MultiBuffer::Isa::AVX512));
+
+}
+
+BENCHMARK_MAIN();
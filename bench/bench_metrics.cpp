@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Мелкие файлы: на них накладные расходы замеров на файл заметнее всего
+struct SmallFilesTree {
+    static constexpr int FILES = 20000;
+    static constexpr int DIRECTORIES = 200;
+    static constexpr int SIGNATURES = 1000;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::string root;
+    std::string base;
+    std::string log;
+
+    SmallFilesTree() {
+        std::mt19937_64 rng(17);
+        base = (work.path() / "base.csv").string();
+        std::ofstream csv(base);
+        for (int s = 0; s < SIGNATURES; ++s) {
+            char hash[33];
+            std::snprintf(hash, sizeof(hash), "%016llx%016llx",
+                          static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+            csv << hash << ";Malware" << s << "\n";
+        }
+
+        root = (dir.path() / "tree").string();
+        for (int f = 0; f < FILES; ++f) {
+            fs::path path = fs::path(root) / ("dir" + std::to_string(f % DIRECTORIES)) /
+                            ("file" + std::to_string(f) + ".bin");
+            bench_utils::writeFile(path, 512 + static_cast<size_t>(rng() % 3584), static_cast<unsigned int>(f));
+        }
+        log = (work.path() / "scan.log").string();
+    }
+
+    static SmallFilesTree& instance() {
+        static SmallFilesTree tree;
+        return tree;
+    }
+};
+
+void scanTree(benchmark::State& state, bool timings, bool progress) {
+    SmallFilesTree& tree = SmallFilesTree::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(tree.base);
+    ScanOptions options;
+    options.collectTimings = timings;
+    std::atomic<uint64_t> reports{0};
+    if (progress) {
+        options.progressIntervalMs = 10;
+        options.metricsPath = (tree.work.path() / "scanner.prom").string();
+        scanner->setProgressCallback([&](const ScanProgress&) { reports++; });
+    }
+    scanner->setScanOptions(options);
+
+    for (auto _ : state) {
+        ScanResult result = scanner->scanDirectory(tree.root, tree.log);
+        if (result.metrics.filesDone != SmallFilesTree::FILES) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.counters["files_per_second"] =
+        benchmark::Counter(SmallFilesTree::FILES, benchmark::Counter::kIsIterationInvariantRate);
+    if (progress) {
+        state.counters["reports"] = static_cast<double>(reports) / static_cast<double>(state.iterations());
+    }
+}
+
+// Только счетчики: так сканирование идет по умолчанию
+void BM_ScanCounters(benchmark::State& state) {
+    scanTree(state, false, false);
+}
+void BM_ScanTimings(benchmark::State& state) {
+    scanTree(state, true, false);
+}
+// Замеры, отчет каждые 10 мс и файл метрик Prometheus
+void BM_ScanTimingsProgress(benchmark::State& state) {
+    scanTree(state, true, true);
+}
+
+BENCHMARK(BM_ScanCounters)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanTimings)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanTimingsProgress)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
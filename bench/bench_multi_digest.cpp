@@ -0,0 +1,159 @@
+#include <benchmark/benchmark.h>
+#include "md5_multibuffer.h"
+#include "bench_utils.h"
+#include <vector>
+
+namespace {
+
+// Корпус файлов по 1 МиБ: после первой итерации он в page cache,
+// и разница между вариантами - стоимость хеширования, а не диска
+struct DigestCorpus {
+    bench_utils::TempDir dir;
+    std::vector<std::string> paths;
+    int64_t totalBytes = 0;
+
+    DigestCorpus() {
+        const size_t fileSize = 1 << 20;
+        for (int i = 0; i < 64; ++i) {
+            auto path = dir.path() / ("f" + std::to_string(i) + ".bin");
+            paths.push_back(bench_utils::writeFile(path, fileSize, static_cast<unsigned int>(i)));
+            totalBytes += static_cast<int64_t>(fileSize);
+        }
+    }
+
+    static DigestCorpus& instance() {
+        static DigestCorpus corpus;
+        return corpus;
+    }
+};
+
+// Секунд на гигабайт: обратная величина пропускной способности
+void setCostPerGb(benchmark::State& state, int64_t bytesPerIteration) {
+    state.counters["s_per_GB"] = benchmark::Counter(static_cast<double>(bytesPerIteration) / 1e9,
+                                                    benchmark::Counter::kIsIterationInvariantRate |
+                                                        benchmark::Counter::kInvert);
+}
+
+enum Algorithm { Md5, Sha1Scalar, Sha1Ni, Sha256Scalar, Sha256Ni, Xxh3 };
+
+// Один алгоритм на данных в памяти: скалярные SHA против SHA-NI и MD5/XXH3 рядом
+void BM_Algorithm(benchmark::State& state) {
+    auto algorithm = static_cast<Algorithm>(state.range(0));
+    bool needsShaNi = algorithm == Sha1Ni || algorithm == Sha256Ni;
+    if (needsShaNi && !ShaKernels::supported(ShaKernels::Isa::ShaNi)) {
+        state.SkipWithError("SHA-NI is not supported by this CPU");
+        return;
+    }
+    ShaKernel kernel = ShaKernels::get(needsShaNi ? ShaKernels::Isa::ShaNi : ShaKernels::Isa::Scalar);
+    const char* labels[] = {"md5", "sha1 scalar", "sha1 sha-ni", "sha256 scalar", "sha256 sha-ni", "xxh3"};
+    state.SetLabel(labels[algorithm]);
+
+    std::vector<uint8_t> data(1 << 20, 0x5a);
+    MD5 md5;
+    SHA1 sha1(kernel);
+    SHA256 sha256(kernel);
+    XXH3 xxh3;
+    for (auto _ : state) {
+        switch (algorithm) {
+        case Md5:
+            md5.update(data.data(), data.size());
+            benchmark::DoNotOptimize(md5.finalize());
+            break;
+        case Sha1Scalar:
+        case Sha1Ni:
+            sha1.update(data.data(), data.size());
+            benchmark::DoNotOptimize(sha1.finalize());
+            break;
+        case Sha256Scalar:
+        case Sha256Ni:
+            sha256.update(data.data(), data.size());
+            benchmark::DoNotOptimize(sha256.finalize());
+            break;
+        case Xxh3:
+            xxh3.reset();
+            xxh3.update(data.data(), data.size());
+            benchmark::DoNotOptimize(xxh3.digest());
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+    setCostPerGb(state, static_cast<int64_t>(data.size()));
+}
+BENCHMARK(BM_Algorithm)->DenseRange(Md5, Xxh3);
+
+// Рабочий путь сканера: multi-buffer MD5 и дополнительные алгоритмы из тех же
+// кусков чтения. Стоимость набора дайджестов на ГБ против одного MD5
+void BM_SinglePass(benchmark::State& state) {
+    auto extra = static_cast<DigestMask>(state.range(0));
+    DigestCorpus& corpus = DigestCorpus::instance();
+    MultiBufferFileHasher hasher;
+    hasher.setDigests(extra);
+    state.SetLabel(formatDigestMask(DIGEST_MD5 | extra));
+
+    for (auto _ : state) {
+        size_t errors = 0;
+        hasher.hashFiles(corpus.paths, [&](size_t, const MD5Digest* digest) {
+            if (!digest) errors++;
+            benchmark::DoNotOptimize(hasher.lastDigests());
+        });
+        benchmark::DoNotOptimize(errors);
+    }
+    state.SetBytesProcessed(state.iterations() * corpus.totalBytes);
+    setCostPerGb(state, corpus.totalBytes);
+}
+BENCHMARK(BM_SinglePass)
+    ->Arg(0)
+    ->Arg(DIGEST_XXH3)
+    ->Arg(DIGEST_SHA1)
+    ->Arg(DIGEST_SHA256)
+    ->Arg(DIGEST_SHA1 | DIGEST_SHA256)
+    ->Arg(DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3)
+    ->Unit(benchmark::kMillisecond);
+
+// Те же алгоритмы одним чтением (DigestSet) против отдельного чтения на каждый:
+// так считали бы несколько дайджестов без общего конвейера
+void BM_PassesPerAlgorithm(benchmark::State& state) {
+    const bool separate = state.range(0) != 0;
+    const DigestMask mask = DIGEST_MD5 | DIGEST_SHA1 | DIGEST_SHA256;
+    DigestCorpus& corpus = DigestCorpus::instance();
+    state.SetLabel(separate ? "read per algorithm" : "one read");
+
+    FileReader reader;
+    DigestSet digests;
+    std::vector<DigestMask> passes;
+    if (separate) {
+        passes = {DIGEST_MD5, DIGEST_SHA1, DIGEST_SHA256};
+    } else {
+        passes = {mask};
+    }
+    int64_t bytesRead = 0;
+    for (auto _ : state) {
+        for (const std::string& path : corpus.paths) {
+            FileDigests result;
+            for (DigestMask pass : passes) {
+                if (!reader.open(path)) {
+                    state.SkipWithError("Cannot open corpus file");
+                    return;
+                }
+                digests.reset(pass);
+                const uint8_t* data = nullptr;
+                int64_t got;
+                while ((got = reader.next(data)) > 0) {
+                    digests.update(data, static_cast<size_t>(got));
+                    bytesRead += got;
+                }
+                digests.finalize(result);
+            }
+            benchmark::DoNotOptimize(result);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * corpus.totalBytes);
+    state.counters["read_bytes"] = benchmark::Counter(static_cast<double>(bytesRead),
+                                                      benchmark::Counter::kAvgIterations);
+    setCostPerGb(state, corpus.totalBytes);
+}
+BENCHMARK(BM_PassesPerAlgorithm)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "md5_calculator.h"
+#include "bench_utils.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Крупные файлы одного размера и база, где у каждой сигнатуры этого размера
+// есть ключ префикса: фильтр по размеру пропускает все файлы, и отсеять их
+// можно только по префиксу. С ключом совпадает один файл из FILES.
+struct LargeCorpus {
+    static constexpr int FILES = 8;
+    static constexpr size_t FILE_SIZE = 256 << 20;
+    static constexpr int SIGNATURES = 1000;
+    static constexpr uint64_t PREFIX_LENGTH = 64 * 1024;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::string root;
+    std::string base;
+    std::string log;
+    std::vector<std::string> paths;
+
+    LargeCorpus() {
+        root = (dir.path() / "tree").string();
+        for (int f = 0; f < FILES; ++f) {
+            paths.push_back(bench_utils::writeFile(fs::path(root) / ("f" + std::to_string(f)), FILE_SIZE,
+                                                   static_cast<unsigned int>(f)));
+        }
+
+        // Файл 0 совпадает с сигнатурой по префиксу, но не по полному хешу
+        std::mt19937_64 rng(14);
+        MD5Digest matchingPrefix = MD5Calculator::calculatePrefixDigest(paths[0], PREFIX_LENGTH);
+        base = (work.path() / "base.csv").string();
+        std::ofstream csv(base);
+        for (int s = 0; s < SIGNATURES; ++s) {
+            MD5Digest full, prefix;
+            for (auto& b : full) b = static_cast<uint8_t>(rng());
+            for (auto& b : prefix) b = static_cast<uint8_t>(rng());
+            if (s == 0) prefix = matchingPrefix;
+            csv << MD5Calculator::bytesToHexString(full.data(), full.size()) << ";Malware" << s << ";" << FILE_SIZE
+                << ";" << MD5Calculator::bytesToHexString(prefix.data(), prefix.size()) << "\n";
+        }
+        log = (work.path() / "scan.log").string();
+    }
+
+    static LargeCorpus& instance() {
+        static LargeCorpus corpus;
+        return corpus;
+    }
+};
+
+void scanCorpus(benchmark::State& state, bool prefixCheck, bool cold) {
+    LargeCorpus& corpus = LargeCorpus::instance();
+    IScannerCore* scanner = createScanner();
+    ScanOptions options;
+    options.prefixCheck = prefixCheck;
+    options.prefixLength = LargeCorpus::PREFIX_LENGTH;
+    scanner->setScanOptions(options);
+    scanner->loadMalwareBase(corpus.base);
+
+    ScanResult result;
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            bench_utils::dropCache(corpus.paths);
+            state.ResumeTiming();
+        }
+        result = scanner->scanDirectory(corpus.root, corpus.log);
+        if (result.totalFiles != LargeCorpus::FILES || result.errors != 0) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    uint64_t bytes = static_cast<uint64_t>(LargeCorpus::FILES) * LargeCorpus::FILE_SIZE;
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+    state.counters["rejected_files"] = result.prefixRejectedFiles;
+    state.counters["skipped_bytes_ratio"] =
+        static_cast<double>(result.prefixSkippedBytes) / static_cast<double>(bytes);
+}
+
+// Прежний путь: каждый файл читается целиком
+void BM_LargeColdFullHash(benchmark::State& state) {
+    scanCorpus(state, false, true);
+}
+// Файлы, чей префикс не совпал ни с одним ключом, дальше префикса не читаются
+void BM_LargeColdPrefixKey(benchmark::State& state) {
+    scanCorpus(state, true, true);
+}
+void BM_LargeWarmFullHash(benchmark::State& state) {
+    scanCorpus(state, false, false);
+}
+void BM_LargeWarmPrefixKey(benchmark::State& state) {
+    scanCorpus(state, true, false);
+}
+
+BENCHMARK(BM_LargeColdFullHash)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(2);
+BENCHMARK(BM_LargeColdPrefixKey)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(2);
+BENCHMARK(BM_LargeWarmFullHash)->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(2);
+BENCHMARK(BM_LargeWarmPrefixKey)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,141 @@
+#include <benchmark/benchmark.h>
+#include "file_io.h"
+#include "bench_utils.h"
+#include <fstream>
+#include <memory>
+#include <random>
+
+namespace {
+
+// Файлы одного размера, общим объемом около TARGET_BYTES; строится один набор за раз
+struct SizedFiles {
+    static constexpr uint64_t TARGET_BYTES = 256ull << 20;
+    static constexpr size_t MAX_FILES = 1000;
+
+    uint64_t size = 0;
+    bench_utils::TempDir dir;
+    std::vector<std::string> paths;
+
+    static SizedFiles& get(uint64_t size) {
+        static std::unique_ptr<SizedFiles> files;
+        if (!files || files->size != size) {
+            files.reset();
+            files.reset(new SizedFiles());
+            files->build(size);
+        }
+        return *files;
+    }
+
+    void build(uint64_t fileSize) {
+        size = fileSize;
+        size_t count = static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(MAX_FILES, TARGET_BYTES / std::max<uint64_t>(1, size))));
+        // Файлы до 8 ГиБ пишутся блоками по 1 МиБ
+        std::vector<char> block(1 << 20);
+        std::mt19937_64 rng(size);
+        for (auto& c : block) c = static_cast<char>(rng());
+        for (size_t i = 0; i < count; ++i) {
+            std::string path = (dir.path() / ("f" + std::to_string(i))).string();
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            for (uint64_t written = 0; written < size;) {
+                size_t n = static_cast<size_t>(std::min<uint64_t>(block.size(), size - written));
+                block[0] = static_cast<char>(i + written);
+                file.write(block.data(), static_cast<std::streamsize>(n));
+                written += n;
+            }
+            paths.push_back(path);
+        }
+    }
+};
+
+// Каждая страница куска читается, иначе отображение не подгрузит данные
+uint64_t touch(const uint8_t* data, size_t size) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; i += 4096) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Прежний путь: 8 КиБ буфер в цикле read до возврата 0
+void BM_ReadLegacy8K(benchmark::State& state, uint64_t size) {
+    SizedFiles& files = SizedFiles::get(size);
+    uint64_t syscalls = 0;
+    uint8_t buffer[8192];
+    for (auto _ : state) {
+        for (const auto& path : files.paths) {
+            InputFile file;
+            file.open(path);
+            int64_t n;
+            syscalls += 2;
+            while ((n = file.read(buffer, sizeof(buffer))) > 0) {
+                benchmark::DoNotOptimize(touch(buffer, static_cast<size_t>(n)));
+                syscalls++;
+            }
+            syscalls++;
+        }
+    }
+    double filesRead = static_cast<double>(state.iterations() * files.paths.size());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * files.paths.size() * size));
+    state.counters["syscalls_per_file"] = static_cast<double>(syscalls) / filesRead;
+}
+
+void BM_ReadStrategy(benchmark::State& state, uint64_t size, ReadStrategy strategy) {
+    SizedFiles& files = SizedFiles::get(size);
+    ReadOptions options;
+    options.strategy = strategy;
+    FileReader reader(options);
+    for (auto _ : state) {
+        for (const auto& path : files.paths) {
+            if (!reader.open(path)) {
+                state.SkipWithError("open failed");
+                return;
+            }
+            const uint8_t* data = nullptr;
+            int64_t n;
+            while ((n = reader.next(data)) > 0) {
+                benchmark::DoNotOptimize(touch(data, static_cast<size_t>(n)));
+            }
+            reader.close();
+        }
+    }
+    double filesRead = static_cast<double>(state.iterations() * files.paths.size());
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * files.paths.size() * size));
+    state.counters["syscalls_per_file"] = static_cast<double>(reader.syscalls()) / filesRead;
+}
+
+std::string sizeLabel(uint64_t size) {
+    if (size >= (1ull << 30)) return std::to_string(size >> 30) + "G";
+    if (size >= (1ull << 20)) return std::to_string(size >> 20) + "M";
+    if (size >= (1ull << 10)) return std::to_string(size >> 10) + "K";
+    return std::to_string(size) + "B";
+}
+
+// Размеры от пустого файла до 8 ГиБ; SingleRead - только для файлов, помещающихся в буфер
+const int registered = []() {
+    const uint64_t sizes[] = {0, 200, 4ull << 10, 64ull << 10, 1ull << 20, 16ull << 20,
+                              256ull << 20, 1ull << 30, 8ull << 30};
+    const std::pair<const char*, ReadStrategy> strategies[] = {
+        {"Stream", ReadStrategy::Stream}, {"SingleRead", ReadStrategy::SingleRead},
+        {"Mapped", ReadStrategy::Mapped}, {"Direct", ReadStrategy::Direct}, {"Auto", ReadStrategy::Auto}};
+
+    for (uint64_t size : sizes) {
+        std::string label = sizeLabel(size);
+        // Крупные файлы не помещаются в page cache целиком - одна итерация
+        int iterations = size >= (1ull << 30) ? 1 : 0;
+        auto apply = [&](benchmark::internal::Benchmark* b) {
+            b->Unit(benchmark::kMillisecond)->UseRealTime();
+            if (iterations) b->Iterations(iterations);
+        };
+        apply(benchmark::RegisterBenchmark(("BM_ReadLegacy8K/" + label).c_str(), BM_ReadLegacy8K, size));
+        for (const auto& strategy : strategies) {
+            if (strategy.second == ReadStrategy::SingleRead && size > ReadOptions::DEFAULT_BUFFER_SIZE) continue;
+            apply(benchmark::RegisterBenchmark((std::string("BM_Read") + strategy.first + "/" + label).c_str(),
+                                               BM_ReadStrategy, size, strategy.second));
+        }
+    }
+    return 0;
+}();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "scan_result_stream.h"
+#include "bench_utils.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Много мелких файлов в глубоких каталогах: на таком дереве запись о каждом
+// файле заметнее всего на фоне хеширования. Найденных файлов почти нет,
+// поэтому лог только найденных почти пуст
+struct SmallFilesTree {
+    static constexpr int FILES = 20000;
+    static constexpr int DIRECTORIES = 200;
+    static constexpr int SIGNATURES = 1000;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::string root;
+    std::string base;
+    std::string log;
+    std::string results;
+    uint64_t pathBytes = 0;
+
+    SmallFilesTree() {
+        std::mt19937_64 rng(17);
+        base = (work.path() / "base.csv").string();
+        std::ofstream csv(base);
+        for (int s = 0; s < SIGNATURES; ++s) {
+            char hash[33];
+            std::snprintf(hash, sizeof(hash), "%016llx%016llx",
+                          static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+            csv << hash << ";Malware" << s << "\n";
+        }
+
+        root = (dir.path() / "home" / "user" / "projects").string();
+        for (int f = 0; f < FILES; ++f) {
+            fs::path path = fs::path(root) / ("module" + std::to_string(f % DIRECTORIES)) / "src" /
+                            ("source_file_" + std::to_string(f) + ".cpp");
+            bench_utils::writeFile(path, 512 + static_cast<size_t>(rng() % 3584), static_cast<unsigned int>(f));
+            pathBytes += path.string().size();
+        }
+        log = (work.path() / "scan.log").string();
+        results = (work.path() / "results").string();
+    }
+
+    static SmallFilesTree& instance() {
+        static SmallFilesTree tree;
+        return tree;
+    }
+};
+
+void scanTree(benchmark::State& state, ResultFormat format) {
+    SmallFilesTree& tree = SmallFilesTree::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(tree.base);
+    ScanOptions options;
+    options.resultFormat = format;
+    options.resultPath = tree.results;
+    scanner->setScanOptions(options);
+
+    ScanResult result;
+    for (auto _ : state) {
+        result = scanner->scanDirectory(tree.root, tree.log);
+        if (result.totalFiles != SmallFilesTree::FILES) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.counters["files_per_second"] =
+        benchmark::Counter(SmallFilesTree::FILES, benchmark::Counter::kIsIterationInvariantRate);
+    if (result.resultRecords) {
+        state.counters["bytes_per_record"] =
+            static_cast<double>(result.resultBytes) / static_cast<double>(result.resultRecords);
+        // Доля от суммарной длины путей: сколько съедает сжатие путей
+        state.counters["size_vs_paths"] =
+            static_cast<double>(result.resultBytes) / static_cast<double>(tree.pathBytes);
+    }
+}
+
+// Прежний режим: в лог попадают только найденные файлы
+void BM_ScanHitsOnly(benchmark::State& state) {
+    scanTree(state, ResultFormat::None);
+}
+void BM_ScanResultsBinary(benchmark::State& state) {
+    scanTree(state, ResultFormat::Binary);
+}
+void BM_ScanResultsNdjson(benchmark::State& state) {
+    scanTree(state, ResultFormat::Ndjson);
+}
+
+// Чтение двоичного потока: сколько записей в секунду отдает ScanResultReader
+void BM_ReadResults(benchmark::State& state) {
+    SmallFilesTree& tree = SmallFilesTree::instance();
+    std::string path = (tree.work.path() / "read.bin").string();
+    {
+        IScannerCore* scanner = createScanner();
+        scanner->loadMalwareBase(tree.base);
+        ScanOptions options;
+        options.resultFormat = ResultFormat::Binary;
+        options.resultPath = path;
+        scanner->setScanOptions(options);
+        scanner->scanDirectory(tree.root, tree.log);
+        destroyScanner(scanner);
+    }
+
+    uint64_t records = 0;
+    for (auto _ : state) {
+        ScanResultReader reader;
+        if (!reader.open(path)) {
+            state.SkipWithError("cannot open results");
+            break;
+        }
+        FileRecord record;
+        uint64_t size = 0;
+        while (reader.next(record)) {
+            size += record.size;
+        }
+        benchmark::DoNotOptimize(size);
+        records = reader.records();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * records));
+}
+
+BENCHMARK(BM_ScanHitsOnly)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanResultsBinary)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanResultsNdjson)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ReadResults)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include "corpus_generator.h"
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+// Выделения памяти за время замера: operator new заменен на весь процесс,
+// на Linux - и внутри библиотеки сканера
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+}
+
+// GCC принимает free в замененном operator delete за парный вызов к new
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Корпуса сквозного замера scanDirectory; каждый строится один раз на процесс
+bench_utils::CorpusSpec smallFiles() {
+    bench_utils::CorpusSpec spec;
+    spec.files = 20000;
+    spec.directories = 200;
+    spec.sizes = bench_utils::SizeDistribution::Uniform;
+    spec.minSize = 512;
+    spec.maxSize = 4096;
+    return spec;
+}
+
+// Размеры от 100 байт до 4 МиБ по порядку величины, база с размерами сигнатур
+bench_utils::CorpusSpec mixedSizes() {
+    bench_utils::CorpusSpec spec;
+    spec.seed = 2;
+    spec.files = 3000;
+    spec.directories = 60;
+    spec.maxSize = 4 * 1024 * 1024;
+    spec.signatures = 10000;
+    spec.signatureSizes = true;
+    return spec;
+}
+
+// Узкое глубокое дерево: цена обхода, а не чтения
+bench_utils::CorpusSpec deepTree() {
+    bench_utils::CorpusSpec spec;
+    spec.seed = 3;
+    spec.files = 10000;
+    spec.directories = 4096;
+    spec.depth = 12;
+    spec.sizes = bench_utils::SizeDistribution::Fixed;
+    spec.minSize = 256;
+    return spec;
+}
+
+struct PreparedCorpus {
+    bench_utils::TempDir dir;
+    bench_utils::Corpus corpus;
+    std::string log;
+
+    explicit PreparedCorpus(const bench_utils::CorpusSpec& spec)
+        : corpus(bench_utils::generateCorpus(spec, dir.path())),
+          log((dir.path() / "scan.log").string()) {}
+};
+
+PreparedCorpus& corpusOf(int profile) {
+    static std::unique_ptr<PreparedCorpus> corpora[3];
+    if (!corpora[profile]) {
+        bench_utils::CorpusSpec specs[] = {smallFiles(), mixedSizes(), deepTree()};
+        corpora[profile].reset(new PreparedCorpus(specs[profile]));
+    }
+    return *corpora[profile];
+}
+
+// Полное сканирование с настройками по умолчанию; число найденных файлов сверяется с корпусом.
+// allocations_per_file - выделений памяти на файл после первого (прогревочного) сканирования
+void scanCorpus(benchmark::State& state, int profile) {
+    PreparedCorpus& prepared = corpusOf(profile);
+    const bench_utils::Corpus& corpus = prepared.corpus;
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(corpus.base);
+    scanner->scanDirectory(corpus.root, prepared.log);
+
+    uint64_t allocationsBefore = allocations.load();
+    for (auto _ : state) {
+        ScanResult result = scanner->scanDirectory(corpus.root, prepared.log);
+        if (result.totalFiles != corpus.files || result.malwareFiles != corpus.malwareFiles) {
+            state.SkipWithError("scan result does not match the corpus");
+        }
+    }
+    uint64_t scanAllocations = allocations.load() - allocationsBefore;
+    destroyScanner(scanner);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * corpus.bytes));
+    state.counters["files_per_second"] =
+        benchmark::Counter(corpus.files, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["malware_files"] = corpus.malwareFiles;
+    state.counters["allocations_per_file"] =
+        static_cast<double>(scanAllocations) / static_cast<double>(state.iterations() * corpus.files);
+}
+
+void BM_ScanSmallFiles(benchmark::State& state) {
+    scanCorpus(state, 0);
+}
+void BM_ScanMixedSizes(benchmark::State& state) {
+    scanCorpus(state, 1);
+}
+void BM_ScanDeepTree(benchmark::State& state) {
+    scanCorpus(state, 2);
+}
+
+BENCHMARK(BM_ScanSmallFiles)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanMixedSizes)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanDeepTree)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "scan_cache.h"
+#include "bench_utils.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Дерево из FILES файлов по FILE_SIZE байт в DIRECTORIES каталогах
+struct CacheTree {
+    static constexpr int FILES = 20000;
+    static constexpr int DIRECTORIES = 100;
+    static constexpr size_t FILE_SIZE = 4096;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::string root;
+    std::string base;
+    std::string log;
+
+    CacheTree() {
+        root = (dir.path() / "tree").string();
+        for (int f = 0; f < FILES; ++f) {
+            bench_utils::writeFile(fs::path(root) / ("d" + std::to_string(f % DIRECTORIES)) /
+                                   ("f" + std::to_string(f)), FILE_SIZE, static_cast<unsigned int>(f));
+        }
+        base = (work.path() / "base.csv").string();
+        std::ofstream(base) << "5d41402abc4b2a76b9719d911017c592;Malware\n";
+        log = (work.path() / "scan.log").string();
+        // Файлы моложе окна гонки не кэшируются
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ScanCache::RACY_WINDOW_NS + 100000000));
+    }
+
+    std::string changedFile(int index) const {
+        return (fs::path(root) / ("d" + std::to_string(index % DIRECTORIES)) / ("f" + std::to_string(index))).string();
+    }
+
+    static CacheTree& instance() {
+        static CacheTree tree;
+        return tree;
+    }
+};
+
+// Сканирование дерева; cachePath пустой - без кэша, fresh - кэш удаляется перед итерацией,
+// changedPercent - доля файлов, переписываемых перед каждой итерацией
+void scanTree(benchmark::State& state, const std::string& cachePath, bool fresh, int changedPercent) {
+    CacheTree& tree = CacheTree::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(tree.base);
+    ScanOptions options;
+    options.cachePath = cachePath;
+    scanner->setScanOptions(options);
+    if (!cachePath.empty() && !fresh) {
+        scanner->scanDirectory(tree.root, tree.log);
+    }
+
+    int changed = CacheTree::FILES * changedPercent / 100;
+    int cached = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (fresh) {
+            fs::remove(cachePath);
+            fs::remove(cachePath + ".journal");
+        }
+        for (int f = 0; f < changed; ++f) {
+            bench_utils::writeFile(tree.changedFile(f * 100 / changedPercent), CacheTree::FILE_SIZE,
+                                   static_cast<unsigned int>(state.iterations() + f));
+        }
+        state.ResumeTiming();
+
+        ScanResult result = scanner->scanDirectory(tree.root, tree.log);
+        cached = result.cachedFiles;
+        if (result.totalFiles != CacheTree::FILES) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.counters["files_per_second"] =
+        benchmark::Counter(CacheTree::FILES, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["cached_files"] = cached;
+}
+
+std::string cachePath(const char* name) {
+    return (CacheTree::instance().work.path() / name).string();
+}
+
+// Базовая линия: каждый файл читается и хешируется
+void BM_ScanNoCache(benchmark::State& state) {
+    scanTree(state, "", false, 0);
+}
+// Первый запуск: все хешируется, и кэш пишется с нуля
+void BM_ScanColdCache(benchmark::State& state) {
+    scanTree(state, cachePath("cold.cache"), true, 0);
+}
+// Повтор по неизмененному дереву: только обход, stat и поиск в базе
+void BM_ScanWarmCache(benchmark::State& state) {
+    scanTree(state, cachePath("warm.cache"), false, 0);
+}
+// Перед каждым повтором переписывается 1% файлов
+void BM_ScanOnePercentChanged(benchmark::State& state) {
+    scanTree(state, cachePath("changed.cache"), false, 1);
+}
+
+BENCHMARK(BM_ScanNoCache)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanColdCache)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanWarmCache)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanOnePercentChanged)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
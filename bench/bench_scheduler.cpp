@@ -0,0 +1,151 @@
+#include <benchmark/benchmark.h>
+#include "work_stealing_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * Базовая линия: прежний пул сканера - одна очередь std::function
+ * под одним мьютексом.
+ */
+class MutexThreadPool {
+public:
+    explicit MutexThreadPool(size_t threadCount) : threadCount_(threadCount) {
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads_.emplace_back([this]() { ThreadFunction(); });
+        }
+    }
+
+    ~MutexThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finish_ = true;
+        }
+        taskPushed_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void PushTask(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push(std::move(task));
+        }
+        taskPushed_.notify_one();
+    }
+
+    void WaitIdle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return tasks_.empty() && activeTasks_ == 0; });
+    }
+
+    size_t ThreadCount() const { return threadCount_; }
+
+private:
+    size_t threadCount_;
+    std::mutex mutex_;
+    std::condition_variable taskPushed_;
+    std::condition_variable idle_;
+    std::queue<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+    size_t activeTasks_ = 0;
+    bool finish_ = false;
+
+    void ThreadFunction() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                taskPushed_.wait(lock, [this]() { return finish_ || !tasks_.empty(); });
+                if (finish_ && tasks_.empty()) return;
+                task = std::move(tasks_.front());
+                tasks_.pop();
+                activeTasks_++;
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--activeTasks_ == 0 && tasks_.empty()) {
+                    idle_.notify_all();
+                }
+            }
+        }
+    }
+};
+
+constexpr int TASKS_PER_ITERATION = 100000;
+constexpr int NESTED_FANOUT = 100;
+
+// Задача размером с прежний FileTask: путь копируется в захват
+struct FileLikeTask {
+    std::string path;
+    std::atomic<int64_t>* sink;
+    void operator()() const { *sink += static_cast<int64_t>(path.size()); }
+};
+
+const std::string& samplePath() {
+    static const std::string path = "/data/corpus/some/nested/directory/file.bin";
+    return path;
+}
+
+template <class Pool>
+void submitFlat(Pool& pool, std::atomic<int64_t>& sink) {
+    for (int i = 0; i < TASKS_PER_ITERATION; ++i) {
+        pool.PushTask(FileLikeTask{samplePath(), &sink});
+    }
+    pool.WaitIdle();
+}
+
+// Внешний поток ставит NESTED_FANOUT задач, каждая из них - остальные:
+// так ставятся пачки файлов из задач обхода каталогов
+template <class Pool>
+void submitNested(Pool& pool, std::atomic<int64_t>& sink) {
+    for (int i = 0; i < NESTED_FANOUT; ++i) {
+        pool.PushTask([&pool, &sink]() {
+            for (int j = 0; j < TASKS_PER_ITERATION / NESTED_FANOUT; ++j) {
+                pool.PushTask(FileLikeTask{samplePath(), &sink});
+            }
+        });
+    }
+    pool.WaitIdle();
+}
+
+template <class Pool>
+void runScheduler(benchmark::State& state, bool nested) {
+    Pool pool(static_cast<size_t>(state.range(0)));
+    std::atomic<int64_t> sink{0};
+    for (auto _ : state) {
+        if (nested) {
+            submitNested(pool, sink);
+        } else {
+            submitFlat(pool, sink);
+        }
+    }
+    benchmark::DoNotOptimize(sink.load());
+    state.counters["tasks_per_second"] =
+        benchmark::Counter(TASKS_PER_ITERATION, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void BM_MutexPool_External(benchmark::State& state) { runScheduler<MutexThreadPool>(state, false); }
+void BM_WorkStealing_External(benchmark::State& state) { runScheduler<WorkStealingPool>(state, false); }
+void BM_MutexPool_Nested(benchmark::State& state) { runScheduler<MutexThreadPool>(state, true); }
+void BM_WorkStealing_Nested(benchmark::State& state) { runScheduler<WorkStealingPool>(state, true); }
+
+#define SCHEDULER_ARGS ->Arg(1)->Arg(4)->Arg(16)->Arg(32)->Arg(64)->Unit(benchmark::kMillisecond)->UseRealTime()
+
+BENCHMARK(BM_MutexPool_External) SCHEDULER_ARGS;
+BENCHMARK(BM_WorkStealing_External) SCHEDULER_ARGS;
+BENCHMARK(BM_MutexPool_Nested) SCHEDULER_ARGS;
+BENCHMARK(BM_WorkStealing_Nested) SCHEDULER_ARGS;
+
+}
+
+BENCHMARK_MAIN();
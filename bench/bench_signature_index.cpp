@@ -0,0 +1,172 @@
+#include <benchmark/benchmark.h>
+#include "signature_index.h"
+#include "md5_calculator.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+const char* const VERDICTS[] = {"Exploit", "Dropper", "Downloader", "Trojan", "Worm"};
+constexpr size_t PROBES = 1 << 16;
+
+MD5Digest randomDigest(std::mt19937_64& rng) {
+    MD5Digest digest;
+    uint64_t a = rng(), b = rng();
+    std::memcpy(digest.data(), &a, 8);
+    std::memcpy(digest.data() + 8, &b, 8);
+    return digest;
+}
+
+// Сигнатуры базы и запросы к ней: половина попадает, половина - чистые файлы
+struct Probes {
+    std::vector<MD5Digest> hits;
+    std::vector<MD5Digest> misses;
+};
+
+// Строится одна база за раз, чтобы 50M сигнатур не держались рядом с остальными
+struct IndexFixture {
+    size_t size = 0;
+    SignatureIndex index;
+    Probes probes;
+
+    static IndexFixture& get(size_t size) {
+        static std::unique_ptr<IndexFixture> fixture;
+        if (!fixture || fixture->size != size) {
+            fixture.reset();
+            fixture.reset(new IndexFixture());
+            fixture->build(size);
+        }
+        return *fixture;
+    }
+
+    void build(size_t count) {
+        size = count;
+        std::mt19937_64 rng(count);
+        index.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            MD5Digest digest = randomDigest(rng);
+            index.insert(digest, VERDICTS[i % 5]);
+            if (i % std::max<size_t>(1, count / PROBES) == 0 && probes.hits.size() < PROBES) {
+                probes.hits.push_back(digest);
+            }
+        }
+        for (size_t i = 0; i < PROBES; ++i) {
+            probes.misses.push_back(randomDigest(rng));
+        }
+        std::shuffle(probes.hits.begin(), probes.hits.end(), rng);
+    }
+};
+
+// Прежнее хранилище: hex-строка -> вердикт, hex строится на каждый файл
+struct MapFixture {
+    size_t size = 0;
+    std::unordered_map<std::string, std::string> map;
+    size_t bytes = 0;
+    Probes probes;
+
+    static MapFixture& get(size_t size) {
+        static std::unique_ptr<MapFixture> fixture;
+        if (!fixture || fixture->size != size) {
+            fixture.reset();
+            fixture.reset(new MapFixture());
+            fixture->build(size);
+        }
+        return *fixture;
+    }
+
+    void build(size_t count) {
+        size = count;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        size_t before = mallinfo2().uordblks;
+#endif
+        std::mt19937_64 rng(count);
+        for (size_t i = 0; i < count; ++i) {
+            MD5Digest digest = randomDigest(rng);
+            map[MD5Calculator::bytesToHexString(digest.data(), digest.size())] = VERDICTS[i % 5];
+            if (i % std::max<size_t>(1, count / PROBES) == 0 && probes.hits.size() < PROBES) {
+                probes.hits.push_back(digest);
+            }
+        }
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        bytes = mallinfo2().uordblks - before;
+#endif
+        for (size_t i = 0; i < PROBES; ++i) {
+            probes.misses.push_back(randomDigest(rng));
+        }
+        std::shuffle(probes.hits.begin(), probes.hits.end(), rng);
+    }
+};
+
+void setCounters(benchmark::State& state, size_t count, size_t bytes) {
+    state.counters["lookups_per_second"] =
+        benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    if (bytes > 0) {
+        state.counters["bytes_per_signature"] = static_cast<double>(bytes) / static_cast<double>(count);
+    }
+}
+
+void BM_SignatureIndexLookup(benchmark::State& state) {
+    IndexFixture& fixture = IndexFixture::get(static_cast<size_t>(state.range(0)));
+    const auto& probes = state.range(1) ? fixture.probes.hits : fixture.probes.misses;
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fixture.index.find(probes[i++ & (PROBES - 1)]));
+    }
+    setCounters(state, fixture.index.size(), fixture.index.memoryUsage());
+}
+BENCHMARK(BM_SignatureIndexLookup)
+    ->ArgNames({"signatures", "hit"})
+    ->Args({1000000, 0})->Args({1000000, 1})
+    ->Args({10000000, 0})->Args({10000000, 1})
+    ->Args({50000000, 0})->Args({50000000, 1});
+
+// Поиск чистого файла: фильтр Блума перед таблицей против одной таблицы
+void BM_NegativeLookup(benchmark::State& state) {
+    IndexFixture& fixture = IndexFixture::get(static_cast<size_t>(state.range(0)));
+    const bool prefilter = state.range(1) != 0;
+    const auto& probes = fixture.probes.misses;
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const MD5Digest& digest = probes[i++ & (PROBES - 1)];
+        benchmark::DoNotOptimize(prefilter ? fixture.index.find(digest) : fixture.index.findUnfiltered(digest));
+    }
+    setCounters(state, fixture.index.size(), 0);
+    state.counters["filter_mib"] = static_cast<double>(fixture.index.filterBytes()) / (1 << 20);
+}
+BENCHMARK(BM_NegativeLookup)
+    ->ArgNames({"signatures", "prefilter"})
+    ->Args({1000000, 0})->Args({1000000, 1})
+    ->Args({10000000, 0})->Args({10000000, 1})
+    ->Args({50000000, 0})->Args({50000000, 1});
+
+void BM_UnorderedMapLookup(benchmark::State& state) {
+    MapFixture& fixture = MapFixture::get(static_cast<size_t>(state.range(0)));
+    const auto& probes = state.range(1) ? fixture.probes.hits : fixture.probes.misses;
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const MD5Digest& digest = probes[i++ & (PROBES - 1)];
+        std::string hash = MD5Calculator::bytesToHexString(digest.data(), digest.size());
+        benchmark::DoNotOptimize(fixture.map.find(hash));
+    }
+    setCounters(state, fixture.map.size(), fixture.bytes);
+}
+BENCHMARK(BM_UnorderedMapLookup)
+    ->ArgNames({"signatures", "hit"})
+    ->Args({1000000, 0})->Args({1000000, 1})
+    ->Args({10000000, 0})->Args({10000000, 1});
+
+}
+
+BENCHMARK_MAIN();
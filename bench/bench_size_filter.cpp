@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Дерево с размерами файлов от 100 байт до 1 МиБ (логравномерно, как в
+// типичном домашнем каталоге) и база с размером у каждой сигнатуры.
+// Часть файлов (MATCHING_PERCENT) совпадает по размеру с какой-нибудь сигнатурой.
+struct SizedTree {
+    static constexpr int FILES = 3000;
+    static constexpr int DIRECTORIES = 60;
+    static constexpr int SIGNATURES = 5000;
+    static constexpr int MATCHING_PERCENT = 5;
+
+    bench_utils::TempDir dir;
+    bench_utils::TempDir work;
+    std::string root;
+    std::string base;
+    std::string log;
+    uint64_t bytes = 0;
+
+    SizedTree() {
+        std::mt19937_64 rng(13);
+        std::uniform_real_distribution<double> logSize(std::log(100.0), std::log(1048576.0));
+        auto randomSize = [&]() { return static_cast<uint64_t>(std::exp(logSize(rng))); };
+
+        std::vector<uint64_t> signatureSizes;
+        base = (work.path() / "base.csv").string();
+        std::ofstream csv(base);
+        for (int s = 0; s < SIGNATURES; ++s) {
+            signatureSizes.push_back(randomSize());
+            char hash[33];
+            std::snprintf(hash, sizeof(hash), "%016llx%016llx",
+                          static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+            csv << hash << ";Malware" << s << ";" << signatureSizes.back() << "\n";
+        }
+
+        root = (dir.path() / "tree").string();
+        for (int f = 0; f < FILES; ++f) {
+            uint64_t size = static_cast<int>(rng() % 100) < MATCHING_PERCENT
+                ? signatureSizes[rng() % signatureSizes.size()]
+                : randomSize();
+            bench_utils::writeFile(fs::path(root) / ("d" + std::to_string(f % DIRECTORIES)) /
+                                   ("f" + std::to_string(f)), static_cast<size_t>(size), static_cast<unsigned int>(f));
+            bytes += size;
+        }
+        log = (work.path() / "scan.log").string();
+    }
+
+    static SizedTree& instance() {
+        static SizedTree tree;
+        return tree;
+    }
+};
+
+void scanTree(benchmark::State& state, bool sizeFilter) {
+    SizedTree& tree = SizedTree::instance();
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(tree.base);
+    ScanOptions options;
+    options.sizeFilter = sizeFilter;
+    scanner->setScanOptions(options);
+
+    ScanResult result;
+    for (auto _ : state) {
+        result = scanner->scanDirectory(tree.root, tree.log);
+        if (result.totalFiles != SizedTree::FILES) {
+            state.SkipWithError("not all files scanned");
+        }
+    }
+    destroyScanner(scanner);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * tree.bytes));
+    state.counters["files_per_second"] =
+        benchmark::Counter(SizedTree::FILES, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["skipped_files"] = result.sizeSkippedFiles;
+    state.counters["skipped_bytes_ratio"] =
+        static_cast<double>(result.sizeSkippedBytes) / static_cast<double>(tree.bytes);
+}
+
+// Прежний путь: хешируется каждый файл
+void BM_ScanWithoutSizeFilter(benchmark::State& state) {
+    scanTree(state, false);
+}
+// Файлы, размера которых нет в базе, не читаются
+void BM_ScanWithSizeFilter(benchmark::State& state) {
+    scanTree(state, true);
+}
+
+BENCHMARK(BM_ScanWithoutSizeFilter)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ScanWithSizeFilter)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,399 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include "corpus_generator.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fuse.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+
+// Смесь размеров от 100 байт до 1 МиБ: мелкие файлы читаются в память
+// потоками чтения, крупные - потоково потоками хеширования
+bench_utils::CorpusSpec corpusSpec() {
+    bench_utils::CorpusSpec spec;
+    spec.seed = 24;
+    spec.files = 2000;
+    spec.directories = 40;
+    spec.maxSize = 1024 * 1024;
+    return spec;
+}
+
+struct PreparedCorpus {
+    bench_utils::TempDir dir;
+    bench_utils::Corpus corpus;
+    std::string log;
+
+    PreparedCorpus()
+        : corpus(bench_utils::generateCorpus(corpusSpec(), dir.path())),
+          log((dir.path() / "scan.log").string()) {}
+};
+
+PreparedCorpus& corpus() {
+    static PreparedCorpus prepared;
+    return prepared;
+}
+
+#ifdef __linux__
+/**
+ * Медленное хранилище для замера: FUSE-зеркало каталога, где каждый запрос
+ * (поиск имени, атрибуты, открытие, чтение, листинг) отвечает с задержкой,
+ * как сетевая файловая система. Сервер отвечает на запросы из многих потоков,
+ * поэтому задержки параллельных запросов перекрываются. Кэши атрибутов и
+ * страниц выключены: каждое сканирование снова идет через сервер.
+ * Нужны root и /dev/fuse; libfuse не нужна - протокол разбирается по linux/fuse.h.
+ */
+class SlowFuse {
+public:
+    SlowFuse(const std::string& source, uint32_t latencyUs, size_t threads) : latencyUs_(latencyUs) {
+        nodes_.push_back("");           // nodeid 0 не используется
+        nodes_.push_back(source);       // FUSE_ROOT_ID
+        if (geteuid() != 0) {
+            return;
+        }
+        fd_ = ::open("/dev/fuse", O_RDWR | O_CLOEXEC);
+        if (fd_ < 0) {
+            return;
+        }
+        mountpoint_ = mountDir_.path().string();
+        std::string data = "fd=" + std::to_string(fd_) + ",rootmode=40000,user_id=0,group_id=0,allow_other";
+        if (mount("benchfuse", mountpoint_.c_str(), "fuse", MS_NOSUID | MS_NODEV, data.c_str()) != 0) {
+            ::close(fd_);
+            fd_ = -1;
+            return;
+        }
+        mounted_ = true;
+        for (size_t i = 0; i < threads; ++i) {
+            threads_.emplace_back([this]() { serve(); });
+        }
+    }
+
+    ~SlowFuse() {
+        if (mounted_) {
+            umount2(mountpoint_.c_str(), MNT_DETACH);
+        }
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    bool mounted() const { return mounted_; }
+    const std::string& path() const { return mountpoint_; }
+
+private:
+    struct DirHandle {
+        std::vector<std::pair<std::string, unsigned char>> entries;
+    };
+
+    void serve() {
+        std::vector<char> buffer(FUSE_MIN_READ_BUFFER + 1024 * 1024);
+        std::vector<char> reply(1024 * 1024);
+        while (true) {
+            ssize_t size = ::read(fd_, buffer.data(), buffer.size());
+            if (size < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                return;                 // ENODEV: файловая система отмонтирована
+            }
+            if (static_cast<size_t>(size) < sizeof(fuse_in_header)) {
+                continue;
+            }
+            const fuse_in_header* in = reinterpret_cast<const fuse_in_header*>(buffer.data());
+            handle(*in, buffer.data() + sizeof(fuse_in_header), reply);
+        }
+    }
+
+    void delay() {
+        if (latencyUs_) {
+            std::this_thread::sleep_for(std::chrono::microseconds(latencyUs_));
+        }
+    }
+
+    void send(uint64_t unique, int error, const void* data, size_t size) {
+        fuse_out_header out;
+        out.len = static_cast<uint32_t>(sizeof(out) + (error ? 0 : size));
+        out.error = -error;
+        out.unique = unique;
+        iovec parts[2] = {{&out, sizeof(out)}, {const_cast<void*>(data), error ? 0 : size}};
+        ssize_t written = ::writev(fd_, parts, 2);
+        (void)written;
+    }
+
+    std::string pathOf(uint64_t node) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return node < nodes_.size() ? nodes_[node] : std::string();
+    }
+
+    uint64_t nodeOf(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = ids_.find(path);
+        if (found != ids_.end()) {
+            return found->second;
+        }
+        nodes_.push_back(path);
+        ids_.emplace(path, nodes_.size() - 1);
+        return nodes_.size() - 1;
+    }
+
+    static void fillAttr(const struct stat& st, uint64_t node, fuse_attr& attr) {
+        std::memset(&attr, 0, sizeof(attr));
+        attr.ino = node;
+        attr.size = static_cast<uint64_t>(st.st_size);
+        attr.blocks = static_cast<uint64_t>(st.st_blocks);
+        attr.atime = static_cast<uint64_t>(st.st_atime);
+        attr.mtime = static_cast<uint64_t>(st.st_mtime);
+        attr.ctime = static_cast<uint64_t>(st.st_ctime);
+        attr.mode = st.st_mode;
+        attr.nlink = static_cast<uint32_t>(st.st_nlink);
+        attr.blksize = 4096;
+    }
+
+    void handle(const fuse_in_header& in, const char* payload, std::vector<char>& reply) {
+        switch (in.opcode) {
+        case FUSE_INIT: {
+            const fuse_init_in* init = reinterpret_cast<const fuse_init_in*>(payload);
+            fuse_init_out out;
+            std::memset(&out, 0, sizeof(out));
+            out.major = FUSE_KERNEL_VERSION;
+            out.minor = std::min<uint32_t>(init->minor, FUSE_KERNEL_MINOR_VERSION);
+            out.max_readahead = init->max_readahead;
+            out.flags = init->flags & FUSE_ASYNC_READ;
+            out.max_background = 64;
+            out.congestion_threshold = 48;
+            out.max_write = 128 * 1024;
+            out.time_gran = 1;
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_LOOKUP: {
+            delay();
+            std::string path = pathOf(in.nodeid) + "/" + payload;
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0) {
+                send(in.unique, errno, nullptr, 0);
+                break;
+            }
+            fuse_entry_out out;
+            std::memset(&out, 0, sizeof(out));
+            out.nodeid = nodeOf(path);
+            fillAttr(st, out.nodeid, out.attr);
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_GETATTR: {
+            delay();
+            struct stat st;
+            if (lstat(pathOf(in.nodeid).c_str(), &st) != 0) {
+                send(in.unique, errno, nullptr, 0);
+                break;
+            }
+            fuse_attr_out out;
+            std::memset(&out, 0, sizeof(out));
+            fillAttr(st, in.nodeid, out.attr);
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_OPEN: {
+            delay();
+            int file = ::open(pathOf(in.nodeid).c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0) {
+                send(in.unique, errno, nullptr, 0);
+                break;
+            }
+            fuse_open_out out;
+            std::memset(&out, 0, sizeof(out));
+            out.fh = static_cast<uint64_t>(file);
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_READ: {
+            delay();
+            const fuse_read_in* read = reinterpret_cast<const fuse_read_in*>(payload);
+            size_t size = std::min<size_t>(read->size, reply.size());
+            ssize_t got = ::pread(static_cast<int>(read->fh), reply.data(), size, static_cast<off_t>(read->offset));
+            if (got < 0) {
+                send(in.unique, errno, nullptr, 0);
+            } else {
+                send(in.unique, 0, reply.data(), static_cast<size_t>(got));
+            }
+            break;
+        }
+        case FUSE_RELEASE: {
+            const fuse_release_in* release = reinterpret_cast<const fuse_release_in*>(payload);
+            ::close(static_cast<int>(release->fh));
+            send(in.unique, 0, nullptr, 0);
+            break;
+        }
+        case FUSE_OPENDIR: {
+            delay();
+            DIR* dir = opendir(pathOf(in.nodeid).c_str());
+            if (!dir) {
+                send(in.unique, errno, nullptr, 0);
+                break;
+            }
+            DirHandle* handle = new DirHandle();
+            while (dirent* entry = readdir(dir)) {
+                handle->entries.emplace_back(entry->d_name, entry->d_type);
+            }
+            closedir(dir);
+            fuse_open_out out;
+            std::memset(&out, 0, sizeof(out));
+            out.fh = reinterpret_cast<uint64_t>(handle);
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_READDIR: {
+            delay();
+            const fuse_read_in* read = reinterpret_cast<const fuse_read_in*>(payload);
+            const DirHandle* handle = reinterpret_cast<const DirHandle*>(read->fh);
+            size_t used = 0;
+            size_t limit = std::min<size_t>(read->size, reply.size());
+            for (size_t i = static_cast<size_t>(read->offset); i < handle->entries.size(); ++i) {
+                const auto& entry = handle->entries[i];
+                size_t length = FUSE_DIRENT_ALIGN(FUSE_NAME_OFFSET + entry.first.size());
+                if (used + length > limit) {
+                    break;
+                }
+                fuse_dirent* dirent = reinterpret_cast<fuse_dirent*>(reply.data() + used);
+                std::memset(dirent, 0, length);
+                dirent->ino = i + 2;
+                dirent->off = i + 1;
+                dirent->namelen = static_cast<uint32_t>(entry.first.size());
+                dirent->type = entry.second;
+                std::memcpy(dirent->name, entry.first.data(), entry.first.size());
+                used += length;
+            }
+            send(in.unique, 0, reply.data(), used);
+            break;
+        }
+        case FUSE_RELEASEDIR: {
+            const fuse_release_in* release = reinterpret_cast<const fuse_release_in*>(payload);
+            delete reinterpret_cast<DirHandle*>(release->fh);
+            send(in.unique, 0, nullptr, 0);
+            break;
+        }
+        case FUSE_FLUSH:
+            send(in.unique, 0, nullptr, 0);
+            break;
+        case FUSE_STATFS: {
+            struct statvfs vfs;
+            fuse_statfs_out out;
+            std::memset(&out, 0, sizeof(out));
+            if (statvfs(pathOf(FUSE_ROOT_ID).c_str(), &vfs) == 0) {
+                out.st.blocks = vfs.f_blocks;
+                out.st.bfree = vfs.f_bfree;
+                out.st.bavail = vfs.f_bavail;
+                out.st.files = vfs.f_files;
+                out.st.ffree = vfs.f_ffree;
+                out.st.bsize = static_cast<uint32_t>(vfs.f_bsize);
+                out.st.frsize = static_cast<uint32_t>(vfs.f_frsize);
+                out.st.namelen = static_cast<uint32_t>(vfs.f_namemax);
+            }
+            send(in.unique, 0, &out, sizeof(out));
+            break;
+        }
+        case FUSE_FORGET:
+        case FUSE_BATCH_FORGET:
+        case FUSE_INTERRUPT:
+            break;                      // ответа не ждут
+        default:
+            send(in.unique, ENOSYS, nullptr, 0);
+            break;
+        }
+    }
+
+    uint32_t latencyUs_;
+    int fd_ = -1;
+    bool mounted_ = false;
+    bench_utils::TempDir mountDir_;
+    std::string mountpoint_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::vector<std::string> nodes_;
+    std::unordered_map<std::string, uint64_t> ids_;
+};
+#endif
+
+// Сканирование корпуса по пути root (сам каталог корпуса или его FUSE-зеркало)
+void scanWith(benchmark::State& state, const std::string& root, const ScanOptions& options) {
+    PreparedCorpus& prepared = corpus();
+    IScannerCore* scanner = createScanner();
+    scanner->setScanOptions(options);
+    scanner->loadMalwareBase(prepared.corpus.base);
+
+    ScanMetrics last;
+    for (auto _ : state) {
+        ScanResult result = scanner->scanDirectory(root, prepared.log);
+        if (result.totalFiles != prepared.corpus.files || result.malwareFiles != prepared.corpus.malwareFiles) {
+            state.SkipWithError("scan result does not match the corpus");
+        }
+        last = result.metrics;
+    }
+    destroyScanner(scanner);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * prepared.corpus.bytes));
+    state.counters["files_per_second"] =
+        benchmark::Counter(prepared.corpus.files, benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["io_threads"] = static_cast<double>(last.ioThreads);
+    state.counters["hash_threads"] = static_cast<double>(last.hashThreads);
+    state.counters["adjustments"] = static_cast<double>(last.threadAdjustments);
+}
+
+// Общий пул фиксированного размера (прежняя модель) против раздельных пулов
+// с подстройкой. Блокирующее чтение: с io_uring пул остается общим
+ScanOptions modelOptions(int model) {
+    ScanOptions options;
+    options.ioEngine = IoEngine::Blocking;
+    options.threadModel = model == 0 ? ThreadModel::Shared : ThreadModel::Split;
+    options.adaptiveThreads = model == 1;
+    return options;
+}
+
+void BM_LocalScan(benchmark::State& state) {
+    scanWith(state, corpus().corpus.root, modelOptions(static_cast<int>(state.range(0))));
+}
+
+// Аргументы: модель (0 - общий пул, 1 - раздельные с подстройкой,
+// 2 - раздельные без подстройки) и задержка запроса к хранилищу в микросекундах
+void BM_SlowStorageScan(benchmark::State& state) {
+#ifdef __linux__
+    SlowFuse fuse(corpus().corpus.root, static_cast<uint32_t>(state.range(1)), 64);
+    if (!fuse.mounted()) {
+        state.SkipWithError("FUSE mount needs root and /dev/fuse");
+        return;
+    }
+    scanWith(state, fuse.path(), modelOptions(static_cast<int>(state.range(0))));
+#else
+    state.SkipWithError("FUSE stand-in is Linux only");
+#endif
+}
+
+BENCHMARK(BM_LocalScan)->DenseRange(0, 2)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_SlowStorageScan)
+    ->ArgsProduct({{0, 1, 2}, {200, 1000}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime()->Iterations(3);
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#include "directory_walker.h"
+#include "bench_utils.h"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Синтетическое дерево: FANOUT подкаталогов на уровень, DEPTH уровней, FILES файлов в каждом
+struct DeepWideTree {
+    static constexpr int FANOUT = 5;
+    static constexpr int DEPTH = 4;
+    static constexpr int FILES = 16;
+
+    bench_utils::TempDir dir;
+    int64_t entries = 0;
+
+    DeepWideTree() {
+        build(dir.path(), 0);
+    }
+
+    void build(const fs::path& path, int depth) {
+        for (int f = 0; f < FILES; ++f) {
+            std::ofstream(path / ("file_" + std::to_string(f)));
+            entries++;
+        }
+        if (depth == DEPTH) return;
+        for (int d = 0; d < FANOUT; ++d) {
+            fs::path child = path / ("dir_" + std::to_string(d));
+            fs::create_directory(child);
+            entries++;
+            build(child, depth + 1);
+        }
+    }
+
+    static DeepWideTree& instance() {
+        static DeepWideTree tree;
+        return tree;
+    }
+};
+
+// Базовая линия: однопоточный std::filesystem::recursive_directory_iterator
+void BM_RecursiveDirectoryIterator(benchmark::State& state) {
+    DeepWideTree& tree = DeepWideTree::instance();
+    for (auto _ : state) {
+        int64_t files = 0;
+        for (const auto& entry : fs::recursive_directory_iterator(tree.dir.path())) {
+            if (entry.is_regular_file()) files++;
+        }
+        benchmark::DoNotOptimize(files);
+    }
+    state.counters["entries_per_second"] =
+        benchmark::Counter(static_cast<double>(tree.entries), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_RecursiveDirectoryIterator)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Параллельный обход: задача на каталог, getdents64/d_type на Linux
+void BM_ParallelDirectoryWalker(benchmark::State& state) {
+    DeepWideTree& tree = DeepWideTree::instance();
+    const size_t threads = static_cast<size_t>(state.range(0));
+    WorkStealingPool pool(threads, threads * 4);
+
+    for (auto _ : state) {
+        std::atomic<int64_t> files{0};
+        ParallelDirectoryWalker walker(pool, WalkOptions(), 64, [&](PathBatch& paths) {
+            files += static_cast<int64_t>(paths.size());
+        });
+        walker.run(tree.dir.path().string());
+        benchmark::DoNotOptimize(files.load());
+    }
+    pool.Terminate(true);
+
+    state.counters["entries_per_second"] =
+        benchmark::Counter(static_cast<double>(tree.entries), benchmark::Counter::kIsIterationInvariantRate);
+}
+BENCHMARK(BM_ParallelDirectoryWalker)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace bench_utils {
+
+    /**
+     * Временная директория бенчмарка, удаляется в деструкторе
+     */
+    class TempDir {
+    public:
+        TempDir() {
+            static const unsigned int processTag = std::random_device{}();
+            static int counter = 0;
+            path_ = std::filesystem::temp_directory_path() /
+                    ("bench_" + std::to_string(processTag) + "_" + std::to_string(counter++));
+            std::filesystem::create_directories(path_);
+        }
+
+        ~TempDir() {
+            std::error_code ec;
+            std::filesystem::remove_all(path_, ec);
+        }
+
+        TempDir(const TempDir&) = delete;
+        TempDir& operator=(const TempDir&) = delete;
+
+        const std::filesystem::path& path() const { return path_; }
+
+    private:
+        std::filesystem::path path_;
+    };
+
+    /**
+     * Создает файл заданного размера с детерминированным содержимым
+     */
+    inline std::string writeFile(const std::filesystem::path& path, size_t size, unsigned int seed = 1) {
+        std::filesystem::create_directories(path.parent_path());
+        std::mt19937 rng(seed);
+        std::string data(size, '\0');
+        for (auto& c : data) {
+            c = static_cast<char>(rng());
+        }
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        return path.string();
+    }
+
+    /**
+     * Выбрасывает страницы файлов из page cache (работает для чистых страниц без прав root)
+     */
+    inline void dropCache(const std::vector<std::string>& paths) {
+#ifndef _WIN32
+        for (const auto& path : paths) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                fdatasync(fd);
+                posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                ::close(fd);
+            }
+        }
+#else
+        (void)paths;
+#endif
+    }
+}
@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+#include "scanner_core.h"
+#include "bench_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Поток загрузок с постоянной частотой: файл 1 КиБ каждые 1/rate с в один из
+// 16 каталогов, каждый сотый - из базы. Задержка - от чтения события до вердикта
+void BM_WatchLatency(benchmark::State& state) {
+    const WatchBackend backend = static_cast<WatchBackend>(state.range(0));
+    const int rate = static_cast<int>(state.range(1));
+    const int seconds = 2;
+    const int files = rate * seconds;
+
+    bench_utils::TempDir dir;
+    std::string base = (dir.path() / "base.csv").string();
+    std::ofstream(base) << "5d41402abc4b2a76b9719d911017c592;Bench.Malware\n";
+    std::string clean(1024, 'x');
+
+    IScannerCore* scanner = createScanner();
+    scanner->loadMalwareBase(base);
+    WatchStats stats;
+    double writeRate = 0.0;
+    int round = 0;
+
+    for (auto _ : state) {
+        std::filesystem::path root = dir.path() / ("round" + std::to_string(round++));
+        for (int d = 0; d < 16; ++d) {
+            std::filesystem::create_directories(root / std::to_string(d));
+        }
+        WatchOptions options;
+        options.backend = backend;
+        if (!scanner->startWatch({root.string()}, (dir.path() / "watch.log").string(), options)) {
+            state.SkipWithError("watch backend is not available");
+            break;
+        }
+
+        auto period = std::chrono::nanoseconds(1000000000 / rate);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < files; ++i) {
+            std::this_thread::sleep_until(start + period * i);
+            std::string path = (root / std::to_string(i % 16) / ("upload" + std::to_string(i))).string();
+            FILE* file = std::fopen(path.c_str(), "wb");
+            if (i % 100 == 0) {
+                std::fwrite("hello", 1, 5, file);
+            } else {
+                clean[0] = static_cast<char>(i);
+                std::fwrite(clean.data(), 1, clean.size(), file);
+            }
+            std::fclose(file);
+        }
+        std::chrono::duration<double> writing = std::chrono::steady_clock::now() - start;
+        writeRate = files / writing.count();
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (scanner->getWatchStats().filesScanned < static_cast<uint64_t>(files) &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        stats = scanner->stopWatch();
+        if (stats.filesScanned != static_cast<uint64_t>(files) ||
+            stats.malwareFiles != static_cast<uint64_t>((files + 99) / 100)) {
+            state.SkipWithError("not every upload got a verdict");
+        }
+    }
+    destroyScanner(scanner);
+
+    state.counters["events_per_second"] = writeRate;
+    state.counters["p50_us"] = static_cast<double>(stats.latency.quantileNs(0.5)) / 1000.0;
+    state.counters["p99_us"] = static_cast<double>(stats.latency.quantileNs(0.99)) / 1000.0;
+    state.counters["p999_us"] = static_cast<double>(stats.latency.quantileNs(0.999)) / 1000.0;
+    state.counters["mean_us"] = stats.latency.meanNs() / 1000.0;
+    state.counters["overflows"] = static_cast<double>(stats.overflows);
+}
+
+BENCHMARK(BM_WatchLatency)
+    ->ArgNames({"backend", "rate"})
+    ->Args({static_cast<int>(WatchBackend::Fanotify), 10000})
+    ->Args({static_cast<int>(WatchBackend::Inotify), 10000})
+    ->Args({static_cast<int>(WatchBackend::Inotify), 1000})
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}
+
+BENCHMARK_MAIN();
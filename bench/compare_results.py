@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Сравнение двух прогонов run_benchmarks.
+
+    compare_results.py BASELINE CONTENDER [--threshold 0.05]
+
+BASELINE и CONTENDER - JSON-файлы Google Benchmark или каталоги с ними.
+Сравнивается медиана real_time (без повторов - единственный замер) каждого
+бенчмарка, найденного в обоих прогонах. Код возврата 1, если хотя бы один
+бенчмарк стал медленнее больше чем на threshold.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def load(path):
+    files = [path]
+    if os.path.isdir(path):
+        files = sorted(os.path.join(path, name) for name in os.listdir(path) if name.endswith(".json"))
+    times = {}
+    for file in files:
+        with open(file, encoding="utf-8") as stream:
+            report = json.load(stream)
+        for entry in report.get("benchmarks", []):
+            if entry.get("error_occurred"):
+                continue
+            aggregate = entry.get("aggregate_name")
+            if aggregate not in (None, "median"):
+                continue
+            name = entry.get("run_name", entry["name"])
+            # Медиана, если она есть, важнее отдельных повторов
+            if aggregate == "median" or name not in times:
+                times[name] = entry["real_time"]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two benchmark runs")
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown treated as a regression (default 0.05)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    contender = load(args.contender)
+    common = sorted(set(baseline) & set(contender))
+    if not common:
+        print("No common benchmarks", file=sys.stderr)
+        return 2
+
+    regressions = 0
+    width = max(len(name) for name in common)
+    for name in common:
+        before, after = baseline[name], contender[name]
+        change = after / before - 1.0 if before > 0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<{width}}  {before:12.4g}  {after:12.4g}  {change:+8.1%}{mark}")
+
+    for name in sorted(set(baseline) ^ set(contender)):
+        print(f"{name:<{width}}  only in {'baseline' if name in baseline else 'contender'}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
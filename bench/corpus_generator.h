@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "md5.h"
+
+namespace bench_utils {
+
+    // Распределение размеров файлов корпуса
+    enum class SizeDistribution {
+        Fixed,          // все файлы minSize
+        Uniform,        // равномерно от minSize до maxSize
+        LogUniform,     // равномерно по порядку величины, как в типичном домашнем каталоге
+    };
+
+    /**
+     * Параметры синтетического корпуса. Одни и те же параметры дают одно и то же
+     * дерево байт в байт на любой платформе: используется только mt19937_64,
+     * без платформенно-зависимых распределений стандартной библиотеки
+     */
+    struct CorpusSpec {
+        uint64_t seed = 1;
+        int files = 1000;
+        int directories = 50;           // каталоги с файлами (листья дерева)
+        int depth = 1;                  // уровней вложенности до листа
+        SizeDistribution sizes = SizeDistribution::LogUniform;
+        uint64_t minSize = 100;
+        uint64_t maxSize = 1024 * 1024;
+        double malwareRate = 0.01;      // доля файлов, чей MD5 есть в базе
+        int signatures = 1000;          // сигнатур в базе, включая совпадающие с файлами
+        bool signatureSizes = false;    // третья колонка CSV с размером файла
+        int linkCopies = 0;             // жестких ссылок на каждый файл: деревья copy1..copyN рядом с copy0
+    };
+
+    // Что получилось на диске
+    struct Corpus {
+        std::string root;               // каталог для сканирования
+        std::string base;               // CSV-база
+        int files = 0;
+        int directories = 0;
+        uint64_t bytes = 0;             // по всем путям, включая ссылки
+        uint64_t uniqueBytes = 0;       // различного содержимого
+        int malwareFiles = 0;           // столько путей должен найти сканер
+    };
+
+    namespace detail {
+
+        inline double unitInterval(std::mt19937_64& rng) {
+            return static_cast<double>(rng() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        inline uint64_t sampleSize(const CorpusSpec& spec, std::mt19937_64& rng) {
+            uint64_t low = std::min(spec.minSize, spec.maxSize);
+            uint64_t high = std::max(spec.minSize, spec.maxSize);
+            switch (spec.sizes) {
+            case SizeDistribution::Fixed:
+                return spec.minSize;
+            case SizeDistribution::Uniform:
+                return low + rng() % (high - low + 1);
+            case SizeDistribution::LogUniform: {
+                double lowLog = std::log(static_cast<double>(std::max<uint64_t>(low, 1)));
+                double highLog = std::log(static_cast<double>(std::max<uint64_t>(high, 1)));
+                uint64_t size = static_cast<uint64_t>(std::exp(lowLog + unitInterval(rng) * (highLog - lowLog)));
+                return std::min(std::max(size, low), high);
+            }
+            }
+            return low;
+        }
+
+        // Путь листа: номер каталога записывается цифрами по основанию fanout, цифра на уровень
+        inline std::filesystem::path leafPath(int directory, int depth, int fanout) {
+            std::filesystem::path path;
+            std::vector<int> digits(static_cast<size_t>(depth));
+            for (int level = depth - 1; level >= 0; --level) {
+                digits[static_cast<size_t>(level)] = directory % fanout;
+                directory /= fanout;
+            }
+            for (int level = 0; level < depth; ++level) {
+                path /= "l" + std::to_string(level) + "_" + std::to_string(digits[static_cast<size_t>(level)]);
+            }
+            return path;
+        }
+
+        inline std::string toHex(const MD5Digest& digest) {
+            static const char HEX[] = "0123456789abcdef";
+            std::string hex(2 * digest.size(), '0');
+            for (size_t i = 0; i < digest.size(); ++i) {
+                hex[2 * i] = HEX[digest[i] >> 4];
+                hex[2 * i + 1] = HEX[digest[i] & 0x0F];
+            }
+            return hex;
+        }
+    }
+
+    /**
+     * Создает в dir дерево tree/ и базу base.csv по спецификации.
+     * Содержимое файла f - поток mt19937_64 с зерном (seed, f), так что файлы
+     * разные, а MD5 зараженных можно записать в базу, не перечитывая их
+     */
+    inline Corpus generateCorpus(const CorpusSpec& spec, const std::filesystem::path& dir) {
+        namespace fs = std::filesystem;
+        Corpus corpus;
+        corpus.root = (dir / "tree").string();
+        corpus.base = (dir / "base.csv").string();
+
+        const int directories = std::max(spec.directories, 1);
+        const int depth = std::max(spec.depth, 1);
+        int fanout = static_cast<int>(std::ceil(std::pow(static_cast<double>(directories), 1.0 / depth)));
+        fanout = std::max(fanout, 2);
+        while (depth > 1 && std::pow(static_cast<double>(fanout - 1), depth) >= directories) {
+            fanout--;
+        }
+
+        std::mt19937_64 rng(spec.seed);
+        std::vector<std::string> signatures;
+        std::vector<uint64_t> signatureSizes;
+        std::string data;
+        for (int f = 0; f < spec.files; ++f) {
+            uint64_t size = detail::sampleSize(spec, rng);
+            bool malware = detail::unitInterval(rng) < spec.malwareRate;
+            int directory = f % directories;
+
+            std::mt19937_64 content(spec.seed * 0x9E3779B97F4A7C15ull + static_cast<uint64_t>(f));
+            data.resize(static_cast<size_t>(size));
+            for (size_t i = 0; i < data.size(); i += 8) {
+                uint64_t word = content();
+                for (size_t b = 0; b < 8 && i + b < data.size(); ++b) {
+                    data[i + b] = static_cast<char>(word >> (8 * b));
+                }
+            }
+
+            fs::path leafPath = detail::leafPath(directory, depth, fanout);
+            fs::path leaf = fs::path(corpus.root) / (spec.linkCopies > 0 ? fs::path("copy0") / leafPath : leafPath);
+            if (f < directories) {
+                fs::create_directories(leaf);
+                corpus.directories++;
+            }
+            fs::path name = "f" + std::to_string(f) + ".bin";
+            std::ofstream file(leaf / name, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            file.close();
+            for (int copy = 1; copy <= spec.linkCopies; ++copy) {
+                fs::path linkLeaf = fs::path(corpus.root) / ("copy" + std::to_string(copy)) / leafPath;
+                if (f < directories) {
+                    fs::create_directories(linkLeaf);
+                    corpus.directories++;
+                }
+                fs::create_hard_link(leaf / name, linkLeaf / name);
+            }
+
+            const int paths = 1 + std::max(spec.linkCopies, 0);
+            corpus.files += paths;
+            corpus.bytes += size * static_cast<uint64_t>(paths);
+            corpus.uniqueBytes += size;
+            if (malware) {
+                corpus.malwareFiles += paths;
+                signatures.push_back(detail::toHex(MD5::hash(data.data(), data.size())));
+                signatureSizes.push_back(size);
+            }
+        }
+
+        // Остальные сигнатуры - случайные дайджесты, ни с одним файлом не совпадающие
+        while (static_cast<int>(signatures.size()) < spec.signatures) {
+            char hash[33];
+            std::snprintf(hash, sizeof(hash), "%016llx%016llx",
+                          static_cast<unsigned long long>(rng()), static_cast<unsigned long long>(rng()));
+            signatures.push_back(hash);
+            signatureSizes.push_back(detail::sampleSize(spec, rng));
+        }
+
+        std::ofstream csv(corpus.base, std::ios::binary | std::ios::trunc);
+        for (size_t s = 0; s < signatures.size(); ++s) {
+            csv << signatures[s] << ";Malware" << s;
+            if (spec.signatureSizes) {
+                csv << ";" << signatureSizes[s];
+            }
+            csv << "\n";
+        }
+        return corpus;
+    }
+}
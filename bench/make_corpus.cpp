@@ -0,0 +1,82 @@
+#include "corpus_generator.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Генератор синтетического корпуса для ручных замеров и сравнения запусков:
+// те же параметры и seed всегда дают то же дерево и ту же базу
+namespace {
+
+void printUsage() {
+    std::cout << "Usage: make_corpus --out DIR [--seed N] [--files N] [--directories N] [--depth N]"
+              << " [--sizes fixed|uniform|loguniform] [--min-size BYTES] [--max-size BYTES]"
+              << " [--malware-rate R] [--signatures N] [--signature-sizes] [--link-copies N]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    bench_utils::CorpusSpec spec;
+    std::string out;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc) {
+            spec.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--files" && i + 1 < argc) {
+            spec.files = std::atoi(argv[++i]);
+        } else if (arg == "--directories" && i + 1 < argc) {
+            spec.directories = std::atoi(argv[++i]);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            spec.depth = std::atoi(argv[++i]);
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            std::string sizes = argv[++i];
+            if (sizes == "fixed") {
+                spec.sizes = bench_utils::SizeDistribution::Fixed;
+            } else if (sizes == "uniform") {
+                spec.sizes = bench_utils::SizeDistribution::Uniform;
+            } else if (sizes == "loguniform") {
+                spec.sizes = bench_utils::SizeDistribution::LogUniform;
+            } else {
+                std::cerr << "Unknown size distribution: " << sizes << std::endl;
+                printUsage();
+                return 1;
+            }
+        } else if (arg == "--min-size" && i + 1 < argc) {
+            spec.minSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-size" && i + 1 < argc) {
+            spec.maxSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--malware-rate" && i + 1 < argc) {
+            spec.malwareRate = std::atof(argv[++i]);
+        } else if (arg == "--signatures" && i + 1 < argc) {
+            spec.signatures = std::atoi(argv[++i]);
+        } else if (arg == "--signature-sizes") {
+            spec.signatureSizes = true;
+        } else if (arg == "--link-copies" && i + 1 < argc) {
+            spec.linkCopies = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+    if (out.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    try {
+        bench_utils::Corpus corpus = bench_utils::generateCorpus(spec, out);
+        std::cout << "Tree: " << corpus.root << std::endl;
+        std::cout << "Base: " << corpus.base << std::endl;
+        std::cout << "Files: " << corpus.files << " in " << corpus.directories << " directories, "
+                  << corpus.bytes << " bytes (" << corpus.uniqueBytes << " distinct)" << std::endl;
+        std::cout << "Malware files: " << corpus.malwareFiles << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to create corpus: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
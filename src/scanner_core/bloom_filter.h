@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+/**
+ * Блочный фильтр Блума (split block, как в Parquet): ключ целиком попадает
+ * в один 32-байтный блок и ставит по одному биту в каждом из восьми слов.
+ * Проверка - одно обращение к памяти, при 10 битах на ключ ложных
+ * срабатываний около 1%.
+ *
+ * Ключ - уже равномерно распределенный 128-битный дайджест: старшая половина
+ * выбирает блок, младшая - биты внутри блока.
+ */
+class BlockedBloomFilter {
+public:
+    static constexpr size_t BITS_PER_KEY = 10;
+
+    struct alignas(32) Block {
+        uint32_t words[8];
+    };
+
+    BlockedBloomFilter() = default;
+    BlockedBloomFilter(BlockedBloomFilter&&) = default;
+    BlockedBloomFilter& operator=(BlockedBloomFilter&&) = default;
+    BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+    BlockedBloomFilter& operator=(const BlockedBloomFilter&) = delete;
+
+    // Размечает пустой фильтр под expectedKeys ключей
+    void init(size_t expectedKeys) {
+        size_t blocks = (expectedKeys * BITS_PER_KEY + 255) / 256;
+        owned_.assign(blocks > 0 ? blocks : 1, Block());
+        blocks_ = owned_.data();
+        blockCount_ = owned_.size();
+    }
+
+    // Смотрит во внешний массив блоков (отображенный файл базы)
+    void attach(const Block* blocks, size_t blockCount) {
+        std::vector<Block>().swap(owned_);
+        blocks_ = blocks;
+        blockCount_ = blockCount;
+    }
+
+    void clear() {
+        std::vector<Block>().swap(owned_);
+        blocks_ = nullptr;
+        blockCount_ = 0;
+    }
+
+    void add(uint64_t lo, uint64_t hi) {
+        Block& block = owned_[blockIndex(hi)];
+        for (int i = 0; i < 8; ++i) {
+            block.words[i] |= bitMask(lo, i);
+        }
+    }
+
+    // false - ключа точно нет; пустой фильтр пропускает все ключи
+    bool mayContain(uint64_t lo, uint64_t hi) const {
+        if (blockCount_ == 0) {
+            return true;
+        }
+        const Block& block = blocks_[blockIndex(hi)];
+        uint32_t missing = 0;
+        for (int i = 0; i < 8; ++i) {
+            missing |= bitMask(lo, i) & ~block.words[i];
+        }
+        return missing == 0;
+    }
+
+    bool empty() const { return blockCount_ == 0; }
+    const Block* blocks() const { return blocks_; }
+    size_t blockCount() const { return blockCount_; }
+    size_t sizeBytes() const { return blockCount_ * sizeof(Block); }
+
+private:
+    const Block* blocks_ = nullptr;
+    size_t blockCount_ = 0;
+    std::vector<Block> owned_;
+
+    size_t blockIndex(uint64_t hash) const {
+#if defined(__SIZEOF_INT128__)
+        __extension__ typedef unsigned __int128 Wide;
+        return static_cast<size_t>((static_cast<Wide>(hash) * blockCount_) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<size_t>(__umulh(hash, blockCount_));
+#else
+        return static_cast<size_t>(hash % blockCount_);
+#endif
+    }
+
+    static uint32_t bitMask(uint64_t lo, int i) {
+        static const uint32_t SALT[8] = {0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+                                         0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u};
+        return 1u << ((static_cast<uint32_t>(lo) * SALT[i]) >> 27);
+    }
+};
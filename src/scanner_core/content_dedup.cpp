@@ -0,0 +1,189 @@
+#include "content_dedup.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t SHARD_COUNT = 64;
+
+struct ContentKeyHash {
+    size_t operator()(const ContentKey& key) const {
+        uint64_t hash = key.device * 0x9E3779B97F4A7C15ull ^ key.inode ^ (key.size * 0xC2B2AE3D27D4EB4Full);
+        if (!key.extents.empty()) {
+            hash ^= std::hash<std::string>()(key.extents) * 0x165667B19E3779F9ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 29));
+    }
+};
+
+void appendWord(std::string& out, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+}
+
+struct ContentDedup::Shard {
+    struct Entry {
+        bool done = false;
+        Result result;
+        std::vector<Waiter> waiters;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<ContentKey, Entry, ContentKeyHash> entries;
+};
+
+ContentDedup::ContentDedup()
+    : shards_(new Shard[SHARD_COUNT]) {
+}
+
+ContentDedup::~ContentDedup() = default;
+
+ContentDedup::Shard& ContentDedup::shardFor(const ContentKey& key) {
+    return shards_[(ContentKeyHash()(key) >> 7) % SHARD_COUNT];
+}
+
+bool ContentDedup::claim(const ContentKey& key, Waiter waiter) {
+    Result result;
+    switch (tryClaim(key, result)) {
+    case Claim::Owner:
+        return true;
+    case Claim::Done:
+        waiter(result);
+        return false;
+    default:
+        wait(key, std::move(waiter));
+        return false;
+    }
+}
+
+ContentDedup::Claim ContentDedup::tryClaim(const ContentKey& key, Result& result) {
+    Shard& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // emplace создал бы узел и для уже известного ключа
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        shard.entries.emplace(key, Shard::Entry());
+        return Claim::Owner;
+    }
+    const Shard::Entry& entry = it->second;
+    if (!entry.done) {
+        return Claim::Busy;
+    }
+    result = entry.result;
+    return Claim::Done;
+}
+
+void ContentDedup::wait(const ContentKey& key, Waiter waiter) {
+    Shard& shard = shardFor(key);
+    Result result;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Shard::Entry& entry = shard.entries[key];
+        if (!entry.done) {
+            entry.waiters.push_back(std::move(waiter));
+            return;
+        }
+        result = entry.result;
+    }
+    waiter(result);
+}
+
+void ContentDedup::complete(const ContentKey& key, const Result& result) {
+    Shard& shard = shardFor(key);
+    std::vector<Waiter> waiters;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it == shard.entries.end()) {
+            return;
+        }
+        it->second.done = true;
+        it->second.result = result;
+        waiters.swap(it->second.waiters);
+    }
+    for (const Waiter& waiter : waiters) {
+        waiter(result);
+    }
+}
+
+bool ContentDedup::inodeKeyOf(const FileStamp& stamp, ContentKey& key) {
+    if (stamp.links < 2 || stamp.inode == 0) {
+        return false;
+    }
+    key.device = stamp.device;
+    key.inode = stamp.inode;
+    key.size = stamp.size;
+    key.extents.clear();
+    return true;
+}
+
+bool ContentDedup::extentKeyOf(const std::string& path, const FileStamp& stamp, ContentKey& key) {
+#ifdef __linux__
+    if (stamp.size < EXTENT_MIN_SIZE) {
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    alignas(8) char buffer[sizeof(struct fiemap) + MAX_EXTENTS * sizeof(struct fiemap_extent)];
+    std::memset(buffer, 0, sizeof(buffer));
+    auto* map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = static_cast<uint32_t>(MAX_EXTENTS);
+    bool ok = ::ioctl(fd, FS_IOC_FIEMAP, map) == 0;
+    ::close(fd);
+    if (!ok || map->fm_mapped_extents == 0) {
+        return false;
+    }
+
+    // Без последнего экстента в ответе файл длиннее MAX_EXTENTS
+    const struct fiemap_extent* extents = map->fm_extents;
+    uint32_t count = map->fm_mapped_extents;
+    if (!(extents[count - 1].fe_flags & FIEMAP_EXTENT_LAST)) {
+        return false;
+    }
+    const uint32_t unusable = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED |
+                              FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |
+                              FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN;
+    bool shared = false;
+    key.extents.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (extents[i].fe_flags & unusable) {
+            return false;
+        }
+        shared = shared || (extents[i].fe_flags & FIEMAP_EXTENT_SHARED);
+        appendWord(key.extents, extents[i].fe_logical);
+        appendWord(key.extents, extents[i].fe_physical);
+        appendWord(key.extents, extents[i].fe_length);
+    }
+    if (!shared) {
+        return false;
+    }
+    key.device = stamp.device;
+    key.inode = 0;
+    key.size = stamp.size;
+    return true;
+#else
+    (void)path;
+    (void)stamp;
+    (void)key;
+    return false;
+#endif
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include "digest_set.h"
+#include "scan_cache.h"
+#include "scanner_api.h"
+
+// Ключ содержимого файла: (устройство, inode) для жестких ссылок или
+// (устройство, размер, физические экстенты) для reflink-копий
+struct ContentKey {
+    uint64_t device = 0;
+    uint64_t inode = 0;         // 0 - ключ по экстентам
+    uint64_t size = 0;
+    std::string extents;        // тройки (логическое смещение, физическое, длина) по 8 байт
+
+    bool operator==(const ContentKey& other) const {
+        return device == other.device && inode == other.inode && size == other.size && extents == other.extents;
+    }
+};
+
+/**
+ * Содержимое, общее для нескольких путей, хешируется один раз за сканирование.
+ * Первый путь с ключом получает claim() == true, читает файл и сообщает итог
+ * в complete(). Остальные пути ждут в таблице и получают тот же итог, не читая
+ * файл: сразу, если он уже известен, или из complete() в потоке первого пути.
+ *
+ * Таблица разбита на шарды со своими мьютексами, обработчики вызываются без блокировок.
+ */
+class SCANNER_API ContentDedup {
+public:
+    enum class Outcome {
+        Digest,             // файл прочитан, digests - его дайджесты
+        RejectedByPrefix,   // ключа префикса нет в базе, целиком файл не читался
+        Error               // файл не прочитался, error - код ошибки
+    };
+
+    struct Result {
+        Outcome outcome = Outcome::Error;
+        FileDigests digests;
+        int error = 0;
+    };
+
+    using Waiter = std::function<void(const Result& result)>;
+
+    enum class Claim {
+        Owner,      // содержимое встретилось впервые: читать файл и вызвать complete()
+        Done,       // итог уже известен и записан в result
+        Busy        // файл читает другой путь: ждать итога через wait()
+    };
+
+    // Экстенты запрашиваются у файлов не меньше этого размера: у мелких
+    // файлов reflink редок, а FIEMAP стоит открытия файла
+    static constexpr uint64_t EXTENT_MIN_SIZE = 64 * 1024;
+    // Файлы с большим числом экстентов не сравниваются
+    static constexpr size_t MAX_EXTENTS = 32;
+
+    ContentDedup();
+    ~ContentDedup();
+    ContentDedup(const ContentDedup&) = delete;
+    ContentDedup& operator=(const ContentDedup&) = delete;
+
+    // true - содержимое встретилось впервые, вызывающий должен вызвать complete(key, ...);
+    // false - waiter уже вызван или будет вызван с итогом первого пути
+    bool claim(const ContentKey& key, Waiter waiter);
+    // То же без обработчика: его (и копию пути в нем) нужно создать, только
+    // если придется ждать. После Busy вызывается wait() с тем же ключом;
+    // если итог появился между вызовами, waiter вызывается сразу
+    Claim tryClaim(const ContentKey& key, Result& result);
+    void wait(const ContentKey& key, Waiter waiter);
+    void complete(const ContentKey& key, const Result& result);
+
+    // Ключ жесткой ссылки: только у файлов с несколькими ссылками
+    static bool inodeKeyOf(const FileStamp& stamp, ContentKey& key);
+    // Ключ по экстентам (FIEMAP, Linux): только если хотя бы один экстент общий
+    // с другим файлом и все экстенты лежат на диске как есть (без сжатия и inline)
+    static bool extentKeyOf(const std::string& path, const FileStamp& stamp, ContentKey& key);
+
+private:
+    struct Shard;
+
+    std::unique_ptr<Shard[]> shards_;
+
+    Shard& shardFor(const ContentKey& key);
+};
@@ -0,0 +1,354 @@
+#include "csv_base_loader.h"
+#include "file_io.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Куски меньше этого не выгодно отдавать отдельной задаче
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+// Кусков на поток: запас для балансировки неравных по стоимости кусков
+constexpr size_t CHUNKS_PER_THREAD = 4;
+// Самая короткая строка с сигнатурой: 32 hex-символа, ';' и перевод строки
+constexpr size_t MIN_SIGNATURE_LINE = 34;
+
+struct Chunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    // Вердикты куска в порядке появления; номера в записях - индексы здесь
+    std::vector<std::string_view> verdicts;
+    // Размеры файлов из третьей колонки у строк без ключа префикса, в порядке строк
+    std::vector<uint64_t> sizes;
+    std::vector<SignatureIndex::PrefixKey> prefixKeys;
+    // В дельте строка "-hash" удаляет сигнатуру
+    bool acceptRemovals = false;
+    std::vector<MD5Digest> removals;
+    DigestMask algorithms = 0;
+    CsvBaseLoader::Stats stats;
+};
+
+// Колонка типа хеша; регистр не важен
+bool typeByName(std::string_view name, HashAlgorithm& algorithm) {
+    if (name.size() < 3 || name.size() > 6) {
+        return false;
+    }
+    char lower[6];
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        lower[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    std::string_view value(lower, name.size());
+    for (HashAlgorithm candidate : {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256}) {
+        if (value == digestName(candidate)) {
+            algorithm = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Без колонки типа алгоритм определяется по длине хеша
+bool typeByLength(size_t length, HashAlgorithm& algorithm) {
+    for (HashAlgorithm candidate : {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256}) {
+        if (length == 2 * digestSize(candidate)) {
+            algorithm = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Хеш сигнатуры в ключ индекса; длина хеша должна соответствовать типу
+bool parseSignatureHash(std::string_view type, std::string_view hex, HashAlgorithm& algorithm, MD5Digest& key,
+                        bool& uppercase) {
+    if (type.empty() ? !typeByLength(hex.size(), algorithm) : !typeByName(type, algorithm)) {
+        return false;
+    }
+    if (algorithm == HashAlgorithm::MD5) {
+        return SignatureIndex::parseHex(hex.data(), hex.size(), key, &uppercase);
+    }
+    uint8_t digest[32];
+    if (!SignatureIndex::parseHex(hex.data(), hex.size(), digest, digestSize(algorithm), &uppercase)) {
+        return false;
+    }
+    key = SignatureIndex::keyDigest(algorithm, digest);
+    return true;
+}
+
+void countAlgorithm(Chunk& chunk, HashAlgorithm algorithm) {
+    chunk.algorithms |= digestBit(algorithm);
+    chunk.stats.sha1 += algorithm == HashAlgorithm::SHA1 ? 1 : 0;
+    chunk.stats.sha256 += algorithm == HashAlgorithm::SHA256 ? 1 : 0;
+}
+
+// Необязательная третья колонка - размер файла: хвост после последнего ';' из одних цифр.
+// Иначе весь остаток строки - вердикт (в нем тоже может быть ';').
+bool splitFileSize(std::string_view& verdict, uint64_t& fileSize) {
+    size_t delimiter = verdict.rfind(';');
+    if (delimiter == std::string_view::npos) {
+        return false;
+    }
+    std::string_view digits = verdict.substr(delimiter + 1);
+    // 19 цифр заведомо помещаются в uint64_t
+    if (digits.empty() || digits.size() > 19) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    verdict = verdict.substr(0, delimiter);
+    fileSize = value;
+    return true;
+}
+
+// Четвертая колонка - ключ префикса: 32 hex-символа после размера файла
+bool splitPrefixKey(std::string_view& verdict, SignatureIndex::PrefixKey& prefixKey) {
+    size_t delimiter = verdict.rfind(';');
+    MD5Digest prefix;
+    if (delimiter == std::string_view::npos ||
+        !SignatureIndex::parseHex(verdict.data() + delimiter + 1, verdict.size() - delimiter - 1, prefix)) {
+        return false;
+    }
+    std::string_view rest = verdict.substr(0, delimiter);
+    uint64_t fileSize;
+    if (!splitFileSize(rest, fileSize)) {
+        return false;
+    }
+    SignatureIndex::Key key = SignatureIndex::toKey(prefix);
+    prefixKey.fileSize = fileSize;
+    prefixKey.lo = key.lo;
+    prefixKey.hi = key.hi;
+    verdict = rest;
+    return true;
+}
+
+void parseChunk(Chunk& chunk, std::vector<SignatureIndex::BulkEntry>& entries) {
+    entries.reserve(static_cast<size_t>(chunk.end - chunk.begin) / MIN_SIGNATURE_LINE + 1);
+
+    std::unordered_map<std::string_view, uint32_t> verdictIds;
+    std::string_view lastVerdict;
+    uint32_t lastVerdictId = 0;
+    bool haveLast = false;
+
+    const char* line = chunk.begin;
+    while (line < chunk.end) {
+        const char* newline = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+        const char* lineEnd = newline ? newline : chunk.end;
+        const char* next = newline ? newline + 1 : chunk.end;
+        chunk.stats.lines++;
+
+        if (lineEnd > line && lineEnd[-1] == '\r') {
+            lineEnd--;
+        }
+        if (lineEnd == line) {
+            chunk.stats.emptyLines++;
+            line = next;
+            continue;
+        }
+
+        SignatureIndex::BulkEntry entry;
+        MD5Digest digest;
+        HashAlgorithm algorithm;
+        bool uppercase = false;
+        if (*line == '-' && chunk.acceptRemovals) {
+            // "-hash" или "-type;hash"
+            std::string_view removal(line + 1, static_cast<size_t>(lineEnd - line - 1));
+            size_t typeEnd = removal.find(';');
+            std::string_view type = typeEnd == std::string_view::npos ? std::string_view() : removal.substr(0, typeEnd);
+            std::string_view hex = typeEnd == std::string_view::npos ? removal : removal.substr(typeEnd + 1);
+            if (parseSignatureHash(type, hex, algorithm, digest, uppercase)) {
+                chunk.removals.push_back(digest);
+                chunk.stats.removals++;
+                chunk.stats.uppercase += uppercase ? 1 : 0;
+            } else {
+                chunk.stats.malformed++;
+            }
+            line = next;
+            continue;
+        }
+
+        // Первая колонка - хеш или тип хеша, за которым идет хеш
+        const char* delimiter = static_cast<const char*>(std::memchr(line, ';', lineEnd - line));
+        std::string_view type;
+        const char* hash = line;
+        if (delimiter && typeByName(std::string_view(line, static_cast<size_t>(delimiter - line)), algorithm)) {
+            type = std::string_view(line, static_cast<size_t>(delimiter - line));
+            hash = delimiter + 1;
+            delimiter = static_cast<const char*>(std::memchr(hash, ';', lineEnd - hash));
+        }
+        if (!delimiter ||
+            !parseSignatureHash(type, std::string_view(hash, static_cast<size_t>(delimiter - hash)), algorithm, digest,
+                                uppercase)) {
+            chunk.stats.malformed++;
+            line = next;
+            continue;
+        }
+        entry.key = SignatureIndex::toKey(digest);
+        countAlgorithm(chunk, algorithm);
+
+        // Подряд обычно идут сигнатуры одного семейства: сначала сравниваем с прошлым вердиктом
+        std::string_view verdict(delimiter + 1, static_cast<size_t>(lineEnd - delimiter - 1));
+        uint64_t fileSize;
+        SignatureIndex::PrefixKey prefixKey;
+        if (splitPrefixKey(verdict, prefixKey)) {
+            chunk.prefixKeys.push_back(prefixKey);
+            chunk.stats.sized++;
+            chunk.stats.prefixed++;
+        } else if (splitFileSize(verdict, fileSize)) {
+            chunk.sizes.push_back(fileSize);
+            chunk.stats.sized++;
+        }
+        if (!haveLast || verdict != lastVerdict) {
+            auto inserted = verdictIds.emplace(verdict, static_cast<uint32_t>(chunk.verdicts.size()));
+            if (inserted.second) {
+                chunk.verdicts.push_back(verdict);
+            }
+            lastVerdict = verdict;
+            lastVerdictId = inserted.first->second;
+            haveLast = true;
+        }
+        entry.verdictId = lastVerdictId;
+        entries.push_back(entry);
+
+        chunk.stats.signatures++;
+        chunk.stats.uppercase += uppercase ? 1 : 0;
+        line = next;
+    }
+}
+
+}
+
+bool CsvBaseLoader::load(const std::string& path, SignatureIndex& index,
+                         const CsvLoadOptions& options, Stats* stats) {
+    return loadFile(path, index, nullptr, options, stats);
+}
+
+bool CsvBaseLoader::loadDelta(const std::string& path, SignatureIndex& added, std::vector<MD5Digest>& removed,
+                              const CsvLoadOptions& options, Stats* stats) {
+    removed.clear();
+    return loadFile(path, added, &removed, options, stats);
+}
+
+bool CsvBaseLoader::loadFile(const std::string& path, SignatureIndex& index, std::vector<MD5Digest>* removed,
+                             const CsvLoadOptions& options, Stats* stats) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    const char* begin = reinterpret_cast<const char*>(file.data());
+    const char* end = begin + file.size();
+    if (file.size() >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) {
+        begin += 3;
+    }
+
+    size_t threads = options.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkSize = options.chunkSize;
+    if (chunkSize == 0) {
+        chunkSize = std::max(MIN_CHUNK_SIZE, static_cast<size_t>(end - begin) / (threads * CHUNKS_PER_THREAD) + 1);
+    }
+
+    // Границы кусков сдвигаются вперед до конца строки
+    std::vector<Chunk> chunks;
+    for (const char* chunkBegin = begin; chunkBegin < end;) {
+        const char* chunkEnd = chunkBegin + std::min(chunkSize, static_cast<size_t>(end - chunkBegin));
+        if (chunkEnd < end) {
+            const char* newline = static_cast<const char*>(std::memchr(chunkEnd - 1, '\n', end - chunkEnd + 1));
+            chunkEnd = newline ? newline + 1 : end;
+        }
+        Chunk chunk;
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunk.acceptRemovals = removed != nullptr;
+        chunks.push_back(std::move(chunk));
+        chunkBegin = chunkEnd;
+    }
+
+    WorkStealingPool pool(std::min(threads, std::max<size_t>(1, chunks.size())));
+    std::vector<std::vector<SignatureIndex::BulkEntry>> batches(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        pool.PushTask([&, i]() { parseChunk(chunks[i], batches[i]); });
+    }
+    pool.WaitIdle();
+
+    // Номера вердиктов кусков переводятся в номера индекса; порядок первых
+    // появлений в файле сохраняется, поэтому и таблица вердиктов детерминирована
+    std::vector<std::vector<uint32_t>> globalIds(chunks.size());
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        globalIds[i].reserve(chunks[i].verdicts.size());
+        for (std::string_view verdict : chunks[i].verdicts) {
+            globalIds[i].push_back(index.internVerdict(std::string(verdict)));
+        }
+    }
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        pool.PushTask([&, i]() {
+            for (auto& entry : batches[i]) {
+                entry.verdictId = globalIds[i][entry.verdictId];
+            }
+        });
+    }
+    pool.WaitIdle();
+
+    size_t duplicates = index.insertBulk(batches, pool);
+    pool.Terminate(true);
+
+    std::vector<uint64_t> sizes;
+    std::vector<SignatureIndex::PrefixKey> prefixKeys;
+    uint64_t unsized = 0;
+    for (const Chunk& chunk : chunks) {
+        sizes.insert(sizes.end(), chunk.sizes.begin(), chunk.sizes.end());
+        prefixKeys.insert(prefixKeys.end(), chunk.prefixKeys.begin(), chunk.prefixKeys.end());
+        unsized += chunk.stats.signatures - chunk.stats.sized;
+    }
+    // Ключи другой длины, чем уже в индексе, несравнимы: остается только размер
+    bool prefixAccepted = prefixKeys.empty() ||
+        index.setPrefixLength(options.prefixLength ? options.prefixLength : index.prefixLength());
+    if (prefixAccepted) {
+        index.addPrefixKeys(prefixKeys);
+    } else {
+        for (const auto& key : prefixKeys) {
+            sizes.push_back(key.fileSize);
+        }
+    }
+    index.addFileSizes(sizes);
+    index.addUnsizedSignatures(unsized);
+    for (const Chunk& chunk : chunks) {
+        index.addAlgorithms(chunk.algorithms);
+    }
+    if (removed) {
+        for (const Chunk& chunk : chunks) {
+            removed->insert(removed->end(), chunk.removals.begin(), chunk.removals.end());
+        }
+    }
+
+    if (stats) {
+        *stats = Stats();
+        for (const Chunk& chunk : chunks) {
+            stats->lines += chunk.stats.lines;
+            stats->signatures += chunk.stats.signatures;
+            stats->sized += chunk.stats.sized;
+            stats->sha1 += chunk.stats.sha1;
+            stats->sha256 += chunk.stats.sha256;
+            stats->prefixed += prefixAccepted ? chunk.stats.prefixed : 0;
+            stats->malformed += chunk.stats.malformed;
+            stats->uppercase += chunk.stats.uppercase;
+            stats->emptyLines += chunk.stats.emptyLines;
+            stats->removals += chunk.stats.removals;
+        }
+        stats->duplicates = duplicates;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "scanner_api.h"
+#include "signature_index.h"
+
+struct CsvLoadOptions {
+    size_t threads = 0;     // потоки разбора: 0 - по числу ядер
+    size_t chunkSize = 0;   // размер куска файла в байтах: 0 - подбирается по размеру и потокам
+    uint64_t prefixLength = 0;  // длина префикса для ключей в четвертой колонке: 0 - как в индексе
+};
+
+/**
+ * Параллельная загрузка CSV-базы "hash;verdict", "hash;verdict;size" или
+ * "hash;verdict;size;prefix" (MD5 первых prefixLength байт файла) в SignatureIndex.
+ * Хеш - MD5, SHA-1 или SHA-256: алгоритм определяется по длине или задается
+ * необязательной первой колонкой типа ("sha256;hash;verdict", регистр не важен).
+ * Файл отображается в память и режется на куски по границам строк; куски
+ * разбираются задачами пула прямо из отображения, без копирования строк.
+ * Вердикты интернируются сначала внутри куска, затем один раз на весь файл.
+ *
+ * Результат не зависит от числа потоков и размера кусков: для повторного
+ * дайджеста остается вердикт последней строки, как при чтении по порядку.
+ *
+ * Если в индексе уже есть ключи префикса другой длины, ключи из файла не
+ * добавляются: их сигнатуры проверяются полным хешем (Stats::prefixed = 0).
+ */
+class SCANNER_API CsvBaseLoader {
+public:
+    struct Stats {
+        uint64_t lines = 0;         // все строки файла, включая пустые
+        uint64_t signatures = 0;    // строки с верной сигнатурой
+        uint64_t sized = 0;         // сигнатуры с размером файла в третьей колонке
+        uint64_t prefixed = 0;      // из них с ключом префикса в четвертой колонке
+        uint64_t sha1 = 0;          // сигнатуры SHA-1
+        uint64_t sha256 = 0;        // сигнатуры SHA-256
+        uint64_t malformed = 0;     // строки без ';', с неизвестным типом или неверным хешем
+        uint64_t duplicates = 0;    // сигнатуры, чей дайджест уже был в базе
+        uint64_t uppercase = 0;     // сигнатуры с заглавными hex-символами (принимаются)
+        uint64_t emptyLines = 0;
+        uint64_t removals = 0;      // строки "-hash" или "-type;hash" в дельте
+    };
+
+    // false, если файл не удалось открыть; неверные строки пропускаются и считаются
+    static bool load(const std::string& path, SignatureIndex& index,
+                     const CsvLoadOptions& options = CsvLoadOptions(), Stats* stats = nullptr);
+
+    // Дельта базы: строки той же формы добавляются в added, строка "-hash"
+    // кладет ключ дайджеста (SignatureIndex::keyDigest) в removed (в порядке файла)
+    static bool loadDelta(const std::string& path, SignatureIndex& added, std::vector<MD5Digest>& removed,
+                          const CsvLoadOptions& options = CsvLoadOptions(), Stats* stats = nullptr);
+
+private:
+    static bool loadFile(const std::string& path, SignatureIndex& index, std::vector<MD5Digest>* removed,
+                         const CsvLoadOptions& options, Stats* stats);
+};
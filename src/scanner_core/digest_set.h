@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "md5.h"
+#include "sha.h"
+#include "xxh3.h"
+
+// Алгоритмы хеширования содержимого файла. MD5 считается всегда, остальные - по маске
+enum class HashAlgorithm { MD5, SHA1, SHA256, XXH3 };
+
+using DigestMask = uint32_t;
+
+constexpr DigestMask DIGEST_MD5 = 1u << 0;
+constexpr DigestMask DIGEST_SHA1 = 1u << 1;
+constexpr DigestMask DIGEST_SHA256 = 1u << 2;
+constexpr DigestMask DIGEST_XXH3 = 1u << 3;
+constexpr DigestMask DIGEST_ALL = DIGEST_MD5 | DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3;
+
+inline DigestMask digestBit(HashAlgorithm algorithm) {
+    return 1u << static_cast<uint32_t>(algorithm);
+}
+
+inline const char* digestName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::MD5:
+        return "md5";
+    case HashAlgorithm::SHA1:
+        return "sha1";
+    case HashAlgorithm::SHA256:
+        return "sha256";
+    case HashAlgorithm::XXH3:
+        return "xxh3";
+    }
+    return "";
+}
+
+// Размер дайджеста в байтах
+inline size_t digestSize(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::MD5:
+        return 16;
+    case HashAlgorithm::SHA1:
+        return 20;
+    case HashAlgorithm::SHA256:
+        return 32;
+    case HashAlgorithm::XXH3:
+        return 8;
+    }
+    return 0;
+}
+
+// Разбор списка вида "md5,sha256,xxh3"; false - неизвестное имя
+inline bool parseDigestMask(const std::string& list, DigestMask& mask) {
+    mask = 0;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string name = list.substr(start, end - start);
+        bool known = false;
+        for (HashAlgorithm algorithm : {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256,
+                                        HashAlgorithm::XXH3}) {
+            if (name == digestName(algorithm)) {
+                mask |= digestBit(algorithm);
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+inline std::string formatDigestMask(DigestMask mask) {
+    std::string result;
+    for (HashAlgorithm algorithm : {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256,
+                                    HashAlgorithm::XXH3}) {
+        if (mask & digestBit(algorithm)) {
+            if (!result.empty()) result += ',';
+            result += digestName(algorithm);
+        }
+    }
+    return result;
+}
+
+// Дайджесты одного файла; заполнены только алгоритмы из mask
+struct FileDigests {
+    DigestMask mask = 0;
+    MD5Digest md5{};
+    SHA1Digest sha1{};
+    SHA256Digest sha256{};
+    uint64_t xxh3 = 0;
+
+    bool has(HashAlgorithm algorithm) const { return (mask & digestBit(algorithm)) != 0; }
+
+    // Дайджест алгоритма в байтах; у XXH3 байтов нет - он хранится числом
+    const uint8_t* bytes(HashAlgorithm algorithm) const {
+        switch (algorithm) {
+        case HashAlgorithm::MD5:
+            return md5.data();
+        case HashAlgorithm::SHA1:
+            return sha1.data();
+        case HashAlgorithm::SHA256:
+            return sha256.data();
+        case HashAlgorithm::XXH3:
+            break;
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * Несколько алгоритмов за один проход по данным. Каждый прочитанный буфер
+ * подается всем алгоритмам из маски кусками по SLICE байт, пока кусок
+ * лежит в L1, - файл читается один раз, сколько бы дайджестов ни считалось.
+ */
+class DigestSet {
+public:
+    static constexpr size_t SLICE = 16 * 1024;
+
+    explicit DigestSet(const ShaKernel& kernel = ShaKernels::best()) : sha1_(kernel), sha256_(kernel) {}
+
+    void reset(DigestMask mask) {
+        mask_ = mask;
+        if (mask_ & DIGEST_MD5) md5_.reset();
+        if (mask_ & DIGEST_SHA1) sha1_.reset();
+        if (mask_ & DIGEST_SHA256) sha256_.reset();
+        if (mask_ & DIGEST_XXH3) xxh3_.reset();
+    }
+
+    DigestMask mask() const { return mask_; }
+
+    void update(const void* data, size_t size) {
+        if (mask_ == 0) {
+            return;
+        }
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+            size_t take = size < SLICE ? size : SLICE;
+            if (mask_ & DIGEST_MD5) md5_.update(bytes, take);
+            if (mask_ & DIGEST_SHA1) sha1_.update(bytes, take);
+            if (mask_ & DIGEST_SHA256) sha256_.update(bytes, take);
+            if (mask_ & DIGEST_XXH3) xxh3_.update(bytes, take);
+            bytes += take;
+            size -= take;
+        }
+    }
+
+    // Дописывает в digests алгоритмы маски; после вызова нужен reset()
+    void finalize(FileDigests& digests) {
+        if (mask_ & DIGEST_MD5) digests.md5 = md5_.finalize();
+        if (mask_ & DIGEST_SHA1) digests.sha1 = sha1_.finalize();
+        if (mask_ & DIGEST_SHA256) digests.sha256 = sha256_.finalize();
+        if (mask_ & DIGEST_XXH3) digests.xxh3 = xxh3_.digest();
+        digests.mask |= mask_;
+    }
+
+private:
+    DigestMask mask_ = 0;
+    MD5 md5_;
+    SHA1 sha1_;
+    SHA256 sha256_;
+    XXH3 xxh3_;
+};
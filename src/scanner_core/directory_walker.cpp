@@ -0,0 +1,388 @@
+#include "directory_walker.h"
+#include "scan_metrics.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifdef _WIN32
+const char DirectoryReader::SEPARATOR = '\\';
+#else
+const char DirectoryReader::SEPARATOR = '/';
+#endif
+
+namespace {
+
+bool isDotEntry(const char* name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+#ifndef _WIN32
+// Тип записи, которую не удалось определить по d_type (ссылка или DT_UNKNOWN)
+DirEntryType classifyEntry(int dirFd, const char* name, bool isLink, bool followSymlinks) {
+    struct stat st;
+    if (!isLink) {
+        if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return DirEntryType::Other;
+        }
+        if (S_ISREG(st.st_mode)) return DirEntryType::File;
+        if (S_ISDIR(st.st_mode)) return DirEntryType::Directory;
+        if (!S_ISLNK(st.st_mode)) return DirEntryType::Other;
+    }
+
+    // Ссылка на файл сканируется как файл, на каталог - только при followSymlinks
+    if (fstatat(dirFd, name, &st, 0) != 0) {
+        return DirEntryType::Other;
+    }
+    if (S_ISREG(st.st_mode)) return DirEntryType::File;
+    if (S_ISDIR(st.st_mode) && followSymlinks) return DirEntryType::Directory;
+    return DirEntryType::Other;
+}
+#endif
+
+#ifdef __linux__
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif
+
+}
+
+#if defined(_WIN32)
+
+bool DirectoryReader::read(const std::string& dirPath, bool followSymlinks,
+                           const Callback& callback, const OpenCallback& onOpen) {
+    if (onOpen) {
+        HANDLE dir = CreateFileA(dirPath.c_str(), FILE_READ_ATTRIBUTES,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (dir == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        BY_HANDLE_FILE_INFORMATION info;
+        BOOL ok = GetFileInformationByHandle(dir, &info);
+        CloseHandle(dir);
+        if (!ok) {
+            return false;
+        }
+        DirectoryId id;
+        id.device = info.dwVolumeSerialNumber;
+        id.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        if (!onOpen(id)) {
+            return true;
+        }
+    }
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileExA((dirPath + "\\*").c_str(), FindExInfoBasic, &data,
+                                   FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE) {
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    }
+
+    do {
+        if (isDotEntry(data.cFileName)) continue;
+
+        DWORD attributes = data.dwFileAttributes;
+        DirEntryType type = DirEntryType::File;
+        if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+            bool isLink = (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+            type = (!isLink || followSymlinks) ? DirEntryType::Directory : DirEntryType::Other;
+        } else if (attributes & FILE_ATTRIBUTE_DEVICE) {
+            type = DirEntryType::Other;
+        }
+        callback(data.cFileName, type);
+    } while (FindNextFileA(find, &data));
+
+    DWORD error = GetLastError();
+    FindClose(find);
+    return error == ERROR_NO_MORE_FILES;
+}
+
+#elif defined(__linux__)
+
+bool DirectoryReader::read(const std::string& dirPath, bool followSymlinks,
+                           const Callback& callback, const OpenCallback& onOpen) {
+    int fd = ::open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (onOpen) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        DirectoryId id;
+        id.device = static_cast<uint64_t>(st.st_dev);
+        id.inode = static_cast<uint64_t>(st.st_ino);
+        if (!onOpen(id)) {
+            ::close(fd);
+            return true;
+        }
+    }
+
+    alignas(8) char buffer[32 * 1024];
+    while (true) {
+        long bytes = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            ::close(fd);
+            return false;
+        }
+        if (bytes == 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < bytes;) {
+            const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+            offset += entry->d_reclen;
+
+            const char* name = entry->d_name;
+            if (isDotEntry(name)) continue;
+
+            DirEntryType type;
+            switch (entry->d_type) {
+            case DT_REG:
+                type = DirEntryType::File;
+                break;
+            case DT_DIR:
+                type = DirEntryType::Directory;
+                break;
+            case DT_LNK:
+                type = classifyEntry(fd, name, true, followSymlinks);
+                break;
+            case DT_UNKNOWN:
+                type = classifyEntry(fd, name, false, followSymlinks);
+                break;
+            default:
+                type = DirEntryType::Other;
+                break;
+            }
+            callback(name, type);
+        }
+    }
+
+    ::close(fd);
+    return true;
+}
+
+#else
+
+bool DirectoryReader::read(const std::string& dirPath, bool followSymlinks,
+                           const Callback& callback, const OpenCallback& onOpen) {
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir) {
+        return false;
+    }
+    int fd = dirfd(dir);
+
+    if (onOpen) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            closedir(dir);
+            return false;
+        }
+        DirectoryId id;
+        id.device = static_cast<uint64_t>(st.st_dev);
+        id.inode = static_cast<uint64_t>(st.st_ino);
+        if (!onOpen(id)) {
+            closedir(dir);
+            return true;
+        }
+    }
+
+    errno = 0;
+    while (struct dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (isDotEntry(name)) continue;
+
+        DirEntryType type;
+        if (entry->d_type == DT_REG) {
+            type = DirEntryType::File;
+        } else if (entry->d_type == DT_DIR) {
+            type = DirEntryType::Directory;
+        } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            type = classifyEntry(fd, name, entry->d_type == DT_LNK, followSymlinks);
+        } else {
+            type = DirEntryType::Other;
+        }
+        callback(name, type);
+    }
+
+    bool ok = errno == 0;
+    closedir(dir);
+    return ok;
+}
+
+#endif
+
+ParallelDirectoryWalker::ParallelDirectoryWalker(WorkStealingPool& pool, const WalkOptions& options,
+                                                 size_t maxBatchSize, BatchHandler onBatch, PathBatchPool* batches)
+    : pool_(pool),
+      options_(options),
+      maxBatchSize_(std::max<size_t>(1, maxBatchSize)),
+      onBatch_(std::move(onBatch)),
+      batches_(batches ? *batches : ownBatches_) {
+}
+
+void ParallelDirectoryWalker::run(const std::string& rootPath) {
+    start(rootPath);
+    pool_.WaitIdle();
+}
+
+void ParallelDirectoryWalker::start(const std::string& rootPath) {
+    std::string root = rootPath;
+    while (root.size() > 1 && (root.back() == '/' || root.back() == DirectoryReader::SEPARATOR) &&
+           root[root.size() - 2] != ':') {
+        root.pop_back();
+    }
+
+    push(DirectoryTask{this, PendingDirectory{root, 0}});
+}
+
+void ParallelDirectoryWalker::startFiles(const std::vector<std::string>& paths) {
+    stats_.files += paths.size();
+    for (size_t first = 0; first < paths.size(); first += maxBatchSize_) {
+        size_t last = std::min(paths.size(), first + maxBatchSize_);
+        PathBatch batch = batches_.take();
+        for (size_t i = first; i < last; ++i) {
+            batch.push_back(std::string_view(paths[i]));
+        }
+        push(BatchTask{this, std::move(batch)});
+    }
+}
+
+template <class Task>
+bool ParallelDirectoryWalker::tryPush(Task& task) {
+    tasks_.fetch_add(1, std::memory_order_relaxed);
+    if (pool_.TryPushTask(std::move(task))) {
+        return true;
+    }
+    // Задача выполнится в текущем потоке, внутри уже учтенной задачи
+    tasks_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <class Task>
+void ParallelDirectoryWalker::push(Task&& task) {
+    tasks_.fetch_add(1, std::memory_order_relaxed);
+    pool_.PushTask(std::forward<Task>(task));
+}
+
+void ParallelDirectoryWalker::taskDone() {
+    if (tasks_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        stats_.finishedNs.store(monotonicNs(), std::memory_order_release);
+    }
+}
+
+void ParallelDirectoryWalker::processDirectories(PendingDirectory first) {
+    // Каталоги, не поместившиеся в очередь пула, обрабатываются здесь же,
+    // файлы копятся в пачку, общую для всех каталогов этой задачи.
+    // Обработчик записей захватывает только this и listing и помещается
+    // в std::function без выделения памяти
+    Listing listing;
+    listing.dir = std::move(first);
+    listing.batch = batches_.take();
+    DirectoryReader::Callback onEntry = [this, &listing](const char* name, DirEntryType type) {
+        addEntry(listing, name, type);
+    };
+
+    DirectoryReader::OpenCallback onOpen;
+    if (options_.followSymlinks) {
+        onOpen = [this](const DirectoryReader::DirectoryId& id) { return markVisited(id); };
+    }
+
+    for (;;) {
+        listing.descend = options_.maxDepth < 0 || listing.dir.depth < options_.maxDepth;
+        listing.inlineNs = 0;
+        uint64_t start = monotonicNs();
+        bool ok = DirectoryReader::read(listing.dir.path, options_.followSymlinks, onEntry, onOpen);
+        stats_.listNs += monotonicNs() - start - listing.inlineNs;
+
+        if (ok) {
+            stats_.directories++;
+        } else {
+            stats_.errors++;
+        }
+        if (listing.local.empty()) {
+            break;
+        }
+        listing.dir = std::move(listing.local.back());
+        listing.local.pop_back();
+    }
+
+    submitBatch(listing.batch);
+    batches_.give(std::move(listing.batch));
+}
+
+void ParallelDirectoryWalker::addEntry(Listing& listing, const char* name, DirEntryType type) {
+    stats_.entries++;
+    if (type == DirEntryType::File) {
+        stats_.files++;
+        listing.batch.append(listing.dir.path, DirectoryReader::SEPARATOR, name);
+        if (listing.batch.size() >= currentBatchSize()) {
+            listing.inlineNs += submitBatch(listing.batch);
+        }
+    } else if (type == DirEntryType::Directory && listing.descend) {
+        // Путь каталога нужен задаче в очереди - одно выделение на каталог
+        PendingDirectory child;
+        child.path.reserve(listing.dir.path.size() + 1 + std::strlen(name));
+        child.path.append(listing.dir.path).push_back(DirectoryReader::SEPARATOR);
+        child.path.append(name);
+        child.depth = listing.dir.depth + 1;
+        submitDirectory(std::move(child), listing.local);
+    }
+}
+
+void ParallelDirectoryWalker::submitDirectory(PendingDirectory dir, std::vector<PendingDirectory>& local) {
+    DirectoryTask task{this, std::move(dir)};
+    if (!tryPush(task)) {
+        local.push_back(std::move(task.dir));
+    }
+}
+
+uint64_t ParallelDirectoryWalker::submitBatch(PathBatch& batch) {
+    if (batch.empty()) return 0;
+
+    BatchTask task{this, std::move(batch)};
+    // При полной очереди пачка хешируется в текущем потоке - это и есть backpressure
+    if (!tryPush(task)) {
+        uint64_t start = monotonicNs();
+        onBatch_(task.paths);
+        batch = std::move(task.paths);
+        batch.clear();
+        return monotonicNs() - start;
+    }
+    batch = batches_.take();
+    return 0;
+}
+
+size_t ParallelDirectoryWalker::currentBatchSize() const {
+    // Пачки растут с числом найденных файлов: первые файлы уходят в работу
+    // сразу, а маленькие деревья все равно делятся между всеми активными потоками
+    size_t size = static_cast<size_t>(stats_.files.load(std::memory_order_relaxed)) / pool_.ActiveThreads();
+    return std::max<size_t>(1, std::min(size, maxBatchSize_));
+}
+
+bool ParallelDirectoryWalker::markVisited(const DirectoryReader::DirectoryId& id) {
+    std::lock_guard<std::mutex> lock(visitedMutex_);
+    return visited_.insert(id).second;
+}
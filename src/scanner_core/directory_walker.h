@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "path_batch.h"
+#include "scanner_api.h"
+#include "work_stealing_pool.h"
+
+enum class DirEntryType { File, Directory, Other };
+
+/**
+ * Чтение одного каталога без std::filesystem.
+ * На Linux - getdents64 большими порциями, тип берется из d_type,
+ * stat выполняется только для ссылок и файловых систем без d_type.
+ */
+class SCANNER_API DirectoryReader {
+public:
+    using Callback = std::function<void(const char* name, DirEntryType type)>;
+
+    struct DirectoryId {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+
+        bool operator==(const DirectoryId& other) const {
+            return device == other.device && inode == other.inode;
+        }
+    };
+
+    // Вызывается после открытия каталога; false - пропустить каталог
+    using OpenCallback = std::function<bool(const DirectoryId& id)>;
+
+    // false, если каталог не удалось открыть или прочитать.
+    // onOpen получает идентификатор каталога (для защиты от циклов по ссылкам).
+    static bool read(const std::string& dirPath, bool followSymlinks,
+                     const Callback& callback, const OpenCallback& onOpen = nullptr);
+
+    static const char SEPARATOR;
+};
+
+struct WalkOptions {
+    int maxDepth = -1;              // -1 без ограничения, 0 - только файлы корня
+    bool followSymlinks = false;    // заходить ли в каталоги по символическим ссылкам
+};
+
+/**
+ * Параллельный обход дерева: каждый каталог - отдельная задача пула.
+ * Найденные файлы копятся в пачки и отдаются onBatch (тоже задачей пула,
+ * а если очередь заполнена - прямо в текущем потоке). Отработавшие пачки
+ * возвращаются в запас (общий, если его передали, иначе свой) и заполняются
+ * снова без выделений памяти.
+ */
+class SCANNER_API ParallelDirectoryWalker {
+public:
+    using BatchHandler = std::function<void(PathBatch& paths)>;
+
+    struct Stats {
+        std::atomic<uint64_t> files{0};
+        std::atomic<uint64_t> directories{0};
+        std::atomic<uint64_t> entries{0};
+        std::atomic<uint64_t> errors{0};
+        // Время чтения каталогов по всем потокам, без пачек, хешированных на месте
+        std::atomic<uint64_t> listNs{0};
+        // monotonicNs() завершения последней задачи обхода; 0 - обход еще идет
+        std::atomic<uint64_t> finishedNs{0};
+    };
+
+    ParallelDirectoryWalker(WorkStealingPool& pool, const WalkOptions& options,
+                            size_t maxBatchSize, BatchHandler onBatch, PathBatchPool* batches = nullptr);
+
+    // Обходит дерево и возвращается, когда все каталоги и пачки обработаны.
+    // Пул на время обхода используется эксклюзивно.
+    void run(const std::string& rootPath);
+
+    // Ставит обход в пул и сразу возвращается; несколько обходов в одном пуле
+    // идут вперемешку, их завершения ждет pool.WaitIdle(). Вызывать из внешнего потока
+    void start(const std::string& rootPath);
+    // Отдает готовый список файлов в onBatch пачками, без обхода каталогов
+    void startFiles(const std::vector<std::string>& paths);
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct PendingDirectory {
+        std::string path;
+        int depth = 0;
+    };
+
+    // Задачи пула - функторы, а не лямбды: при отказе TryPushTask
+    // их данные не перемещаются и остаются у вызывающего
+    struct DirectoryTask {
+        ParallelDirectoryWalker* walker;
+        PendingDirectory dir;
+        void operator()() {
+            walker->processDirectories(std::move(dir));
+            walker->taskDone();
+        }
+    };
+
+    // Задача обхода: текущий каталог, каталоги, не ушедшие в очередь, и пачка файлов
+    struct Listing {
+        PendingDirectory dir;
+        bool descend = false;
+        uint64_t inlineNs = 0;      // время пачек, хешированных на месте
+        std::vector<PendingDirectory> local;
+        PathBatch batch;
+    };
+
+    struct BatchTask {
+        ParallelDirectoryWalker* walker;
+        PathBatch paths;
+        void operator()() {
+            walker->onBatch_(paths);
+            walker->batches_.give(std::move(paths));
+            walker->taskDone();
+        }
+    };
+
+    struct DirectoryIdHash {
+        size_t operator()(const DirectoryReader::DirectoryId& id) const {
+            return static_cast<size_t>(id.inode * 0x9E3779B97F4A7C15ull ^ id.device);
+        }
+    };
+
+    WorkStealingPool& pool_;
+    WalkOptions options_;
+    size_t maxBatchSize_;
+    BatchHandler onBatch_;
+    Stats stats_;
+    // Задачи этого обхода в пуле; счетчик растет до постановки, поэтому
+    // ноль означает, что порожденных задач больше не будет
+    std::atomic<size_t> tasks_{0};
+
+    std::mutex visitedMutex_;
+    std::unordered_set<DirectoryReader::DirectoryId, DirectoryIdHash> visited_;
+
+    PathBatchPool ownBatches_;
+    PathBatchPool& batches_;
+
+    void processDirectories(PendingDirectory first);
+    void addEntry(Listing& listing, const char* name, DirEntryType type);
+    void submitDirectory(PendingDirectory dir, std::vector<PendingDirectory>& local);
+    // Возвращает время, ушедшее на пачку в текущем потоке (0 - ушла в очередь)
+    uint64_t submitBatch(PathBatch& batch);
+    size_t currentBatchSize() const;
+    template <class Task>
+    bool tryPush(Task& task);
+    template <class Task>
+    void push(Task&& task);
+    void taskDone();
+    bool markVisited(const DirectoryReader::DirectoryId& id);
+};
@@ -0,0 +1,817 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Файл, открытый только на чтение, с последовательным доступом.
+ * Ошибки не бросают исключений: вызывающий код проверяет результат и lastError().
+ */
+class InputFile {
+public:
+    InputFile() = default;
+
+    ~InputFile() {
+        close();
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        handle_ = CreateFileA(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+        if (handle_ == INVALID_HANDLE_VALUE) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            lastError_ = errno;
+            return false;
+        }
+#endif
+        lastError_ = 0;
+        return true;
+    }
+
+    // Количество прочитанных байт, 0 в конце файла, -1 при ошибке
+    int64_t read(void* buffer, size_t size) {
+#ifdef _WIN32
+        DWORD toRead = size > 0x40000000u ? 0x40000000u : static_cast<DWORD>(size);
+        DWORD bytesRead = 0;
+        if (!ReadFile(handle_, buffer, toRead, &bytesRead, NULL)) {
+            DWORD error = GetLastError();
+            if (error == ERROR_HANDLE_EOF) {
+                return 0;
+            }
+            lastError_ = static_cast<int>(error);
+            return -1;
+        }
+        return bytesRead;
+#else
+        while (true) {
+            ssize_t bytesRead = ::read(fd_, buffer, size);
+            if (bytesRead >= 0) {
+                return bytesRead;
+            }
+            if (errno != EINTR) {
+                lastError_ = errno;
+                return -1;
+            }
+        }
+#endif
+    }
+
+    // Размер открытого файла; false - это не обычный файл или размер не узнать
+    bool regularSize(uint64_t& size) {
+#ifdef _WIN32
+        LARGE_INTEGER fileSize;
+        if (GetFileType(handle_) != FILE_TYPE_DISK || !GetFileSizeEx(handle_, &fileSize)) {
+            return false;
+        }
+        size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+            return false;
+        }
+        size = static_cast<uint64_t>(st.st_size);
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    bool isOpen() const {
+#ifdef _WIN32
+        return handle_ != INVALID_HANDLE_VALUE;
+#else
+        return fd_ >= 0;
+#endif
+    }
+
+    int lastError() const { return lastError_; }
+
+private:
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    int lastError_ = 0;
+};
+
+/**
+ * Файл, целиком отображенный в память только на чтение.
+ * Страницы подгружаются по обращению и разделяются между процессами через page cache.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            lastError_ = static_cast<int>(GetLastError());
+            CloseHandle(file);
+            return false;
+        }
+        size_ = static_cast<size_t>(fileSize.QuadPart);
+        if (size_ > 0) {
+            mapping_ = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping_) {
+                data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            }
+            if (!data_) {
+                lastError_ = static_cast<int>(GetLastError());
+                CloseHandle(file);
+                close();
+                return false;
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            lastError_ = errno;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            lastError_ = errno;
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED) {
+                lastError_ = errno;
+                ::close(fd);
+                size_ = 0;
+                return false;
+            }
+            data_ = static_cast<const uint8_t*>(data);
+        }
+        // Отображение живет и после закрытия дескриптора
+        ::close(fd);
+#endif
+        open_ = true;
+        lastError_ = 0;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = NULL;
+        }
+#else
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        open_ = false;
+    }
+
+    bool isOpen() const { return open_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    int lastError() const { return lastError_; }
+
+private:
+#ifdef _WIN32
+    HANDLE mapping_ = NULL;
+#endif
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+    int lastError_ = 0;
+};
+
+/**
+ * Файл для записи с явным сбросом на диск. Используется там, где запись
+ * должна пережить сбой: данные пишутся во временный файл или дописываются
+ * в журнал, sync() дожидается их попадания на диск.
+ */
+class OutputFile {
+public:
+    OutputFile() = default;
+
+    ~OutputFile() {
+        close();
+    }
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // truncate - начать с пустого файла, иначе запись продолжается с конца
+    bool open(const std::string& path, bool truncate) {
+        close();
+#ifdef _WIN32
+        handle_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                              truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle_ == INVALID_HANDLE_VALUE) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+        if (!truncate) {
+            SetFilePointer(handle_, 0, NULL, FILE_END);
+        }
+#else
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : O_APPEND), 0644);
+        if (fd_ < 0) {
+            lastError_ = errno;
+            return false;
+        }
+#endif
+        lastError_ = 0;
+        return true;
+    }
+
+    bool write(const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (size > 0) {
+#ifdef _WIN32
+            DWORD chunk = size > 0x40000000u ? 0x40000000u : static_cast<DWORD>(size);
+            DWORD written = 0;
+            if (!WriteFile(handle_, p, chunk, &written, NULL)) {
+                lastError_ = static_cast<int>(GetLastError());
+                return false;
+            }
+#else
+            ssize_t written = ::write(fd_, p, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                lastError_ = errno;
+                return false;
+            }
+#endif
+            p += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    struct Buffer {
+        const void* data;
+        size_t size;
+    };
+
+    // Пишет буферы подряд; на POSIX - одним writev на до MAX_GATHER буферов
+    bool writeGather(const Buffer* buffers, size_t count) {
+#ifdef _WIN32
+        for (size_t i = 0; i < count; ++i) {
+            if (!write(buffers[i].data, buffers[i].size)) {
+                return false;
+            }
+        }
+        return true;
+#else
+        struct iovec vectors[MAX_GATHER];
+        size_t first = 0;
+        size_t skip = 0;    // уже записанные байты буфера first
+        while (first < count) {
+            size_t n = 0;
+            for (size_t i = first; i < count && n < MAX_GATHER; ++i, ++n) {
+                size_t offset = i == first ? skip : 0;
+                vectors[n].iov_base = const_cast<uint8_t*>(static_cast<const uint8_t*>(buffers[i].data) + offset);
+                vectors[n].iov_len = buffers[i].size - offset;
+            }
+            ssize_t written = ::writev(fd_, vectors, static_cast<int>(n));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                lastError_ = errno;
+                return false;
+            }
+            // Частичная запись: продолжаем с первого недописанного буфера
+            size_t left = static_cast<size_t>(written);
+            while (first < count && left >= buffers[first].size - skip) {
+                left -= buffers[first].size - skip;
+                skip = 0;
+                first++;
+            }
+            skip += left;
+        }
+        return true;
+#endif
+    }
+
+    // Обрезает файл до size байт; следующая запись идет с нового конца
+    bool truncate(uint64_t size) {
+#ifdef _WIN32
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(handle_, position, NULL, FILE_BEGIN) || !SetEndOfFile(handle_)) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+#else
+        if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+            lastError_ = errno;
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // Дожидается записи данных на диск
+    bool sync() {
+#ifdef _WIN32
+        if (!FlushFileBuffers(handle_)) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+#else
+        if (fdatasync(fd_) != 0) {
+            lastError_ = errno;
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    bool isOpen() const {
+#ifdef _WIN32
+        return handle_ != INVALID_HANDLE_VALUE;
+#else
+        return fd_ >= 0;
+#endif
+    }
+
+    int lastError() const { return lastError_; }
+
+    // Буферов на один writev (IOV_MAX не меньше 1024 на Linux)
+    static constexpr size_t MAX_GATHER = 64;
+
+    /**
+     * Атомарно заменяет target файлом source (оба в одном каталоге).
+     * На POSIX после rename сбрасывается и каталог, иначе после сбоя
+     * на диске может остаться старая запись каталога.
+     */
+    static bool replace(const std::string& source, const std::string& target) {
+#ifdef _WIN32
+        return MoveFileExA(source.c_str(), target.c_str(),
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        if (::rename(source.c_str(), target.c_str()) != 0) {
+            return false;
+        }
+        size_t slash = target.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : target.substr(0, slash));
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            fsync(fd);
+            ::close(fd);
+        }
+        return true;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    int lastError_ = 0;
+};
+
+/**
+ * Выровненный буфер (O_DIRECT требует выравнивания адреса и длины чтения).
+ * Память не обнуляется и переиспользуется между файлами.
+ */
+class AlignedBuffer {
+public:
+    static constexpr size_t ALIGNMENT = 4096;
+
+    AlignedBuffer() = default;
+
+    ~AlignedBuffer() {
+        release();
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    // Гарантирует емкость не меньше size; false при нехватке памяти
+    bool reserve(size_t size) {
+        if (size <= capacity_) {
+            return true;
+        }
+        release();
+        size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+#ifdef _WIN32
+        data_ = static_cast<uint8_t*>(_aligned_malloc(size, ALIGNMENT));
+#else
+        void* data = nullptr;
+        data_ = posix_memalign(&data, ALIGNMENT, size) == 0 ? static_cast<uint8_t*>(data) : nullptr;
+#endif
+        capacity_ = data_ ? size : 0;
+        return data_ != nullptr;
+    }
+
+    uint8_t* data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+
+    void release() {
+#ifdef _WIN32
+        _aligned_free(data_);
+#else
+        free(data_);
+#endif
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+};
+
+enum class ReadStrategy {
+    Auto,       // выбор по размеру файла
+    Stream,     // последовательные чтения буфером bufferSize (крупные файлы - largeBufferSize)
+    SingleRead, // весь файл одним чтением (файлы не больше bufferSize)
+    Mapped,     // отображение всего файла с MADV_SEQUENTIAL (при Auto - только с mapLargeFiles)
+    Direct      // O_DIRECT крупными выровненными чтениями, мимо page cache
+};
+
+struct ReadOptions {
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    ReadStrategy strategy = ReadStrategy::Auto;
+    size_t bufferSize = DEFAULT_BUFFER_SIZE;        // буфер потокового чтения и предел SingleRead
+    uint64_t largeFileSize = 1024 * 1024;           // с этого размера файл читается крупными кусками
+    size_t largeBufferSize = 256 * 1024;            // размер одного чтения крупного файла
+    bool directIo = false;                          // крупные файлы читать O_DIRECT мимо page cache
+    size_t directBufferSize = 4 * 1024 * 1024;      // размер одного чтения O_DIRECT (кратен 4 КиБ)
+    // Крупные файлы отображать в память. Файл, укороченный во время хеширования
+    // отображения, дает SIGBUS и роняет процесс, поэтому это только по явному выбору
+    // и для файлов, которые никто не укорачивает
+    bool mapLargeFiles = false;
+    // Файлы, которые могут меняться, не отображаются и при mapLargeFiles
+    bool filesMayChange = false;                    // файлы пишутся во время сканирования (наблюдение)
+    int64_t stableBeforeNs = 0;                     // файл, измененный позже (нс от 1970 года), не отображать; 0 - не проверять
+
+    // Стратегия для обычного файла данного размера
+    ReadStrategy choose(uint64_t size) const {
+        if (strategy != ReadStrategy::Auto) {
+            // Одним чтением нельзя прочитать файл больше буфера
+            return strategy == ReadStrategy::SingleRead && size > bufferSize ? ReadStrategy::Stream : strategy;
+        }
+        if (size <= bufferSize) {
+            return ReadStrategy::SingleRead;
+        }
+        if (size >= largeFileSize && directIo) {
+            return ReadStrategy::Direct;
+        }
+        if (size >= largeFileSize && mapLargeFiles) {
+            return ReadStrategy::Mapped;
+        }
+        return ReadStrategy::Stream;
+    }
+};
+
+/**
+ * Чтение файла с выбором стратегии по размеру: размер берется fstat уже
+ * открытого дескриптора (getdents64 размеров не дает). Маленький файл читается
+ * одним read в буфер читателя, средний - потоково, крупный - потоково
+ * большими выровненными кусками или O_DIRECT. Отображение крупных файлов
+ * включается явно (ReadOptions::mapLargeFiles): укорочение отображенного
+ * файла во время чтения дает SIGBUS, а при чтении это просто короткий файл.
+ * Файл, который может меняться (filesMayChange, stableBeforeNs), не
+ * отображается и тогда. Для обычного файла конец определяется по размеру,
+ * без лишнего read, возвращающего 0.
+ *
+ * next() отдает очередной кусок файла без копирования: указатель смотрит
+ * в буфер читателя или в отображение и действителен до следующего next/close.
+ * Буферы переиспользуются между файлами.
+ */
+class FileReader {
+public:
+    explicit FileReader(const ReadOptions& options = ReadOptions()) : options_(options) {}
+
+    ~FileReader() {
+        close();
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    // Применяется к файлам, открытым после вызова
+    void setOptions(const ReadOptions& options) { options_ = options; }
+    const ReadOptions& options() const { return options_; }
+
+    bool open(const std::string& path) {
+        close();
+        offset_ = 0;
+        size_ = 0;
+        regular_ = false;
+        // Windows не дает укоротить отображенный файл, там отображение безопасно
+        bool changing = false;
+#ifdef _WIN32
+        handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        syscalls_++;
+        if (handle_ == INVALID_HANDLE_VALUE) {
+            lastError_ = static_cast<int>(GetLastError());
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        syscalls_++;
+        if (GetFileType(handle_) == FILE_TYPE_DISK && GetFileSizeEx(handle_, &fileSize)) {
+            size_ = static_cast<uint64_t>(fileSize.QuadPart);
+            regular_ = true;
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        syscalls_++;
+        if (fd_ < 0) {
+            lastError_ = errno;
+            return false;
+        }
+        struct stat st;
+        syscalls_++;
+        if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<uint64_t>(st.st_size);
+            regular_ = true;
+            int64_t mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            changing = options_.filesMayChange ||
+                       (options_.stableBeforeNs != 0 && mtimeNs >= options_.stableBeforeNs);
+        }
+#endif
+        strategy_ = regular_ ? options_.choose(size_) : ReadStrategy::Stream;
+        if (strategy_ == ReadStrategy::Mapped && changing) {
+            strategy_ = ReadStrategy::Stream;
+        }
+        lastError_ = 0;
+        return prepare();
+    }
+
+    // Очередной кусок файла: число байт, 0 в конце файла, -1 при ошибке
+    int64_t next(const uint8_t*& data) {
+        if (regular_ && offset_ >= size_) {
+            return 0;
+        }
+        if (strategy_ == ReadStrategy::Mapped) {
+            data = mapped_ + offset_;
+            int64_t size = static_cast<int64_t>(size_ - offset_);
+            offset_ = size_;
+            return size;
+        }
+
+        int64_t bytesRead = readAt(buffer_.data(), chunk_);
+#if !defined(_WIN32) && defined(O_DIRECT)
+        if (bytesRead < 0 && lastError_ == EINVAL && strategy_ == ReadStrategy::Direct) {
+            // Файловая система приняла O_DIRECT при открытии, но не при чтении
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+            syscalls_ += 2;
+            strategy_ = ReadStrategy::Stream;
+            chunk_ = streamChunk();
+            bytesRead = readAt(buffer_.data(), chunk_);
+        }
+#endif
+        if (bytesRead < 0) {
+            return -1;
+        }
+        if (bytesRead == 0 && regular_) {
+            // Файл укоротился после fstat
+            size_ = offset_;
+        }
+        offset_ += static_cast<uint64_t>(bytesRead);
+        data = buffer_.data();
+        return bytesRead;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (mapped_) {
+            UnmapViewOfFile(mapped_);
+            syscalls_++;
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = NULL;
+        }
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+            syscalls_++;
+        }
+#else
+        if (mapped_) {
+            munmap(const_cast<uint8_t*>(mapped_), static_cast<size_t>(size_));
+            syscalls_++;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+            syscalls_++;
+        }
+#endif
+        mapped_ = nullptr;
+    }
+
+    ReadStrategy strategy() const { return strategy_; }
+    uint64_t size() const { return size_; }
+    int lastError() const { return lastError_; }
+
+    // Число системных вызовов с момента создания (для бенчмарков)
+    uint64_t syscalls() const { return syscalls_; }
+
+private:
+    ReadOptions options_;
+    ReadStrategy strategy_ = ReadStrategy::Stream;
+    AlignedBuffer buffer_;
+    const uint8_t* mapped_ = nullptr;
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = NULL;
+#else
+    int fd_ = -1;
+#endif
+    uint64_t size_ = 0;
+    uint64_t offset_ = 0;
+    size_t chunk_ = 0;          // размер одного чтения выбранной стратегии
+    bool regular_ = false;
+    int lastError_ = 0;
+    uint64_t syscalls_ = 0;
+
+    // Потоковое чтение: крупный файл при выборе по размеру читается кусками
+    // largeBufferSize, остальные и явно заданный Stream - кусками bufferSize
+    size_t streamChunk() const {
+        bool large = options_.strategy == ReadStrategy::Auto && regular_ && size_ >= options_.largeFileSize;
+        return large ? std::max(options_.largeBufferSize, options_.bufferSize) : options_.bufferSize;
+    }
+
+    // Готовит выбранную стратегию; при неудаче переходит к потоковому чтению
+    bool prepare() {
+        if (strategy_ == ReadStrategy::Mapped && size_ > 0 && mapFile()) {
+            return true;
+        }
+        if (strategy_ == ReadStrategy::Mapped) {
+            strategy_ = ReadStrategy::Stream;
+        }
+#if !defined(_WIN32) && defined(O_DIRECT)
+        if (strategy_ == ReadStrategy::Direct) {
+            syscalls_ += 2;
+            if (fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_DIRECT) != 0) {
+                // tmpfs и часть сетевых ФС не поддерживают O_DIRECT
+                strategy_ = ReadStrategy::Stream;
+            }
+        }
+#else
+        if (strategy_ == ReadStrategy::Direct) {
+            // FILE_FLAG_NO_BUFFERING задается только при открытии, а без O_DIRECT -
+            // обычное потоковое чтение
+            strategy_ = ReadStrategy::Stream;
+        }
+#endif
+        if (strategy_ == ReadStrategy::Stream && regular_ && size_ > options_.bufferSize) {
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            syscalls_++;
+#endif
+        }
+
+        chunk_ = streamChunk();
+        if (strategy_ == ReadStrategy::SingleRead) {
+            chunk_ = static_cast<size_t>(size_);
+        } else if (strategy_ == ReadStrategy::Direct) {
+            chunk_ = options_.directBufferSize;
+        }
+        // После отказа O_DIRECT тот же буфер читается потоково
+        size_t needed = std::max(chunk_, strategy_ == ReadStrategy::Direct ? streamChunk() : size_t(0));
+        if (!buffer_.reserve(needed > 0 ? needed : 1)) {
+            lastError_ = ENOMEM;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool mapFile() {
+#ifdef _WIN32
+        syscalls_ += 2;
+        mapping_ = CreateFileMappingA(handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_) {
+            mapped_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!mapped_ && mapping_) {
+            CloseHandle(mapping_);
+            mapping_ = NULL;
+        }
+#else
+        syscalls_++;
+        void* data = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, fd_, 0);
+        if (data != MAP_FAILED) {
+            mapped_ = static_cast<const uint8_t*>(data);
+            madvise(data, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+            syscalls_++;
+        }
+#endif
+        return mapped_ != nullptr;
+    }
+
+    int64_t readAt(uint8_t* buffer, size_t size) {
+#ifdef _WIN32
+        DWORD toRead = size > 0x40000000u ? 0x40000000u : static_cast<DWORD>(size);
+        DWORD bytesRead = 0;
+        syscalls_++;
+        if (!ReadFile(handle_, buffer, toRead, &bytesRead, NULL)) {
+            DWORD error = GetLastError();
+            if (error == ERROR_HANDLE_EOF) {
+                return 0;
+            }
+            lastError_ = static_cast<int>(error);
+            return -1;
+        }
+        return bytesRead;
+#else
+        while (true) {
+            syscalls_++;
+            ssize_t bytesRead = ::read(fd_, buffer, size);
+            if (bytesRead >= 0) {
+                return bytesRead;
+            }
+            if (errno != EINTR) {
+                lastError_ = errno;
+                return -1;
+            }
+        }
+#endif
+    }
+};
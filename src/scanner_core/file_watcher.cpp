@@ -0,0 +1,584 @@
+#include "file_watcher.h"
+#include "directory_walker.h"
+#include "scan_metrics.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+#include <utility>
+
+#ifdef __linux__
+#include <climits>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool isUnder(const std::string& path, const std::string& root) {
+    if (root == "/") {
+        return !path.empty() && path[0] == '/';
+    }
+    return path.size() >= root.size() && path.compare(0, root.size(), root) == 0 &&
+           (path.size() == root.size() || path[root.size()] == '/');
+}
+
+bool underAnyRoot(const std::string& path, const std::vector<std::string>& roots) {
+    for (const std::string& root : roots) {
+        if (isUnder(path, root)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string joinPath(const std::string& dir, const char* name) {
+    std::string path = dir;
+    if (path.empty() || path.back() != '/') {
+        path += '/';
+    }
+    path += name;
+    return path;
+}
+
+}
+
+// Механизм наблюдения: дескриптор для poll и разбор накопившихся событий
+struct FileWatcher::Backend {
+    std::vector<std::string> roots;
+    std::atomic<uint64_t> events{0};
+    std::atomic<uint64_t> ignored{0};
+    std::atomic<uint64_t> watches{0};
+    std::atomic<uint64_t> errors{0};
+
+    virtual ~Backend() = default;
+    virtual int fd() const = 0;
+    // Читает события, пока они есть; false - ошибка чтения, error - errno
+    virtual bool drain(std::vector<FileEvent>& events, int& error) = 0;
+
+    // Файлы появившегося в дереве каталога и его подкаталогов. onDirectory
+    // вызывается до чтения каталога, чтобы файлы, созданные после чтения, пришли событиями
+    template <class OnDirectory>
+    void listTree(const std::string& dir, uint64_t timeNs, bool reportFiles,
+                  std::vector<FileEvent>& out, OnDirectory onDirectory) {
+        std::vector<std::string> stack{dir};
+        while (!stack.empty()) {
+            std::string current = std::move(stack.back());
+            stack.pop_back();
+            onDirectory(current);
+            bool ok = DirectoryReader::read(current, false, [&](const char* name, DirEntryType type) {
+                if (type == DirEntryType::Directory) {
+                    stack.push_back(joinPath(current, name));
+                } else if (type == DirEntryType::File && reportFiles) {
+                    FileEvent event;
+                    event.path = joinPath(current, name);
+                    event.timeNs = timeNs;
+                    out.push_back(std::move(event));
+                }
+            });
+            if (!ok) {
+                errors++;
+            }
+        }
+    }
+};
+
+#ifdef __linux__
+
+/**
+ * fanotify с FAN_REPORT_DFID_NAME: у события есть дескриптор (file handle)
+ * родительского каталога и имя. Каталог открывается по дескриптору через
+ * любой открытый объект той же файловой системы, путь берется из /proc/self/fd.
+ */
+struct FileWatcher::Fanotify : FileWatcher::Backend {
+    static constexpr uint64_t MASK = FAN_CLOSE_WRITE | FAN_MOVED_TO | FAN_MOVED_FROM | FAN_DELETE | FAN_ONDIR;
+    // Кэш путей каталогов сбрасывается целиком, если разрастается
+    static constexpr size_t DIRECTORY_CACHE_LIMIT = 64 * 1024;
+
+    struct Mount {
+        fsid_t fsid;
+        int fd;
+    };
+
+    int fd_ = -1;
+    std::vector<Mount> mounts_;
+    std::unordered_map<std::string, std::string> directories_;
+
+    ~Fanotify() override {
+        for (const Mount& mount : mounts_) {
+            ::close(mount.fd);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    int fd() const override { return fd_; }
+
+    bool open(int& error) {
+        fd_ = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME,
+                            O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            error = errno;
+            return false;
+        }
+        for (const std::string& root : roots) {
+            if (fanotify_mark(fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, MASK, AT_FDCWD, root.c_str()) != 0 ||
+                !addMount(root, error)) {
+                error = error ? error : errno;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Открытый корень нужен open_by_handle_at (дескриптор O_PATH он не принимает);
+    // заодно проверяется, что на это есть права
+    bool addMount(const std::string& root, int& error) {
+        int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        struct statfs fs;
+        if (rootFd < 0 || fstatfs(rootFd, &fs) != 0) {
+            error = errno;
+            if (rootFd >= 0) {
+                ::close(rootFd);
+            }
+            return false;
+        }
+        for (const Mount& mount : mounts_) {
+            if (std::memcmp(&mount.fsid, &fs.f_fsid, sizeof(fsid_t)) == 0) {
+                ::close(rootFd);
+                return true;
+            }
+        }
+
+        alignas(struct file_handle) char buffer[sizeof(struct file_handle) + MAX_HANDLE_SZ];
+        auto* handle = reinterpret_cast<struct file_handle*>(buffer);
+        handle->handle_bytes = MAX_HANDLE_SZ;
+        int mountId = 0;
+        int probe = -1;
+        if (name_to_handle_at(rootFd, "", handle, &mountId, AT_EMPTY_PATH) == 0) {
+            probe = open_by_handle_at(rootFd, handle, O_PATH | O_CLOEXEC);
+        }
+        if (probe < 0) {
+            error = errno;
+            ::close(rootFd);
+            return false;
+        }
+        ::close(probe);
+        mounts_.push_back(Mount{fs.f_fsid, rootFd});
+        return true;
+    }
+
+    bool directoryPath(const struct fanotify_event_info_fid* info, std::string& path) {
+        auto* handle = reinterpret_cast<struct file_handle*>(const_cast<unsigned char*>(info->handle));
+        std::string key(reinterpret_cast<const char*>(&info->fsid), sizeof(info->fsid));
+        key.append(reinterpret_cast<const char*>(&handle->handle_type), sizeof(handle->handle_type));
+        key.append(reinterpret_cast<const char*>(handle->f_handle), handle->handle_bytes);
+        auto cached = directories_.find(key);
+        if (cached != directories_.end()) {
+            path = cached->second;
+            return true;
+        }
+
+        int mountFd = -1;
+        for (const Mount& mount : mounts_) {
+            if (std::memcmp(&mount.fsid, &info->fsid, sizeof(fsid_t)) == 0) {
+                mountFd = mount.fd;
+                break;
+            }
+        }
+        if (mountFd < 0) {
+            return false;
+        }
+        int dirFd = open_by_handle_at(mountFd, handle, O_PATH | O_CLOEXEC);
+        if (dirFd < 0) {
+            return false;
+        }
+        char link[32];
+        std::snprintf(link, sizeof(link), "/proc/self/fd/%d", dirFd);
+        char target[PATH_MAX];
+        ssize_t length = ::readlink(link, target, sizeof(target));
+        ::close(dirFd);
+        if (length <= 0 || target[0] != '/') {
+            return false;
+        }
+        path.assign(target, static_cast<size_t>(length));
+        if (directories_.size() >= DIRECTORY_CACHE_LIMIT) {
+            directories_.clear();
+        }
+        directories_.emplace(std::move(key), path);
+        return true;
+    }
+
+    bool drain(std::vector<FileEvent>& out, int& error) override {
+        alignas(struct fanotify_event_metadata) char buffer[64 * 1024];
+        for (;;) {
+            ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+            if (length < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    return true;
+                }
+                error = errno;
+                return false;
+            }
+            uint64_t now = monotonicNs();
+            auto* event = reinterpret_cast<struct fanotify_event_metadata*>(buffer);
+            for (; FAN_EVENT_OK(event, length); event = FAN_EVENT_NEXT(event, length)) {
+                events++;
+                if (event->fd >= 0) {
+                    ::close(event->fd);
+                }
+                if (event->mask & FAN_Q_OVERFLOW) {
+                    FileEvent overflow;
+                    overflow.type = FileEvent::Type::Overflow;
+                    overflow.timeNs = now;
+                    out.push_back(std::move(overflow));
+                    continue;
+                }
+                handle(*event, now, out);
+            }
+        }
+    }
+
+    void handle(const struct fanotify_event_metadata& event, uint64_t now, std::vector<FileEvent>& out) {
+        // Каталог перенесен или удален: закэшированные пути под ним устарели
+        if ((event.mask & FAN_ONDIR) && (event.mask & (FAN_MOVED_FROM | FAN_DELETE | FAN_MOVED_TO))) {
+            directories_.clear();
+        }
+
+        const struct fanotify_event_info_fid* fid = nullptr;
+        const char* info = reinterpret_cast<const char*>(&event) + event.metadata_len;
+        const char* end = reinterpret_cast<const char*>(&event) + event.event_len;
+        while (info + sizeof(struct fanotify_event_info_header) <= end) {
+            auto* header = reinterpret_cast<const struct fanotify_event_info_header*>(info);
+            if (header->len == 0) {
+                break;
+            }
+            if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                fid = reinterpret_cast<const struct fanotify_event_info_fid*>(info);
+                break;
+            }
+            info += header->len;
+        }
+        std::string dir;
+        if (!fid || !directoryPath(fid, dir)) {
+            ignored++;
+            return;
+        }
+        auto* handle = reinterpret_cast<const struct file_handle*>(fid->handle);
+        const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+        std::string path = joinPath(dir, name);
+        if (!underAnyRoot(path, roots)) {
+            ignored++;
+            return;
+        }
+
+        if (event.mask & FAN_ONDIR) {
+            // Метка на всю файловую систему: подкаталоги отдельных меток не требуют
+            if (event.mask & FAN_MOVED_TO) {
+                listTree(path, now, true, out, [](const std::string&) {});
+            }
+            return;
+        }
+        // Ядро сливает события одного имени в одну маску, и порядок теряется:
+        // записан и удален или удален и записан заново - решает наличие файла
+        bool changed = event.mask & (FAN_CLOSE_WRITE | FAN_MOVED_TO);
+        bool removed = event.mask & (FAN_MOVED_FROM | FAN_DELETE);
+        if (changed && removed) {
+            struct stat st;
+            removed = ::lstat(path.c_str(), &st) != 0;
+            changed = !removed;
+        }
+        if (!changed && !removed) {
+            return;
+        }
+        FileEvent file;
+        file.type = changed ? FileEvent::Type::Changed : FileEvent::Type::Removed;
+        file.path = std::move(path);
+        file.timeNs = now;
+        out.push_back(std::move(file));
+    }
+};
+
+/**
+ * inotify: метка на каждый каталог. Каталог, перенесенный из дерева,
+ * снимается с наблюдения вместе с подкаталогами; появившийся - добавляется
+ */
+struct FileWatcher::Inotify : FileWatcher::Backend {
+    static constexpr uint32_t MASK =
+        IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR | IN_DONT_FOLLOW;
+
+    int fd_ = -1;
+    std::unordered_map<int, std::string> directories_;
+    int addError_ = 0;
+
+    ~Inotify() override {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    int fd() const override { return fd_; }
+
+    bool open(int& error) {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            error = errno;
+            return false;
+        }
+        std::vector<FileEvent> none;
+        for (const std::string& root : roots) {
+            if (!addWatch(root)) {
+                error = addError_;
+                return false;
+            }
+            listTree(root, 0, false, none, [this, &root](const std::string& dir) {
+                if (dir != root) {
+                    addWatch(dir);
+                }
+            });
+        }
+        return true;
+    }
+
+    bool addWatch(const std::string& dir) {
+        int wd = inotify_add_watch(fd_, dir.c_str(), MASK);
+        if (wd < 0) {
+            addError_ = errno;
+            errors++;
+            return false;
+        }
+        directories_[wd] = dir;
+        watches = directories_.size();
+        return true;
+    }
+
+    void removeTree(const std::string& dir) {
+        for (auto it = directories_.begin(); it != directories_.end();) {
+            if (isUnder(it->second, dir)) {
+                inotify_rm_watch(fd_, it->first);
+                it = directories_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        watches = directories_.size();
+    }
+
+    bool drain(std::vector<FileEvent>& out, int& error) override {
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;) {
+            ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+            if (length < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    return true;
+                }
+                error = errno;
+                return false;
+            }
+            uint64_t now = monotonicNs();
+            for (char* p = buffer; p < buffer + length;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                events++;
+                handle(*event, now, out);
+            }
+        }
+    }
+
+    void handle(const struct inotify_event& event, uint64_t now, std::vector<FileEvent>& out) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            FileEvent overflow;
+            overflow.type = FileEvent::Type::Overflow;
+            overflow.timeNs = now;
+            out.push_back(std::move(overflow));
+            return;
+        }
+        if (event.mask & IN_IGNORED) {
+            directories_.erase(event.wd);
+            watches = directories_.size();
+            return;
+        }
+        auto dir = directories_.find(event.wd);
+        if (dir == directories_.end() || event.len == 0) {
+            ignored++;
+            return;
+        }
+        std::string path = joinPath(dir->second, event.name);
+
+        if (event.mask & IN_ISDIR) {
+            if (event.mask & (IN_CREATE | IN_MOVED_TO)) {
+                listTree(path, now, true, out, [this](const std::string& sub) { addWatch(sub); });
+            } else if (event.mask & IN_MOVED_FROM) {
+                removeTree(path);
+            }
+            return;
+        }
+        FileEvent file;
+        file.path = std::move(path);
+        file.timeNs = now;
+        if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+            out.push_back(std::move(file));
+        } else if (event.mask & (IN_MOVED_FROM | IN_DELETE)) {
+            file.type = FileEvent::Type::Removed;
+            out.push_back(std::move(file));
+        }
+    }
+};
+
+#endif
+
+FileWatcher::FileWatcher() = default;
+
+FileWatcher::~FileWatcher() {
+    close();
+}
+
+std::string FileWatcher::canonicalRoot(const std::string& root) {
+    std::error_code ec;
+    std::string path = std::filesystem::canonical(root, ec).string();
+    if (ec) {
+        return std::string();
+    }
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+bool FileWatcher::open(const std::vector<std::string>& roots, WatchBackend backend) {
+    close();
+    lastError_ = 0;
+#ifdef __linux__
+    std::vector<std::string> canonical;
+    for (const std::string& root : roots) {
+        canonical.push_back(canonicalRoot(root));
+        if (canonical.back().empty() || !std::filesystem::is_directory(canonical.back())) {
+            lastError_ = ENOENT;
+            return false;
+        }
+    }
+    if (canonical.empty()) {
+        lastError_ = EINVAL;
+        return false;
+    }
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd_ < 0) {
+        lastError_ = errno;
+        return false;
+    }
+
+    if (backend != WatchBackend::Inotify) {
+        std::unique_ptr<Fanotify> fanotify(new Fanotify());
+        fanotify->roots = canonical;
+        if (fanotify->open(lastError_)) {
+            impl_ = std::move(fanotify);
+            backend_ = WatchBackend::Fanotify;
+            return true;
+        }
+        if (backend == WatchBackend::Fanotify) {
+            close();
+            return false;
+        }
+    }
+    std::unique_ptr<Inotify> inotify(new Inotify());
+    inotify->roots = canonical;
+    lastError_ = 0;
+    if (!inotify->open(lastError_)) {
+        close();
+        return false;
+    }
+    impl_ = std::move(inotify);
+    backend_ = WatchBackend::Inotify;
+    return true;
+#else
+    (void)roots;
+    (void)backend;
+    lastError_ = ENOSYS;
+    return false;
+#endif
+}
+
+void FileWatcher::close() {
+    impl_.reset();
+#ifdef __linux__
+    if (wakeFd_ >= 0) {
+        ::close(wakeFd_);
+    }
+#endif
+    wakeFd_ = -1;
+    backend_ = WatchBackend::Auto;
+}
+
+bool FileWatcher::isOpen() const {
+    return impl_ != nullptr;
+}
+
+bool FileWatcher::read(std::vector<FileEvent>& events, int64_t timeoutNs) {
+#ifdef __linux__
+    if (!impl_) {
+        return false;
+    }
+    struct pollfd fds[2] = {{impl_->fd(), POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+    struct timespec timeout;
+    timeout.tv_sec = static_cast<time_t>(timeoutNs / 1000000000);
+    timeout.tv_nsec = static_cast<long>(timeoutNs % 1000000000);
+    int ready = ppoll(fds, 2, timeoutNs < 0 ? nullptr : &timeout, nullptr);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        lastError_ = errno;
+        return false;
+    }
+    if (fds[1].revents & POLLIN) {
+        uint64_t value;
+        ssize_t ignored = ::read(wakeFd_, &value, sizeof(value));
+        (void)ignored;
+    }
+    if (fds[0].revents & POLLIN) {
+        return impl_->drain(events, lastError_);
+    }
+    return true;
+#else
+    (void)events;
+    (void)timeoutNs;
+    return false;
+#endif
+}
+
+void FileWatcher::wake() {
+#ifdef __linux__
+    if (wakeFd_ >= 0) {
+        uint64_t one = 1;
+        ssize_t written = ::write(wakeFd_, &one, sizeof(one));
+        (void)written;
+    }
+#endif
+}
+
+FileWatcher::Stats FileWatcher::stats() const {
+    Stats stats;
+    if (impl_) {
+        stats.events = impl_->events;
+        stats.ignored = impl_->ignored;
+        stats.watches = impl_->watches;
+        stats.errors = impl_->errors;
+    }
+    return stats;
+}
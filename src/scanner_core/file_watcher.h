@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "scanner_api.h"
+#include "scanner_core.h"
+
+// Событие наблюдения за деревом
+struct FileEvent {
+    enum class Type {
+        Changed,    // файл закрыт после записи, перенесен в дерево или найден в новом каталоге
+        Removed,    // файл удален или перенесен из дерева
+        Overflow    // очередь событий ядра переполнилась, часть событий потеряна
+    };
+
+    Type type = Type::Changed;
+    std::string path;           // у Overflow пустой
+    uint64_t timeNs = 0;        // monotonicNs() чтения события (ядро времени события не сообщает)
+};
+
+/**
+ * Наблюдение за деревьями каталогов (Linux).
+ *
+ * fanotify: одна метка на файловую систему корня (FAN_MARK_FILESYSTEM),
+ * события приходят с дескриптором родительского каталога и именем
+ * (FAN_REPORT_DFID_NAME, Linux 5.9+). Путь каталога восстанавливается через
+ * open_by_handle_at и кэшируется до первого переноса или удаления каталога.
+ * Нужны CAP_SYS_ADMIN и CAP_DAC_READ_SEARCH; события вне корней отбрасываются.
+ *
+ * inotify: метка на каждый каталог дерева, новые каталоги добавляются по
+ * событиям. Упирается в fs.inotify.max_user_watches.
+ *
+ * Файлы каталога, появившегося в дереве, сообщаются как Changed: они могли
+ * быть записаны до того, как каталог стал виден наблюдению.
+ */
+class SCANNER_API FileWatcher {
+public:
+    struct Stats {
+        uint64_t events = 0;        // событий прочитано из ядра
+        uint64_t ignored = 0;       // вне корней или не разрешились в путь
+        uint64_t watches = 0;       // меток inotify
+        uint64_t errors = 0;        // каталоги, которые не удалось добавить или прочитать
+    };
+
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Auto - fanotify, если ядро и права позволяют, иначе inotify.
+    // false - наблюдение недоступно, lastError() - errno
+    bool open(const std::vector<std::string>& roots, WatchBackend backend = WatchBackend::Auto);
+    void close();
+    bool isOpen() const;
+
+    // Выбранный механизм (после open)
+    WatchBackend backend() const { return backend_; }
+    int lastError() const { return lastError_; }
+
+    // Дописывает события в events. Ждет не дольше timeoutNs (< 0 - без ограничения),
+    // пока не придут события или не будет вызван wake(). false - ошибка чтения
+    bool read(std::vector<FileEvent>& events, int64_t timeoutNs);
+
+    // Прерывает ожидание в read(); можно вызывать из любого потока
+    void wake();
+
+    Stats stats() const;
+
+    // Канонический путь без завершающего '/': так пути приходят от ядра
+    static std::string canonicalRoot(const std::string& root);
+
+private:
+    struct Backend;
+    struct Fanotify;
+    struct Inotify;
+
+    std::unique_ptr<Backend> impl_;
+    WatchBackend backend_ = WatchBackend::Auto;
+    int wakeFd_ = -1;
+    int lastError_ = 0;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using MD5Digest = std::array<uint8_t, 16>;
+
+/**
+ * Потоковая реализация MD5 (RFC 1321) без внешних зависимостей.
+ * Раунды развернуты макросами, контекст живет на стеке и не требует
+ * инициализации криптопровайдера.
+ */
+class MD5 {
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t DIGEST_SIZE = 16;
+
+    MD5() { reset(); }
+
+    void reset() {
+        state_[0] = 0x67452301u;
+        state_[1] = 0xefcdab89u;
+        state_[2] = 0x98badcfeu;
+        state_[3] = 0x10325476u;
+        length_ = 0;
+        bufferSize_ = 0;
+    }
+
+    void update(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        length_ += size;
+
+        if (bufferSize_ > 0) {
+            size_t take = BLOCK_SIZE - bufferSize_;
+            if (take > size) take = size;
+            std::memcpy(buffer_ + bufferSize_, bytes, take);
+            bufferSize_ += take;
+            bytes += take;
+            size -= take;
+            if (bufferSize_ < BLOCK_SIZE) {
+                return;
+            }
+            transform(state_, buffer_, 1);
+            bufferSize_ = 0;
+        }
+
+        size_t blocks = size / BLOCK_SIZE;
+        if (blocks > 0) {
+            transform(state_, bytes, blocks);
+            bytes += blocks * BLOCK_SIZE;
+            size -= blocks * BLOCK_SIZE;
+        }
+
+        if (size > 0) {
+            std::memcpy(buffer_, bytes, size);
+            bufferSize_ = size;
+        }
+    }
+
+    void finalize(uint8_t* digest) {
+        uint64_t bitLength = length_ * 8;
+
+        buffer_[bufferSize_++] = 0x80;
+        if (bufferSize_ > BLOCK_SIZE - 8) {
+            std::memset(buffer_ + bufferSize_, 0, BLOCK_SIZE - bufferSize_);
+            transform(state_, buffer_, 1);
+            bufferSize_ = 0;
+        }
+        std::memset(buffer_ + bufferSize_, 0, BLOCK_SIZE - 8 - bufferSize_);
+        for (int i = 0; i < 8; ++i) {
+            buffer_[BLOCK_SIZE - 8 + i] = static_cast<uint8_t>(bitLength >> (8 * i));
+        }
+        transform(state_, buffer_, 1);
+
+        for (int i = 0; i < 4; ++i) {
+            storeLE(digest + 4 * i, state_[i]);
+        }
+        reset();
+    }
+
+    MD5Digest finalize() {
+        MD5Digest digest;
+        finalize(digest.data());
+        return digest;
+    }
+
+    static MD5Digest hash(const void* data, size_t size) {
+        MD5 md5;
+        md5.update(data, size);
+        return md5.finalize();
+    }
+
+    // Обрабатывает blocks полных 64-байтных блоков без буферизации
+    static void transform(uint32_t* state, const uint8_t* data, size_t blocks) {
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+
+        for (; blocks > 0; --blocks, data += BLOCK_SIZE) {
+            uint32_t x[16];
+            for (int i = 0; i < 16; ++i) {
+                x[i] = loadLE(data + 4 * i);
+            }
+
+            const uint32_t aa = a, bb = b, cc = c, dd = d;
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f, a, b, c, d, xk, t, s) \
+    (a) += f((b), (c), (d)) + (xk) + (t); \
+    (a) = ((a) << (s)) | ((a) >> (32 - (s))); \
+    (a) += (b)
+
+            MD5_STEP(MD5_F, a, b, c, d, x[0], 0xd76aa478u, 7);
+            MD5_STEP(MD5_F, d, a, b, c, x[1], 0xe8c7b756u, 12);
+            MD5_STEP(MD5_F, c, d, a, b, x[2], 0x242070dbu, 17);
+            MD5_STEP(MD5_F, b, c, d, a, x[3], 0xc1bdceeeu, 22);
+            MD5_STEP(MD5_F, a, b, c, d, x[4], 0xf57c0fafu, 7);
+            MD5_STEP(MD5_F, d, a, b, c, x[5], 0x4787c62au, 12);
+            MD5_STEP(MD5_F, c, d, a, b, x[6], 0xa8304613u, 17);
+            MD5_STEP(MD5_F, b, c, d, a, x[7], 0xfd469501u, 22);
+            MD5_STEP(MD5_F, a, b, c, d, x[8], 0x698098d8u, 7);
+            MD5_STEP(MD5_F, d, a, b, c, x[9], 0x8b44f7afu, 12);
+            MD5_STEP(MD5_F, c, d, a, b, x[10], 0xffff5bb1u, 17);
+            MD5_STEP(MD5_F, b, c, d, a, x[11], 0x895cd7beu, 22);
+            MD5_STEP(MD5_F, a, b, c, d, x[12], 0x6b901122u, 7);
+            MD5_STEP(MD5_F, d, a, b, c, x[13], 0xfd987193u, 12);
+            MD5_STEP(MD5_F, c, d, a, b, x[14], 0xa679438eu, 17);
+            MD5_STEP(MD5_F, b, c, d, a, x[15], 0x49b40821u, 22);
+
+            MD5_STEP(MD5_G, a, b, c, d, x[1], 0xf61e2562u, 5);
+            MD5_STEP(MD5_G, d, a, b, c, x[6], 0xc040b340u, 9);
+            MD5_STEP(MD5_G, c, d, a, b, x[11], 0x265e5a51u, 14);
+            MD5_STEP(MD5_G, b, c, d, a, x[0], 0xe9b6c7aau, 20);
+            MD5_STEP(MD5_G, a, b, c, d, x[5], 0xd62f105du, 5);
+            MD5_STEP(MD5_G, d, a, b, c, x[10], 0x02441453u, 9);
+            MD5_STEP(MD5_G, c, d, a, b, x[15], 0xd8a1e681u, 14);
+            MD5_STEP(MD5_G, b, c, d, a, x[4], 0xe7d3fbc8u, 20);
+            MD5_STEP(MD5_G, a, b, c, d, x[9], 0x21e1cde6u, 5);
+            MD5_STEP(MD5_G, d, a, b, c, x[14], 0xc33707d6u, 9);
+            MD5_STEP(MD5_G, c, d, a, b, x[3], 0xf4d50d87u, 14);
+            MD5_STEP(MD5_G, b, c, d, a, x[8], 0x455a14edu, 20);
+            MD5_STEP(MD5_G, a, b, c, d, x[13], 0xa9e3e905u, 5);
+            MD5_STEP(MD5_G, d, a, b, c, x[2], 0xfcefa3f8u, 9);
+            MD5_STEP(MD5_G, c, d, a, b, x[7], 0x676f02d9u, 14);
+            MD5_STEP(MD5_G, b, c, d, a, x[12], 0x8d2a4c8au, 20);
+
+            MD5_STEP(MD5_H, a, b, c, d, x[5], 0xfffa3942u, 4);
+            MD5_STEP(MD5_H, d, a, b, c, x[8], 0x8771f681u, 11);
+            MD5_STEP(MD5_H, c, d, a, b, x[11], 0x6d9d6122u, 16);
+            MD5_STEP(MD5_H, b, c, d, a, x[14], 0xfde5380cu, 23);
+            MD5_STEP(MD5_H, a, b, c, d, x[1], 0xa4beea44u, 4);
+            MD5_STEP(MD5_H, d, a, b, c, x[4], 0x4bdecfa9u, 11);
+            MD5_STEP(MD5_H, c, d, a, b, x[7], 0xf6bb4b60u, 16);
+            MD5_STEP(MD5_H, b, c, d, a, x[10], 0xbebfbc70u, 23);
+            MD5_STEP(MD5_H, a, b, c, d, x[13], 0x289b7ec6u, 4);
+            MD5_STEP(MD5_H, d, a, b, c, x[0], 0xeaa127fau, 11);
+            MD5_STEP(MD5_H, c, d, a, b, x[3], 0xd4ef3085u, 16);
+            MD5_STEP(MD5_H, b, c, d, a, x[6], 0x04881d05u, 23);
+            MD5_STEP(MD5_H, a, b, c, d, x[9], 0xd9d4d039u, 4);
+            MD5_STEP(MD5_H, d, a, b, c, x[12], 0xe6db99e5u, 11);
+            MD5_STEP(MD5_H, c, d, a, b, x[15], 0x1fa27cf8u, 16);
+            MD5_STEP(MD5_H, b, c, d, a, x[2], 0xc4ac5665u, 23);
+
+            MD5_STEP(MD5_I, a, b, c, d, x[0], 0xf4292244u, 6);
+            MD5_STEP(MD5_I, d, a, b, c, x[7], 0x432aff97u, 10);
+            MD5_STEP(MD5_I, c, d, a, b, x[14], 0xab9423a7u, 15);
+            MD5_STEP(MD5_I, b, c, d, a, x[5], 0xfc93a039u, 21);
+            MD5_STEP(MD5_I, a, b, c, d, x[12], 0x655b59c3u, 6);
+            MD5_STEP(MD5_I, d, a, b, c, x[3], 0x8f0ccc92u, 10);
+            MD5_STEP(MD5_I, c, d, a, b, x[10], 0xffeff47du, 15);
+            MD5_STEP(MD5_I, b, c, d, a, x[1], 0x85845dd1u, 21);
+            MD5_STEP(MD5_I, a, b, c, d, x[8], 0x6fa87e4fu, 6);
+            MD5_STEP(MD5_I, d, a, b, c, x[15], 0xfe2ce6e0u, 10);
+            MD5_STEP(MD5_I, c, d, a, b, x[6], 0xa3014314u, 15);
+            MD5_STEP(MD5_I, b, c, d, a, x[13], 0x4e0811a1u, 21);
+            MD5_STEP(MD5_I, a, b, c, d, x[4], 0xf7537e82u, 6);
+            MD5_STEP(MD5_I, d, a, b, c, x[11], 0xbd3af235u, 10);
+            MD5_STEP(MD5_I, c, d, a, b, x[2], 0x2ad7d2bbu, 15);
+            MD5_STEP(MD5_I, b, c, d, a, x[9], 0xeb86d391u, 21);
+
+#undef MD5_STEP
+#undef MD5_I
+#undef MD5_H
+#undef MD5_G
+#undef MD5_F
+
+            a += aa;
+            b += bb;
+            c += cc;
+            d += dd;
+        }
+
+        state[0] = a;
+        state[1] = b;
+        state[2] = c;
+        state[3] = d;
+    }
+
+private:
+    uint32_t state_[4];
+    uint64_t length_;
+    uint8_t buffer_[BLOCK_SIZE];
+    size_t bufferSize_;
+
+    static uint32_t loadLE(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) |
+               (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) |
+               (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static void storeLE(uint8_t* p, uint32_t v) {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+        p[2] = static_cast<uint8_t>(v >> 16);
+        p[3] = static_cast<uint8_t>(v >> 24);
+    }
+};
@@ -1,106 +1,102 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
-#include <windows.h>
-#include <wincrypt.h>
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
+#include "md5.h"
+#include "file_io.h"
 
 /**
- * Класс для вычисления MD5 хеша файлов с использованием Windows CryptoAPI
+ * Класс для вычисления MD5 хеша файлов встроенной реализацией MD5
  */
 class MD5Calculator {
 public:
+    static constexpr size_t BUFFER_SIZE = ReadOptions::DEFAULT_BUFFER_SIZE;
+
     static std::string calculateFileMD5(const std::string& filePath) {
-        HCRYPTPROV hProv = 0;
-        HCRYPTHASH hHash = 0;
-        HANDLE hFile = INVALID_HANDLE_VALUE;
-        
-        const DWORD BUFFER_SIZE = 8192;
-        const DWORD MD5_LENGTH = 16;
-        
-        try {
-            hFile = CreateFileA(filePath.c_str(), 
-                               GENERIC_READ, 
-                               FILE_SHARE_READ, 
-                               NULL, 
-                               OPEN_EXISTING, 
-                               FILE_FLAG_SEQUENTIAL_SCAN, 
-                               NULL);
-            
-            if (hFile == INVALID_HANDLE_VALUE) {
-                throw std::runtime_error("Cannot open file: " + filePath);
-            }
-            
-            // Получаем хэндл криптопровайдера
-            if (!CryptAcquireContext(&hProv, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT)) {
-                throw std::runtime_error("CryptAcquireContext failed");
-            }
-            
-            if (!CryptCreateHash(hProv, CALG_MD5, 0, 0, &hHash)) {
-                throw std::runtime_error("CryptCreateHash failed");
-            }
-            
-            BYTE buffer[BUFFER_SIZE];
-            DWORD bytesRead = 0;
-            
-            while (ReadFile(hFile, buffer, BUFFER_SIZE, &bytesRead, NULL) && bytesRead > 0) {
-                if (!CryptHashData(hHash, buffer, bytesRead, 0)) {
-                    throw std::runtime_error("CryptHashData failed");
-                }
-            }
+        MD5Digest digest = calculateFileDigest(filePath);
+        return bytesToHexString(digest.data(), digest.size());
+    }
 
-            DWORD lastError = GetLastError();
-            if (lastError != ERROR_SUCCESS && lastError != ERROR_HANDLE_EOF) {
-                throw std::runtime_error("File read error: " + std::to_string(lastError));
-            }
-            
-            BYTE hash[MD5_LENGTH];
-            DWORD hashLength = MD5_LENGTH;
-            
-            if (!CryptGetHashParam(hHash, HP_HASHVAL, hash, &hashLength, 0)) {
-                throw std::runtime_error("CryptGetHashParam failed");
-            }
+    // Способ чтения выбирается по размеру файла (см. FileReader)
+    static MD5Digest calculateFileDigest(const std::string& filePath, const ReadOptions& options = ReadOptions()) {
+        FileReader reader(options);
+        if (!reader.open(filePath)) {
+            throw std::runtime_error("Cannot open file: " + filePath);
+        }
+
+        MD5 md5;
+        const uint8_t* data = nullptr;
+        int64_t bytesRead;
+        while ((bytesRead = reader.next(data)) > 0) {
+            md5.update(data, static_cast<size_t>(bytesRead));
+        }
 
-            if (hashLength != MD5_LENGTH) {
-                throw std::runtime_error("Invalid hash length");
-            }
-            
-            std::string result = bytesToHexString(hash, hashLength);
-            
-            cleanup(hHash, hProv, hFile);
-            
-            return result;
-            
-        } catch (...) {
-            cleanup(hHash, hProv, hFile);
-            throw;
+        if (bytesRead < 0) {
+            throw std::runtime_error("File read error: " + std::to_string(reader.lastError()));
         }
+
+        return md5.finalize();
     }
 
-private:
-    static std::string bytesToHexString(const BYTE* data, DWORD len) {
-        std::string result;
-        const char* hex_chars = "0123456789abcdef";
-        
-        for (DWORD i = 0; i < len; ++i) {
-            unsigned char byte = data[i];  
-            result += hex_chars[(byte >> 4) & 0x0F]; 
-            result += hex_chars[byte & 0x0F];        
+    // MD5 первых prefixLength байт файла (всего файла, если он короче).
+    // Префикс читается потоково буфером не длиннее обычного: отображение крупного
+    // файла с MADV_SEQUENTIAL подгрузило бы с диска намного больше префикса,
+    // а буфер в длину префикса из командной строки может быть любого размера
+    static MD5Digest calculatePrefixDigest(const std::string& filePath, uint64_t prefixLength) {
+        MD5Digest digest;
+        int error = 0;
+        if (!tryPrefixDigest(filePath, prefixLength, digest, error)) {
+            throw std::runtime_error("Cannot read file prefix: " + filePath + " (" + std::to_string(error) + ")");
         }
-        return result;
+        return digest;
     }
-    
-    static void cleanup(HCRYPTHASH hHash, HCRYPTPROV hProv, HANDLE hFile) {
-        if (hHash) {
-            CryptDestroyHash(hHash);
+
+    // То же без исключения: false и код ошибки, если файл не открылся или не прочитался
+    static bool tryPrefixDigest(const std::string& filePath, uint64_t prefixLength, MD5Digest& digest, int& error) {
+        ReadOptions options;
+        options.strategy = ReadStrategy::Stream;
+        options.bufferSize = static_cast<size_t>(
+            std::max<uint64_t>(1, std::min<uint64_t>(prefixLength, ReadOptions::DEFAULT_BUFFER_SIZE)));
+        FileReader reader(options);
+        if (!reader.open(filePath)) {
+            error = reader.lastError();
+            return false;
+        }
+
+        MD5 md5;
+        const uint8_t* data = nullptr;
+        int64_t bytesRead = 0;
+        uint64_t remaining = prefixLength;
+        while (remaining > 0 && (bytesRead = reader.next(data)) > 0) {
+            size_t used = static_cast<size_t>(std::min<uint64_t>(remaining, static_cast<uint64_t>(bytesRead)));
+            md5.update(data, used);
+            remaining -= used;
         }
-        if (hProv) {
-            CryptReleaseContext(hProv, 0);
+
+        if (bytesRead < 0) {
+            error = reader.lastError();
+            return false;
         }
-        if (hFile != INVALID_HANDLE_VALUE) {
-            CloseHandle(hFile);
+
+        digest = md5.finalize();
+        return true;
+    }
+
+    static std::string bytesToHexString(const unsigned char* data, size_t len) {
+        std::string result(len * 2, '\0');
+        bytesToHex(data, len, &result[0]);
+        return result;
+    }
+
+    // Пишет 2 * len hex-символов в out без завершающего нуля
+    static void bytesToHex(const unsigned char* data, size_t len, char* out) {
+        static const char hex_chars[] = "0123456789abcdef";
+
+        for (size_t i = 0; i < len; ++i) {
+            unsigned char byte = data[i];
+            out[2 * i] = hex_chars[(byte >> 4) & 0x0F];
+            out[2 * i + 1] = hex_chars[byte & 0x0F];
         }
     }
 };
\ No newline at end of file
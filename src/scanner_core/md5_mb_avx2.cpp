@@ -0,0 +1,45 @@
+#include "md5_mb_kernel.h"
+
+// Файл собирается с -mavx2 (/arch:AVX2), вызывается только после проверки CPU
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct VecAVX2 {
+    using Reg = __m256i;
+    static constexpr size_t LANES = 8;
+
+    static Reg load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(uint32_t* p, Reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static Reg set1(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+    static Reg add(Reg a, Reg b) { return _mm256_add_epi32(a, b); }
+
+    template <int S>
+    static Reg rotl(Reg v) { return _mm256_or_si256(_mm256_slli_epi32(v, S), _mm256_srli_epi32(v, 32 - S)); }
+
+    static Reg F(Reg x, Reg y, Reg z) { return _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z))); }
+    static Reg G(Reg x, Reg y, Reg z) { return _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y))); }
+    static Reg H(Reg x, Reg y, Reg z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+    static Reg I(Reg x, Reg y, Reg z) {
+        return _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, _mm256_set1_epi32(-1))));
+    }
+
+    static void loadWords(const uint8_t* const* data, size_t offset, Reg* out) {
+        Reg v[4];
+        for (int j = 0; j < 4; ++j) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j] + offset));
+            __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j + 4] + offset));
+            v[j] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        }
+        MD5_MB_TRANSPOSE4(_mm256, v, out);
+    }
+};
+
+}
+
+void md5MultiBlockAVX2(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    md5MultiBlock<VecAVX2>(state, data, blocks);
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include "md5_mb_kernel.h"
+
+// Файл собирается с -mavx512f (/arch:AVX512), вызывается только после проверки CPU
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace {
+
+struct VecAVX512 {
+    using Reg = __m512i;
+    static constexpr size_t LANES = 16;
+
+    static Reg load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+    static void store(uint32_t* p, Reg v) { _mm512_storeu_si512(p, v); }
+    static Reg set1(uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+    static Reg add(Reg a, Reg b) { return _mm512_add_epi32(a, b); }
+
+    template <int S>
+    static Reg rotl(Reg v) { return _mm512_rol_epi32(v, S); }
+
+    // Функции раундов одной инструкцией vpternlogd
+    static Reg F(Reg x, Reg y, Reg z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+    static Reg G(Reg x, Reg y, Reg z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe4); }
+    static Reg H(Reg x, Reg y, Reg z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+    static Reg I(Reg x, Reg y, Reg z) { return _mm512_ternarylogic_epi32(x, y, z, 0x39); }
+
+    static void loadWords(const uint8_t* const* data, size_t offset, Reg* out) {
+        Reg v[4];
+        for (int j = 0; j < 4; ++j) {
+            Reg r = _mm512_zextsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j] + offset)));
+            r = _mm512_inserti32x4(r, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j + 4] + offset)), 1);
+            r = _mm512_inserti32x4(r, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j + 8] + offset)), 2);
+            r = _mm512_inserti32x4(r, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j + 12] + offset)), 3);
+            v[j] = r;
+        }
+        MD5_MB_TRANSPOSE4(_mm512, v, out);
+    }
+};
+
+}
+
+void md5MultiBlockAVX512(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    md5MultiBlock<VecAVX512>(state, data, blocks);
+}
+
+#endif
@@ -0,0 +1,42 @@
+#include "md5_mb_kernel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace {
+
+struct VecSSE2 {
+    using Reg = __m128i;
+    static constexpr size_t LANES = 4;
+
+    static Reg load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint32_t* p, Reg v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static Reg set1(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+    static Reg add(Reg a, Reg b) { return _mm_add_epi32(a, b); }
+
+    template <int S>
+    static Reg rotl(Reg v) { return _mm_or_si128(_mm_slli_epi32(v, S), _mm_srli_epi32(v, 32 - S)); }
+
+    static Reg F(Reg x, Reg y, Reg z) { return _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z))); }
+    static Reg G(Reg x, Reg y, Reg z) { return _mm_xor_si128(y, _mm_and_si128(z, _mm_xor_si128(x, y))); }
+    static Reg H(Reg x, Reg y, Reg z) { return _mm_xor_si128(_mm_xor_si128(x, y), z); }
+    static Reg I(Reg x, Reg y, Reg z) {
+        return _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, _mm_set1_epi32(-1))));
+    }
+
+    static void loadWords(const uint8_t* const* data, size_t offset, Reg* out) {
+        Reg v[4];
+        for (int j = 0; j < 4; ++j) {
+            v[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data[j] + offset));
+        }
+        MD5_MB_TRANSPOSE4(_mm, v, out);
+    }
+};
+
+}
+
+void md5MultiBlockSSE2(uint32_t* state, const uint8_t* const* data, size_t blocks) {
+    md5MultiBlock<VecSSE2>(state, data, blocks);
+}
+
+#endif
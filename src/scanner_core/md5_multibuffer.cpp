@@ -0,0 +1,493 @@
+#include "md5_multibuffer.h"
+#include "file_io.h"
+#include "scan_metrics.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MD5_MB_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef MD5_MB_X86
+void md5MultiBlockSSE2(uint32_t* state, const uint8_t* const* data, size_t blocks);
+#endif
+#ifdef SCANNER_MD5_MB_AVX2
+void md5MultiBlockAVX2(uint32_t* state, const uint8_t* const* data, size_t blocks);
+#endif
+#ifdef SCANNER_MD5_MB_AVX512
+void md5MultiBlockAVX512(uint32_t* state, const uint8_t* const* data, size_t blocks);
+#endif
+
+namespace {
+
+const uint32_t MD5_INIT[4] = {0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u};
+
+#ifdef MD5_MB_X86
+#if defined(_MSC_VER)
+bool cpuHasAvx2() {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+}
+
+bool cpuHasAvx512f() {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0xe6) != 0xe6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 16)) != 0;
+}
+#else
+// __builtin_cpu_supports учитывает и поддержку расширенных регистров ОС (XGETBV)
+bool cpuHasAvx2() { return __builtin_cpu_supports("avx2"); }
+bool cpuHasAvx512f() { return __builtin_cpu_supports("avx512f"); }
+#endif
+#endif
+
+// timing == nullptr - без замеров времени; digests получает те же куски, что и MD5
+bool hashFileScalar(FileReader& reader, const std::string& path, MD5Digest& digest, uint64_t& length,
+                    FileTiming* timing, DigestSet& digests) {
+    uint64_t start = timing ? monotonicNs() : 0;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    MD5 md5;
+    const uint8_t* data = nullptr;
+    int64_t bytesRead;
+    length = 0;
+    if (timing) {
+        *timing = FileTiming();
+        uint64_t now = monotonicNs();
+        timing->openNs = now - start;
+        while (true) {
+            start = now;
+            bytesRead = reader.next(data);
+            now = monotonicNs();
+            timing->readNs += now - start;
+            if (bytesRead <= 0) break;
+            md5.update(data, static_cast<size_t>(bytesRead));
+            digests.update(data, static_cast<size_t>(bytesRead));
+            length += static_cast<uint64_t>(bytesRead);
+            start = now;
+            now = monotonicNs();
+            timing->hashNs += now - start;
+        }
+    } else {
+        while ((bytesRead = reader.next(data)) > 0) {
+            md5.update(data, static_cast<size_t>(bytesRead));
+            digests.update(data, static_cast<size_t>(bytesRead));
+            length += static_cast<uint64_t>(bytesRead);
+        }
+    }
+    reader.close();
+    if (bytesRead < 0) {
+        return false;
+    }
+
+    digest = md5.finalize();
+    return true;
+}
+
+}
+
+bool MD5MultiBuffer::supported(Isa isa) {
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+#ifdef MD5_MB_X86
+    case Isa::SSE2:
+        return true;
+#endif
+#ifdef SCANNER_MD5_MB_AVX2
+    case Isa::AVX2:
+        return cpuHasAvx2();
+#endif
+#ifdef SCANNER_MD5_MB_AVX512
+    case Isa::AVX512:
+        return cpuHasAvx512f();
+#endif
+    default:
+        return false;
+    }
+}
+
+MD5MultiBufferKernel MD5MultiBuffer::get(Isa isa) {
+    MD5MultiBufferKernel kernel;
+    if (!supported(isa)) {
+        return kernel;
+    }
+
+    switch (isa) {
+#ifdef MD5_MB_X86
+    case Isa::SSE2:
+        kernel = {"sse2", 4, md5MultiBlockSSE2};
+        break;
+#endif
+#ifdef SCANNER_MD5_MB_AVX2
+    case Isa::AVX2:
+        kernel = {"avx2", 8, md5MultiBlockAVX2};
+        break;
+#endif
+#ifdef SCANNER_MD5_MB_AVX512
+    case Isa::AVX512:
+        kernel = {"avx512", 16, md5MultiBlockAVX512};
+        break;
+#endif
+    default:
+        break;
+    }
+    return kernel;
+}
+
+const MD5MultiBufferKernel& MD5MultiBuffer::best() {
+    static const MD5MultiBufferKernel kernel = []() {
+        for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE2}) {
+            if (supported(isa)) {
+                return get(isa);
+            }
+        }
+        return MD5MultiBufferKernel();
+    }();
+    return kernel;
+}
+
+/**
+ * Дорожка: открытый файл и окно с еще не обработанными блоками. Окно смотрит
+ * прямо в кусок файла (буфер читателя или отображение); неполный блок на стыке
+ * кусков собирается в tail. После конца файла в tail дописывается MD5-паддинг,
+ * и дорожка дорабатывает последние блоки тем же ядром.
+ */
+struct MultiBufferFileHasher::Lane {
+    FileReader reader;
+    // Файл, уже прочитанный в память: отдается одним куском вместо reader
+    const uint8_t* memory = nullptr;
+    size_t memorySize = 0;
+    bool fromMemory = false;
+    uint8_t tail[3 * MD5::BLOCK_SIZE];
+    const uint8_t* data = tail;
+    size_t pos = 0;
+    size_t end = 0;
+    // Остаток куска после блока, собранного в tail
+    const uint8_t* pending = nullptr;
+    size_t pendingSize = 0;
+    size_t index = 0;
+    uint64_t length = 0;
+    bool active = false;
+    bool final = false;
+    bool timing = false;
+    FileTiming times;
+    DigestMask extraDigests = 0;
+    DigestSet digests;
+
+    size_t availableBlocks() const { return (end - pos) / MD5::BLOCK_SIZE; }
+
+    bool open(const std::string& path) {
+        uint64_t start = timing ? monotonicNs() : 0;
+        fromMemory = false;
+        if (!reader.open(path)) {
+            return false;
+        }
+        if (timing) {
+            times = FileTiming();
+            times.openNs = monotonicNs() - start;
+        }
+        reset();
+        return true;
+    }
+
+    void openMemory(const uint8_t* bytes, size_t size) {
+        fromMemory = true;
+        memory = bytes;
+        memorySize = size;
+        times = FileTiming();
+        reset();
+    }
+
+    void reset() {
+        data = tail;
+        pos = end = 0;
+        pendingSize = 0;
+        length = 0;
+        final = false;
+        digests.reset(extraDigests);
+    }
+
+    int64_t nextChunk(const uint8_t*& chunk) {
+        if (!fromMemory) {
+            return reader.next(chunk);
+        }
+        chunk = memory;
+        int64_t size = static_cast<int64_t>(memorySize);
+        memorySize = 0;
+        return size;
+    }
+
+    void closeSource() {
+        if (!fromMemory) {
+            reader.close();
+        }
+    }
+
+    // Переходит к следующему куску файла, пока не наберется хотя бы один полный блок
+    bool fill() {
+        while (!final && availableBlocks() == 0) {
+            size_t rest = end - pos;
+            if (pendingSize > 0) {
+                // rest == 0: блок в tail обработан целиком
+                data = pending;
+                pos = 0;
+                end = pendingSize;
+                pendingSize = 0;
+                continue;
+            }
+            std::memmove(tail, data + pos, rest);
+            data = tail;
+            pos = 0;
+            end = rest;
+
+            const uint8_t* chunk = nullptr;
+            uint64_t start = timing ? monotonicNs() : 0;
+            int64_t bytesRead = nextChunk(chunk);
+            if (timing && !fromMemory) {
+                times.readNs += monotonicNs() - start;
+            }
+            if (bytesRead < 0) {
+                closeSource();
+                return false;
+            }
+            if (bytesRead == 0) {
+                appendPadding();
+                closeSource();
+                break;
+            }
+            size_t size = static_cast<size_t>(bytesRead);
+            length += size;
+            if (extraDigests) {
+                // Кусок еще в кеше: остальные алгоритмы получают его сразу
+                uint64_t hashStart = timing ? monotonicNs() : 0;
+                digests.update(chunk, size);
+                if (timing) {
+                    times.hashNs += monotonicNs() - hashStart;
+                }
+            }
+            if (rest == 0) {
+                data = chunk;
+                end = size;
+                continue;
+            }
+            size_t take = std::min(MD5::BLOCK_SIZE - rest, size);
+            std::memcpy(tail + end, chunk, take);
+            end += take;
+            pending = chunk + take;
+            pendingSize = size - take;
+        }
+        return true;
+    }
+
+    void appendPadding() {
+        uint64_t bitLength = length * 8;
+        tail[end++] = 0x80;
+        while (end % MD5::BLOCK_SIZE != MD5::BLOCK_SIZE - 8) {
+            tail[end++] = 0;
+        }
+        for (int i = 0; i < 8; ++i) {
+            tail[end++] = static_cast<uint8_t>(bitLength >> (8 * i));
+        }
+        final = true;
+    }
+};
+
+MultiBufferFileHasher::MultiBufferFileHasher(const MD5MultiBufferKernel& kernel, const ReadOptions& readOptions)
+    : kernel_(kernel),
+      lanes_(kernel.lanes),
+      state_(4 * kernel.lanes),
+      data_(kernel.lanes) {
+    setReadOptions(readOptions);
+}
+
+void MultiBufferFileHasher::setReadOptions(const ReadOptions& readOptions) {
+    for (Lane& lane : lanes_) {
+        lane.reader.setOptions(readOptions);
+    }
+}
+
+void MultiBufferFileHasher::setTiming(bool enabled) {
+    timing_ = enabled;
+    for (Lane& lane : lanes_) {
+        lane.timing = enabled;
+    }
+}
+
+void MultiBufferFileHasher::setDigests(DigestMask extra) {
+    extraDigests_ = extra & ~DIGEST_MD5;
+    for (Lane& lane : lanes_) {
+        lane.extraDigests = extraDigests_;
+    }
+}
+
+MultiBufferFileHasher::~MultiBufferFileHasher() = default;
+
+void MultiBufferFileHasher::hashFiles(const std::string* paths, size_t count, const Callback& callback) {
+    run(count,
+        [&](Lane& lane, size_t index) { return lane.open(paths[index]); },
+        [&](size_t index, MD5Digest& digest) {
+            return hashFileScalar(lanes_[0].reader, paths[index], digest, lastLength_,
+                                  timing_ ? &lastTiming_ : nullptr, scalarDigests_);
+        },
+        callback);
+}
+
+void MultiBufferFileHasher::hashBuffers(const uint8_t* const* data, const size_t* sizes, size_t count,
+                                        const Callback& callback) {
+    run(count,
+        [&](Lane& lane, size_t index) {
+            lane.openMemory(data[index], sizes[index]);
+            return true;
+        },
+        [&](size_t index, MD5Digest& digest) {
+            uint64_t start = timing_ ? monotonicNs() : 0;
+            MD5 md5;
+            md5.update(data[index], sizes[index]);
+            scalarDigests_.update(data[index], sizes[index]);
+            digest = md5.finalize();
+            lastLength_ = sizes[index];
+            lastTiming_ = FileTiming();
+            lastTiming_.hashNs = timing_ ? monotonicNs() - start : 0;
+            return true;
+        },
+        callback);
+}
+
+template <class Open, class Scalar>
+void MultiBufferFileHasher::run(size_t count, const Open& open, const Scalar& scalar, const Callback& callback) {
+    if (!kernel_.isVector()) {
+        for (size_t i = 0; i < count; ++i) {
+            MD5Digest digest;
+            scalarDigests_.reset(extraDigests_);
+            if (!scalar(i, digest)) {
+                lastError_ = lanes_[0].reader.lastError();
+                callback(i, nullptr);
+                continue;
+            }
+            finishDigests(digest, scalarDigests_);
+            callback(i, &digest);
+        }
+        return;
+    }
+
+    const size_t n = kernel_.lanes;
+    size_t next = 0;
+
+    // Подает в дорожку следующий файл, который удалось открыть
+    auto startLane = [&](size_t laneIndex) {
+        Lane& lane = lanes_[laneIndex];
+        lane.active = false;
+        while (next < count) {
+            size_t index = next++;
+            if (!open(lane, index)) {
+                lastError_ = lane.reader.lastError();
+                callback(index, nullptr);
+                continue;
+            }
+            lane.index = index;
+            lane.active = true;
+            for (size_t w = 0; w < 4; ++w) {
+                state_[w * n + laneIndex] = MD5_INIT[w];
+            }
+            if (lane.fill()) {
+                return;
+            }
+            lane.active = false;
+            lastError_ = lane.reader.lastError();
+            callback(index, nullptr);
+        }
+    };
+
+    auto finishLane = [&](size_t laneIndex) {
+        MD5Digest digest;
+        for (size_t w = 0; w < 4; ++w) {
+            uint32_t v = state_[w * n + laneIndex];
+            for (size_t i = 0; i < 4; ++i) {
+                digest[4 * w + i] = static_cast<uint8_t>(v >> (8 * i));
+            }
+        }
+        lastLength_ = lanes_[laneIndex].length;
+        lastTiming_ = lanes_[laneIndex].times;
+        finishDigests(digest, lanes_[laneIndex].digests);
+        callback(lanes_[laneIndex].index, &digest);
+        startLane(laneIndex);
+    };
+
+    for (size_t l = 0; l < n; ++l) {
+        startLane(l);
+    }
+
+    while (true) {
+        size_t activeCount = 0;
+        size_t firstActive = 0;
+        size_t blocks = SIZE_MAX;
+        for (size_t l = 0; l < n; ++l) {
+            if (!lanes_[l].active) continue;
+            if (activeCount++ == 0) firstActive = l;
+            size_t available = lanes_[l].availableBlocks();
+            if (available < blocks) blocks = available;
+        }
+        if (activeCount == 0) {
+            break;
+        }
+
+        uint64_t hashStart = timing_ ? monotonicNs() : 0;
+        if (activeCount == 1) {
+            // Последний файл нет смысла гонять через векторное ядро
+            Lane& lane = lanes_[firstActive];
+            uint32_t scalar[4];
+            for (size_t w = 0; w < 4; ++w) scalar[w] = state_[w * n + firstActive];
+            blocks = lane.availableBlocks();
+            MD5::transform(scalar, lane.data + lane.pos, blocks);
+            for (size_t w = 0; w < 4; ++w) state_[w * n + firstActive] = scalar[w];
+        } else {
+            // Неактивные дорожки читают данные первой активной, результат отбрасывается
+            for (size_t l = 0; l < n; ++l) {
+                const Lane& lane = lanes_[l].active ? lanes_[l] : lanes_[firstActive];
+                data_[l] = lane.data + lane.pos;
+            }
+            kernel_.process(state_.data(), data_.data(), blocks);
+        }
+        // Время ядра делится поровну между файлами в дорожках
+        uint64_t hashShare = timing_ ? (monotonicNs() - hashStart) / activeCount : 0;
+
+        for (size_t l = 0; l < n; ++l) {
+            Lane& lane = lanes_[l];
+            if (!lane.active) continue;
+            lane.times.hashNs += hashShare;
+            lane.pos += blocks * MD5::BLOCK_SIZE;
+            if (lane.availableBlocks() > 0) continue;
+            if (lane.final) {
+                finishLane(l);
+            } else if (!lane.fill()) {
+                lastError_ = lane.reader.lastError();
+                callback(lane.index, nullptr);
+                startLane(l);
+            }
+        }
+    }
+}
+
+void MultiBufferFileHasher::finishDigests(const MD5Digest& md5, DigestSet& digests) {
+    lastDigests_.mask = DIGEST_MD5;
+    lastDigests_.md5 = md5;
+    digests.finalize(lastDigests_);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "digest_set.h"
+#include "file_io.h"
+#include "md5.h"
+#include "scanner_api.h"
+
+/**
+ * Ядро multi-buffer MD5: обрабатывает blocks блоков по 64 байта для каждой
+ * из lanes независимых дорожек. state хранится по словам: state[w * lanes + lane],
+ * data[lane] указывает на данные дорожки.
+ */
+using MD5MultiBlockFunc = void (*)(uint32_t* state, const uint8_t* const* data, size_t blocks);
+
+struct MD5MultiBufferKernel {
+    const char* name = "scalar";
+    size_t lanes = 1;
+    MD5MultiBlockFunc process = nullptr;
+
+    bool isVector() const { return process != nullptr; }
+};
+
+/**
+ * Выбор SIMD-ядра по возможностям процессора (проверяется во время выполнения)
+ */
+class SCANNER_API MD5MultiBuffer {
+public:
+    enum class Isa { Scalar, SSE2, AVX2, AVX512 };
+
+    // Лучшее доступное ядро; результат кешируется
+    static const MD5MultiBufferKernel& best();
+
+    // Конкретное ядро, если процессор и сборка его поддерживают, иначе скалярное
+    static MD5MultiBufferKernel get(Isa isa);
+
+    static bool supported(Isa isa);
+};
+
+// Время стадий одного файла (см. MultiBufferFileHasher::setTiming)
+struct FileTiming {
+    uint64_t openNs = 0;
+    uint64_t readNs = 0;
+    uint64_t hashNs = 0;    // доля вызовов ядра: время вызова делится между файлами в дорожках
+};
+
+/**
+ * Хеширует набор файлов, держа по одному файлу в каждой дорожке SIMD-ядра.
+ * Когда файл в дорожке заканчивается, в нее сразу подается следующий.
+ * Без векторного ядра файлы хешируются последовательно скалярным MD5.
+ * Каждая дорожка читает свой файл FileReader'ом: способ чтения выбирается
+ * по размеру, а блоки хешируются прямо из буфера чтения или отображения.
+ *
+ * Дополнительные дайджесты (setDigests) считаются из тех же кусков файла,
+ * как только кусок прочитан: файл читается один раз при любом их наборе.
+ */
+class SCANNER_API MultiBufferFileHasher {
+public:
+    // digest == nullptr означает ошибку открытия или чтения файла;
+    // ее код внутри вызова возвращает lastError(), а длину
+    // прочитанного файла при успехе - lastLength()
+    using Callback = std::function<void(size_t index, const MD5Digest* digest)>;
+
+    static constexpr size_t LANE_BUFFER_SIZE = ReadOptions::DEFAULT_BUFFER_SIZE;
+
+    explicit MultiBufferFileHasher(const MD5MultiBufferKernel& kernel = MD5MultiBuffer::best(),
+                                   const ReadOptions& readOptions = ReadOptions());
+    ~MultiBufferFileHasher();
+
+    // Применяется к файлам, открытым после вызова
+    void setReadOptions(const ReadOptions& readOptions);
+
+    // Замерять время открытия, чтения и хеширования каждого файла (lastTiming)
+    void setTiming(bool enabled);
+
+    // Алгоритмы, которые считаются вместе с MD5 (DIGEST_SHA1 и т.д.);
+    // применяется к файлам, открытым после вызова
+    void setDigests(DigestMask extra);
+    DigestMask digests() const { return extraDigests_; }
+
+    MultiBufferFileHasher(const MultiBufferFileHasher&) = delete;
+    MultiBufferFileHasher& operator=(const MultiBufferFileHasher&) = delete;
+
+    const MD5MultiBufferKernel& kernel() const { return kernel_; }
+
+    // Код ошибки (errno) последнего файла, отданного callback с nullptr
+    int lastError() const { return lastError_; }
+    // Число байт последнего файла, отданного callback с дайджестом
+    uint64_t lastLength() const { return lastLength_; }
+    // Время стадий того же файла, если включен setTiming
+    const FileTiming& lastTiming() const { return lastTiming_; }
+    // Все дайджесты того же файла: MD5 и алгоритмы setDigests
+    const FileDigests& lastDigests() const { return lastDigests_; }
+
+    void hashFiles(const std::string* paths, size_t count, const Callback& callback);
+
+    void hashFiles(const std::vector<std::string>& paths, const Callback& callback) {
+        hashFiles(paths.data(), paths.size(), callback);
+    }
+
+    // То же для файлов, уже прочитанных в память: data[i] длиной sizes[i].
+    // Ошибок не бывает, в lastTiming есть только время хеширования
+    void hashBuffers(const uint8_t* const* data, const size_t* sizes, size_t count, const Callback& callback);
+
+private:
+    struct Lane;
+
+    // Общий цикл по дорожкам: open подает в дорожку файл index,
+    // scalar хеширует его целиком, когда векторного ядра нет
+    template <class Open, class Scalar>
+    void run(size_t count, const Open& open, const Scalar& scalar, const Callback& callback);
+    // Собирает lastDigests: MD5 дорожки и дайджесты остальных алгоритмов
+    void finishDigests(const MD5Digest& md5, DigestSet& digests);
+
+    MD5MultiBufferKernel kernel_;
+    std::vector<Lane> lanes_;
+    std::vector<uint32_t> state_;
+    std::vector<const uint8_t*> data_;  // указатели дорожек для ядра
+    int lastError_ = 0;
+    uint64_t lastLength_ = 0;
+    bool timing_ = false;
+    FileTiming lastTiming_;
+    DigestMask extraDigests_ = 0;
+    DigestSet scalarDigests_;
+    FileDigests lastDigests_;
+};
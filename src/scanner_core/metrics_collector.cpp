@@ -0,0 +1,70 @@
+#include "metrics_collector.h"
+
+#include <algorithm>
+
+namespace {
+
+// Номер сборщика: кэш потока не примет блок прежнего сборщика за блок нового
+std::atomic<uint64_t> nextCollectorId{1};
+
+}
+
+void MetricsCollector::Histogram::mergeInto(LatencyHistogram& histogram) const {
+    for (size_t i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+        histogram.counts[i] += counts_[i].get();
+    }
+    histogram.count += count_.get();
+    histogram.totalNs += totalNs_.get();
+}
+
+MetricsCollector::MetricsCollector(bool timings)
+    : timings_(timings),
+      id_(nextCollectorId++) {
+}
+
+MetricsCollector::~MetricsCollector() = default;
+
+MetricsCollector::ThreadMetrics& MetricsCollector::local() {
+    struct CachedBlock {
+        uint64_t collectorId = 0;
+        ThreadMetrics* metrics = nullptr;
+    };
+    thread_local CachedBlock cached;
+    if (cached.collectorId != id_) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.emplace_back(new ThreadMetrics());
+        cached.collectorId = id_;
+        cached.metrics = threads_.back().get();
+    }
+    return *cached.metrics;
+}
+
+void MetricsCollector::snapshot(ScanMetrics& metrics) {
+    metrics.timings = timings_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& thread : threads_) {
+        metrics.filesDone += thread->filesDone.get();
+        metrics.bytesHashed += thread->bytesHashed.get();
+        metrics.batches += thread->batches.get();
+        for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+            const FileStage& from = thread->bySize[c];
+            FileStageMetrics& to = metrics.bySize[c];
+            to.files += from.files.get();
+            to.bytes += from.bytes.get();
+            from.open.mergeInto(to.open);
+            from.read.mergeInto(to.read);
+            from.hash.mergeInto(to.hash);
+        }
+        thread->stat.mergeInto(metrics.stat);
+        thread->cache.mergeInto(metrics.cache);
+        thread->prefix.mergeInto(metrics.prefix);
+        thread->lookup.mergeInto(metrics.lookup);
+        thread->log.mergeInto(metrics.log);
+        metrics.queueDepthMax = std::max(metrics.queueDepthMax, thread->queueDepthMax.get());
+        metrics.queueDepthSum += thread->queueDepthSum.get();
+        metrics.filesRead += thread->filesRead.get();
+        metrics.filesFromMemory += thread->filesFromMemory.get();
+        metrics.readBusyNs += thread->readBusyNs.get();
+        metrics.hashBusyNs += thread->hashBusyNs.get();
+    }
+}
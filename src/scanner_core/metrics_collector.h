@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "scan_metrics.h"
+
+/**
+ * Сборщик метрик: у каждого потока свой блок счетчиков на отдельной
+ * кэш-линии. Пишет в блок только его поток (обычные load/store без
+ * lock-префикса), а снимок собирается из любого потока на ходу.
+ */
+class SCANNER_API MetricsCollector {
+public:
+    // Счетчик с одним писателем
+    class Counter {
+    public:
+        void add(uint64_t delta) {
+            value_.store(value_.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+        void max(uint64_t value) {
+            if (value > value_.load(std::memory_order_relaxed)) {
+                value_.store(value, std::memory_order_relaxed);
+            }
+        }
+        void set(uint64_t value) { value_.store(value, std::memory_order_relaxed); }
+        uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    class Histogram {
+    public:
+        void add(uint64_t ns) {
+            counts_[LatencyHistogram::bucketOf(ns)].add(1);
+            count_.add(1);
+            totalNs_.add(ns);
+        }
+        void mergeInto(LatencyHistogram& histogram) const;
+
+    private:
+        Counter counts_[LatencyHistogram::BUCKETS];
+        Counter count_;
+        Counter totalNs_;
+    };
+
+    struct FileStage {
+        Counter files;
+        Counter bytes;
+        Histogram open;
+        Histogram read;
+        Histogram hash;
+    };
+
+    struct alignas(64) ThreadMetrics {
+        Counter filesDone;
+        Counter bytesHashed;
+        Counter batches;
+        FileStage bySize[SIZE_CLASSES];
+        Histogram stat;
+        Histogram cache;
+        Histogram prefix;
+        Histogram lookup;
+        Histogram log;
+        Counter queueDepthMax;
+        Counter queueDepthSum;
+        Counter filesRead;
+        Counter filesFromMemory;
+        Counter readBusyNs;
+        Counter hashBusyNs;
+    };
+
+    explicit MetricsCollector(bool timings);
+    ~MetricsCollector();
+    MetricsCollector(const MetricsCollector&) = delete;
+    MetricsCollector& operator=(const MetricsCollector&) = delete;
+
+    bool timings() const { return timings_; }
+
+    // Блок текущего потока; регистрируется при первом обращении
+    ThreadMetrics& local();
+
+    // Сумма по всем потокам; поля обхода и elapsed заполняет вызывающий
+    void snapshot(ScanMetrics& metrics);
+
+private:
+    bool timings_;
+    uint64_t id_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads_;
+};
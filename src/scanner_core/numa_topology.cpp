@@ -0,0 +1,274 @@
+#include "numa_topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+
+// Вся машина одним узлом: процессоры 0..N-1
+std::vector<NumaTopology::Node> singleNode(std::vector<int> cpus) {
+    if (cpus.empty()) {
+        unsigned int count = std::thread::hardware_concurrency();
+        for (unsigned int cpu = 0; cpu < std::max(1u, count); ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+    }
+    std::vector<NumaTopology::Node> nodes(1);
+    nodes[0].cpus = std::move(cpus);
+    return nodes;
+}
+
+#if defined(__linux__)
+const char NODE_DIRECTORY[] = "/sys/devices/system/node";
+// Процессов с маской на большее число процессоров не бывает на практике
+const int MAX_CPUS = CPU_SETSIZE;
+// Политика памяти mbind: страницы выделяются на узле, пока на нем есть место
+const int MPOL_PREFERRED_POLICY = 1;
+
+std::vector<NumaTopology::Node> detectNodes() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    std::vector<int> allowedCpus;
+    if (masked) {
+        for (int cpu = 0; cpu < MAX_CPUS; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                allowedCpus.push_back(cpu);
+            }
+        }
+    }
+
+    std::vector<NumaTopology::Node> nodes;
+    DIR* dir = opendir(NODE_DIRECTORY);
+    if (!dir) {
+        return singleNode(allowedCpus);
+    }
+    while (dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (std::strncmp(name, "node", 4) != 0 || name[4] < '0' || name[4] > '9') {
+            continue;
+        }
+        std::ifstream file(std::string(NODE_DIRECTORY) + "/" + name + "/cpulist");
+        std::string text;
+        std::vector<int> cpus;
+        if (!std::getline(file, text) || !NumaTopology::parseCpuList(text, cpus)) {
+            continue;
+        }
+        NumaTopology::Node node;
+        node.id = std::atoi(name + 4);
+        for (int cpu : cpus) {
+            if (!masked || (cpu < MAX_CPUS && CPU_ISSET(cpu, &allowed))) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        // Узлы только с памятью или вне cpuset потоков не получают
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+    closedir(dir);
+    if (nodes.empty()) {
+        return singleNode(allowedCpus);
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NumaTopology::Node& a, const NumaTopology::Node& b) { return a.id < b.id; });
+    return nodes;
+}
+#elif defined(_WIN32)
+// Процессоры первой группы (до 64): больше пул хеширования не занимает
+std::vector<NumaTopology::Node> detectNodes() {
+    ULONG highest = 0;
+    std::vector<NumaTopology::Node> nodes;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        for (ULONG id = 0; id <= highest; ++id) {
+            ULONGLONG mask = 0;
+            if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(id), &mask) || mask == 0) {
+                continue;
+            }
+            NumaTopology::Node node;
+            node.id = static_cast<int>(id);
+            for (int cpu = 0; cpu < 64; ++cpu) {
+                if (mask & (ULONGLONG(1) << cpu)) {
+                    node.cpus.push_back(cpu);
+                }
+            }
+            nodes.push_back(std::move(node));
+        }
+    }
+    return nodes.empty() ? singleNode({}) : nodes;
+}
+#else
+std::vector<NumaTopology::Node> detectNodes() {
+    return singleNode({});
+}
+#endif
+
+}
+
+NumaTopology::NumaTopology(std::vector<Node> nodes) : nodes_(std::move(nodes)) {
+    if (nodes_.empty()) {
+        nodes_ = singleNode({});
+    }
+}
+
+const NumaTopology& NumaTopology::system() {
+    static const NumaTopology topology(detectNodes());
+    return topology;
+}
+
+size_t NumaTopology::cpuCount() const {
+    size_t count = 0;
+    for (const Node& node : nodes_) {
+        count += node.cpus.size();
+    }
+    return count;
+}
+
+bool NumaTopology::parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    cpus.clear();
+    const char* p = text.c_str();
+    while (*p && *p != '\n') {
+        char* end;
+        long first = std::strtol(p, &end, 10);
+        if (end == p || first < 0) {
+            return false;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = std::strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                return false;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(static_cast<int>(cpu));
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p && *p != '\n') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NumaTopology::pinCurrentThread(const Node& node) {
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : node.cpus) {
+        if (cpu < MAX_CPUS) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    // Для вызывающего потока, а не всего процесса
+    return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cpu : node.cpus) {
+        if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+            mask |= DWORD_PTR(1) << cpu;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+NodeBuffer::~NodeBuffer() {
+    release();
+}
+
+NodeBuffer::NodeBuffer(NodeBuffer&& other) noexcept
+    : node_(other.node_), data_(other.data_), capacity_(other.capacity_) {
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+}
+
+NodeBuffer& NodeBuffer::operator=(NodeBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        node_ = other.node_;
+        data_ = other.data_;
+        capacity_ = other.capacity_;
+        other.data_ = nullptr;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+bool NodeBuffer::reserve(size_t size, size_t keep) {
+    if (size <= capacity_) {
+        return true;
+    }
+    // Рост вдвое: буфер доходит до наибольшей пачки и дальше не выделяется
+    size_t capacity = std::max(size, capacity_ * 2);
+#ifdef _WIN32
+    void* data = node_ >= 0
+        ? VirtualAllocExNuma(GetCurrentProcess(), NULL, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                             static_cast<DWORD>(node_))
+        : VirtualAlloc(NULL, capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!data) {
+        return false;
+    }
+#else
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    capacity = (capacity + page - 1) / page * page;
+    void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node_ >= 0) {
+        // Привязка - только пожелание: без памяти на узле страницы возьмутся с соседнего
+        unsigned long mask[4] = {};
+        const size_t bits = sizeof(mask) * 8;
+        if (static_cast<size_t>(node_) < bits) {
+            mask[node_ / (sizeof(unsigned long) * 8)] |= 1ul << (node_ % (sizeof(unsigned long) * 8));
+            syscall(SYS_mbind, data, capacity, MPOL_PREFERRED_POLICY, mask, bits + 1, 0);
+        }
+    }
+#endif
+#endif
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    if (keep > 0) {
+        std::memcpy(bytes, data_, std::min(keep, capacity_));
+    }
+    release();
+    data_ = bytes;
+    capacity_ = capacity;
+    return true;
+}
+
+void NodeBuffer::release() {
+    if (!data_) {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(data_, 0, MEM_RELEASE);
+#else
+    munmap(data_, capacity_);
+#endif
+    data_ = nullptr;
+    capacity_ = 0;
+}
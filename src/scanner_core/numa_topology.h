@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "scanner_api.h"
+
+/**
+ * Узлы NUMA и их процессоры, доступные процессу. На Linux узлы читаются из
+ * /sys/devices/system/node, процессоры пересекаются с маской sched_getaffinity
+ * (cpuset контейнера), узлы без доступных процессоров отбрасываются.
+ * Где узлов не видно, вся машина - один узел 0.
+ */
+class SCANNER_API NumaTopology {
+public:
+    struct Node {
+        int id = 0;
+        std::vector<int> cpus;
+    };
+
+    explicit NumaTopology(std::vector<Node> nodes);
+
+    // Топология машины; определяется при первом вызове
+    static const NumaTopology& system();
+
+    // Список процессоров в формате sysfs ("0-3,8,10-11"); false - строка не разобрана
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+    // Привязывает вызывающий поток к процессорам узла; false - не вышло или не поддерживается
+    static bool pinCurrentThread(const Node& node);
+
+    size_t nodeCount() const { return nodes_.size(); }
+    const Node& node(size_t index) const { return nodes_[index]; }
+    size_t cpuCount() const;
+
+private:
+    std::vector<Node> nodes_;
+};
+
+/**
+ * Буфер, страницы которого выделяются на заданном узле NUMA: mbind с
+ * MPOL_PREFERRED на Linux, VirtualAllocExNuma на Windows. Без привязки
+ * страницы достались бы узлу потока, который первым пишет в буфер, -
+ * потоку чтения, а не хеширования. node < 0 - память без привязки.
+ */
+class SCANNER_API NodeBuffer {
+public:
+    explicit NodeBuffer(int node = -1) : node_(node) {}
+    ~NodeBuffer();
+
+    NodeBuffer(NodeBuffer&& other) noexcept;
+    NodeBuffer& operator=(NodeBuffer&& other) noexcept;
+    NodeBuffer(const NodeBuffer&) = delete;
+    NodeBuffer& operator=(const NodeBuffer&) = delete;
+
+    // Емкость не меньше size, первые keep байт сохраняются; false - памяти не выделить
+    bool reserve(size_t size, size_t keep = 0);
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+    int node() const { return node_; }
+
+private:
+    void release();
+
+    int node_;
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Пачка путей файлов, которая переиспользуется без выделений памяти.
+ * clear не освобождает строки, а только сбрасывает счетчик: следующий путь
+ * пишется в строку прошлого, и ее буфера уже хватает. Обход каталогов
+ * возвращает отработавшие пачки в PathBatchPool, поэтому после первых пачек
+ * сканирование не выделяет память на файлы.
+ *
+ * Пути остаются std::string с завершающим нулем: хешеры и open берут
+ * их как есть. Перемещение пачки переносит буферы без копирования.
+ */
+class PathBatch {
+public:
+    PathBatch() = default;
+    PathBatch(PathBatch&& other) noexcept : paths_(std::move(other.paths_)), size_(other.size_) {
+        other.paths_.clear();
+        other.size_ = 0;
+    }
+    PathBatch& operator=(PathBatch&& other) noexcept {
+        if (this != &other) {
+            paths_ = std::move(other.paths_);
+            size_ = other.size_;
+            other.paths_.clear();
+            other.size_ = 0;
+        }
+        return *this;
+    }
+    PathBatch(const PathBatch&) = delete;
+    PathBatch& operator=(const PathBatch&) = delete;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const std::string& operator[](size_t index) const { return paths_[index]; }
+    const std::string* data() const { return paths_.data(); }
+    const std::string* begin() const { return paths_.data(); }
+    const std::string* end() const { return paths_.data() + size_; }
+
+    // Путь "каталог, разделитель, имя" в следующей свободной строке
+    void append(std::string_view directory, char separator, std::string_view name) {
+        std::string& path = next();
+        reserve(path, directory.size() + 1 + name.size());
+        path.append(directory.data(), directory.size()).push_back(separator);
+        path.append(name.data(), name.size());
+    }
+
+    void push_back(std::string_view path) {
+        std::string& slot = next();
+        reserve(slot, path.size());
+        slot.assign(path.data(), path.size());
+    }
+
+    // Строка переезжает в пачку целиком; буфер свободной строки освобождается
+    void push_back(std::string&& path) {
+        if (size_ < paths_.size()) {
+            paths_[size_++] = std::move(path);
+        } else {
+            paths_.push_back(std::move(path));
+            size_++;
+        }
+    }
+
+    // Строки остаются с буферами для следующих путей
+    void clear() { size_ = 0; }
+
+    // Строк с буферами, включая свободные
+    size_t capacity() const { return paths_.size(); }
+
+private:
+    // Буфер растет с запасом, чтобы соседний путь длиннее на пару символов
+    // не выделял его заново; меньшим буфер не становится
+    static constexpr size_t SLACK = 64;
+
+    static void reserve(std::string& path, size_t length) {
+        if (path.capacity() < length) {
+            path.reserve(length + SLACK);
+        }
+    }
+
+    std::string& next() {
+        if (size_ == paths_.size()) {
+            paths_.emplace_back();
+        }
+        std::string& path = paths_[size_++];
+        path.clear();
+        return path;
+    }
+
+    std::vector<std::string> paths_;
+    size_t size_ = 0;
+};
+
+/**
+ * Запас пустых пачек со строками от прошлых путей. Пачка берется и
+ * возвращается под мьютексом - раз на пачку, а не на файл. Сканер держит
+ * один запас на все сканирования, и следующее начинается с готовыми пачками
+ */
+class PathBatchPool {
+public:
+    PathBatch take() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (spare_.empty()) {
+            return PathBatch();
+        }
+        PathBatch batch = std::move(spare_.back());
+        spare_.pop_back();
+        return batch;
+    }
+
+    void give(PathBatch&& batch) {
+        batch.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        spare_.push_back(std::move(batch));
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return spare_.size();
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<PathBatch> spare_;
+};
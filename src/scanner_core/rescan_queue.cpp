@@ -0,0 +1,140 @@
+#include "rescan_queue.h"
+
+#include <algorithm>
+#include <limits>
+
+RescanQueue::RescanQueue(uint64_t debounceNs, uint64_t maxDelayNs)
+    : debounceNs_(debounceNs), maxDelayNs_(std::max(debounceNs, maxDelayNs)) {}
+
+void RescanQueue::touch(const std::string& path, uint64_t nowNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.events++;
+    auto found = entries_.find(path);
+    if (found == entries_.end()) {
+        Entry& entry = entries_[path];
+        entry.firstNs = nowNs;
+        entry.lastNs = nowNs;
+        schedule(path, entry);
+        return;
+    }
+
+    Entry& entry = found->second;
+    stats_.coalesced++;
+    if (!entry.waiting) {
+        if (!entry.dirty) {
+            entry.dirty = true;
+            entry.dirtyFirstNs = nowNs;
+        }
+        entry.dirtyLastNs = nowNs;
+        return;
+    }
+    // Срок отодвигается только в записи; запись кучи догонит его при извлечении
+    entry.lastNs = std::max(entry.lastNs, nowNs);
+    entry.dueNs = dueOf(entry);
+}
+
+void RescanQueue::cancel(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(path);
+    if (found == entries_.end()) {
+        return;
+    }
+    if (found->second.waiting) {
+        // Запись кучи остается и будет пропущена: записи с таким номером больше нет
+        stats_.cancelled++;
+        pending_--;
+        entries_.erase(found);
+    } else {
+        found->second.dirty = false;
+    }
+}
+
+size_t RescanQueue::popDue(uint64_t nowNs, size_t maxCount, std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    while (count < maxCount) {
+        dropStale();
+        if (heap_.empty() || heap_.top().dueNs > nowNs) {
+            break;
+        }
+        entries_[heap_.top().path].waiting = false;
+        pending_--;
+        paths.push_back(heap_.top().path);
+        heap_.pop();
+        count++;
+    }
+    return count;
+}
+
+uint64_t RescanQueue::nextDueNs() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropStale();
+    return heap_.empty() ? std::numeric_limits<uint64_t>::max() : heap_.top().dueNs;
+}
+
+bool RescanQueue::finish(const std::string& path, uint64_t& firstEventNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = entries_.find(path);
+    if (found == entries_.end() || found->second.waiting) {
+        firstEventNs = 0;
+        return false;
+    }
+    Entry& entry = found->second;
+    firstEventNs = entry.firstNs;
+    if (!entry.dirty) {
+        entries_.erase(found);
+        return false;
+    }
+    entry.firstNs = entry.dirtyFirstNs;
+    entry.lastNs = entry.dirtyLastNs;
+    entry.dirty = false;
+    stats_.requeued++;
+    schedule(path, entry);
+    return true;
+}
+
+size_t RescanQueue::pending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+size_t RescanQueue::inFlight() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size() - pending_;
+}
+
+RescanQueue::Stats RescanQueue::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void RescanQueue::schedule(const std::string& path, Entry& entry) {
+    entry.dueNs = dueOf(entry);
+    entry.sequence = ++sequence_;
+    entry.waiting = true;
+    pending_++;
+    heap_.push(HeapItem{entry.dueNs, entry.sequence, path});
+}
+
+uint64_t RescanQueue::dueOf(const Entry& entry) const {
+    return std::min(entry.lastNs + debounceNs_, entry.firstNs + maxDelayNs_);
+}
+
+// Снимает с вершины кучи записи отмененных и уже выданных файлов и
+// переставляет записи файлов, срок которых отодвинули новые события
+void RescanQueue::dropStale() {
+    while (!heap_.empty()) {
+        const HeapItem& top = heap_.top();
+        auto found = entries_.find(top.path);
+        if (found == entries_.end() || !found->second.waiting || found->second.sequence != top.sequence) {
+            heap_.pop();
+            continue;
+        }
+        if (found->second.dueNs <= top.dueNs) {
+            return;
+        }
+        HeapItem moved{found->second.dueNs, top.sequence, top.path};
+        heap_.pop();
+        heap_.push(std::move(moved));
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "scanner_api.h"
+
+/**
+ * Очередь файлов на проверку в режиме наблюдения. События по одному пути
+ * сливаются: файл проверяется через debounce после последнего события, но
+ * не позже maxDelay после первого. Файлы выдаются по сроку из кучи, в которой
+ * у ждущего файла одна запись: новое событие только отодвигает срок, а запись
+ * переставляется, когда доходит до вершины. Записи отмененных файлов там же
+ * и снимаются.
+ *
+ * Пока файл проверяется, новые события по нему не ставят его второй раз,
+ * а запоминаются: finish() вернет файл в очередь. Можно вызывать из любых потоков.
+ */
+class SCANNER_API RescanQueue {
+public:
+    struct Stats {
+        uint64_t events = 0;        // вызовов touch
+        uint64_t coalesced = 0;     // события по файлу, который уже ждет или проверяется
+        uint64_t cancelled = 0;     // ожидавшие проверки файлы, снятые cancel
+        uint64_t requeued = 0;      // файлы, снова поставленные после проверки
+    };
+
+    RescanQueue(uint64_t debounceNs, uint64_t maxDelayNs);
+
+    // Событие по файлу в момент nowNs
+    void touch(const std::string& path, uint64_t nowNs);
+    // Файл удален или перенесен: ожидающая проверка отменяется
+    void cancel(const std::string& path);
+
+    // Забирает до maxCount файлов со сроком не позже nowNs в порядке сроков
+    size_t popDue(uint64_t nowNs, size_t maxCount, std::vector<std::string>& paths);
+    // Срок ближайшего файла; UINT64_MAX - ждущих нет
+    uint64_t nextDueNs();
+
+    // Проверка файла, выданного popDue, закончена. firstEventNs - первое событие,
+    // которое она покрыла (0 - файла нет среди выданных). true - пока файл
+    // проверялся, пришли новые события, и он снова в очереди
+    bool finish(const std::string& path, uint64_t& firstEventNs);
+
+    size_t pending();       // ждут срока
+    size_t inFlight();      // выданы и еще не завершены
+    Stats stats();
+
+private:
+    struct Entry {
+        uint64_t firstNs = 0;       // первое событие ожидания (или текущей проверки)
+        uint64_t lastNs = 0;
+        uint64_t dueNs = 0;
+        uint64_t sequence = 0;      // запись кучи с другим номером устарела
+        bool waiting = false;       // ждет в куче; иначе проверяется
+        bool dirty = false;         // при проверке пришли события
+        uint64_t dirtyFirstNs = 0;
+        uint64_t dirtyLastNs = 0;
+    };
+
+    struct HeapItem {
+        uint64_t dueNs;
+        uint64_t sequence;
+        std::string path;
+
+        bool operator>(const HeapItem& other) const {
+            return dueNs != other.dueNs ? dueNs > other.dueNs : sequence > other.sequence;
+        }
+    };
+
+    uint64_t debounceNs_;
+    uint64_t maxDelayNs_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>> heap_;
+    uint64_t sequence_ = 0;
+    size_t pending_ = 0;
+    Stats stats_;
+
+    uint64_t dueOf(const Entry& entry) const;
+    void schedule(const std::string& path, Entry& entry);
+    void dropStale();
+};
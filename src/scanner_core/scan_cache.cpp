@@ -0,0 +1,623 @@
+#include "scan_cache.h"
+#include "checksum.h"
+#include "file_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+/**
+ * Запись кэша, одинаковая в памяти, в снимке и в журнале (little-endian).
+ * Снимок: SnapshotHeader и recordCount записей подряд.
+ * Журнал: JournalHeader и записи, каждая со своей контрольной суммой.
+ * Запись версии 1 - первые 56 байт, при загрузке она дополняется маской DIGEST_MD5.
+ */
+struct CacheRecord {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeNs;
+    int64_t ctimeNs;
+    uint8_t digest[16];
+    // версия 2
+    uint32_t digests;       // маска алгоритмов, дайджесты которых заполнены
+    uint8_t sha1[20];
+    uint8_t sha256[32];
+    uint64_t xxh3;
+};
+const size_t RECORD_SIZE_V1 = 56;
+static_assert(offsetof(CacheRecord, digests) == RECORD_SIZE_V1, "version 1 record layout must not change");
+static_assert(sizeof(CacheRecord) == 120, "scan cache record layout must not change");
+
+struct JournalRecord {
+    CacheRecord record;
+    uint64_t checksum;      // по записи, с номером поколения в качестве затравки
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;
+    uint64_t recordCount;
+    uint64_t payloadChecksum;
+    uint64_t headerChecksum;    // по всем полям заголовка, кроме самой суммы
+};
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;        // поколение снимка, к которому относится журнал
+    uint64_t headerChecksum;
+};
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'C', 'A', 'N', 'C', 'A', 'C', '\x1a'};
+const char JOURNAL_MAGIC[8] = {'S', 'C', 'A', 'N', 'J', 'R', 'N', '\x1a'};
+const char JOURNAL_SUFFIX[] = ".journal";
+
+const uint32_t SLOT_USED = 1;
+const uint32_t SLOT_SEEN = 2;   // файл встречен после open
+
+const unsigned SHARD_BITS = 6;
+const size_t SHARD_COUNT = size_t(1) << SHARD_BITS;
+const size_t MIN_SHARD_CAPACITY = 64;
+const size_t MAX_LOAD_PERCENT = 70;
+// Журнал сжимается в снимок, когда в нем больше половины снимка и еще столько записей
+const uint64_t COMPACT_MIN_RECORDS = 65536;
+
+struct CacheSlot {
+    CacheRecord record;
+    uint32_t flags = 0;
+};
+
+uint64_t fileHash(uint64_t device, uint64_t inode) {
+    uint64_t h = (inode ^ (device * 0xC2B2AE3D27D4EB4Full)) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 31);
+}
+
+// Слот файла или свободный слот, куда его вставить; таблица не пуста и не полна
+CacheSlot& probe(std::vector<CacheSlot>& slots, uint64_t hash, uint64_t device, uint64_t inode) {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        CacheSlot& slot = slots[i];
+        if (!(slot.flags & SLOT_USED) || (slot.record.device == device && slot.record.inode == inode)) {
+            return slot;
+        }
+    }
+}
+
+void rehash(std::vector<CacheSlot>& slots, size_t capacity) {
+    std::vector<CacheSlot> old(capacity);
+    old.swap(slots);
+    for (const CacheSlot& slot : old) {
+        if (slot.flags & SLOT_USED) {
+            probe(slots, fileHash(slot.record.device, slot.record.inode),
+                  slot.record.device, slot.record.inode) = slot;
+        }
+    }
+}
+
+size_t capacityFor(size_t count) {
+    size_t capacity = MIN_SHARD_CAPACITY;
+    while (count * 100 >= capacity * MAX_LOAD_PERCENT) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+CacheRecord toRecord(const FileStamp& stamp, const FileDigests& digests) {
+    CacheRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.device = stamp.device;
+    record.inode = stamp.inode;
+    record.size = stamp.size;
+    record.mtimeNs = stamp.mtimeNs;
+    record.ctimeNs = stamp.ctimeNs;
+    record.digests = digests.mask & DIGEST_ALL;
+    std::memcpy(record.digest, digests.md5.data(), sizeof(record.digest));
+    if (digests.mask & DIGEST_SHA1) std::memcpy(record.sha1, digests.sha1.data(), sizeof(record.sha1));
+    if (digests.mask & DIGEST_SHA256) std::memcpy(record.sha256, digests.sha256.data(), sizeof(record.sha256));
+    if (digests.mask & DIGEST_XXH3) record.xxh3 = digests.xxh3;
+    return record;
+}
+
+// Запись версии recordSize: у записи версии 1 есть только MD5
+CacheRecord readRecord(const uint8_t* data, size_t recordSize) {
+    CacheRecord record;
+    std::memset(&record, 0, sizeof(record));
+    std::memcpy(&record, data, recordSize);
+    if (recordSize == RECORD_SIZE_V1) {
+        record.digests = DIGEST_MD5;
+    }
+    return record;
+}
+
+// Размер записи, который обязан быть у версии; 0 - версия не поддерживается
+size_t recordSizeFor(uint32_t version) {
+    switch (version) {
+    case 1: return RECORD_SIZE_V1;
+    case 2: return sizeof(CacheRecord);
+    default: return 0;
+    }
+}
+
+bool sameFile(const CacheRecord& record, const FileStamp& stamp) {
+    return record.size == stamp.size && record.mtimeNs == stamp.mtimeNs && record.ctimeNs == stamp.ctimeNs;
+}
+
+uint64_t snapshotHeaderChecksum(const SnapshotHeader& header) {
+    return checksum64(&header, offsetof(SnapshotHeader, headerChecksum), 0);
+}
+
+uint64_t journalHeaderChecksum(const JournalHeader& header) {
+    return checksum64(&header, offsetof(JournalHeader, headerChecksum), 0);
+}
+
+bool isMissingFile(int error) {
+#ifdef _WIN32
+    return error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND;
+#else
+    return error == ENOENT;
+#endif
+}
+
+bool fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+#ifdef _WIN32
+// FILETIME (100 нс от 1601 года) в наносекунды от 1970 года
+int64_t fileTimeToUnixNs(int64_t fileTime) {
+    return (fileTime - 116444736000000000ll) * 100;
+}
+#endif
+
+}
+
+struct ScanCache::Shard {
+    std::mutex mutex;
+    std::vector<CacheSlot> slots;
+    size_t used = 0;
+    std::vector<CacheRecord> pending;   // измененные записи, еще не дописанные в журнал
+
+    // Вставляет или заменяет запись; true - запись новая или изменилась
+    bool upsert(const CacheRecord& record, uint64_t hash, uint32_t flags) {
+        if ((used + 1) * 100 >= slots.size() * MAX_LOAD_PERCENT) {
+            rehash(slots, std::max(MIN_SHARD_CAPACITY, slots.size() * 2));
+        }
+        CacheSlot& slot = probe(slots, hash, record.device, record.inode);
+        bool isNew = !(slot.flags & SLOT_USED);
+        bool changed = isNew || std::memcmp(&slot.record, &record, sizeof(record)) != 0;
+        if (isNew) used++;
+        slot.record = record;
+        slot.flags |= SLOT_USED | flags;
+        return changed;
+    }
+};
+
+ScanCache::ScanCache(int64_t racyWindowNs)
+    : racyWindowNs_(racyWindowNs), shards_(SHARD_COUNT) {
+}
+
+ScanCache::~ScanCache() = default;
+
+ScanCache::Shard& ScanCache::shardFor(uint64_t hash) {
+    return shards_[hash >> (64 - SHARD_BITS)];
+}
+
+const ScanCache::Shard& ScanCache::shardFor(uint64_t hash) const {
+    return shards_[hash >> (64 - SHARD_BITS)];
+}
+
+void ScanCache::clear() {
+    for (Shard& shard : shards_) {
+        std::vector<CacheSlot>().swap(shard.slots);
+        std::vector<CacheRecord>().swap(shard.pending);
+        shard.used = 0;
+    }
+    journal_.reset();
+    generation_ = 0;
+    snapshotRecords_ = 0;
+    journalRecords_ = 0;
+    journalValidSize_ = 0;
+    droppedRecords_ = 0;
+    needsCompaction_ = false;
+    hits_ = 0;
+    misses_ = 0;
+    stale_ = 0;
+    incomplete_ = 0;
+    racy_ = 0;
+}
+
+bool ScanCache::open(const std::string& path, std::string* error) {
+    clear();
+    path_ = path;
+    if (!loadSnapshot(path, error)) {
+        clear();
+        needsCompaction_ = true;
+        return false;
+    }
+    loadJournal(path + JOURNAL_SUFFIX);
+    return true;
+}
+
+bool ScanCache::loadSnapshot(const std::string& path, std::string* error) {
+    MappedFile file;
+    if (!file.open(path)) {
+        // Первый запуск: снимка еще нет
+        if (isMissingFile(file.lastError())) {
+            return true;
+        }
+        return fail(error, "Cannot open scan cache: " + path);
+    }
+    if (file.size() < sizeof(SnapshotHeader)) {
+        return fail(error, "Scan cache is too small: " + path);
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+        return fail(error, "Not a scan cache file: " + path);
+    }
+    if (header.headerChecksum != snapshotHeaderChecksum(header)) {
+        return fail(error, "Scan cache header is corrupted: " + path);
+    }
+    const size_t recordSize = recordSizeFor(header.version);
+    if (recordSize == 0 || header.recordSize != recordSize) {
+        return fail(error, "Unsupported scan cache version: " + std::to_string(header.version));
+    }
+    if (header.recordCount > (file.size() - sizeof(header)) / recordSize) {
+        return fail(error, "Scan cache is truncated: " + path);
+    }
+    const uint8_t* records = file.data() + sizeof(header);
+    size_t bytes = static_cast<size_t>(header.recordCount) * recordSize;
+    if (checksum64(records, bytes, header.generation) != header.payloadChecksum) {
+        return fail(error, "Scan cache checksum mismatch: " + path);
+    }
+
+    size_t perShard = capacityFor(static_cast<size_t>(header.recordCount) / SHARD_COUNT * 9 / 8);
+    for (Shard& shard : shards_) {
+        shard.slots.assign(perShard, CacheSlot());
+    }
+    for (size_t i = 0; i < header.recordCount; ++i) {
+        CacheRecord record = readRecord(records + i * recordSize, recordSize);
+        uint64_t hash = fileHash(record.device, record.inode);
+        shardFor(hash).upsert(record, hash, 0);
+    }
+    generation_ = header.generation;
+    snapshotRecords_ = header.recordCount;
+    // Снимок старой версии переписывается при первом commit
+    needsCompaction_ = header.version != FORMAT_VERSION;
+    return true;
+}
+
+void ScanCache::loadJournal(const std::string& path) {
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(JournalHeader)) {
+        return;
+    }
+    JournalHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    // Журнал другого поколения остался от прерванного сжатия: все его записи уже в снимке
+    const size_t recordSize = recordSizeFor(header.version);
+    if (std::memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.headerChecksum != journalHeaderChecksum(header) ||
+        recordSize == 0 || header.recordSize != recordSize ||
+        header.generation != generation_) {
+        return;
+    }
+
+    // Записи читаются до первой поврежденной: хвост мог оборваться при сбое
+    const size_t entrySize = recordSize + sizeof(uint64_t);
+    journalValidSize_ = sizeof(header);
+    size_t offset = sizeof(header);
+    for (; offset + entrySize <= file.size(); offset += entrySize) {
+        const uint8_t* entry = file.data() + offset;
+        uint64_t checksum;
+        std::memcpy(&checksum, entry + recordSize, sizeof(checksum));
+        if (checksum64(entry, recordSize, generation_) != checksum) {
+            break;
+        }
+        CacheRecord record = readRecord(entry, recordSize);
+        uint64_t hash = fileHash(record.device, record.inode);
+        shardFor(hash).upsert(record, hash, 0);
+        journalRecords_++;
+        journalValidSize_ = offset + entrySize;
+    }
+    uint64_t damaged = file.size() - journalValidSize_;
+    droppedRecords_ += (damaged + entrySize - 1) / entrySize;
+    // В журнал старой версии новые записи не дописать: он начнется заново со снимком
+    if (header.version != FORMAT_VERSION) {
+        needsCompaction_ = true;
+    }
+}
+
+bool ScanCache::lookup(const FileStamp& stamp, MD5Digest& digest) {
+    FileDigests digests;
+    if (!lookup(stamp, DIGEST_MD5, digests)) {
+        return false;
+    }
+    digest = digests.md5;
+    return true;
+}
+
+bool ScanCache::lookup(const FileStamp& stamp, DigestMask required, FileDigests& digests) {
+    uint64_t hash = fileHash(stamp.device, stamp.inode);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.slots.empty()) {
+        misses_++;
+        return false;
+    }
+    CacheSlot& slot = probe(shard.slots, hash, stamp.device, stamp.inode);
+    if (!(slot.flags & SLOT_USED)) {
+        misses_++;
+        return false;
+    }
+    slot.flags |= SLOT_SEEN;
+    const CacheRecord& record = slot.record;
+    if (!sameFile(record, stamp)) {
+        stale_++;
+        return false;
+    }
+    if ((record.digests & required) != required) {
+        incomplete_++;
+        return false;
+    }
+    digests.mask = record.digests;
+    std::memcpy(digests.md5.data(), record.digest, digests.md5.size());
+    std::memcpy(digests.sha1.data(), record.sha1, digests.sha1.size());
+    std::memcpy(digests.sha256.data(), record.sha256, digests.sha256.size());
+    digests.xxh3 = record.xxh3;
+    hits_++;
+    return true;
+}
+
+bool ScanCache::store(const FileStamp& stamp, const MD5Digest& digest, int64_t observedAtNs) {
+    FileDigests digests;
+    digests.mask = DIGEST_MD5;
+    digests.md5 = digest;
+    return store(stamp, digests, observedAtNs);
+}
+
+bool ScanCache::store(const FileStamp& stamp, const FileDigests& digests, int64_t observedAtNs) {
+    if (std::max(stamp.mtimeNs, stamp.ctimeNs) > observedAtNs - racyWindowNs_) {
+        racy_++;
+        return false;
+    }
+    CacheRecord record = toRecord(stamp, digests);
+    uint64_t hash = fileHash(stamp.device, stamp.inode);
+    Shard& shard = shardFor(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Содержимое не изменилось: дайджесты, посчитанные прошлым сканированием, остаются
+    if (!shard.slots.empty()) {
+        const CacheSlot& slot = probe(shard.slots, hash, stamp.device, stamp.inode);
+        const CacheRecord& old = slot.record;
+        if ((slot.flags & SLOT_USED) && sameFile(old, stamp) &&
+            std::memcmp(old.digest, record.digest, sizeof(record.digest)) == 0) {
+            DigestMask keep = old.digests & ~record.digests;
+            if (keep & DIGEST_SHA1) std::memcpy(record.sha1, old.sha1, sizeof(record.sha1));
+            if (keep & DIGEST_SHA256) std::memcpy(record.sha256, old.sha256, sizeof(record.sha256));
+            if (keep & DIGEST_XXH3) record.xxh3 = old.xxh3;
+            record.digests |= keep;
+        }
+    }
+    if (shard.upsert(record, hash, SLOT_SEEN)) {
+        shard.pending.push_back(record);
+    }
+    return true;
+}
+
+bool ScanCache::openJournal(bool restart, std::string* error) {
+    std::string journalPath = path_ + JOURNAL_SUFFIX;
+    journal_.reset(new OutputFile());
+    if (!restart) {
+        // Поврежденный хвост отрезается, новые записи идут сразу за последней целой
+        if (journal_->open(journalPath, false) && journal_->truncate(journalValidSize_)) {
+            return true;
+        }
+        journal_.reset();
+        return fail(error, "Cannot open scan cache journal: " + journalPath);
+    }
+
+    JournalHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.recordSize = sizeof(CacheRecord);
+    header.generation = generation_;
+    header.headerChecksum = journalHeaderChecksum(header);
+    if (!journal_->open(journalPath, true) || !journal_->write(&header, sizeof(header))) {
+        journal_.reset();
+        return fail(error, "Cannot create scan cache journal: " + journalPath);
+    }
+    journalValidSize_ = sizeof(header);
+    journalRecords_ = 0;
+    return true;
+}
+
+bool ScanCache::flush(std::string* error) {
+    if (path_.empty()) {
+        return fail(error, "Scan cache is not open");
+    }
+    if (needsCompaction_) {
+        return compact(false, error);
+    }
+
+    std::vector<JournalRecord> entries;
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const CacheRecord& record : shard.pending) {
+            entries.push_back({record, checksum64(&record, sizeof(record), generation_)});
+        }
+        shard.pending.clear();
+    }
+    if (entries.empty()) {
+        return true;
+    }
+
+    if (!journal_ && !openJournal(journalValidSize_ == 0, error)) {
+        needsCompaction_ = true;
+        return false;
+    }
+    size_t bytes = entries.size() * sizeof(JournalRecord);
+    if (!journal_->write(entries.data(), bytes) || !journal_->sync()) {
+        // Записи остались в памяти: следующий commit перепишет снимок целиком
+        journal_.reset();
+        needsCompaction_ = true;
+        return fail(error, "Scan cache journal write error: " + path_ + JOURNAL_SUFFIX);
+    }
+    journalRecords_ += entries.size();
+    journalValidSize_ += bytes;
+    return true;
+}
+
+bool ScanCache::compact(bool dropUnseen, std::string* error) {
+    if (path_.empty()) {
+        return fail(error, "Scan cache is not open");
+    }
+
+    std::vector<CacheRecord> records;
+    records.reserve(size());
+    for (Shard& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const CacheSlot& slot : shard.slots) {
+            if ((slot.flags & SLOT_USED) && (!dropUnseen || (slot.flags & SLOT_SEEN))) {
+                records.push_back(slot.record);
+            }
+        }
+    }
+
+    // Поколение растет и после потери снимка, чтобы не принять старый журнал за новый
+    uint64_t generation = std::max(generation_ + 1, static_cast<uint64_t>(now()));
+    size_t bytes = records.size() * sizeof(CacheRecord);
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.recordSize = sizeof(CacheRecord);
+    header.generation = generation;
+    header.recordCount = records.size();
+    header.payloadChecksum = checksum64(records.data(), bytes, generation);
+    header.headerChecksum = snapshotHeaderChecksum(header);
+
+    // Снимок пишется рядом и подменяет старый только целиком записанным
+    std::string tempPath = path_ + ".tmp";
+    OutputFile file;
+    bool written = file.open(tempPath, true) &&
+                   file.write(&header, sizeof(header)) &&
+                   file.write(records.data(), bytes) &&
+                   file.sync();
+    file.close();
+    if (!written || !OutputFile::replace(tempPath, path_)) {
+        std::remove(tempPath.c_str());
+        needsCompaction_ = true;
+        return fail(error, "Cannot write scan cache: " + path_);
+    }
+
+    generation_ = generation;
+    snapshotRecords_ = records.size();
+    needsCompaction_ = false;
+    for (Shard& shard : shards_) {
+        shard.pending.clear();
+    }
+    if (dropUnseen) {
+        for (Shard& shard : shards_) {
+            std::vector<CacheSlot>().swap(shard.slots);
+            shard.used = 0;
+        }
+        for (const CacheRecord& record : records) {
+            uint64_t hash = fileHash(record.device, record.inode);
+            shardFor(hash).upsert(record, hash, SLOT_SEEN);
+        }
+    }
+
+    // Журнал прошлого поколения больше не нужен; до его замены он игнорируется по номеру поколения
+    journal_.reset();
+    if (!openJournal(true, error) || !journal_->sync()) {
+        journal_.reset();
+        journalValidSize_ = 0;
+        return false;
+    }
+    return true;
+}
+
+bool ScanCache::commit(bool dropUnseen, std::string* error) {
+    uint64_t pending = 0;
+    for (const Shard& shard : shards_) {
+        pending += shard.pending.size();
+    }
+    if (dropUnseen || needsCompaction_ ||
+        journalRecords_ + pending > snapshotRecords_ / 2 + COMPACT_MIN_RECORDS) {
+        return compact(dropUnseen, error);
+    }
+    return flush(error);
+}
+
+size_t ScanCache::size() const {
+    size_t total = 0;
+    for (const Shard& shard : shards_) {
+        total += shard.used;
+    }
+    return total;
+}
+
+ScanCache::Stats ScanCache::stats() const {
+    Stats stats;
+    stats.entries = size();
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.stale = stale_;
+    stats.incomplete = incomplete_;
+    stats.racy = racy_;
+    stats.journalRecords = journalRecords_;
+    stats.droppedRecords = droppedRecords_;
+    return stats;
+}
+
+bool ScanCache::stampOf(const std::string& path, FileStamp& stamp) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    BY_HANDLE_FILE_INFORMATION info;
+    FILE_BASIC_INFO basic;
+    bool ok = GetFileInformationByHandle(file, &info) &&
+              GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof(basic));
+    CloseHandle(file);
+    if (!ok || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+    stamp.device = info.dwVolumeSerialNumber;
+    stamp.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    stamp.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    stamp.mtimeNs = fileTimeToUnixNs(basic.LastWriteTime.QuadPart);
+    stamp.ctimeNs = fileTimeToUnixNs(basic.ChangeTime.QuadPart);
+    stamp.links = info.nNumberOfLinks;
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    stamp.device = static_cast<uint64_t>(st.st_dev);
+    stamp.inode = static_cast<uint64_t>(st.st_ino);
+    stamp.size = static_cast<uint64_t>(st.st_size);
+    stamp.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    stamp.ctimeNs = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+    stamp.links = static_cast<uint32_t>(st.st_nlink);
+#endif
+    return true;
+}
+
+int64_t ScanCache::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "digest_set.h"
+#include "md5.h"
+#include "scanner_api.h"
+
+class OutputFile;
+
+// Метаданные файла, по которым решается, верить ли сохраненному дайджесту
+struct FileStamp {
+    uint64_t device = 0;
+    uint64_t inode = 0;
+    uint64_t size = 0;
+    int64_t mtimeNs = 0;    // время изменения, нс от 1970 года
+    int64_t ctimeNs = 0;    // время изменения метаданных (на Windows - ChangeTime)
+    uint32_t links = 1;     // жестких ссылок на файл
+};
+
+/**
+ * Кэш дайджестов между запусками: (устройство, inode) -> размер, mtime, ctime
+ * и дайджесты файла (MD5 и посчитанные вместе с ним SHA-1, SHA-256, XXH3).
+ * Если метаданные файла не изменились и в записи есть все нужные дайджесты,
+ * повторное сканирование берет их из кэша и проверяет по текущей базе, не читая файл.
+ *
+ * В памяти - таблицы с открытой адресацией, разбитые на шарды со своими
+ * мьютексами: lookup и store вызываются из задач пула. На диске - снимок
+ * (path) и журнал (path.journal). Новые записи дописываются в журнал с
+ * контрольной суммой на каждую, оборванный хвост журнала отбрасывается при
+ * загрузке. Сжатие пишет снимок во временный файл и атомарно подменяет им
+ * старый, после чего журнал начинается заново; журнал от прошлого снимка
+ * узнается по номеру поколения и не применяется.
+ *
+ * Файл, измененный незадолго до stat, не кэшируется (RACY_WINDOW_NS): его
+ * следующее изменение может не сдвинуть время из-за грубых отметок времени
+ * файловой системы, и устаревший дайджест выглядел бы верным.
+ */
+class SCANNER_API ScanCache {
+public:
+    struct Stats {
+        uint64_t entries = 0;           // записей в кэше
+        uint64_t hits = 0;              // дайджест взят из кэша
+        uint64_t misses = 0;            // файла нет в кэше
+        uint64_t stale = 0;             // файл есть, но метаданные изменились
+        uint64_t incomplete = 0;        // метаданные те же, но нужных дайджестов в записи нет
+        uint64_t racy = 0;              // дайджест не сохранен: файл изменен слишком недавно
+        uint64_t journalRecords = 0;    // записей в журнале после последнего снимка
+        uint64_t droppedRecords = 0;    // отброшенные при загрузке поврежденные записи
+    };
+
+    // Окно "гонки" с отметками времени: 2 с покрывают и FAT с точностью mtime в 2 с
+    static constexpr int64_t RACY_WINDOW_NS = 2000000000;
+    // Версия формата снимка и журнала (1 - только MD5: читается, при commit переписывается)
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    explicit ScanCache(int64_t racyWindowNs = RACY_WINDOW_NS);
+    ~ScanCache();
+    ScanCache(const ScanCache&) = delete;
+    ScanCache& operator=(const ScanCache&) = delete;
+
+    // Загружает снимок и журнал; отсутствующий файл - пустой кэш.
+    // false, если снимок поврежден: кэш остается пустым и будет переписан при commit.
+    bool open(const std::string& path, std::string* error = nullptr);
+
+    // Дайджест файла, если его метаданные совпадают с сохраненными
+    bool lookup(const FileStamp& stamp, MD5Digest& digest);
+    // Все дайджесты записи, если метаданные совпадают и в ней есть алгоритмы required
+    bool lookup(const FileStamp& stamp, DigestMask required, FileDigests& digests);
+
+    // Запоминает дайджест. observedAtNs - время до вызова stat (now());
+    // false, если файл изменен в пределах окна гонки и не кэшируется.
+    bool store(const FileStamp& stamp, const MD5Digest& digest, int64_t observedAtNs);
+    // То же для набора дайджестов; алгоритмы прежней записи того же содержимого сохраняются
+    bool store(const FileStamp& stamp, const FileDigests& digests, int64_t observedAtNs);
+
+    // Дописывает новые записи в журнал и дожидается их записи на диск
+    bool flush(std::string* error = nullptr);
+
+    // Переписывает снимок и начинает журнал заново. dropUnseen - удалить записи
+    // файлов, не встреченных (lookup/store) после open.
+    bool compact(bool dropUnseen, std::string* error = nullptr);
+
+    // flush, а если журнал разросся или снимок был поврежден - compact.
+    // flush, compact и commit нельзя вызывать одновременно с lookup/store.
+    bool commit(bool dropUnseen = false, std::string* error = nullptr);
+
+    size_t size() const;
+    Stats stats() const;
+
+    // Метаданные файла по пути, без открытия на чтение; false - не обычный файл или ошибка
+    static bool stampOf(const std::string& path, FileStamp& stamp);
+    // Текущее время в тех же единицах, что и отметки FileStamp
+    static int64_t now();
+
+private:
+    struct Shard;
+
+    int64_t racyWindowNs_;
+    std::string path_;
+    std::vector<Shard> shards_;
+    std::unique_ptr<OutputFile> journal_;
+    uint64_t generation_ = 0;
+    uint64_t snapshotRecords_ = 0;
+    uint64_t journalRecords_ = 0;
+    uint64_t journalValidSize_ = 0;     // байт журнала до первой поврежденной записи
+    uint64_t droppedRecords_ = 0;
+    bool needsCompaction_ = false;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> stale_{0};
+    std::atomic<uint64_t> incomplete_{0};
+    std::atomic<uint64_t> racy_{0};
+
+    Shard& shardFor(uint64_t hash);
+    const Shard& shardFor(uint64_t hash) const;
+    bool loadSnapshot(const std::string& path, std::string* error);
+    void loadJournal(const std::string& path);
+    bool openJournal(bool restart, std::string* error);
+    void clear();
+};
@@ -0,0 +1,368 @@
+#include "scan_log_writer.h"
+#include "file_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace {
+
+// Номер писателя: кэш потока не примет слот закрытого писателя за слот нового
+std::atomic<uint64_t> nextWriterId{1};
+
+}
+
+struct ScanLogWriter::Block {
+    std::atomic<Block*> next{nullptr};
+    size_t size = 0;
+    size_t capacity = 0;
+    uint64_t lines = 0;
+    uint32_t frame[2] = {0, 0};     // кадр блока в режиме framed, заполняется при записи
+
+    // Данные лежат сразу за заголовком блока
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+
+    static Block* allocate(size_t capacity) {
+        Block* block = new (::operator new(sizeof(Block) + capacity)) Block();
+        block->capacity = capacity;
+        return block;
+    }
+
+    static void release(Block* block) {
+        block->~Block();
+        ::operator delete(block);
+    }
+};
+
+// Буфер одного потока; трогает его только сам поток, а после остановки потоков - close
+struct ScanLogWriter::Slot {
+    Block* block = nullptr;
+    int64_t oldestMs = 0;       // когда в блок легла первая строка
+    std::string previousKey;    // ключ последней записи блока
+};
+
+ScanLogWriter::ScanLogWriter(const LogWriterOptions& options)
+    : options_(options),
+      file_(new OutputFile()),
+      id_(nextWriterId++),
+      stub_(new Block()) {
+    options_.blockSize = std::max<size_t>(options_.blockSize, 256);
+    head_.store(stub_.get(), std::memory_order_relaxed);
+    tail_ = stub_.get();
+}
+
+ScanLogWriter::~ScanLogWriter() {
+    close();
+}
+
+bool ScanLogWriter::open(const std::string& path, std::string_view header, std::string* error) {
+    close();
+    if (!file_->open(path, true)) {
+        lastError_ = file_->lastError();
+        if (error) *error = "Cannot create file: " + path;
+        return false;
+    }
+    if (!header.empty()) {
+        if (!file_->write(header.data(), header.size())) {
+            lastError_ = file_->lastError();
+            if (error) *error = "Log write error: " + std::to_string(lastError_);
+            file_->close();
+            return false;
+        }
+        bytes_ += header.size();
+        writes_++;
+    }
+
+    id_ = nextWriterId++;
+    stub_->next.store(nullptr, std::memory_order_relaxed);
+    head_.store(stub_.get(), std::memory_order_relaxed);
+    tail_ = stub_.get();
+    stopping_ = false;
+    failed_ = false;
+    lastError_ = 0;
+    writer_ = std::thread([this]() { run(); });
+    return true;
+}
+
+void ScanLogWriter::appendLine(std::initializer_list<std::string_view> fields) {
+    size_t length = fields.size();  // разделители и перевод строки
+    for (std::string_view field : fields) {
+        length += field.size();
+    }
+
+    Slot& slot = threadSlot();
+    Block* block = reserve(slot, length);
+    char* out = block->data() + block->size;
+    bool first = true;
+    for (std::string_view field : fields) {
+        if (!first) *out++ = ';';
+        std::memcpy(out, field.data(), field.size());
+        out += field.size();
+        first = false;
+    }
+    *out = '\n';
+    commit(slot, length);
+}
+
+char* ScanLogWriter::beginRecord(size_t maxSize, std::string*& previousKey) {
+    Slot& slot = threadSlot();
+    Block* block = reserve(slot, maxSize);
+    previousKey = &slot.previousKey;
+    return block->data() + block->size;
+}
+
+void ScanLogWriter::commitRecord(size_t size) {
+    commit(threadSlot(), size);
+}
+
+// Блок потока, в котором хватает места на length байт; полный блок сдается писателю
+ScanLogWriter::Block* ScanLogWriter::reserve(Slot& slot, size_t length) {
+    if (slot.block && slot.block->size + length > slot.block->capacity) {
+        submit(slot.block);
+        slot.block = nullptr;
+    }
+    if (!slot.block) {
+        slot.block = takeBlock(std::max(length, options_.blockSize));
+        slot.oldestMs = nowMs();
+        slot.previousKey.clear();
+    }
+    return slot.block;
+}
+
+void ScanLogWriter::commit(Slot& slot, size_t length) {
+    Block* block = slot.block;
+    block->size += length;
+    block->lines++;
+
+    if (nowMs() - slot.oldestMs >= static_cast<int64_t>(options_.flushIntervalMs)) {
+        submit(block);
+        slot.block = nullptr;
+    }
+}
+
+void ScanLogWriter::poll() {
+    Slot& slot = threadSlot();
+    if (slot.block && slot.block->size > 0 &&
+        nowMs() - slot.oldestMs >= static_cast<int64_t>(options_.flushIntervalMs)) {
+        submit(slot.block);
+        slot.block = nullptr;
+    }
+}
+
+void ScanLogWriter::flush() {
+    Slot& slot = threadSlot();
+    if (slot.block && slot.block->size > 0) {
+        submit(slot.block);
+        slot.block = nullptr;
+    }
+}
+
+bool ScanLogWriter::close(std::string* error) {
+    if (!writer_.joinable()) {
+        return !failed_;
+    }
+
+    // Потоки уже не пишут: их неполные блоки сдаются отсюда
+    {
+        std::lock_guard<std::mutex> lock(slotsMutex_);
+        for (auto& entry : slots_) {
+            Block* block = entry.second->block;
+            if (block && block->size > 0) {
+                submit(block);
+            } else if (block) {
+                Block::release(block);
+            }
+        }
+        slots_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+
+    {
+        std::lock_guard<std::mutex> lock(freeMutex_);
+        for (Block* block : freeBlocks_) {
+            Block::release(block);
+        }
+        freeBlocks_.clear();
+    }
+    file_->close();
+
+    if (failed_) {
+        if (error) *error = "Log write error: " + std::to_string(lastError_);
+        return false;
+    }
+    return true;
+}
+
+ScanLogWriter::Stats ScanLogWriter::stats() const {
+    Stats stats;
+    stats.lines = lines_;
+    stats.bytes = bytes_;
+    stats.writes = writes_;
+    stats.syncs = syncs_;
+    return stats;
+}
+
+ScanLogWriter::Slot& ScanLogWriter::threadSlot() {
+    struct CachedSlot {
+        uint64_t writerId = 0;
+        Slot* slot = nullptr;
+    };
+    thread_local CachedSlot cached;
+    if (cached.writerId != id_) {
+        std::lock_guard<std::mutex> lock(slotsMutex_);
+        std::unique_ptr<Slot>& slot = slots_[std::this_thread::get_id()];
+        if (!slot) {
+            slot.reset(new Slot());
+        }
+        cached.writerId = id_;
+        cached.slot = slot.get();
+    }
+    return *cached.slot;
+}
+
+ScanLogWriter::Block* ScanLogWriter::takeBlock(size_t capacity) {
+    if (capacity == options_.blockSize) {
+        std::lock_guard<std::mutex> lock(freeMutex_);
+        if (!freeBlocks_.empty()) {
+            Block* block = freeBlocks_.back();
+            freeBlocks_.pop_back();
+            return block;
+        }
+    }
+    return Block::allocate(capacity);
+}
+
+void ScanLogWriter::push(Block* block) {
+    block->next.store(nullptr, std::memory_order_relaxed);
+    Block* previous = head_.exchange(block, std::memory_order_acq_rel);
+    previous->next.store(block, std::memory_order_release);
+}
+
+void ScanLogWriter::submit(Block* block) {
+    push(block);
+    // Без мьютекса: пропущенное пробуждение писатель наверстает по таймауту
+    wake_.notify_one();
+}
+
+ScanLogWriter::Block* ScanLogWriter::pop() {
+    Block* tail = tail_;
+    Block* next = tail->next.load(std::memory_order_acquire);
+    if (tail == stub_.get()) {
+        if (!next) {
+            return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    // Последний блок можно забрать, только вернув в очередь заглушку
+    if (tail != head_.load(std::memory_order_acquire)) {
+        return nullptr;     // поток еще не дописал ссылку на следующий блок
+    }
+    push(stub_.get());
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+void ScanLogWriter::run() {
+    const int64_t interval = static_cast<int64_t>(options_.flushIntervalMs);
+    // В режиме framed каждому блоку нужен еще один буфер под кадр
+    const size_t maxBatch = options_.framed ? OutputFile::MAX_GATHER / 2 : OutputFile::MAX_GATHER;
+    std::vector<Block*> batch;
+    batch.reserve(maxBatch);
+    int64_t lastSync = nowMs();
+    bool dirty = false;
+
+    while (true) {
+        batch.clear();
+        while (batch.size() < maxBatch) {
+            Block* block = pop();
+            if (!block) break;
+            batch.push_back(block);
+        }
+
+        if (!batch.empty()) {
+            writeBlocks(batch);
+            dirty = true;
+        } else {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            if (stopping_) {
+                break;
+            }
+            wake_.wait_for(lock, std::chrono::milliseconds(std::max<int64_t>(1, interval)));
+        }
+
+        bool syncNow = options_.durability == LogDurability::EveryWrite ||
+                       (options_.durability == LogDurability::Interval && nowMs() - lastSync >= interval);
+        if (dirty && syncNow && !failed_) {
+            file_->sync();
+            syncs_++;
+            dirty = false;
+            lastSync = nowMs();
+        }
+    }
+
+    if (dirty && options_.durability != LogDurability::Buffered && !failed_) {
+        file_->sync();
+        syncs_++;
+    }
+}
+
+void ScanLogWriter::writeBlocks(std::vector<Block*>& blocks) {
+    OutputFile::Buffer buffers[OutputFile::MAX_GATHER];
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+    size_t count = 0;
+    for (Block* block : blocks) {
+        if (options_.framed) {
+            block->frame[0] = static_cast<uint32_t>(block->size);
+            block->frame[1] = static_cast<uint32_t>(block->lines);
+            buffers[count++] = {block->frame, sizeof(block->frame)};
+            bytes += sizeof(block->frame);
+        }
+        buffers[count++] = {block->data(), block->size};
+        lines += block->lines;
+        bytes += block->size;
+    }
+    // После ошибки блоки только возвращаются: потоки пула не должны копить память
+    if (!failed_) {
+        if (file_->writeGather(buffers, count)) {
+            lines_ += lines;
+            bytes_ += bytes;
+            writes_++;
+        } else {
+            lastError_ = file_->lastError();
+            failed_ = true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(freeMutex_);
+    for (Block* block : blocks) {
+        if (block->capacity == options_.blockSize) {
+            block->size = 0;
+            block->lines = 0;
+            freeBlocks_.push_back(block);
+        } else {
+            Block::release(block);
+        }
+    }
+}
+
+int64_t ScanLogWriter::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
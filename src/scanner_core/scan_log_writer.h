@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "scanner_api.h"
+#include "scanner_core.h"
+
+class OutputFile;
+
+struct LogWriterOptions {
+    size_t blockSize = 64 * 1024;       // буфер потока; строка длиннее уходит отдельным блоком
+    uint32_t flushIntervalMs = 100;     // сколько строка может ждать в буфере потока и до fdatasync
+    LogDurability durability = LogDurability::Buffered;
+    bool framed = false;                // каждый блок предваряется кадром: uint32 размер данных, uint32 число записей
+};
+
+/**
+ * Лог сканирования, в который пишут все потоки пула. Каждый поток копирует
+ * строку в свой блок без блокировок; заполненный блок уходит в lock-free
+ * MPSC-очередь (Вьюков), и отдельный поток-писатель выгружает накопившиеся
+ * блоки одним writev. Строка целиком лежит в одном блоке, поэтому строки
+ * разных потоков не перемешиваются.
+ *
+ * Неполный блок потока сдается, когда в нем есть строка старше
+ * flushIntervalMs (проверяется при append и poll), и при close.
+ *
+ * Кроме строк, в блок можно писать записи произвольного формата
+ * (beginRecord/commitRecord). В режиме framed блоки выходят кадрами, и
+ * запись может ссылаться на предыдущую запись того же блока.
+ */
+class SCANNER_API ScanLogWriter {
+public:
+    struct Stats {
+        uint64_t lines = 0;         // строк и записей
+        uint64_t bytes = 0;         // записано в файл, включая заголовок и кадры
+        uint64_t writes = 0;        // вызовов write/writev
+        uint64_t syncs = 0;         // вызовов fdatasync
+    };
+
+    explicit ScanLogWriter(const LogWriterOptions& options = LogWriterOptions());
+    ~ScanLogWriter();
+    ScanLogWriter(const ScanLogWriter&) = delete;
+    ScanLogWriter& operator=(const ScanLogWriter&) = delete;
+
+    // Создает файл заново, пишет header и запускает поток-писатель
+    bool open(const std::string& path, std::string_view header = std::string_view(),
+              std::string* error = nullptr);
+
+    // Дописывает строку: поля через ';' и перевод строки. Можно вызывать из любых потоков
+    void appendLine(std::initializer_list<std::string_view> fields);
+
+    // Место под запись до maxSize байт в блоке текущего потока; запись
+    // завершает commitRecord(size) из того же потока. previousKey - ключ,
+    // сохраненный предыдущей записью этого блока (пустой в начале блока):
+    // по нему записи сжимаются относительно предыдущей
+    char* beginRecord(size_t maxSize, std::string*& previousKey);
+    void commitRecord(size_t size);
+
+    // Сдает буфер текущего потока, если строки в нем ждут дольше flushIntervalMs
+    void poll();
+    // Сдает буфер текущего потока сразу, не дожидаясь flushIntervalMs
+    void flush();
+
+    // Выгружает буферы всех потоков и останавливает писателя. Вызывается,
+    // когда потоки, писавшие в лог, уже остановлены. false - была ошибка записи
+    bool close(std::string* error = nullptr);
+
+    bool isOpen() const { return writer_.joinable(); }
+    // Код ошибки open или записи (errno, на Windows - GetLastError); читается после open или close
+    int lastError() const { return lastError_; }
+    Stats stats() const;
+
+private:
+    struct Block;
+    struct Slot;
+
+    LogWriterOptions options_;
+    std::unique_ptr<OutputFile> file_;
+    uint64_t id_;                       // отличает писателя в кэше потоков от прежнего по тому же адресу
+
+    // MPSC-очередь заполненных блоков: потоки делают exchange головы, писатель читает с хвоста
+    std::atomic<Block*> head_;
+    Block* tail_;
+    std::unique_ptr<Block> stub_;
+
+    // Буферы потоков: регистрируются один раз на поток
+    std::mutex slotsMutex_;
+    std::unordered_map<std::thread::id, std::unique_ptr<Slot>> slots_;
+
+    // Свободные блоки: берутся раз на заполненный блок, а не на строку
+    std::mutex freeMutex_;
+    std::vector<Block*> freeBlocks_;
+
+    std::thread writer_;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> failed_{false};
+    int lastError_ = 0;
+
+    std::atomic<uint64_t> lines_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> syncs_{0};
+
+    Slot& threadSlot();
+    Block* reserve(Slot& slot, size_t length);
+    void commit(Slot& slot, size_t length);
+    Block* takeBlock(size_t capacity);
+    void push(Block* block);
+    void submit(Block* block);
+    Block* pop();
+    void run();
+    void writeBlocks(std::vector<Block*>& blocks);
+    static int64_t nowMs();
+};
@@ -0,0 +1,109 @@
+#include "scan_metrics.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+const char* const STAGE_NAMES[] = {"open", "read", "hash"};
+
+void appendLine(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length > 0) {
+        out.append(line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+    }
+}
+
+void appendHistogram(std::string& out, const char* name, const std::string& labels, const LatencyHistogram& histogram) {
+    const char* comma = labels.empty() ? "" : ",";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKETS; ++i) {
+        cumulative += histogram.counts[i];
+        appendLine(out, "%s_bucket{%s%sle=\"%.9g\"} %llu\n", name, labels.c_str(), comma,
+                   static_cast<double>(LatencyHistogram::bucketLimitNs(i)) / 1e9,
+                   static_cast<unsigned long long>(cumulative));
+    }
+    appendLine(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels.c_str(), comma,
+               static_cast<unsigned long long>(histogram.count));
+    appendLine(out, "%s_sum{%s} %.9g\n", name, labels.c_str(), static_cast<double>(histogram.totalNs) / 1e9);
+    appendLine(out, "%s_count{%s} %llu\n", name, labels.c_str(), static_cast<unsigned long long>(histogram.count));
+}
+
+void appendCounter(std::string& out, const char* name, const char* type, const char* help, double value) {
+    appendLine(out, "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name, type, name, value);
+}
+
+}
+
+std::string formatPrometheus(const ScanMetrics& metrics, uint64_t malware, uint64_t errors) {
+    std::string out;
+    appendCounter(out, "scanner_elapsed_seconds", "gauge", "Time since the scan started", metrics.elapsed);
+    appendCounter(out, "scanner_directories_total", "counter", "Directories read",
+                  static_cast<double>(metrics.directories));
+    appendCounter(out, "scanner_files_found_total", "counter", "Files found by the traversal",
+                  static_cast<double>(metrics.filesFound));
+    appendCounter(out, "scanner_files_done_total", "counter", "Files with a final outcome",
+                  static_cast<double>(metrics.filesDone));
+    appendCounter(out, "scanner_bytes_hashed_total", "counter", "Bytes read and hashed",
+                  static_cast<double>(metrics.bytesHashed));
+    appendCounter(out, "scanner_batches_total", "counter", "File batches processed",
+                  static_cast<double>(metrics.batches));
+    appendCounter(out, "scanner_malware_total", "counter", "Malware files found", static_cast<double>(malware));
+    appendCounter(out, "scanner_errors_total", "counter", "Unreadable files and directories",
+                  static_cast<double>(errors));
+    appendCounter(out, "scanner_list_seconds_total", "counter", "Thread time spent reading directories",
+                  static_cast<double>(metrics.listNs) / 1e9);
+    appendCounter(out, "scanner_queue_depth", "gauge", "Tasks queued in the thread pool",
+                  static_cast<double>(metrics.queueDepth));
+    appendCounter(out, "scanner_queue_depth_max", "gauge", "Largest queue depth seen at a batch",
+                  static_cast<double>(metrics.queueDepthMax));
+    if (metrics.ioThreads) {
+        appendCounter(out, "scanner_io_threads", "gauge", "Active threads reading files",
+                      static_cast<double>(metrics.ioThreads));
+        appendCounter(out, "scanner_hash_threads", "gauge", "Active threads hashing files read into memory",
+                      static_cast<double>(metrics.hashThreads));
+        appendCounter(out, "scanner_thread_adjustments_total", "counter", "Thread count changes",
+                      static_cast<double>(metrics.threadAdjustments));
+        appendCounter(out, "scanner_read_busy_seconds_total", "counter", "Thread time spent reading files",
+                      static_cast<double>(metrics.readBusyNs) / 1e9);
+        appendCounter(out, "scanner_hash_busy_seconds_total", "counter", "Thread time spent hashing files",
+                      static_cast<double>(metrics.hashBusyNs) / 1e9);
+    }
+
+    out += "# HELP scanner_files_hashed_total Files hashed, by size class\n"
+           "# TYPE scanner_files_hashed_total counter\n";
+    for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+        appendLine(out, "scanner_files_hashed_total{size=\"%s\"} %llu\n", sizeClassName(static_cast<SizeClass>(c)),
+                   static_cast<unsigned long long>(metrics.bySize[c].files));
+    }
+
+    if (!metrics.timings) {
+        return out;
+    }
+    out += "# HELP scanner_file_stage_seconds Per-file open, read and hash time, by size class\n"
+           "# TYPE scanner_file_stage_seconds histogram\n";
+    for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+        const FileStageMetrics& stage = metrics.bySize[c];
+        const LatencyHistogram* histograms[] = {&stage.open, &stage.read, &stage.hash};
+        for (size_t s = 0; s < 3; ++s) {
+            std::string labels = std::string("stage=\"") + STAGE_NAMES[s] + "\",size=\"" +
+                                 sizeClassName(static_cast<SizeClass>(c)) + "\"";
+            appendHistogram(out, "scanner_file_stage_seconds", labels, *histograms[s]);
+        }
+    }
+    out += "# HELP scanner_stage_seconds Per-file time of the other scan stages\n"
+           "# TYPE scanner_stage_seconds histogram\n";
+    const std::pair<const char*, const LatencyHistogram*> stages[] = {
+        {"stat", &metrics.stat}, {"cache", &metrics.cache}, {"prefix", &metrics.prefix},
+        {"lookup", &metrics.lookup}, {"log", &metrics.log},
+    };
+    for (const auto& stage : stages) {
+        appendHistogram(out, "scanner_stage_seconds", std::string("stage=\"") + stage.first + "\"", *stage.second);
+    }
+    return out;
+}
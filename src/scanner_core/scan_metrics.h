@@ -0,0 +1,154 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "scanner_api.h"
+
+// Монотонное время в наносекундах для замеров стадий
+inline uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * Гистограмма задержек по степеням двойки: корзина i - до 2^i нс,
+ * последняя собирает все, что дольше ~2 с
+ */
+struct LatencyHistogram {
+    static constexpr size_t BUCKETS = 32;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t count = 0;
+    uint64_t totalNs = 0;
+
+    static size_t bucketOf(uint64_t ns) {
+        if (ns <= 1) {
+            return 0;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        size_t bucket = 64 - static_cast<size_t>(__builtin_clzll(ns - 1));
+#else
+        size_t bucket = 0;
+        for (uint64_t v = ns - 1; v; v >>= 1) {
+            bucket++;
+        }
+#endif
+        return bucket < BUCKETS ? bucket : BUCKETS - 1;
+    }
+
+    // Верхняя граница корзины; у последней ее нет
+    static uint64_t bucketLimitNs(size_t bucket) { return uint64_t(1) << bucket; }
+
+    void add(uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        count++;
+        totalNs += ns;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        count += other.count;
+        totalNs += other.totalNs;
+    }
+
+    // Оценка квантиля сверху: граница корзины, в которую он попал
+    uint64_t quantileNs(double q) const {
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return bucketLimitNs(i);
+            }
+        }
+        return count ? bucketLimitNs(BUCKETS - 1) : 0;
+    }
+
+    double meanNs() const { return count ? static_cast<double>(totalNs) / static_cast<double>(count) : 0.0; }
+};
+
+// Классы размеров файлов, по которым разбиты задержки чтения и хеширования
+enum class SizeClass { Under4K, Under64K, Under1M, Under16M, Larger };
+constexpr size_t SIZE_CLASSES = 5;
+
+inline SizeClass sizeClassOf(uint64_t size) {
+    if (size < 4 * 1024) return SizeClass::Under4K;
+    if (size < 64 * 1024) return SizeClass::Under64K;
+    if (size < 1024 * 1024) return SizeClass::Under1M;
+    if (size < 16 * 1024 * 1024) return SizeClass::Under16M;
+    return SizeClass::Larger;
+}
+
+// Метка класса в отчетах: верхняя граница размера
+inline const char* sizeClassName(SizeClass sizeClass) {
+    switch (sizeClass) {
+    case SizeClass::Under4K: return "4KiB";
+    case SizeClass::Under64K: return "64KiB";
+    case SizeClass::Under1M: return "1MiB";
+    case SizeClass::Under16M: return "16MiB";
+    case SizeClass::Larger: return "inf";
+    }
+    return "unknown";
+}
+
+// Прочитанные файлы одного класса размеров
+struct FileStageMetrics {
+    uint64_t files = 0;
+    uint64_t bytes = 0;
+    LatencyHistogram open;      // открытие (с io_uring - от постановки в очередь до завершения)
+    LatencyHistogram read;      // все чтения файла
+    LatencyHistogram hash;      // доля времени SIMD-ядра, приходящаяся на файл
+};
+
+/**
+ * Метрики сканирования. Счетчики собираются всегда, задержки стадий -
+ * только с ScanOptions::collectTimings
+ */
+struct ScanMetrics {
+    double elapsed = 0.0;
+    bool timings = false;
+
+    // Обход
+    uint64_t directories = 0;
+    uint64_t entries = 0;
+    uint64_t filesFound = 0;
+    uint64_t listNs = 0;            // суммарно по потокам, без пачек, хешированных при обходе
+
+    // Файлы
+    uint64_t filesDone = 0;         // файлов с любым исходом
+    uint64_t bytesHashed = 0;
+    uint64_t batches = 0;
+    FileStageMetrics bySize[SIZE_CLASSES];
+    LatencyHistogram stat;
+    LatencyHistogram cache;         // поиск и сохранение в кэше дайджестов
+    LatencyHistogram prefix;        // проверка ключа префикса
+    LatencyHistogram lookup;        // поиск дайджеста в базе
+    LatencyHistogram log;           // запись в лог и поток результатов
+
+    // Глубина очереди пула в задачах, замеряется при каждой пачке
+    uint64_t queueDepth = 0;        // в момент снимка
+    uint64_t queueDepthMax = 0;
+    uint64_t queueDepthSum = 0;
+
+    // Раздельные пулы (ThreadModel::Split); без них нули
+    uint64_t ioThreads = 0;         // активных потоков чтения в момент снимка
+    uint64_t hashThreads = 0;       // активных потоков хеширования
+    uint64_t threadAdjustments = 0; // изменений числа потоков за сканирование
+    uint64_t filesRead = 0;         // файлов, прошедших стадию чтения
+    uint64_t filesFromMemory = 0;   // из них захешировано из памяти потоками хеширования
+    uint64_t readBusyNs = 0;        // суммарно по потокам: стадия чтения
+    uint64_t hashBusyNs = 0;        // суммарно по потокам: стадия хеширования
+
+    double filesPerSecond() const { return elapsed > 0 ? static_cast<double>(filesDone) / elapsed : 0.0; }
+    double bytesPerSecond() const { return elapsed > 0 ? static_cast<double>(bytesHashed) / elapsed : 0.0; }
+    double averageQueueDepth() const {
+        return batches ? static_cast<double>(queueDepthSum) / static_cast<double>(batches) : 0.0;
+    }
+};
+
+// Метрики в текстовом формате Prometheus (для textfile collector node_exporter)
+SCANNER_API std::string formatPrometheus(const ScanMetrics& metrics, uint64_t malware, uint64_t errors);
@@ -0,0 +1,412 @@
+#include "scan_result_stream.h"
+#include "file_io.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char RESULT_MAGIC[8] = {'S', 'C', 'A', 'N', 'R', 'E', 'S', '\x1a'};
+
+struct ResultStreamHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+};
+
+// Кадр блока, который пишет ScanLogWriter в режиме framed
+struct FrameHeader {
+    uint32_t payloadSize;
+    uint32_t records;
+};
+
+const uint8_t STATUS_MASK = 0x07;
+const uint8_t FLAG_DIGEST = 0x08;
+const uint8_t FLAG_SIZE = 0x10;
+const uint8_t FLAG_CACHED = 0x20;
+const uint8_t FLAG_EXTRA_DIGESTS = 0x40;
+
+// Дополнительные дайджесты записи: все, кроме MD5
+const DigestMask EXTRA_DIGESTS = DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3;
+
+const size_t MAX_VARINT = 10;
+// Запись без пути и вердикта: флаги, четыре varint и дайджесты
+const size_t MAX_FIXED_RECORD = 1 + 5 * MAX_VARINT + 16 + 1 + 20 + 32 + 8;
+
+void appendHex(std::string& out, const uint8_t* data, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; ++i) {
+        out += hex[data[i] >> 4];
+        out += hex[data[i] & 0x0f];
+    }
+}
+
+uint8_t* putVarint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+bool getVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* statusName(FileStatus status) {
+    switch (status) {
+    case FileStatus::Clean: return "clean";
+    case FileStatus::Malware: return "malware";
+    case FileStatus::Error: return "error";
+    case FileStatus::SkippedBySize: return "size_skipped";
+    case FileStatus::RejectedByPrefix: return "prefix_rejected";
+    }
+    return "unknown";
+}
+
+void appendJsonString(std::string& out, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (u < 0x20) {
+            out += "\\u00";
+            out += hex[u >> 4];
+            out += hex[u & 0x0f];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+}
+
+ScanResultWriter::ScanResultWriter(ResultFormat format, const LogWriterOptions& options)
+    : format_(format),
+      log_([&]() {
+          LogWriterOptions logOptions = options;
+          logOptions.framed = format == ResultFormat::Binary;
+          return logOptions;
+      }()) {
+}
+
+ScanResultWriter::~ScanResultWriter() = default;
+
+bool ScanResultWriter::open(const std::string& path, std::string* error) {
+    if (format_ != ResultFormat::Binary) {
+        return log_.open(path, std::string_view(), error);
+    }
+    ResultStreamHeader header;
+    std::memcpy(header.magic, RESULT_MAGIC, sizeof(header.magic));
+    header.version = ScanResultReader::FORMAT_VERSION;
+    header.headerSize = sizeof(header);
+    return log_.open(path, std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)), error);
+}
+
+bool ScanResultWriter::close(std::string* error) {
+    return log_.close(error);
+}
+
+void ScanResultWriter::append(const FileRecord& record) {
+    std::string* previous = nullptr;
+    if (format_ == ResultFormat::Ndjson) {
+        thread_local std::string line;
+        line.clear();
+        appendJson(record, line);
+        char* out = log_.beginRecord(line.size(), previous);
+        std::memcpy(out, line.data(), line.size());
+        log_.commitRecord(line.size());
+        return;
+    }
+
+    size_t maxSize = MAX_FIXED_RECORD + record.path.size() + record.verdict.size();
+    uint8_t* start = reinterpret_cast<uint8_t*>(log_.beginRecord(maxSize, previous));
+    uint8_t* out = start;
+
+    const DigestMask extra = record.hasDigest ? record.extraDigests & EXTRA_DIGESTS : 0;
+    uint8_t flags = static_cast<uint8_t>(record.status) & STATUS_MASK;
+    if (record.hasDigest) flags |= FLAG_DIGEST;
+    if (extra) flags |= FLAG_EXTRA_DIGESTS;
+    if (record.hasSize) flags |= FLAG_SIZE;
+    if (record.cached) flags |= FLAG_CACHED;
+    *out++ = flags;
+
+    size_t limit = std::min(previous->size(), record.path.size());
+    size_t shared = 0;
+    while (shared < limit && (*previous)[shared] == record.path[shared]) {
+        shared++;
+    }
+    size_t suffix = record.path.size() - shared;
+    out = putVarint(out, shared);
+    out = putVarint(out, suffix);
+    std::memcpy(out, record.path.data() + shared, suffix);
+    out += suffix;
+
+    if (record.hasSize) {
+        out = putVarint(out, record.size);
+    }
+    if (record.hasDigest) {
+        std::memcpy(out, record.digest.data(), record.digest.size());
+        out += record.digest.size();
+    }
+    if (extra) {
+        *out++ = static_cast<uint8_t>(extra);
+        if (extra & DIGEST_SHA1) {
+            std::memcpy(out, record.sha1.data(), record.sha1.size());
+            out += record.sha1.size();
+        }
+        if (extra & DIGEST_SHA256) {
+            std::memcpy(out, record.sha256.data(), record.sha256.size());
+            out += record.sha256.size();
+        }
+        if (extra & DIGEST_XXH3) {
+            std::memcpy(out, &record.xxh3, sizeof(record.xxh3));
+            out += sizeof(record.xxh3);
+        }
+    }
+    if (record.status == FileStatus::Malware) {
+        out = putVarint(out, record.verdict.size());
+        std::memcpy(out, record.verdict.data(), record.verdict.size());
+        out += record.verdict.size();
+    }
+    if (record.status == FileStatus::Error) {
+        out = putVarint(out, static_cast<uint32_t>(record.error));
+    }
+
+    previous->assign(record.path.data(), record.path.size());
+    log_.commitRecord(static_cast<size_t>(out - start));
+}
+
+void ScanResultWriter::appendJson(const FileRecord& record, std::string& out) {
+    out += "{\"path\":";
+    appendJsonString(out, record.path);
+    if (record.hasSize) {
+        out += ",\"size\":";
+        out += std::to_string(record.size);
+    }
+    if (record.hasDigest) {
+        out += ",\"md5\":\"";
+        appendHex(out, record.digest.data(), record.digest.size());
+        out += '"';
+        if (record.extraDigests & DIGEST_SHA1) {
+            out += ",\"sha1\":\"";
+            appendHex(out, record.sha1.data(), record.sha1.size());
+            out += '"';
+        }
+        if (record.extraDigests & DIGEST_SHA256) {
+            out += ",\"sha256\":\"";
+            appendHex(out, record.sha256.data(), record.sha256.size());
+            out += '"';
+        }
+        if (record.extraDigests & DIGEST_XXH3) {
+            // XXH3 печатается числом в hex, как у xxhsum
+            uint8_t xxh3[8];
+            for (int i = 0; i < 8; ++i) {
+                xxh3[i] = static_cast<uint8_t>(record.xxh3 >> (56 - 8 * i));
+            }
+            out += ",\"xxh3\":\"";
+            appendHex(out, xxh3, sizeof(xxh3));
+            out += '"';
+        }
+    }
+    out += ",\"status\":\"";
+    out += statusName(record.status);
+    out += '"';
+    if (record.cached) {
+        out += ",\"cached\":true";
+    }
+    if (record.status == FileStatus::Malware) {
+        out += ",\"verdict\":";
+        appendJsonString(out, record.verdict);
+    }
+    if (record.status == FileStatus::Error) {
+        out += ",\"error\":";
+        out += std::to_string(record.error);
+    }
+    out += "}\n";
+}
+
+ScanResultReader::ScanResultReader()
+    : file_(new MappedFile()) {
+}
+
+ScanResultReader::~ScanResultReader() = default;
+
+bool ScanResultReader::open(const std::string& path, std::string* error) {
+    pos_ = frameEnd_ = 0;
+    frameRecords_ = 0;
+    path_.clear();
+    records_ = 0;
+    truncated_ = false;
+    error_.clear();
+
+    if (!file_->open(path)) {
+        error_ = "Cannot open file: " + path;
+    } else {
+        ResultStreamHeader header;
+        if (file_->size() < sizeof(header)) {
+            error_ = "Not a result stream: " + path;
+        } else {
+            std::memcpy(&header, file_->data(), sizeof(header));
+            if (std::memcmp(header.magic, RESULT_MAGIC, sizeof(header.magic)) != 0) {
+                error_ = "Not a result stream: " + path;
+            } else if (header.version < 1 || header.version > FORMAT_VERSION) {
+                error_ = "Unsupported result stream version: " + std::to_string(header.version);
+            } else if (header.headerSize < sizeof(header) || header.headerSize > file_->size()) {
+                error_ = "Corrupted result stream header: " + path;
+            }
+        }
+    }
+    if (!error_.empty()) {
+        if (error) *error = error_;
+        file_->close();
+        return false;
+    }
+
+    ResultStreamHeader header;
+    std::memcpy(&header, file_->data(), sizeof(header));
+    pos_ = frameEnd_ = header.headerSize;
+    return true;
+}
+
+bool ScanResultReader::next(FileRecord& record) {
+    if (!file_->isOpen() || !error_.empty() || truncated_) {
+        return false;
+    }
+    const uint8_t* data = file_->data();
+    const size_t size = file_->size();
+
+    while (frameRecords_ == 0) {
+        if (pos_ != frameEnd_) {
+            return fail("Frame size does not match its records");
+        }
+        if (pos_ == size) {
+            return false;
+        }
+        FrameHeader frame;
+        if (size - pos_ < sizeof(frame)) {
+            truncated_ = true;
+            return false;
+        }
+        std::memcpy(&frame, data + pos_, sizeof(frame));
+        pos_ += sizeof(frame);
+        if (frame.payloadSize > size - pos_) {
+            truncated_ = true;
+            return false;
+        }
+        frameEnd_ = pos_ + frame.payloadSize;
+        frameRecords_ = frame.records;
+        path_.clear();
+    }
+
+    const uint8_t* in = data + pos_;
+    const uint8_t* end = data + frameEnd_;
+    if (in == end) {
+        return fail("Record outside of frame");
+    }
+    uint8_t flags = *in++;
+    if ((flags & STATUS_MASK) > static_cast<uint8_t>(FileStatus::RejectedByPrefix) ||
+        (flags & ~(STATUS_MASK | FLAG_DIGEST | FLAG_SIZE | FLAG_CACHED | FLAG_EXTRA_DIGESTS)) ||
+        ((flags & FLAG_EXTRA_DIGESTS) && !(flags & FLAG_DIGEST))) {
+        return fail("Unknown record flags");
+    }
+    record = FileRecord();
+    record.status = static_cast<FileStatus>(flags & STATUS_MASK);
+    record.hasDigest = (flags & FLAG_DIGEST) != 0;
+    record.hasSize = (flags & FLAG_SIZE) != 0;
+    record.cached = (flags & FLAG_CACHED) != 0;
+
+    uint64_t shared = 0;
+    uint64_t suffix = 0;
+    if (!getVarint(in, end, shared) || !getVarint(in, end, suffix) ||
+        shared > path_.size() || suffix > static_cast<uint64_t>(end - in)) {
+        return fail("Corrupted record path");
+    }
+    path_.resize(static_cast<size_t>(shared));
+    path_.append(reinterpret_cast<const char*>(in), static_cast<size_t>(suffix));
+    in += suffix;
+    record.path = path_;
+
+    if (record.hasSize && !getVarint(in, end, record.size)) {
+        return fail("Corrupted record size");
+    }
+    if (record.hasDigest) {
+        if (static_cast<size_t>(end - in) < record.digest.size()) {
+            return fail("Corrupted record digest");
+        }
+        std::memcpy(record.digest.data(), in, record.digest.size());
+        in += record.digest.size();
+    }
+    if (flags & FLAG_EXTRA_DIGESTS) {
+        if (in == end || (*in & ~EXTRA_DIGESTS)) {
+            return fail("Corrupted record digests");
+        }
+        record.extraDigests = *in++;
+        size_t need = ((record.extraDigests & DIGEST_SHA1) ? record.sha1.size() : 0) +
+                      ((record.extraDigests & DIGEST_SHA256) ? record.sha256.size() : 0) +
+                      ((record.extraDigests & DIGEST_XXH3) ? sizeof(record.xxh3) : 0);
+        if (static_cast<size_t>(end - in) < need) {
+            return fail("Corrupted record digests");
+        }
+        if (record.extraDigests & DIGEST_SHA1) {
+            std::memcpy(record.sha1.data(), in, record.sha1.size());
+            in += record.sha1.size();
+        }
+        if (record.extraDigests & DIGEST_SHA256) {
+            std::memcpy(record.sha256.data(), in, record.sha256.size());
+            in += record.sha256.size();
+        }
+        if (record.extraDigests & DIGEST_XXH3) {
+            std::memcpy(&record.xxh3, in, sizeof(record.xxh3));
+            in += sizeof(record.xxh3);
+        }
+    }
+    if (record.status == FileStatus::Malware) {
+        uint64_t length = 0;
+        if (!getVarint(in, end, length) || length > static_cast<uint64_t>(end - in)) {
+            return fail("Corrupted record verdict");
+        }
+        record.verdict = std::string_view(reinterpret_cast<const char*>(in), static_cast<size_t>(length));
+        in += length;
+    }
+    if (record.status == FileStatus::Error) {
+        uint64_t code = 0;
+        if (!getVarint(in, end, code)) {
+            return fail("Corrupted record error code");
+        }
+        record.error = static_cast<int>(static_cast<uint32_t>(code));
+    }
+
+    pos_ = static_cast<size_t>(in - data);
+    frameRecords_--;
+    records_++;
+    return true;
+}
+
+bool ScanResultReader::isResultFile(const std::string& path) {
+    InputFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    char magic[sizeof(RESULT_MAGIC)];
+    return file.read(magic, sizeof(magic)) == static_cast<int64_t>(sizeof(magic)) &&
+           std::memcmp(magic, RESULT_MAGIC, sizeof(magic)) == 0;
+}
+
+bool ScanResultReader::fail(const char* message) {
+    error_ = std::string(message) + " at offset " + std::to_string(pos_);
+    return false;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "digest_set.h"
+#include "md5.h"
+#include "scan_log_writer.h"
+#include "scanner_api.h"
+#include "scanner_core.h"
+
+class MappedFile;
+
+// Чем закончилась проверка файла
+enum class FileStatus : uint8_t {
+    Clean = 0,
+    Malware = 1,
+    Error = 2,              // файл не открылся или не прочитался
+    SkippedBySize = 3,      // не читался: сигнатур такого размера в базе нет
+    RejectedByPrefix = 4    // прочитан только префикс, его ключа в базе нет
+};
+
+// Запись потока результатов. Строки у записи, прочитанной ScanResultReader,
+// смотрят в его буферы и живут до следующего next()
+struct FileRecord {
+    std::string_view path;
+    FileStatus status = FileStatus::Clean;
+    bool hasSize = false;       // stat удался
+    uint64_t size = 0;
+    bool hasDigest = false;
+    MD5Digest digest{};
+    DigestMask extraDigests = 0;    // какие дайджесты кроме MD5 посчитаны (при hasDigest)
+    SHA1Digest sha1{};
+    SHA256Digest sha256{};
+    uint64_t xxh3 = 0;
+    bool cached = false;        // дайджест взят из кэша, файл не читался
+    std::string_view verdict;   // только у Malware
+    int error = 0;              // errno (GetLastError на Windows), только у Error
+};
+
+/**
+ * Поток результатов сканирования: запись на каждый файл, включая чистые.
+ * Пишется через ScanLogWriter, то есть буферами потоков и отдельным
+ * писателем, в одном из двух форматов.
+ *
+ * NDJSON - объект на строку:
+ *   {"path":"...","size":N,"md5":"...","sha1":"...","sha256":"...","xxh3":"...",
+ *    "status":"clean","cached":true,"verdict":"...","error":N}
+ * Неизвестные и неприменимые поля опускаются; байты пути не проверяются
+ * на UTF-8, экранируются только кавычки, '\' и управляющие символы.
+ *
+ * Двоичный формат - заголовок (8 байт "SCANRES\x1a", uint32 версия,
+ * uint32 размер заголовка), затем кадры буферов потоков: uint32 размер
+ * данных, uint32 число записей, записи. Запись:
+ *   uint8 флаги: биты 0-2 статус, 3 - есть дайджест, 4 - есть размер, 5 - из кэша,
+ *   6 - есть дополнительные дайджесты;
+ *   varint общая длина пути с предыдущей записью кадра, varint длина остатка, остаток;
+ *   [varint размер] [16 байт MD5] [uint8 маска, 20 байт SHA-1, 32 байта SHA-256,
+ *   uint64 XXH3 - только алгоритмы маски] [varint длина вердикта, вердикт] [varint код ошибки].
+ * Словарем путей служит предыдущая запись кадра: файлы одной пачки лежат
+ * в одном каталоге и повторяют его путь. Кадры независимы, поэтому
+ * оборванный при падении последний кадр не портит остальные.
+ * Все поля little-endian.
+ */
+class SCANNER_API ScanResultWriter {
+public:
+    explicit ScanResultWriter(ResultFormat format, const LogWriterOptions& options = LogWriterOptions());
+    ~ScanResultWriter();
+    ScanResultWriter(const ScanResultWriter&) = delete;
+    ScanResultWriter& operator=(const ScanResultWriter&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr);
+
+    // Можно вызывать из любых потоков
+    void append(const FileRecord& record);
+
+    void poll() { log_.poll(); }
+    void flush() { log_.flush(); }
+    bool close(std::string* error = nullptr);
+
+    ResultFormat format() const { return format_; }
+    int lastError() const { return log_.lastError(); }
+    ScanLogWriter::Stats stats() const { return log_.stats(); }
+
+    // Запись в виде строки NDJSON с переводом строки
+    static void appendJson(const FileRecord& record, std::string& out);
+
+private:
+    ResultFormat format_;
+    ScanLogWriter log_;
+};
+
+/**
+ * Читает двоичный поток результатов через отображение файла.
+ * Оборванный последний кадр (писатель не успел его дописать) считается
+ * концом потока: next() возвращает false, а truncated() - true.
+ */
+class SCANNER_API ScanResultReader {
+public:
+    // Версия 2 добавила бит 6 флагов; файлы версии 1 читаются как есть
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    ScanResultReader();
+    ~ScanResultReader();
+    ScanResultReader(const ScanResultReader&) = delete;
+    ScanResultReader& operator=(const ScanResultReader&) = delete;
+
+    bool open(const std::string& path, std::string* error = nullptr);
+
+    // false - записи кончились или файл поврежден (тогда error() не пуст)
+    bool next(FileRecord& record);
+
+    bool truncated() const { return truncated_; }
+    const std::string& error() const { return error_; }
+    uint64_t records() const { return records_; }
+
+    // Начинается ли файл с заголовка двоичного потока результатов
+    static bool isResultFile(const std::string& path);
+
+private:
+    std::unique_ptr<MappedFile> file_;
+    size_t pos_ = 0;
+    size_t frameEnd_ = 0;
+    uint32_t frameRecords_ = 0;     // записей кадра еще не прочитано
+    std::string path_;              // путь текущей записи, по нему восстанавливается следующий
+    uint64_t records_ = 0;
+    bool truncated_ = false;
+    std::string error_;
+
+    bool fail(const char* message);
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef _WIN32
+#ifdef SCANNER_CORE_EXPORTS
+#define SCANNER_API __declspec(dllexport)
+#else
+#define SCANNER_API __declspec(dllimport)
+#endif
+#else
+#define SCANNER_API __attribute__((visibility("default")))
+#endif
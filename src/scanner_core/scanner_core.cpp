@@ -1,7 +1,9 @@
+#include <cerrno>
 #include <filesystem>
 #include <fstream>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
 #include <atomic>
 #include <chrono>
@@ -10,211 +12,1604 @@
 #include <functional>
 #include <stdexcept>
 #include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <set>
 #include "md5_calculator.h"
+#include "md5_multibuffer.h"
+#include "uring_file_hasher.h"
+#include "work_stealing_pool.h"
+#include "directory_walker.h"
+#include "signature_index.h"
+#include "signature_base.h"
+#include "csv_base_loader.h"
+#include "scan_cache.h"
+#include "scan_log_writer.h"
+#include "scan_result_stream.h"
+#include "metrics_collector.h"
+#include "content_dedup.h"
+#include "file_watcher.h"
+#include "rescan_queue.h"
+#include "numa_topology.h"
+#include "storage_profile.h"
+#include "thread_controller.h"
 // #include <openssl/md5.h>
 // #include <openssl/evp.h>  // todo
 
-#include "scanner_core.h"
+#ifndef SCANNER_CORE_EXPORTS
 #define SCANNER_CORE_EXPORTS
+#endif
+#include "scanner_core.h"
 
 namespace fs = std::filesystem;
 
-class ThreadPool {
+namespace {
+
+// Замер одной стадии файла; без включенных замеров часы не читаются
+class StageTimer {
 public:
-    ThreadPool(size_t threadCount) 
-        : ThreadPoolSize_(threadCount),
-          wait_(true),
-          finish_(false) {
-        for (size_t i = 0; i < threadCount; ++i) {
-            threads_.emplace_back([this]() { this->ThreadFunction(); });
+    explicit StageTimer(MetricsCollector::Histogram* histogram)
+        : histogram_(histogram), start_(histogram ? monotonicNs() : 0) {}
+
+    ~StageTimer() {
+        if (histogram_) {
+            histogram_->add(monotonicNs() - start_);
         }
     }
-    
-    void PushTask(const std::function<void()>& task) {
-        if (finish_) {
-            throw std::runtime_error("ThreadPool is finished");
-        }
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            tasks_.push(task);
-        }
-        taskPushed_.notify_one();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+    MetricsCollector::Histogram* histogram_;
+    uint64_t start_;
+};
+
+// Файл метрик подменяется целиком: сборщик не должен увидеть его недописанным
+bool writeMetricsFile(const std::string& path, const std::string& text) {
+    std::string tempPath = path + ".tmp";
+    OutputFile file;
+    bool written = file.open(tempPath, true) && file.write(text.data(), text.size());
+    file.close();
+    if (!written || !OutputFile::replace(tempPath, path)) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+
+class ScannerCore : public IScannerCore {
+private:
+    SignatureBase signatures;
+    BaseLoadStats loadStats;
+    mutable std::mutex baseMutex;       // загрузки и дельты идут по одному
+    ScanOptions options;
+    ProgressCallback progressCallback;
+    std::unique_ptr<WorkStealingPool> workers;
+    PathBatchPool pathBatches;          // пачки путей живут между сканированиями, как и пул
+    // Раздельная модель: пул чтения и пулы хеширования по узлам NUMA, тоже между сканированиями
+    struct HashNode;
+    std::unique_ptr<WorkStealingPool> readers;
+    std::vector<std::unique_ptr<HashNode>> hashNodes;
+    size_t hashLimit = 0;               // потоков хеширования во всех узлах
+    std::atomic<size_t> hashCursor{0};  // узел для следующей пачки чтения
+    std::mutex scanMutex;               // сканирования идут по одному: пул общий
+    WatchCallback watchCallback;
+    struct WatchSession;
+    std::unique_ptr<WatchSession> watch;
+    std::mutex watchMutex;
+    // Открытые файлы кэша: сканирование и наблюдение идут независимо и не должны
+    // открыть один кэш дважды, иначе commit одного переписал бы записи другого
+    std::mutex cachesMutex;
+    std::set<std::string> openCaches;
+
+public:
+    ~ScannerCore() override {
+        stopWatch();
+    }
+
+    void setScanOptions(const ScanOptions& scanOptions) override {
+        options = scanOptions;
     }
 
-    void Terminate(bool wait) {
-        std::unique_lock<std::mutex> lock(mutex_);
+    void setProgressCallback(ProgressCallback callback) override {
+        progressCallback = std::move(callback);
+    }
 
-        finish_ = true;
-        wait_ = wait;
-        
-        if (wait_){
-            TerminateWait_.wait(lock, [this]() { return tasks_.empty(); });
+    // загружает базу вредоносных хешей: двоичная база отображается в память,
+    // CSV разбирается в индекс двоичных дайджестов. Сигнатуры добавляются
+    // к уже загруженным, новый снимок базы публикуется целиком
+    bool loadMalwareBase(const std::string& basePath) override {
+        std::lock_guard<std::mutex> lock(baseMutex);
+        SignatureIndex index;
+        BaseLoadStats stats = loadStats;
+        if (!loadIndex(basePath, index, stats)) {
+            return false;
         }
-        
-        taskPushed_.notify_all();
-        lock.unlock();
+        stats.duplicates += signatures.extend(std::move(index));
+        loadStats = stats;
+        return true;
+    }
 
-        for (auto& thread: threads_){
-            thread.join();
+    // База строится в вызывающем потоке, сканирования идут по старой до публикации
+    bool reloadMalwareBase(const std::string& basePath) override {
+        std::lock_guard<std::mutex> lock(baseMutex);
+        SignatureIndex index;
+        BaseLoadStats stats;
+        if (!loadIndex(basePath, index, stats)) {
+            return false;
         }
+        signatures.replace(std::move(index));
+        loadStats = stats;
+        return true;
     }
 
-    bool IsActive() const {
-        std::unique_lock<std::mutex> lock(mutex_);
-        return !finish_;
+    bool applyBaseDelta(const std::string& deltaPath) override {
+        std::lock_guard<std::mutex> lock(baseMutex);
+        SignatureIndex added;
+        std::vector<MD5Digest> removed;
+        CsvBaseLoader::Stats stats;
+        CsvLoadOptions csvOptions;
+        csvOptions.threads = 1;
+        csvOptions.prefixLength = signatures.acquire()->prefixLength();
+        if (!CsvBaseLoader::loadDelta(deltaPath, added, removed, csvOptions, &stats)) {
+            return false;
+        }
+        addCsvStats(loadStats, stats);
+        loadStats.removed += signatures.applyDelta(added, removed);
+        return true;
     }
 
-    size_t QueueSize() const {
-        std::unique_lock<std::mutex> lock_(mutex_);
-        return tasks_.size();
+    bool compileMalwareBase(const std::string& outputPath) override {
+        return signatures.merged()->save(outputPath);
     }
-    
-private:
-    mutable std::mutex mutex_;
-    std::condition_variable taskPushed_;
-    std::condition_variable TerminateWait_;
-    size_t ThreadPoolSize_;
-    bool wait_;
-    bool finish_;
-
-    std::queue<std::function<void()>> tasks_;
-    std::vector<std::thread> threads_;
-    
-    void ThreadFunction() {
-        while (true) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(mutex_);
-                taskPushed_.wait(lock, [this]() { return finish_ || !tasks_.empty(); });
 
-                if (finish_ && (tasks_.empty() || !wait_)) {
-                    if (wait_ && tasks_.empty()) {
-                        TerminateWait_.notify_one();
+    BaseLoadStats getLoadStats() const override {
+        std::lock_guard<std::mutex> lock(baseMutex);
+        BaseLoadStats stats = loadStats;
+        SignatureBase::Reader base = signatures.acquire();
+        stats.fileSizes = base->hasSizeFilter() ? base->fileSizeCount() : 0;
+        stats.prefixKeys = base->prefixKeyCount();
+        stats.prefixLength = stats.prefixKeys ? base->prefixLength() : 0;
+        stats.version = base->version();
+        stats.algorithms = base->algorithms();
+        return stats;
+    }
+
+    // main функция сканирования: обход дерева и хеширование идут одновременно
+    ScanResult scanDirectory(const std::string& rootPath, const std::string& logPath) override {
+        std::vector<ScanTarget> targets(1);
+        targets[0].root = rootPath;
+        return scanBatch(targets, logPath).total;
+    }
+
+    // Цели сканируются в общем пуле: корни ставятся в него все сразу, и пока
+    // одни цели дочитывают последние файлы, другие уже обходятся
+    BatchScanResult scanBatch(const std::vector<ScanTarget>& targets, const std::string& logPath) override {
+        std::lock_guard<std::mutex> scanLock(scanMutex);
+        auto start = std::chrono::high_resolution_clock::now();
+        uint64_t startNs = monotonicNs();
+        BatchScanResult batch;
+        batch.targets.resize(targets.size());
+        ScanResult& result = batch.total;
+
+        // Найденные файлы пишутся через буферы потоков и отдельный поток-писатель
+        LogWriterOptions logOptions;
+        logOptions.flushIntervalMs = options.logFlushIntervalMs;
+        logOptions.durability = options.logDurability;
+        ScanLogWriter logFile(logOptions);
+        if (!logFile.open(logPath, "file_path;hash;verdict\n")) {
+            result.errors++;
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> duration = end - start;
+            result.duration = duration.count();
+            return batch;
+        }
+
+        // Поток результатов по всем файлам идет тем же путем, что и лог, но своим писателем
+        std::unique_ptr<ScanResultWriter> results;
+        if (options.resultFormat != ResultFormat::None && !options.resultPath.empty()) {
+            results.reset(new ScanResultWriter(options.resultFormat, logOptions));
+            if (!results->open(options.resultPath)) {
+                logFile.close();
+                result.errors++;
+                auto end = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> duration = end - start;
+                result.duration = duration.count();
+                return batch;
+            }
+        }
+
+        // Кэш дайджестов между запусками. Поврежденный кэш не мешает
+        // сканированию: он начинается пустым и переписывается при сохранении
+        std::unique_ptr<ScanCache> cache;
+        std::string cacheKey;
+        if (!options.cachePath.empty()) {
+            cacheKey = cacheKeyOf(options.cachePath);
+            if (claimCache(cacheKey)) {
+                cache.reset(new ScanCache());
+                cache->open(options.cachePath);
+            } else {
+                // Кэш открыт наблюдением: сканирование идет без него
+                result.errors++;
+            }
+        }
+
+        // Таблица общего содержимого одна на пакет: ссылки могут вести и в другую цель
+        std::unique_ptr<ContentDedup> dedup;
+        if (options.dedupHardLinks || options.dedupExtents) {
+            dedup.reset(new ContentDedup());
+        }
+
+        // Каталоги обходятся параллельно задачами того же пула; каждой задаче
+        // хеширования достается пачка файлов на все SIMD-дорожки воркера,
+        // а с io_uring - на всю глубину его очереди
+        const MD5MultiBufferKernel& kernel = MD5MultiBuffer::best();
+        bool useUring = options.ioEngine == IoEngine::Uring && UringFileHasher::supported();
+        size_t batchSize = useUring ? UringFileHasher::DEFAULT_QUEUE_DEPTH * URING_BATCH_DEPTHS
+                                    : kernel.lanes * FILES_PER_LANE;
+        // С io_uring поток не блокируется на чтении, и пул остается один.
+        // В раздельной модели обход и чтение идут в пуле чтения, а
+        // хеширование - в пулах узлов NUMA
+        const bool split = options.threadModel == ThreadModel::Split && !useUring;
+        if (split) {
+            prepareSplitPools();
+        }
+        WorkStealingPool& threadPool = split ? *readers : workerPool();
+        MetricsCollector metrics(options.collectTimings);
+        WalkOptions walkOptions;
+        walkOptions.maxDepth = options.maxDepth;
+        walkOptions.followSymlinks = options.followSymlinks;
+
+        // Файл, измененный после начала обхода, может еще писаться: его не отображаем
+        ReadOptions readOptions;
+        readOptions.directIo = options.directIo;
+        readOptions.mapLargeFiles = options.mapLargeFiles;
+        readOptions.stableBeforeNs = ScanCache::now();
+
+        // У каждой цели свои счетчики и свой обход; лог, кэш и метрики общие
+        std::vector<std::unique_ptr<TargetScan>> scans;
+        scans.reserve(targets.size());
+        for (size_t t = 0; t < targets.size(); ++t) {
+            scans.emplace_back(new TargetScan{
+                ScanState{logFile, results.get(), metrics, options.collectTimings, useUring, cache.get(),
+                          dedup.get(), options.sizeFilter, options.prefixCheck, nullptr},
+                nullptr});
+            ScanState& state = scans.back()->state;
+            state.readOptions = readOptions;
+            scans.back()->walker.reset(new ParallelDirectoryWalker(threadPool, walkOptions, batchSize,
+                [&, &state = state](PathBatch& paths) {
+                    // Глубина очереди замеряется перед пачкой: сколько работы ждет за ней
+                    uint64_t queueDepth = threadPool.QueueSize();
+                    // Файлы, ушедшие на хеширование, засчитает стадия хеширования
+                    size_t done = paths.size();
+                    if (split) {
+                        done -= readBatch(paths, state);
+                    } else {
+                        processBatch(paths, state);
                     }
-                    return;
+                    MetricsCollector::ThreadMetrics& local = metrics.local();
+                    local.batches.add(1);
+                    local.filesDone.add(done);
+                    local.queueDepthMax.max(queueDepth);
+                    local.queueDepthSum.add(queueDepth);
+                    // Строки, застрявшие в буфере потока, уходят в файл по интервалу сброса
+                    logFile.poll();
+                    if (state.results) {
+                        state.results->poll();
+                    }
+                }, &pathBatches));
+        }
+
+        // Раздельная модель: потоков чтения сначала по профилю хранилища
+        // первой цели, хеширования - по ядрам; дальше, если число не задано,
+        // их подстраивает контроллер
+        std::unique_ptr<ThreadController> controller;
+        std::atomic<uint64_t> adjustments{0};
+        if (split) {
+            size_t io = options.ioThreads;
+            if (io == 0) {
+                StorageProfile profile = StorageProfile::probe(storagePathOf(targets));
+                io = profile.initialIoThreads(NumaTopology::system().cpuCount(), readers->ThreadCount());
+            }
+            readers->SetActiveThreads(io);
+            setHashThreads(hashLimit);
+            bool tuneIo = options.ioThreads == 0;
+            bool tuneHash = options.hashThreads == 0;
+            if (options.adaptiveThreads && (tuneIo || tuneHash)) {
+                ThreadController::Limits limits;
+                limits.minIo = tuneIo ? 1 : io;
+                limits.maxIo = tuneIo ? readers->ThreadCount() : io;
+                limits.minHash = tuneHash ? hashNodes.size() : hashLimit;
+                limits.maxHash = hashLimit;
+                controller.reset(new ThreadController(limits, io, hashLimit));
+            }
+        }
+
+        // Снимок хода сканирования: счетчики потоков, обход и очередь пула
+        auto progressOf = [&](ScanProgress& progress) {
+            progress.metrics = ScanMetrics();
+            metrics.snapshot(progress.metrics);
+            for (const auto& scan : scans) {
+                const ParallelDirectoryWalker::Stats& walk = scan->walker->stats();
+                progress.metrics.directories += walk.directories;
+                progress.metrics.entries += walk.entries;
+                progress.metrics.filesFound += walk.files;
+                progress.metrics.listNs += walk.listNs;
+                progress.malwareFiles += static_cast<uint64_t>(scan->state.malwareFound);
+                progress.errors += walk.errors + static_cast<uint64_t>(scan->state.fileErrors);
+            }
+            progress.metrics.queueDepth = threadPool.QueueSize();
+            if (split) {
+                progress.metrics.ioThreads = readers->ActiveThreads();
+                progress.metrics.hashThreads = activeHashThreads();
+                progress.metrics.threadAdjustments = adjustments.load(std::memory_order_relaxed);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+            progress.metrics.elapsed = elapsed.count();
+        };
+
+        // Отчеты о ходе идут из отдельного потока: воркеры только пишут свои счетчики
+        ProgressCallback callback = progressCallback;
+        const bool reporting = callback || !options.metricsPath.empty();
+        ScanProgress lastProgress;
+        auto report = [&](bool finished) {
+            ScanProgress progress;
+            progressOf(progress);
+            progress.finished = finished;
+            double interval = progress.metrics.elapsed - lastProgress.metrics.elapsed;
+            if (interval > 0) {
+                progress.filesPerSecond =
+                    static_cast<double>(progress.metrics.filesDone - lastProgress.metrics.filesDone) / interval;
+                progress.bytesPerSecond =
+                    static_cast<double>(progress.metrics.bytesHashed - lastProgress.metrics.bytesHashed) / interval;
+            }
+            lastProgress = progress;
+            bool written = options.metricsPath.empty() ||
+                writeMetricsFile(options.metricsPath,
+                                 formatPrometheus(progress.metrics, progress.malwareFiles, progress.errors));
+            if (callback) {
+                callback(progress);
+            }
+            return written;
+        };
+
+        std::mutex reportMutex;
+        std::condition_variable reportWake;
+        bool walkFinished = false;
+        std::thread reporter;
+        if (reporting) {
+            reporter = std::thread([&]() {
+                auto interval = std::chrono::milliseconds(std::max<uint32_t>(1, options.progressIntervalMs));
+                std::unique_lock<std::mutex> lock(reportMutex);
+                while (!reportWake.wait_for(lock, interval, [&]() { return walkFinished; })) {
+                    lock.unlock();
+                    report(false);
+                    lock.lock();
                 }
+            });
+        }
+        std::thread tuner;
+        if (controller) {
+            tuner = std::thread([&]() {
+                auto interval = std::chrono::milliseconds(CONTROL_INTERVAL_MS);
+                std::unique_lock<std::mutex> lock(reportMutex);
+                while (!reportWake.wait_for(lock, interval, [&]() { return walkFinished; })) {
+                    lock.unlock();
+                    if (controller->update(sampleOf(metrics, startNs))) {
+                        readers->SetActiveThreads(controller->ioThreads());
+                        setHashThreads(controller->hashThreads());
+                        adjustments.store(controller->adjustments(), std::memory_order_relaxed);
+                    }
+                    lock.lock();
+                }
+            });
+        }
 
-                task = tasks_.front();
-                tasks_.pop();
+        // Постановка ждет места в ограниченной очереди пула, так что
+        // тысячи целей не копятся в памяти задачами
+        for (size_t t = 0; t < targets.size(); ++t) {
+            if (!targets[t].root.empty()) {
+                scans[t]->walker->start(targets[t].root);
+            }
+            if (!targets[t].files.empty()) {
+                scans[t]->walker->startFiles(targets[t].files);
+            }
+        }
+        threadPool.WaitIdle();
+        // Пул чтения пуст, значит все пачки уже в очередях хеширования
+        if (split) {
+            for (const auto& node : hashNodes) {
+                node->pool->WaitIdle();
             }
-            
-            task();
         }
+
+        if (reporter.joinable() || tuner.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(reportMutex);
+                walkFinished = true;
+            }
+            reportWake.notify_all();
+            if (reporter.joinable()) {
+                reporter.join();
+            }
+            if (tuner.joinable()) {
+                tuner.join();
+            }
+        }
+
+        if (!logFile.close()) {
+            result.errors++;
+        }
+        if (results) {
+            if (!results->close()) {
+                result.errors++;
+            }
+            result.resultRecords = results->stats().lines;
+            result.resultBytes = results->stats().bytes;
+        }
+        if (cache) {
+            if (!cache->commit(options.pruneCache)) {
+                result.errors++;
+            }
+            cache.reset();
+            releaseCache(cacheKey);
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> duration = end - start;
+
+        for (size_t t = 0; t < targets.size(); ++t) {
+            ScanResult& target = batch.targets[t];
+            resultOf(*scans[t], startNs, target);
+            result.totalFiles += target.totalFiles;
+            result.malwareFiles += target.malwareFiles;
+            result.errors += target.errors;
+            result.cachedFiles += target.cachedFiles;
+            result.cacheMismatches += target.cacheMismatches;
+            result.sizeSkippedFiles += target.sizeSkippedFiles;
+            result.sizeSkippedBytes += target.sizeSkippedBytes;
+            result.prefixRejectedFiles += target.prefixRejectedFiles;
+            result.prefixSkippedBytes += target.prefixSkippedBytes;
+            result.linkedFiles += target.linkedFiles;
+            result.linkedBytes += target.linkedBytes;
+        }
+        result.duration = duration.count();
+
+        ScanProgress summary;
+        progressOf(summary);
+        result.metrics = summary.metrics;
+        if (reporting && !report(true)) {
+            result.errors++;
+        }
+
+        return batch;
+    }
+
+    bool startWatch(const std::vector<std::string>& roots, const std::string& logPath,
+                    const WatchOptions& watchOptions) override {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        if (watch || roots.empty()) {
+            return false;
+        }
+        std::unique_ptr<WatchSession> session(new WatchSession(watchOptions));
+        if (!session->watcher.open(roots, watchOptions.backend)) {
+            int error = session->watcher.lastError();
+            session.reset();
+            errno = error;
+            return false;
+        }
+        for (const std::string& root : roots) {
+            session->roots.push_back(FileWatcher::canonicalRoot(root));
+        }
+
+        LogWriterOptions logOptions;
+        logOptions.flushIntervalMs = options.logFlushIntervalMs;
+        logOptions.durability = options.logDurability;
+        session->logFile.reset(new ScanLogWriter(logOptions));
+        if (!session->logFile->open(logPath, "file_path;hash;verdict\n")) {
+            int error = session->logFile->lastError();
+            session.reset();
+            errno = error;
+            return false;
+        }
+        if (options.resultFormat != ResultFormat::None && !options.resultPath.empty()) {
+            session->results.reset(new ScanResultWriter(options.resultFormat, logOptions));
+            if (!session->results->open(options.resultPath)) {
+                int error = session->results->lastError();
+                session->logFile->close();
+                session.reset();
+                errno = error;
+                return false;
+            }
+        }
+        if (!options.cachePath.empty()) {
+            std::string cacheKey = cacheKeyOf(options.cachePath);
+            if (!claimCache(cacheKey)) {
+                session->logFile->close();
+                if (session->results) {
+                    session->results->close();
+                }
+                session.reset();
+                errno = EBUSY;
+                return false;
+            }
+            session->cacheKey = cacheKey;
+            session->cache.reset(new ScanCache());
+            session->cache->open(options.cachePath);
+        }
+
+        // Таблицы общего содержимого нет: ее итоги устаревают, как только файл перезаписан
+        const MD5MultiBufferKernel& kernel = MD5MultiBuffer::best();
+        bool useUring = options.ioEngine == IoEngine::Uring && UringFileHasher::supported();
+        session->batchSize = useUring ? UringFileHasher::DEFAULT_QUEUE_DEPTH * URING_BATCH_DEPTHS
+                                      : kernel.lanes * FILES_PER_LANE;
+        WatchSession* current = session.get();
+        session->callback = watchCallback;
+        session->metrics.reset(new MetricsCollector(options.collectTimings));
+        session->state.reset(new ScanState{*session->logFile, session->results.get(), *session->metrics,
+                                           options.collectTimings, useUring, session->cache.get(), nullptr,
+                                           options.sizeFilter, options.prefixCheck,
+                                           [current](const FileRecord& record) { current->verdict(record); }});
+        // Наблюдаемые файлы обычно еще пишутся другими процессами
+        session->state->readOptions.directIo = options.directIo;
+        session->state->readOptions.filesMayChange = true;
+
+        unsigned int numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 1;
+        session->pool.reset(new WorkStealingPool(numThreads, numThreads * QUEUE_TASKS_PER_THREAD));
+        session->walkOptions.maxDepth = options.maxDepth;
+        session->walkOptions.followSymlinks = options.followSymlinks;
+        session->rescanRequested = watchOptions.initialScan;
+        session->startNs = monotonicNs();
+        session->thread = std::thread([this, current]() { runWatch(*current); });
+        watch = std::move(session);
+        return true;
+    }
+
+    WatchStats stopWatch() override {
+        std::unique_ptr<WatchSession> session;
+        {
+            std::lock_guard<std::mutex> lock(watchMutex);
+            session = std::move(watch);
+        }
+        if (!session) {
+            return WatchStats();
+        }
+        session->stopping = true;
+        session->watcher.wake();
+        session->thread.join();
+
+        // Файлы, ждущие срока, проверяются сразу; пока идет проверка, они могут вернуться в очередь
+        do {
+            dispatchDue(*session, std::numeric_limits<uint64_t>::max());
+            session->pool->WaitIdle();
+        } while (session->queue.pending() > 0);
+
+        WatchStats stats = statsOf(*session);
+        if (!session->logFile->close()) {
+            stats.errors++;
+        }
+        if (session->results && !session->results->close()) {
+            stats.errors++;
+        }
+        if (session->cache) {
+            if (!session->cache->commit(false)) {
+                stats.errors++;
+            }
+            session->cache.reset();
+            releaseCache(session->cacheKey);
+        }
+        return stats;
+    }
+
+    WatchStats getWatchStats() override {
+        std::lock_guard<std::mutex> lock(watchMutex);
+        return watch ? statsOf(*watch) : WatchStats();
+    }
+
+    void setWatchCallback(WatchCallback callback) override {
+        watchCallback = std::move(callback);
     }
-};
 
-class ScannerCore : public IScannerCore {
 private:
-    std::unordered_map<std::string, std::string> malwareHashes;
-    std::mutex logMutex;
-    
-    struct FileTask {
-        std::string path;  // полный путь
-        std::string relativePath;  // путь от корня 
-    };
+    // сколько файлов на одну SIMD-дорожку выдается в задаче
+    static constexpr size_t FILES_PER_LANE = 4;
+    // пачка для io_uring - несколько глубин очереди, чтобы очередь не пустела к концу пачки
+    static constexpr size_t URING_BATCH_DEPTHS = 2;
+    // глубина очереди пула в задачах на поток
+    static constexpr size_t QUEUE_TASKS_PER_THREAD = 4;
+    // потоков чтения раздельной модели, если их число не задано; лишние спят
+    static constexpr size_t MAX_AUTO_IO_THREADS = 64;
+    // файл не больше этого поток чтения кладет в память, крупный читается потоково при хешировании
+    static constexpr uint64_t IN_MEMORY_LIMIT = 256 * 1024;
+    // байт файлов в памяти на пачку чтения: ограничивает память пачек в очередях
+    static constexpr size_t MEMORY_PER_JOB = 2 * 1024 * 1024;
+    // как часто контроллер пересматривает число потоков
+    static constexpr uint32_t CONTROL_INTERVAL_MS = 100;
+    // как часто поток наблюдения проверяет, можно ли начать отложенное пересканирование
+    static constexpr int64_t RESCAN_POLL_NS = 50 * 1000 * 1000;
 
-public:
-    // загружает базу вредоносных хешей в мапу
-    bool loadMalwareBase(const std::string& csvPath) override {
-        std::ifstream file(csvPath);
-        if (!file.is_open()) {
+    // Пул создается при первом сканировании и живет до уничтожения сканера.
+    // Ограниченные очереди: обход не убегает вперед хеширования,
+    // у каждого воркера не больше numThreads * QUEUE_TASKS_PER_THREAD задач
+    WorkStealingPool& workerPool() {
+        if (!workers) {
+            unsigned int numThreads = std::thread::hardware_concurrency();
+            if (numThreads == 0) numThreads = 1;
+            workers.reset(new WorkStealingPool(numThreads, numThreads * QUEUE_TASKS_PER_THREAD));
+        }
+        return *workers;
+    }
+
+    // Пулы раздельной модели создаются на наибольшее число потоков и
+    // пересоздаются, только если оно задано другим. Потоки хеширования
+    // делятся между узлами NUMA поровну и привязываются к ядрам своего узла
+    void prepareSplitPools() {
+        const NumaTopology& topology = NumaTopology::system();
+        size_t ioLimit = options.ioThreads ? options.ioThreads : MAX_AUTO_IO_THREADS;
+        if (!readers || readers->ThreadCount() != ioLimit) {
+            // Очередь как у общего пула: емкость дека - на каждого воркера, и
+            // очередь на все 64 потока держала бы в памяти сотни пачек обхода
+            size_t queue = std::min(ioLimit, topology.cpuCount()) * QUEUE_TASKS_PER_THREAD;
+            readers.reset(new WorkStealingPool(ioLimit, queue));
+        }
+        size_t limit = options.hashThreads ? options.hashThreads : topology.cpuCount();
+        if (!hashNodes.empty() && hashLimit == limit) {
+            return;
+        }
+        hashNodes.clear();
+        hashLimit = limit;
+        bool numa = topology.nodeCount() > 1;
+        size_t nodes = std::min(topology.nodeCount(), limit);
+        for (size_t n = 0; n < nodes; ++n) {
+            size_t threads = limit / nodes + (n < limit % nodes ? 1 : 0);
+            std::unique_ptr<HashNode> node(new HashNode());
+            node->numaNode = numa ? topology.node(n).id : -1;
+            node->queueCapacity = threads * QUEUE_TASKS_PER_THREAD;
+            WorkStealingPool::ThreadStart pin;
+            if (numa) {
+                NumaTopology::Node cpus = topology.node(n);
+                pin = [cpus](size_t) { NumaTopology::pinCurrentThread(cpus); };
+            }
+            node->pool.reset(new WorkStealingPool(threads, node->queueCapacity, pin));
+            hashNodes.push_back(std::move(node));
+        }
+    }
+
+    // Активные потоки хеширования делятся между узлами, в каждом хотя бы один
+    void setHashThreads(size_t total) {
+        size_t nodes = hashNodes.size();
+        for (size_t n = 0; n < nodes; ++n) {
+            hashNodes[n]->pool->SetActiveThreads(std::max<size_t>(1, total / nodes + (n < total % nodes ? 1 : 0)));
+        }
+    }
+
+    size_t activeHashThreads() const {
+        size_t threads = 0;
+        for (const auto& node : hashNodes) {
+            threads += node->pool->ActiveThreads();
+        }
+        return threads;
+    }
+
+    // Замер для контроллера потоков: счетчики стадий и очереди пулов
+    ThreadController::Sample sampleOf(MetricsCollector& metrics, uint64_t startNs) const {
+        ScanMetrics snapshot;
+        metrics.snapshot(snapshot);
+        ThreadController::Sample sample;
+        sample.elapsedNs = monotonicNs() - startNs;
+        sample.filesDone = snapshot.filesDone;
+        sample.filesRead = snapshot.filesRead;
+        sample.readNs = snapshot.readBusyNs;
+        sample.filesHashed = snapshot.filesFromMemory;
+        sample.hashNs = snapshot.hashBusyNs;
+        sample.readBacklog = readers->QueueSize();
+        for (const auto& node : hashNodes) {
+            sample.hashBacklog += node->pool->QueueSize();
+            sample.hashCapacity += node->queueCapacity;
+        }
+        return sample;
+    }
+
+    // Путь, по которому определяется хранилище пакета
+    static std::string storagePathOf(const std::vector<ScanTarget>& targets) {
+        for (const ScanTarget& target : targets) {
+            if (!target.root.empty()) {
+                return target.root;
+            }
+            if (!target.files.empty()) {
+                return target.files.front();
+            }
+        }
+        return ".";
+    }
+
+    // Путь кэша, по которому сравниваются открытые кэши
+    static std::string cacheKeyOf(const std::string& path) {
+        std::error_code error;
+        fs::path absolute = fs::absolute(path, error);
+        return (error ? fs::path(path) : absolute).lexically_normal().string();
+    }
+
+    // false - кэш уже открыт сканированием или наблюдением
+    bool claimCache(const std::string& key) {
+        std::lock_guard<std::mutex> lock(cachesMutex);
+        return openCaches.insert(key).second;
+    }
+
+    void releaseCache(const std::string& key) {
+        std::lock_guard<std::mutex> lock(cachesMutex);
+        openCaches.erase(key);
+    }
+    // CSV разбирается параллельно прямо из отображения файла; двоичная база
+    // не разбирается: поиск идет прямо по отображенному файлу, а страницы
+    // делятся через page cache между всеми процессами сканера
+    bool loadIndex(const std::string& basePath, SignatureIndex& index, BaseLoadStats& stats) {
+        if (SignatureIndex::isDatabaseFile(basePath)) {
+            if (!index.openMapped(basePath)) {
+                return false;
+            }
+            stats.signatures += index.size();
+            return true;
+        }
+        CsvBaseLoader::Stats csvStats;
+        CsvLoadOptions csvOptions;
+        csvOptions.prefixLength = options.prefixLength;
+        if (!CsvBaseLoader::load(basePath, index, csvOptions, &csvStats)) {
             return false;
         }
+        addCsvStats(stats, csvStats);
+        return true;
+    }
 
-        std::string line;
-        while (std::getline(file, line)) {
-            size_t delimiterPos = line.find(';');
-            if (delimiterPos != std::string::npos) {
-                std::string hash = line.substr(0, delimiterPos);
-                std::string verdict = line.substr(delimiterPos + 1);
-                malwareHashes[hash] = verdict;
+    static void addCsvStats(BaseLoadStats& stats, const CsvBaseLoader::Stats& csvStats) {
+        stats.signatures += csvStats.signatures;
+        stats.lines += csvStats.lines;
+        stats.malformed += csvStats.malformed;
+        stats.duplicates += csvStats.duplicates;
+        stats.uppercase += csvStats.uppercase;
+        stats.emptyLines += csvStats.emptyLines;
+    }
+
+    // Состояние одного сканирования, общее для задач пула
+    struct ScanState {
+        ScanLogWriter& logFile;
+        ScanResultWriter* results;      // nullptr - пишется только лог найденных файлов
+        MetricsCollector& metrics;
+        bool timing;                    // замерять задержки стадий
+        bool useUring;
+        ScanCache* cache;               // nullptr - сканирование без кэша
+        ContentDedup* dedup;            // nullptr - каждый путь читается сам
+        bool filterBySize;              // отсеивать по размеру, если у всех сигнатур он известен
+        bool checkPrefix;               // отсеивать по ключу префикса, если в базе они есть
+        // Каждая запись о файле, и без потока результатов (режим наблюдения)
+        std::function<void(const FileRecord& record)> onRecord;
+        ReadOptions readOptions = ReadOptions();  // способ чтения файлов блокирующими хешерами
+        std::atomic<int> malwareFound{0};
+        std::atomic<int> fileErrors{0};
+        std::atomic<int> cachedFiles{0};
+        std::atomic<int> cacheMismatches{0};
+        std::atomic<int> sizeSkippedFiles{0};
+        std::atomic<uint64_t> sizeSkippedBytes{0};
+        std::atomic<int> prefixRejectedFiles{0};
+        std::atomic<uint64_t> prefixSkippedBytes{0};
+        std::atomic<int> linkedFiles{0};
+        std::atomic<uint64_t> linkedBytes{0};
+        // Раздельная модель: когда пул хеширования закончил последнюю пачку цели.
+        // Обход к этому времени уже завершен, и итог цели считается по нему
+        std::atomic<uint64_t> hashedNs{0};
+
+        // Гистограмма стадии в блоке метрик текущего потока; nullptr без замеров
+        MetricsCollector::Histogram* stage(MetricsCollector::Histogram MetricsCollector::ThreadMetrics::* histogram) {
+            return timing ? &(metrics.local().*histogram) : nullptr;
+        }
+    };
+
+    using Stage = MetricsCollector::ThreadMetrics;
+
+    // Одна цель пакетного сканирования
+    struct TargetScan {
+        ScanState state;
+        std::unique_ptr<ParallelDirectoryWalker> walker;
+    };
+
+    // Наблюдение: поток событий ставит файлы в очередь и раздает созревшие
+    // пачками в свой пул, чтобы сканирования scanBatch шли независимо
+    struct WatchSession {
+        WatchOptions watchOptions;
+        std::vector<std::string> roots;     // канонические пути, в них же приходят события
+        FileWatcher watcher;
+        RescanQueue queue;
+        std::unique_ptr<ScanLogWriter> logFile;
+        std::unique_ptr<ScanResultWriter> results;
+        std::unique_ptr<ScanCache> cache;
+        std::string cacheKey;               // занятый сессией путь кэша (cacheKeyOf)
+        std::unique_ptr<MetricsCollector> metrics;
+        std::unique_ptr<ScanState> state;
+        std::unique_ptr<WorkStealingPool> pool;
+        WalkOptions walkOptions;
+        size_t batchSize = 0;
+        WatchCallback callback;
+        std::thread thread;
+        std::atomic<bool> stopping{false};
+        uint64_t startNs = 0;
+
+        // Пересканирования корней: начальная проверка и переполнения очереди ядра
+        std::vector<std::unique_ptr<ParallelDirectoryWalker>> rescans;
+        std::mutex rescansMutex;            // список дополняет поток наблюдения, читает statsOf
+        bool rescanRequested = false;
+        std::atomic<uint64_t> overflows{0};
+
+        std::atomic<uint64_t> filesScanned{0};
+        std::atomic<uint64_t> vanished{0};
+        std::atomic<uint64_t> readErrors{0};
+        std::mutex latencyMutex;
+        LatencyHistogram latency;
+
+        explicit WatchSession(const WatchOptions& options)
+            : watchOptions(options),
+              queue(static_cast<uint64_t>(options.debounceUs) * 1000,
+                    static_cast<uint64_t>(options.maxDelayMs) * 1000000) {}
+
+        // Вердикт по файлу: файл снимается с очереди (или возвращается в нее,
+        // если при проверке пришли события), задержка считается от первого события
+        void verdict(const FileRecord& record) {
+            uint64_t now = monotonicNs();
+            uint64_t firstNs = 0;
+            if (queue.finish(std::string(record.path), firstNs)) {
+                watcher.wake();
+            }
+            uint64_t latencyNs = firstNs && now > firstNs ? now - firstNs : 0;
+            filesScanned++;
+            if (record.status == FileStatus::Error && record.error == ENOENT) {
+                vanished++;
+            }
+            if (firstNs) {
+                std::lock_guard<std::mutex> lock(latencyMutex);
+                latency.add(latencyNs);
+            }
+            if (callback) {
+                callback(record, latencyNs);
+            }
+        }
+    };
+
+    // Поток наблюдения: ждет событий до срока ближайшего файла, созревшие
+    // файлы отдает пулу. Пересканирование после переполнения начинается,
+    // когда закончено предыдущее
+    void runWatch(WatchSession& session) {
+        std::vector<FileEvent> events;
+        while (!session.stopping) {
+            if (session.rescanRequested && rescansFinished(session)) {
+                session.rescanRequested = false;
+                startRescan(session);
+            }
+            uint64_t now = monotonicNs();
+            dispatchDue(session, now);
+
+            uint64_t next = session.queue.nextDueNs();
+            int64_t timeoutNs = -1;
+            if (next != std::numeric_limits<uint64_t>::max()) {
+                timeoutNs = next > now ? static_cast<int64_t>(next - now) : 0;
+            }
+            // Пересканирование ждет своей очереди без событий - проверять его по таймеру
+            if (session.rescanRequested && (timeoutNs < 0 || timeoutNs > RESCAN_POLL_NS)) {
+                timeoutNs = RESCAN_POLL_NS;
+            }
+            events.clear();
+            if (!session.watcher.read(events, timeoutNs)) {
+                session.readErrors++;
+                break;
+            }
+            for (FileEvent& event : events) {
+                switch (event.type) {
+                case FileEvent::Type::Changed:
+                    session.queue.touch(event.path, event.timeNs);
+                    break;
+                case FileEvent::Type::Removed:
+                    session.queue.cancel(event.path);
+                    break;
+                case FileEvent::Type::Overflow:
+                    session.overflows++;
+                    session.rescanRequested = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Созревшие файлы делятся между воркерами: при малой нагрузке каждому
+    // достается несколько файлов, и вердикт не ждет чужой пачки
+    void dispatchDue(WatchSession& session, uint64_t nowNs) {
+        thread_local std::vector<std::string> due;
+        size_t threads = session.pool->ThreadCount();
+        for (;;) {
+            due.clear();
+            if (session.queue.popDue(nowNs, session.batchSize * threads, due) == 0) {
+                return;
+            }
+            size_t chunk = std::min(session.batchSize, (due.size() + threads - 1) / threads);
+            for (size_t first = 0; first < due.size(); first += chunk) {
+                size_t last = std::min(due.size(), first + chunk);
+                PathBatch paths;
+                for (size_t i = first; i < last; ++i) {
+                    paths.push_back(std::move(due[i]));
+                }
+                session.pool->PushTask([this, &session, paths = std::move(paths)]() mutable {
+                    watchBatch(paths, session);
+                });
+            }
+        }
+    }
+
+    void watchBatch(const PathBatch& paths, WatchSession& session) {
+        processBatch(paths, *session.state);
+        MetricsCollector::ThreadMetrics& local = session.metrics->local();
+        local.batches.add(1);
+        local.filesDone.add(paths.size());
+        // Найденный файл должен попасть в лог сразу, а не когда поток возьмет следующую пачку
+        session.logFile->flush();
+        if (session.results) {
+            session.results->flush();
+        }
+    }
+
+    static bool rescansFinished(const WatchSession& session) {
+        for (const auto& walker : session.rescans) {
+            if (walker->stats().finishedNs == 0) {
+                return false;
             }
         }
         return true;
     }
 
-    // main функция сканирования
-    ScanResult scanDirectory(const std::string& rootPath, const std::string& logPath) override {
-        auto start = std::chrono::high_resolution_clock::now();
-        ScanResult result;
-        
-        std::vector<FileTask> fileTasks;
-        try {
-            for (const auto& entry : fs::recursive_directory_iterator(rootPath)) {
-                if (entry.is_regular_file()) {
-                    FileTask task;
-                    task.path = entry.path().string();
-                    task.relativePath = fs::relative(entry.path(), rootPath).string();
-                    fileTasks.push_back(task);
+    void startRescan(WatchSession& session) {
+        std::lock_guard<std::mutex> lock(session.rescansMutex);
+        for (const std::string& root : session.roots) {
+            session.rescans.emplace_back(new ParallelDirectoryWalker(*session.pool, session.walkOptions,
+                session.batchSize, [this, &session](PathBatch& paths) {
+                    watchBatch(paths, session);
+                }, &pathBatches));
+            session.rescans.back()->start(root);
+        }
+    }
+
+    WatchStats statsOf(WatchSession& session) {
+        WatchStats stats;
+        RescanQueue::Stats queue = session.queue.stats();
+        FileWatcher::Stats watcher = session.watcher.stats();
+        stats.backend = session.watcher.backend();
+        stats.events = queue.events;
+        stats.coalesced = queue.coalesced;
+        stats.cancelled = queue.cancelled;
+        stats.overflows = session.overflows;
+        stats.filesScanned = session.filesScanned;
+        stats.malwareFiles = static_cast<uint64_t>(session.state->malwareFound);
+        stats.vanished = session.vanished;
+        uint64_t fileErrors = static_cast<uint64_t>(session.state->fileErrors);
+        stats.errors = (fileErrors > stats.vanished ? fileErrors - stats.vanished : 0) + watcher.errors +
+                       session.readErrors;
+        {
+            std::lock_guard<std::mutex> lock(session.rescansMutex);
+            for (const auto& walker : session.rescans) {
+                stats.errors += walker->stats().errors;
+            }
+        }
+        stats.pending = session.queue.pending();
+        {
+            std::lock_guard<std::mutex> lock(session.latencyMutex);
+            stats.latency = session.latency;
+        }
+        session.metrics->snapshot(stats.metrics);
+        stats.metrics.queueDepth = session.pool->QueueSize();
+        stats.metrics.elapsed = static_cast<double>(monotonicNs() - session.startNs) / 1e9;
+        return stats;
+    }
+
+    // Итоги цели; metrics - только ее обход
+    static void resultOf(const TargetScan& scan, uint64_t startNs, ScanResult& result) {
+        const ScanState& state = scan.state;
+        const ParallelDirectoryWalker::Stats& walk = scan.walker->stats();
+        result.totalFiles = static_cast<int>(walk.files);
+        result.malwareFiles = state.malwareFound;
+        result.errors = static_cast<int>(walk.errors) + state.fileErrors;
+        result.cachedFiles = state.cachedFiles;
+        result.cacheMismatches = state.cacheMismatches;
+        result.sizeSkippedFiles = state.sizeSkippedFiles;
+        result.sizeSkippedBytes = state.sizeSkippedBytes;
+        result.prefixRejectedFiles = state.prefixRejectedFiles;
+        result.prefixSkippedBytes = state.prefixSkippedBytes;
+        result.linkedFiles = state.linkedFiles;
+        result.linkedBytes = state.linkedBytes;
+        uint64_t finishedNs = std::max<uint64_t>(walk.finishedNs, state.hashedNs);
+        result.duration = finishedNs > startNs ? static_cast<double>(finishedNs - startNs) / 1e9 : 0.0;
+        result.metrics.directories = walk.directories;
+        result.metrics.entries = walk.entries;
+        result.metrics.filesFound = walk.files;
+        result.metrics.listNs = walk.listNs;
+    }
+
+    // Файл, который придется прочитать, и что о нем известно из кэша
+    struct PendingFile {
+        FileStamp stamp;
+        bool stamped;                   // stat удался, дайджест можно сохранить
+        bool cached;                    // в кэше есть все нужные дайджесты (при перепроверке)
+        FileDigests cachedDigests;
+        bool contentOwner = false;      // первый путь к содержимому: его итог ждут остальные
+        ContentKey content;
+    };
+
+    // digests == nullptr - файл не прочитался, error - код ошибки;
+    // иначе length - число прочитанных байт, то есть размер файла
+    using DigestCallback = std::function<void(size_t index, const FileDigests* digests, int error, uint64_t length)>;
+
+    // Файл пачки чтения: где в буфере пачки лежит его содержимое
+    struct ReadSlot {
+        size_t offset = 0;
+        size_t size = 0;
+        FileTiming timing;              // открытие и чтение, если включены замеры
+    };
+
+    // Небольшие файлы, прочитанные потоком чтения для пула хеширования.
+    // Пачки переиспользуются: буфер дорастает до самой крупной и лежит в
+    // памяти узла NUMA, потоки которого ее хешируют
+    struct ReadJob {
+        explicit ReadJob(int node) : data(node) {}
+        PathBatch paths;
+        bool filtered = false;          // файлы прошли отбор, pending - что о них известно
+        std::vector<PendingFile> pending;
+        int64_t observedAt = 0;
+        std::vector<ReadSlot> slots;
+        NodeBuffer data;
+    };
+
+    // Узел NUMA раздельной модели: потоки хеширования на его ядрах и запас пачек
+    struct HashNode {
+        std::unique_ptr<WorkStealingPool> pool;
+        int numaNode = -1;              // -1 - узел один, память и потоки не привязываются
+        size_t queueCapacity = 0;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ReadJob>> spare;
+
+        std::unique_ptr<ReadJob> take() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (spare.empty()) {
+                return std::unique_ptr<ReadJob>(new ReadJob(numaNode));
+            }
+            std::unique_ptr<ReadJob> job = std::move(spare.back());
+            spare.pop_back();
+            return job;
+        }
+
+        void give(std::unique_ptr<ReadJob> job) {
+            std::lock_guard<std::mutex> lock(mutex);
+            spare.push_back(std::move(job));
+        }
+    };
+
+    // Файлы не читаются, если их размера нет среди сигнатур базы или если
+    // их метаданные не изменились: тогда дайджест берется из кэша и
+    // проверяется по базе. У крупного файла, все сигнатуры размера которого
+    // с ключом префикса, сначала читается только префикс. Остальные
+    // хешируются и попадают в кэш. Поток результатов получает запись
+    // о каждом файле; без stat размер файла берется из числа прочитанных байт.
+    // Снимок базы закрепляется на пачку: обновление базы подхватит следующая
+    void processBatch(const PathBatch& paths, ScanState& state) {
+        SignatureBase::Reader pinned = signatures.acquire();
+        const SignatureSnapshot& base = *pinned;
+        if (!needsSelection(base, state)) {
+            hashBatch(paths, state, digestsFor(base), [&](size_t index, const FileDigests* digests, int error,
+                                                          uint64_t length) {
+                finishFile(state, base, paths[index], nullptr, digests, error, length, 0);
+            });
+            return;
+        }
+
+        // Строки пачки потока живут между пачками: копия пути не выделяет память
+        thread_local PathBatch pendingPaths;
+        thread_local std::vector<PendingFile> pending;
+        int64_t observedAt = selectFiles(paths, base, state, pendingPaths, pending);
+        if (pendingPaths.empty()) {
+            return;
+        }
+        hashBatch(pendingPaths, state, digestsFor(base), [&](size_t index, const FileDigests* digests, int error,
+                                                             uint64_t length) {
+            finishFile(state, base, pendingPaths[index], &pending[index], digests, error, length, observedAt);
+        });
+    }
+
+    // Стадия чтения раздельной модели, в потоке чтения. Файлы отбираются,
+    // как в processBatch, небольшие читаются в буфер пачки и уходят в пул
+    // хеширования очередного узла (при полной очереди поток чтения ждет).
+    // Потоки хеширования не ждут хранилища: крупные файлы поток чтения
+    // хеширует сам, читая потоково, а ошибки открытия записывает сразу.
+    // Возвращает число файлов, отданных на хеширование
+    size_t readBatch(PathBatch& paths, ScanState& state) {
+        MetricsCollector::ThreadMetrics& local = state.metrics.local();
+        uint64_t start = monotonicNs();
+        thread_local PathBatch selected;
+        thread_local std::vector<PendingFile> pending;
+        const PathBatch* files = &paths;
+        bool filtered;
+        int64_t observedAt = 0;
+        {
+            SignatureBase::Reader pinned = signatures.acquire();
+            filtered = needsSelection(*pinned, state);
+            if (filtered) {
+                observedAt = selectFiles(paths, *pinned, state, selected, pending);
+                files = &selected;
+            }
+        }
+
+        thread_local std::vector<size_t> streamed;
+        thread_local std::vector<std::pair<size_t, int>> failed;
+        streamed.clear();
+        failed.clear();
+        size_t handed = 0;
+        size_t next = 0;
+        while (next < files->size()) {
+            HashNode& node = *hashNodes[hashCursor.fetch_add(1, std::memory_order_relaxed) % hashNodes.size()];
+            std::unique_ptr<ReadJob> job = node.take();
+            job->filtered = filtered;
+            job->observedAt = observedAt;
+            next = readFiles(*files, filtered ? &pending : nullptr, next, *job, state, streamed, failed);
+            if (job->paths.empty()) {
+                node.give(std::move(job));
+                continue;
+            }
+            handed += job->paths.size();
+            ReadJob* ready = job.release();
+            node.pool->PushTask([this, ready, &node, &state]() {
+                hashJob(std::unique_ptr<ReadJob>(ready), node, state);
+            });
+        }
+
+        if (!streamed.empty() || !failed.empty()) {
+            SignatureBase::Reader pinned = signatures.acquire();
+            const SignatureSnapshot& base = *pinned;
+            auto finish = [&](size_t index, const FileDigests* digests, int error, uint64_t length) {
+                finishFile(state, base, (*files)[index], filtered ? &pending[index] : nullptr,
+                           digests, error, length, observedAt);
+            };
+            for (const auto& file : failed) {
+                finish(file.first, nullptr, file.second, 0);
+            }
+            if (!streamed.empty()) {
+                thread_local PathBatch streamPaths;
+                streamPaths.clear();
+                for (size_t index : streamed) {
+                    streamPaths.push_back(std::string_view((*files)[index]));
                 }
+                hashBatch(streamPaths, state, digestsFor(base), [&finish](size_t index, const FileDigests* digests,
+                                                                          int error, uint64_t length) {
+                    finish(streamed[index], digests, error, length);
+                });
             }
-        } catch (const fs::filesystem_error& e) {
-            result.errors++;
         }
+        local.filesRead.add(files->size());
+        local.readBusyNs.add(monotonicNs() - start);
+        return handed;
+    }
+
+    // Читает файлы начиная с first в буфер пачки, пока он не наберет
+    // MEMORY_PER_JOB; крупные (streamed) и не открывшиеся (failed) остаются
+    // потоку чтения. Без отбора размер узнается только после открытия.
+    // Возвращает индекс первого файла, не попавшего в пачку
+    size_t readFiles(const PathBatch& files, const std::vector<PendingFile>* pending, size_t first,
+                     ReadJob& job, ScanState& state, std::vector<size_t>& streamed,
+                     std::vector<std::pair<size_t, int>>& failed) {
+        job.paths.clear();
+        job.pending.clear();
+        job.slots.clear();
+        size_t used = 0;
+        size_t i = first;
+        for (; i < files.size() && used < MEMORY_PER_JOB; ++i) {
+            // Размер крупного файла уже известен по stat отбора: файл не
+            // открывается здесь, чтобы потом снова открыться при хешировании
+            if (pending && (*pending)[i].stamped && (*pending)[i].stamp.size > IN_MEMORY_LIMIT) {
+                streamed.push_back(i);
+                continue;
+            }
+            uint64_t openStart = state.timing ? monotonicNs() : 0;
+            InputFile file;
+            if (!file.open(files[i])) {
+                failed.emplace_back(i, file.lastError());
+                continue;
+            }
+            uint64_t size = 0;
+            if (!file.regularSize(size) || size > IN_MEMORY_LIMIT || !job.data.reserve(used + size, used)) {
+                streamed.push_back(i);
+                continue;
+            }
+            uint64_t readStart = state.timing ? monotonicNs() : 0;
+            uint8_t* target = job.data.data() + used;
+            size_t got = 0;
+            while (got < size) {
+                int64_t bytesRead = file.read(target + got, static_cast<size_t>(size) - got);
+                if (bytesRead <= 0) {
+                    break;
+                }
+                got += static_cast<size_t>(bytesRead);
+            }
+            // Ошибка чтения записывается, как в потоковом хешировании: без дайджеста
+            if (got < size && file.lastError() != 0) {
+                failed.emplace_back(i, file.lastError());
+                continue;
+            }
+            ReadSlot slot;
+            slot.offset = used;
+            slot.size = got;
+            if (state.timing) {
+                slot.timing.openNs = readStart - openStart;
+                slot.timing.readNs = monotonicNs() - readStart;
+            }
+            job.paths.push_back(std::string_view(files[i]));
+            if (pending) {
+                job.pending.push_back((*pending)[i]);
+            }
+            job.slots.push_back(slot);
+            used += got;
+        }
+        return i;
+    }
 
-        result.totalFiles = fileTasks.size();
+    // Стадия хеширования, в потоке узла: файлы пачки идут из памяти в
+    // дорожки multi-buffer ядра. Снимок базы свой: пачка могла ждать в очереди
+    void hashJob(std::unique_ptr<ReadJob> job, HashNode& node, ScanState& state) {
+        MetricsCollector::ThreadMetrics& local = state.metrics.local();
+        uint64_t start = monotonicNs();
+        {
+            SignatureBase::Reader pinned = signatures.acquire();
+            const SignatureSnapshot& base = *pinned;
+            ReadJob& batch = *job;
+            thread_local std::vector<const uint8_t*> buffers;
+            thread_local std::vector<size_t> sizes;
+            buffers.clear();
+            sizes.clear();
+            for (const ReadSlot& slot : batch.slots) {
+                buffers.push_back(batch.data.data() + slot.offset);
+                sizes.push_back(slot.size);
+            }
 
-        if (fileTasks.empty()) {
-            auto end = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> duration = end - start;
-            result.duration = duration.count();
-            return result;
+            thread_local MultiBufferFileHasher memoryHasher;
+            auto hashed = [&](size_t index, const MD5Digest*) {
+                const ReadSlot& slot = batch.slots[index];
+                FileTiming timing = slot.timing;
+                timing.hashNs = memoryHasher.lastTiming().hashNs;
+                countHashed(state, local, slot.size, timing);
+                finishFile(state, base, batch.paths[index], batch.filtered ? &batch.pending[index] : nullptr,
+                           &memoryHasher.lastDigests(), 0, slot.size, batch.observedAt);
+            };
+            // std::function получает одну ссылку и не выделяет память на пачку
+            memoryHasher.setTiming(state.timing);
+            memoryHasher.setDigests(digestsFor(base));
+            memoryHasher.hashBuffers(buffers.data(), sizes.data(), buffers.size(),
+                [&hashed](size_t index, const MD5Digest* digest) { hashed(index, digest); });
+            local.filesDone.add(batch.paths.size());
+            local.filesFromMemory.add(batch.paths.size());
+        }
+        uint64_t end = monotonicNs();
+        local.hashBusyNs.add(end - start);
+        uint64_t hashed = state.hashedNs.load(std::memory_order_relaxed);
+        while (hashed < end && !state.hashedNs.compare_exchange_weak(hashed, end, std::memory_order_relaxed)) {
+        }
+        state.logFile.poll();
+        if (state.results) {
+            state.results->poll();
         }
+        node.give(std::move(job));
+    }
 
-        unsigned int numThreads = std::thread::hardware_concurrency();
-        if (numThreads == 0) numThreads = 1;
-        
-        ThreadPool threadPool(numThreads);
+    // Алгоритмы, которые считаются за проход по файлу: MD5, типы хешей
+    // сигнатур базы и запрошенные для кэша и потока результатов
+    DigestMask digestsFor(const SignatureSnapshot& base) const {
+        return DIGEST_MD5 | base.algorithms() | (options.digests & DIGEST_ALL);
+    }
 
-        std::ofstream logFile(logPath, std::ios::trunc);
-        if (!logFile.is_open()) {
-            result.errors++;
-            auto end = std::chrono::high_resolution_clock::now();  // todo
-            std::chrono::duration<double> duration = end - start;
-            result.duration = duration.count();
-            return result;
+    // Без кэша, общего содержимого и фильтров базы читаются все файлы пачки
+    static bool needsSelection(const SignatureSnapshot& base, const ScanState& state) {
+        return state.cache || state.dedup || (state.filterBySize && base.hasSizeFilter()) ||
+               (state.checkPrefix && base.hasPrefixKeys());
+    }
+
+    // Отбирает в selected и pending файлы, которые придется прочитать; остальные
+    // получают итог сразу. Возвращает время до stat: файл, измененный позже,
+    // не будет сохранен в кэш
+    int64_t selectFiles(const PathBatch& paths, const SignatureSnapshot& base, ScanState& state,
+                        PathBatch& selected, std::vector<PendingFile>& pending) {
+        bool filterBySize = state.filterBySize && base.hasSizeFilter();
+        bool checkPrefix = state.checkPrefix && base.hasPrefixKeys();
+        const DigestMask required = digestsFor(base);
+        selected.clear();
+        pending.clear();
+
+        int64_t observedAt = ScanCache::now();
+        for (const std::string& path : paths) {
+            PendingFile file;
+            {
+                StageTimer timer(state.stage(&Stage::stat));
+                file.stamped = ScanCache::stampOf(path, file.stamp);
+            }
+            if (filterBySize && file.stamped && !base.mayMatchSize(file.stamp.size)) {
+                state.sizeSkippedFiles++;
+                state.sizeSkippedBytes += file.stamp.size;
+                report(state, path, file, FileStatus::SkippedBySize);
+                continue;
+            }
+            file.cached = false;
+            if (file.stamped && state.cache) {
+                StageTimer timer(state.stage(&Stage::cache));
+                file.cached = state.cache->lookup(file.stamp, required, file.cachedDigests);
+            }
+            if (file.cached && !options.revalidateCache) {
+                state.cachedFiles++;
+                FileRecord record = recordOf(path, file);
+                record.cached = true;
+                checkDigest(path, file.cachedDigests, base, state, &record);
+                continue;
+            }
+            if (state.dedup && file.stamped && !file.cached && contentKeyOf(path, file.stamp, file.content)) {
+                // Путь копируется в обработчик, только если итога придется ждать:
+                // пачка путей к тому времени будет переиспользована
+                ContentDedup::Result shared;
+                ContentDedup::Claim claim = state.dedup->tryClaim(file.content, shared);
+                if (claim == ContentDedup::Claim::Done) {
+                    reportShared(state, path, file, shared);
+                    continue;
+                }
+                if (claim == ContentDedup::Claim::Busy) {
+                    state.dedup->wait(file.content, [this, &state, path, file](const ContentDedup::Result& result) {
+                        reportShared(state, path, file, result);
+                    });
+                    continue;
+                }
+                file.contentOwner = true;
+            }
+            if (checkPrefix && file.stamped && !file.cached && base.usesPrefixKey(file.stamp.size)) {
+                int error = 0;
+                bool mayMatch;
+                {
+                    StageTimer timer(state.stage(&Stage::prefix));
+                    mayMatch = mayMatchByPrefix(path, file.stamp.size, base, error);
+                }
+                if (!mayMatch) {
+                    if (error == 0) {
+                        state.prefixRejectedFiles++;
+                        state.prefixSkippedBytes += file.stamp.size - base.prefixLength();
+                        report(state, path, file, FileStatus::RejectedByPrefix);
+                    } else {
+                        state.fileErrors++;
+                        report(state, path, file, FileStatus::Error, error);
+                    }
+                    completeShared(state, file, error == 0 ? ContentDedup::Outcome::RejectedByPrefix
+                                                          : ContentDedup::Outcome::Error, nullptr, error);
+                    continue;
+                }
+            }
+            selected.push_back(std::string_view(path));
+            pending.push_back(file);
         }
-        
-        
-        logFile << "file_path;hash;verdict" << std::endl;
+        return observedAt;
+    }
 
-        std::atomic<int> malwareFound{0};
-        std::atomic<int> fileErrors{0};
+    // Итог прочитанного файла: кэш, проверка по базе и записи о файле.
+    // file == nullptr - файл шел без отбора, и о нем известен только путь
+    static void finishFile(ScanState& state, const SignatureSnapshot& base, const std::string& path,
+                           const PendingFile* file, const FileDigests* digests, int error, uint64_t length,
+                           int64_t observedAt) {
+        if (!file) {
+            FileRecord record;
+            record.path = path;
+            if (!digests) {
+                state.fileErrors++;
+                if (state.results || state.onRecord) {
+                    record.status = FileStatus::Error;
+                    record.error = error;
+                    emit(state, record);
+                }
+                return;
+            }
+            record.hasSize = true;
+            record.size = length;
+            checkDigest(path, *digests, base, state, &record);
+            return;
+        }
+
+        if (!digests) {
+            state.fileErrors++;
+            report(state, path, *file, FileStatus::Error, error);
+            completeShared(state, *file, ContentDedup::Outcome::Error, nullptr, error);
+            return;
+        }
+        if (file->cached && file->cachedDigests.md5 != digests->md5) {
+            state.cacheMismatches++;
+        }
+        if (file->stamped && state.cache) {
+            StageTimer timer(state.stage(&Stage::cache));
+            state.cache->store(file->stamp, *digests, observedAt);
+        }
+        FileRecord record = recordOf(path, *file);
+        if (!record.hasSize) {
+            record.hasSize = true;
+            record.size = length;
+        }
+        checkDigest(path, *digests, base, state, &record);
+        completeShared(state, *file, ContentDedup::Outcome::Digest, digests, 0);
+    }
+
+    // Ключ содержимого, если его могут делить несколько путей
+    bool contentKeyOf(const std::string& path, const FileStamp& stamp, ContentKey& key) const {
+        if (options.dedupHardLinks && ContentDedup::inodeKeyOf(stamp, key)) {
+            return true;
+        }
+        return options.dedupExtents && ContentDedup::extentKeyOf(path, stamp, key);
+    }
+
+    // Итог первого пути к содержимому отдается путям, которые его ждут
+    static void completeShared(ScanState& state, const PendingFile& file, ContentDedup::Outcome outcome,
+                               const FileDigests* digests, int error) {
+        if (!file.contentOwner) {
+            return;
+        }
+        ContentDedup::Result result;
+        result.outcome = outcome;
+        if (digests) {
+            result.digests = *digests;
+        }
+        result.error = error;
+        state.dedup->complete(file.content, result);
+    }
+
+    // Путь, содержимое которого прочитано по другому пути: сообщается тот же итог.
+    // Вызывается из пачки, прочитавшей содержимое, поэтому закрепляет свой снимок базы
+    void reportShared(ScanState& state, const std::string& path, const PendingFile& file,
+                      const ContentDedup::Result& result) {
+        switch (result.outcome) {
+        case ContentDedup::Outcome::Digest: {
+            state.linkedFiles++;
+            state.linkedBytes += file.stamp.size;
+            FileRecord record = recordOf(path, file);
+            checkDigest(path, result.digests, *signatures.acquire(), state, &record);
+            break;
+        }
+        case ContentDedup::Outcome::RejectedByPrefix:
+            state.linkedFiles++;
+            state.linkedBytes += file.stamp.size;
+            report(state, path, file, FileStatus::RejectedByPrefix);
+            break;
+        case ContentDedup::Outcome::Error:
+            state.fileErrors++;
+            report(state, path, file, FileStatus::Error, result.error);
+            break;
+        }
+    }
+
+    // false - ключа префикса файла нет в базе, и целиком его читать не нужно
+    // (или префикс не прочитался: тогда error - код ошибки)
+    static bool mayMatchByPrefix(const std::string& path, uint64_t fileSize, const SignatureSnapshot& base,
+                                 int& error) {
+        MD5Digest prefix;
+        if (!MD5Calculator::tryPrefixDigest(path, base.prefixLength(), prefix, error)) {
+            return false;
+        }
+        return base.mayMatchPrefix(fileSize, prefix);
+    }
 
-        for (const auto& task : fileTasks) {
-            threadPool.PushTask([this, task, &logFile,  &malwareFound, &fileErrors]() {
-                processFile(task, logFile,  malwareFound, fileErrors);
+    // хеширует пачку файлов multi-buffer ядром текущего потока
+    // (без SIMD хешер считает файлы по одному скалярным MD5);
+    // с io_uring чтения всей пачки идут асинхронно из одного потока.
+    // Алгоритмы digests считаются из тех же буферов чтения, что и MD5
+    void hashBatch(const PathBatch& paths, ScanState& state, DigestMask digests, const DigestCallback& onDigest) {
+        MetricsCollector::ThreadMetrics& local = state.metrics.local();
+        auto forward = [&](auto& hasher) {
+            hasher.setTiming(state.timing);
+            hasher.setDigests(digests);
+            hasher.hashFiles(paths.data(), paths.size(), [&](size_t index, const MD5Digest* digest) {
+                if (!digest) {
+                    onDigest(index, nullptr, hasher.lastError(), 0);
+                    return;
+                }
+                uint64_t length = hasher.lastLength();
+                countHashed(state, local, length, hasher.lastTiming());
+                onDigest(index, &hasher.lastDigests(), 0, length);
             });
+        };
+        // Способ чтения каждого файла выбирается по его размеру
+        if (state.useUring) {
+            thread_local UringFileHasher uringHasher;
+            uringHasher.setReadOptions(state.readOptions);
+            forward(uringHasher);
+        } else {
+            thread_local MultiBufferFileHasher hasher;
+            hasher.setReadOptions(state.readOptions);
+            forward(hasher);
         }
+    }
 
-        threadPool.Terminate(true);
+    // Прочитанный файл учитывается в своем классе размеров
+    static void countHashed(ScanState& state, MetricsCollector::ThreadMetrics& local, uint64_t length,
+                            const FileTiming& timing) {
+        MetricsCollector::FileStage& stage = local.bySize[static_cast<size_t>(sizeClassOf(length))];
+        local.bytesHashed.add(length);
+        stage.files.add(1);
+        stage.bytes.add(length);
+        if (state.timing) {
+            stage.open.add(timing.openNs);
+            stage.read.add(timing.readNs);
+            stage.hash.add(timing.hashNs);
+        }
+    }
 
-        auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> duration = end - start;
+    // Запись потока результатов с тем, что известно о файле до чтения
+    static FileRecord recordOf(const std::string& path, const PendingFile& file) {
+        FileRecord record;
+        record.path = path;
+        record.hasSize = file.stamped;
+        record.size = file.stamped ? file.stamp.size : 0;
+        return record;
+    }
 
-        result.malwareFiles = malwareFound;
-        result.errors += fileErrors;
-        result.duration = duration.count();
+    // Записывает в поток результатов файл, дайджест которого не посчитан
+    static void report(ScanState& state, const std::string& path, const PendingFile& file,
+                       FileStatus status, int error = 0) {
+        if (state.results || state.onRecord) {
+            FileRecord record = recordOf(path, file);
+            record.status = status;
+            record.error = error;
+            StageTimer timer(state.stage(&Stage::log));
+            emit(state, record);
+        }
+    }
 
-        return result;
+    // Запись о файле уходит в поток результатов и наблюдению
+    static void emit(ScanState& state, const FileRecord& record) {
+        if (state.results) {
+            state.results->append(record);
+        }
+        if (state.onRecord) {
+            state.onRecord(record);
+        }
     }
 
-private:
-    void processFile(const FileTask& task, std::ofstream& logFile,  
-                    std::atomic<int>& malwareFound,
-                    std::atomic<int>& fileErrors) {
-        try {
-            std::string hash = MD5Calculator::calculateFileMD5(task.path);
-
-            auto it = malwareHashes.find(hash);
-            if (it != malwareHashes.end()) {
-                malwareFound++;
-                
-                std::lock_guard<std::mutex> lock(logMutex);
-                logFile << task.path << ";" << hash << ";" << it->second << std::endl;
-            }
-        } catch (const std::exception& e) {
-            fileErrors++;
+    // сравнение идет по двоичным дайджестам, hex-строка нужна только для лога
+    // и собирается на стеке; строка копируется в буфер потока без общей блокировки.
+    // В лог пишется дайджест того алгоритма, сигнатура которого совпала
+    static void checkDigest(const std::string& path, const FileDigests& digests, const SignatureSnapshot& base,
+                            ScanState& state, FileRecord* record) {
+        const std::string* verdict;
+        HashAlgorithm matched = HashAlgorithm::MD5;
+        {
+            StageTimer timer(state.stage(&Stage::lookup));
+            verdict = base.find(digests, &matched);
+        }
+        if (!verdict && !state.results && !state.onRecord) {
+            return;
+        }
+
+        StageTimer timer(state.stage(&Stage::log));
+        if (verdict) {
+            state.malwareFound++;
+
+            char hash[2 * sizeof(SHA256Digest)];
+            size_t size = digestSize(matched);
+            MD5Calculator::bytesToHex(digests.bytes(matched), size, hash);
+            state.logFile.appendLine({path, std::string_view(hash, 2 * size), *verdict});
+        }
+        if (state.results || state.onRecord) {
+            record->status = verdict ? FileStatus::Malware : FileStatus::Clean;
+            record->hasDigest = true;
+            record->digest = digests.md5;
+            record->extraDigests = digests.mask & ~DIGEST_MD5;
+            record->sha1 = digests.sha1;
+            record->sha256 = digests.sha256;
+            record->xxh3 = digests.xxh3;
+            if (verdict) {
+                record->verdict = *verdict;
+            }
+            emit(state, *record);
         }
     }
 };
@@ -1,29 +1,206 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include <memory>
 
-#ifdef SCANNER_CORE_EXPORTS
-#define SCANNER_API __declspec(dllexport)
-#else
-#define SCANNER_API __declspec(dllimport)
-#endif
+#include "scanner_api.h"
+#include "scan_metrics.h"
 
 struct ScanResult {
     int totalFiles = 0;
     int malwareFiles = 0;
     int errors = 0;
     double duration = 0.0;
+    int cachedFiles = 0;        // файлы, дайджест которых взят из кэша без чтения
+    int cacheMismatches = 0;    // при перепроверке кэша: дайджест файла не совпал с сохраненным
+    int sizeSkippedFiles = 0;   // файлы не читались: сигнатур такого размера в базе нет
+    uint64_t sizeSkippedBytes = 0;
+    int prefixRejectedFiles = 0;    // прочитан только префикс: его ключа нет в базе
+    uint64_t prefixSkippedBytes = 0;    // байт этих файлов после префикса
+    int linkedFiles = 0;            // файлы не читались: то же содержимое уже хешировано по другому пути
+    uint64_t linkedBytes = 0;       // их размер
+    uint64_t resultRecords = 0;     // записей в потоке результатов
+    uint64_t resultBytes = 0;       // его размер в байтах
+    ScanMetrics metrics;            // счетчики и задержки стадий по всему сканированию
+};
+
+// Цель пакетного сканирования (см. IScannerCore::scanBatch)
+struct ScanTarget {
+    std::string root;                   // каталог для обхода; пусто - без обхода
+    std::vector<std::string> files;     // файлы, проверяемые без обхода
+};
+
+// Итоги пакетного сканирования
+struct BatchScanResult {
+    // По цели в порядке запроса. duration - от начала пакета до последнего файла цели;
+    // в metrics только счетчики обхода, метрики хеширования общие и есть в total
+    std::vector<ScanResult> targets;
+    ScanResult total;                   // сумма по целям, ошибки лога, потока результатов и кэша
+};
+
+// Отчет о ходе сканирования (см. IScannerCore::setProgressCallback)
+struct ScanProgress {
+    ScanMetrics metrics;            // снимок с начала сканирования
+    uint64_t malwareFiles = 0;
+    uint64_t errors = 0;
+    double filesPerSecond = 0.0;    // с прошлого отчета
+    double bytesPerSecond = 0.0;
+    bool finished = false;          // последний отчет, сканирование завершено
+};
+
+using ProgressCallback = std::function<void(const ScanProgress& progress)>;
+
+// Способ чтения файлов при хешировании
+enum class IoEngine {
+    Uring,      // io_uring (Linux 5.6+); если недоступен - блокирующее чтение
+    Blocking    // блокирующие open/read в потоках пула
+};
+
+// Как потоки сканирования делят чтение и хеширование
+enum class ThreadModel {
+    Shared,     // один пул по числу ядер: каждый поток и читает, и хеширует
+    Split       // пул чтения и пулы хеширования по узлам NUMA; с io_uring - как Shared
+};
+
+// Когда строки лога сканирования сбрасываются на диск
+enum class LogDurability {
+    Buffered,   // строки отдаются ОС, на диск она сбрасывает их сама
+    Interval,   // fdatasync не реже раза в logFlushIntervalMs
+    EveryWrite  // fdatasync после каждой записи в файл
+};
+
+// Формат потока результатов по всем файлам (см. ScanResultWriter)
+enum class ResultFormat {
+    None,       // только лог найденных файлов
+    Ndjson,     // объект JSON на строку
+    Binary      // компактные записи со сжатием путей, читаются ScanResultReader
+};
+
+struct ScanOptions {
+    int maxDepth = -1;              // глубина обхода: -1 без ограничения, 0 - только файлы корня
+    bool followSymlinks = false;    // заходить в каталоги по символическим ссылкам (с защитой от циклов)
+    IoEngine ioEngine = IoEngine::Uring;
+    ThreadModel threadModel = ThreadModel::Split;
+    uint32_t ioThreads = 0;         // потоков чтения: 0 - по профилю хранилища и дальше по метрикам
+    uint32_t hashThreads = 0;       // потоков хеширования: 0 - по доступным ядрам и дальше по метрикам
+    bool adaptiveThreads = true;    // подстраивать число потоков, заданных нулем, по ходу сканирования
+    bool directIo = false;          // крупные файлы читать O_DIRECT мимо page cache (блокирующее чтение)
+    bool mapLargeFiles = false;     // крупные файлы отображать; укорочение файла во время чтения дает SIGBUS
+    // кэш дайджестов между запусками; пусто - без кэша. Кэш, открытый наблюдением,
+    // сканирование не открывает: идет без него и считает ошибку
+    std::string cachePath;
+    bool revalidateCache = false;   // читать все файлы и сверять дайджесты с кэшем
+    bool pruneCache = false;        // удалить из кэша файлы, не найденные этим сканированием
+    bool sizeFilter = true;         // не хешировать файлы, размера которых нет среди сигнатур базы
+    bool prefixCheck = true;        // крупные файлы сначала сверять по ключу префикса
+    bool dedupHardLinks = false;    // жесткие ссылки на один inode хешировать один раз (нужен stat каждого файла)
+    bool dedupExtents = false;      // reflink-копии с общими экстентами (FIEMAP, Linux) - тоже один раз
+    uint64_t prefixLength = 64 * 1024;  // длина префикса для ключей в загружаемых после этого CSV-базах
+    uint32_t logFlushIntervalMs = 100;  // сколько найденная строка может ждать в буфере лога
+    LogDurability logDurability = LogDurability::Buffered;
+    ResultFormat resultFormat = ResultFormat::None;
+    std::string resultPath;         // поток результатов: путь, размер, дайджест, вердикт и ошибка каждого файла
+    uint32_t digests = 0;           // маска DIGEST_* (digest_set.h): что считать вместе с MD5 за тот же проход;
+                                    // алгоритмы сигнатур базы добавляются сами
+    bool collectTimings = false;    // гистограммы задержек стадий; счетчики собираются всегда
+    std::string metricsPath;        // метрики в формате Prometheus, переписываются с каждым отчетом
+    uint32_t progressIntervalMs = 1000;     // период progress callback и файла метрик
+};
+
+// Источник событий файловой системы в режиме наблюдения
+enum class WatchBackend {
+    Auto,       // fanotify, если доступен (Linux 5.9+, CAP_SYS_ADMIN), иначе inotify
+    Fanotify,   // одна метка на файловую систему
+    Inotify     // метка на каждый каталог дерева
+};
+
+struct WatchOptions {
+    WatchBackend backend = WatchBackend::Auto;
+    uint32_t debounceUs = 2000;     // файл проверяется, когда события по нему затихли на это время
+    uint32_t maxDelayMs = 1000;     // но не позже этого срока после первого события
+    bool initialScan = false;       // сначала проверить файлы, уже лежащие в каталогах
+};
+
+// Итоги наблюдения; счетчики с момента startWatch
+struct WatchStats {
+    WatchBackend backend = WatchBackend::Auto;  // выбранный механизм
+    uint64_t events = 0;            // события по файлам, включая найденные в новых каталогах
+    uint64_t coalesced = 0;         // слиты с событием по файлу, уже ждущему проверки
+    uint64_t cancelled = 0;         // файл удален или перенесен до проверки
+    uint64_t overflows = 0;         // переполнения очереди ядра: корни пересканировались
+    uint64_t filesScanned = 0;      // вердиктов, включая файлы пересканирования
+    uint64_t malwareFiles = 0;
+    uint64_t errors = 0;            // ошибки чтения файлов и наблюдения за каталогами
+    uint64_t vanished = 0;          // файл исчез между событием и проверкой (не ошибка)
+    uint64_t pending = 0;           // ждут проверки в момент снимка
+    LatencyHistogram latency;       // от первого события по файлу до вердикта
+    ScanMetrics metrics;            // стадии проверки файлов
+};
+
+struct FileRecord;
+
+// Вердикт по файлу в режиме наблюдения. latencyNs - от первого события
+// по файлу; 0 у файлов начальной проверки и пересканирования
+using WatchCallback = std::function<void(const FileRecord& record, uint64_t latencyNs)>;
+
+// Итоги загрузки баз, накапливаются по вызовам loadMalwareBase и applyBaseDelta;
+// reloadMalwareBase начинает их заново
+struct BaseLoadStats {
+    uint64_t signatures = 0;    // сигнатуры из CSV и двоичных баз
+    uint64_t lines = 0;         // строки CSV, включая пустые
+    uint64_t malformed = 0;     // пропущенные строки CSV с неверным форматом
+    uint64_t duplicates = 0;    // сигнатуры, заменившие вердикт уже загруженной
+    uint64_t uppercase = 0;     // сигнатуры с заглавными hex-символами
+    uint64_t emptyLines = 0;
+    uint64_t fileSizes = 0;     // различных размеров файлов в базе; 0 - фильтр по размеру не работает
+    uint64_t prefixKeys = 0;    // ключей префикса в базе
+    uint64_t prefixLength = 0;  // длина префикса этих ключей
+    uint64_t removed = 0;       // сигнатуры, удаленные дельтами
+    uint64_t version = 0;       // номер опубликованного снимка базы, растет с каждым обновлением
+    uint32_t algorithms = 0;    // типы хешей сигнатур базы, маска DIGEST_* (digest_set.h)
 };
 
 class SCANNER_API IScannerCore {
 public:
     virtual ~IScannerCore() = default;
     
-    virtual bool loadMalwareBase(const std::string& csvPath) = 0;
+    // Загружает базу: CSV "hash;verdict[;size[;prefix]]" или двоичную базу (открывается через mmap)
+    virtual bool loadMalwareBase(const std::string& basePath) = 0;
+    // Сохраняет загруженную базу в двоичном формате для мгновенной загрузки
+    virtual bool compileMalwareBase(const std::string& outputPath) = 0;
+    // Загружает базу заново в вызывающем потоке и атомарно подменяет ею текущую.
+    // Сканирования и наблюдение не останавливаются: пачки файлов, начатые после
+    // подмены, проверяются по новой базе. При ошибке остается старая
+    virtual bool reloadMalwareBase(const std::string& basePath) = 0;
+    // Дельта в формате CSV-базы, строка "-hash" удаляет сигнатуру. Применяется
+    // без перестройки базы и публикуется так же, как reloadMalwareBase
+    virtual bool applyBaseDelta(const std::string& deltaPath) = 0;
+    virtual BaseLoadStats getLoadStats() const = 0;
     virtual ScanResult scanDirectory(const std::string& rootPath, const std::string& logPath) = 0;
+    // Сканирует цели в одном общем логе. Пул потоков сканера живет между вызовами,
+    // обходы целей идут в нем вперемешку. Вызовы сканирования одного сканера выполняются по очереди
+    virtual BatchScanResult scanBatch(const std::vector<ScanTarget>& targets, const std::string& logPath) = 0;
+    virtual void setScanOptions(const ScanOptions& options) = 0;
+    // Вызывается из отдельного потока раз в progressIntervalMs и по завершении; nullptr - отключить
+    virtual void setProgressCallback(ProgressCallback callback) = 0;
+
+    // Наблюдение за каталогами: файл проверяется после закрытия на запись или
+    // переноса в дерево, найденные пишутся в logPath. Идет в своих потоках
+    // до stopWatch и не мешает scanDirectory/scanBatch. Параметры сканирования
+    // берутся на момент запуска, база - на каждую пачку файлов.
+    // false - наблюдение недоступно (errno - причина) или уже идет;
+    // errno = EBUSY - кэш cachePath открыт идущим сканированием
+    virtual bool startWatch(const std::vector<std::string>& roots, const std::string& logPath,
+                            const WatchOptions& watchOptions) = 0;
+    // Проверяет файлы, уже ждущие в очереди, и останавливает наблюдение
+    virtual WatchStats stopWatch() = 0;
+    virtual WatchStats getWatchStats() = 0;
+    // Вызывается из потоков проверки на каждый файл; задается до startWatch
+    virtual void setWatchCallback(WatchCallback callback) = 0;
 };
 
 extern "C" SCANNER_API IScannerCore* createScanner();
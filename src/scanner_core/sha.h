@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "scanner_api.h"
+
+using SHA1Digest = std::array<uint8_t, 20>;
+using SHA256Digest = std::array<uint8_t, 32>;
+
+/**
+ * Функция сжатия SHA: обрабатывает blocks блоков по 64 байта,
+ * state - слова состояния в порядке стандарта (5 у SHA-1, 8 у SHA-256)
+ */
+using ShaBlockFunc = void (*)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+struct ShaKernel {
+    const char* name = "scalar";
+    ShaBlockFunc sha1 = nullptr;
+    ShaBlockFunc sha256 = nullptr;
+};
+
+/**
+ * Выбор ядер SHA-1 и SHA-256 по возможностям процессора: инструкции
+ * SHA-NI (x86, проверяются по CPUID во время выполнения) или переносимая
+ * скалярная реализация
+ */
+class SCANNER_API ShaKernels {
+public:
+    enum class Isa { Scalar, ShaNi };
+
+    // Лучшее доступное ядро; результат кешируется
+    static const ShaKernel& best();
+
+    // Конкретное ядро, если процессор и сборка его поддерживают, иначе скалярное
+    static ShaKernel get(Isa isa);
+
+    static bool supported(Isa isa);
+};
+
+/**
+ * Потоковая часть SHA-1 и SHA-256 (FIPS 180-4): буферизация блоков и
+ * паддинг с длиной в big-endian. Сами блоки сжимает ядро ShaKernel.
+ */
+template <size_t StateWords, size_t DigestSize>
+class ShaStream {
+public:
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t DIGEST_SIZE = DigestSize;
+
+    void update(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        length_ += size;
+
+        if (bufferSize_ > 0) {
+            size_t take = BLOCK_SIZE - bufferSize_;
+            if (take > size) take = size;
+            std::memcpy(buffer_ + bufferSize_, bytes, take);
+            bufferSize_ += take;
+            bytes += take;
+            size -= take;
+            if (bufferSize_ < BLOCK_SIZE) {
+                return;
+            }
+            transform_(state_, buffer_, 1);
+            bufferSize_ = 0;
+        }
+
+        size_t blocks = size / BLOCK_SIZE;
+        if (blocks > 0) {
+            transform_(state_, bytes, blocks);
+            bytes += blocks * BLOCK_SIZE;
+            size -= blocks * BLOCK_SIZE;
+        }
+
+        if (size > 0) {
+            std::memcpy(buffer_, bytes, size);
+            bufferSize_ = size;
+        }
+    }
+
+protected:
+    explicit ShaStream(ShaBlockFunc transform) : transform_(transform) {}
+
+    void start(const uint32_t* init) {
+        std::memcpy(state_, init, sizeof(state_));
+        length_ = 0;
+        bufferSize_ = 0;
+    }
+
+    void finish(uint8_t* digest) {
+        uint64_t bitLength = length_ * 8;
+
+        buffer_[bufferSize_++] = 0x80;
+        if (bufferSize_ > BLOCK_SIZE - 8) {
+            std::memset(buffer_ + bufferSize_, 0, BLOCK_SIZE - bufferSize_);
+            transform_(state_, buffer_, 1);
+            bufferSize_ = 0;
+        }
+        std::memset(buffer_ + bufferSize_, 0, BLOCK_SIZE - 8 - bufferSize_);
+        for (int i = 0; i < 8; ++i) {
+            buffer_[BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(bitLength >> (8 * i));
+        }
+        transform_(state_, buffer_, 1);
+
+        for (size_t i = 0; i < DigestSize / 4; ++i) {
+            digest[4 * i] = static_cast<uint8_t>(state_[i] >> 24);
+            digest[4 * i + 1] = static_cast<uint8_t>(state_[i] >> 16);
+            digest[4 * i + 2] = static_cast<uint8_t>(state_[i] >> 8);
+            digest[4 * i + 3] = static_cast<uint8_t>(state_[i]);
+        }
+    }
+
+private:
+    ShaBlockFunc transform_;
+    uint32_t state_[StateWords];
+    uint64_t length_ = 0;
+    uint8_t buffer_[BLOCK_SIZE];
+    size_t bufferSize_ = 0;
+};
+
+class SHA1 : public ShaStream<5, 20> {
+public:
+    explicit SHA1(const ShaKernel& kernel = ShaKernels::best()) : ShaStream(kernel.sha1) { reset(); }
+
+    void reset() {
+        static const uint32_t INIT[5] = {0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u, 0xc3d2e1f0u};
+        start(INIT);
+    }
+
+    SHA1Digest finalize() {
+        SHA1Digest digest;
+        finish(digest.data());
+        reset();
+        return digest;
+    }
+
+    static SHA1Digest hash(const void* data, size_t size) {
+        SHA1 sha;
+        sha.update(data, size);
+        return sha.finalize();
+    }
+};
+
+class SHA256 : public ShaStream<8, 32> {
+public:
+    explicit SHA256(const ShaKernel& kernel = ShaKernels::best()) : ShaStream(kernel.sha256) { reset(); }
+
+    void reset() {
+        static const uint32_t INIT[8] = {0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+                                         0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u};
+        start(INIT);
+    }
+
+    SHA256Digest finalize() {
+        SHA256Digest digest;
+        finish(digest.data());
+        reset();
+        return digest;
+    }
+
+    static SHA256Digest hash(const void* data, size_t size) {
+        SHA256 sha;
+        sha.update(data, size);
+        return sha.finalize();
+    }
+};
@@ -0,0 +1,167 @@
+#include <cstddef>
+#include <cstdint>
+
+// Файл собирается с -msha -msse4.1 -mssse3, вызывается только после проверки CPU
+#if defined(__SHA__) || defined(_MSC_VER)
+#include <immintrin.h>
+
+namespace {
+
+alignas(16) const uint32_t SHA256_K[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+    0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+    0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+    0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+    0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+    0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+    0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u,
+};
+
+}
+
+/**
+ * SHA-1 на инструкциях SHA-NI. Регистр ABCD хранит слова в обратном порядке,
+ * E0/E1 по очереди держат слово E (в старших 32 битах) плюс слова сообщения.
+ * Расписание сообщения: SHA1MSG1/XOR/SHA1MSG2 готовят слова для группы
+ * из четырех раундов на три группы вперед.
+ */
+void sha1BlocksShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+    __m128i e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+    __m128i e1;
+    __m128i m0, m1, m2, m3;
+
+// Группа из четырех раундов со словами mc; ea получает их, eb - копию ABCD
+#define SHA1_ROUNDS(ea, eb, mc, f)           \
+    ea = _mm_sha1nexte_epu32(ea, mc);        \
+    eb = abcd;                               \
+    abcd = _mm_sha1rnds4_epu32(abcd, ea, f)
+#define SHA1_MSG1(mp, mc) mp = _mm_sha1msg1_epu32(mp, mc)
+#define SHA1_MSG2(mn, mc) mn = _mm_sha1msg2_epu32(mn, mc)
+#define SHA1_XOR(mpp, mc) mpp = _mm_xor_si128(mpp, mc)
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abcdSave = abcd;
+        const __m128i e0Save = e0;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), MASK);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), MASK);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), MASK);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), MASK);
+
+        // Раунды 0-3: E складывается со словами напрямую
+        e0 = _mm_add_epi32(e0, m0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        // 4-19
+        SHA1_ROUNDS(e1, e0, m1, 0); SHA1_MSG1(m0, m1);
+        SHA1_ROUNDS(e0, e1, m2, 0); SHA1_MSG1(m1, m2); SHA1_XOR(m0, m2);
+        SHA1_ROUNDS(e1, e0, m3, 0); SHA1_MSG2(m0, m3); SHA1_MSG1(m2, m3); SHA1_XOR(m1, m3);
+        SHA1_ROUNDS(e0, e1, m0, 0); SHA1_MSG2(m1, m0); SHA1_MSG1(m3, m0); SHA1_XOR(m2, m0);
+
+        // 20-39
+        SHA1_ROUNDS(e1, e0, m1, 1); SHA1_MSG2(m2, m1); SHA1_MSG1(m0, m1); SHA1_XOR(m3, m1);
+        SHA1_ROUNDS(e0, e1, m2, 1); SHA1_MSG2(m3, m2); SHA1_MSG1(m1, m2); SHA1_XOR(m0, m2);
+        SHA1_ROUNDS(e1, e0, m3, 1); SHA1_MSG2(m0, m3); SHA1_MSG1(m2, m3); SHA1_XOR(m1, m3);
+        SHA1_ROUNDS(e0, e1, m0, 1); SHA1_MSG2(m1, m0); SHA1_MSG1(m3, m0); SHA1_XOR(m2, m0);
+        SHA1_ROUNDS(e1, e0, m1, 1); SHA1_MSG2(m2, m1); SHA1_MSG1(m0, m1); SHA1_XOR(m3, m1);
+
+        // 40-59
+        SHA1_ROUNDS(e0, e1, m2, 2); SHA1_MSG2(m3, m2); SHA1_MSG1(m1, m2); SHA1_XOR(m0, m2);
+        SHA1_ROUNDS(e1, e0, m3, 2); SHA1_MSG2(m0, m3); SHA1_MSG1(m2, m3); SHA1_XOR(m1, m3);
+        SHA1_ROUNDS(e0, e1, m0, 2); SHA1_MSG2(m1, m0); SHA1_MSG1(m3, m0); SHA1_XOR(m2, m0);
+        SHA1_ROUNDS(e1, e0, m1, 2); SHA1_MSG2(m2, m1); SHA1_MSG1(m0, m1); SHA1_XOR(m3, m1);
+        SHA1_ROUNDS(e0, e1, m2, 2); SHA1_MSG2(m3, m2); SHA1_MSG1(m1, m2); SHA1_XOR(m0, m2);
+
+        // 60-79
+        SHA1_ROUNDS(e1, e0, m3, 3); SHA1_MSG2(m0, m3); SHA1_MSG1(m2, m3); SHA1_XOR(m1, m3);
+        SHA1_ROUNDS(e0, e1, m0, 3); SHA1_MSG2(m1, m0); SHA1_MSG1(m3, m0); SHA1_XOR(m2, m0);
+        SHA1_ROUNDS(e1, e0, m1, 3); SHA1_MSG2(m2, m1); SHA1_XOR(m3, m1);
+        SHA1_ROUNDS(e0, e1, m2, 3); SHA1_MSG2(m3, m2);
+        SHA1_ROUNDS(e1, e0, m3, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0Save);
+        abcd = _mm_add_epi32(abcd, abcdSave);
+    }
+
+#undef SHA1_ROUNDS
+#undef SHA1_MSG1
+#undef SHA1_MSG2
+#undef SHA1_XOR
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+/**
+ * SHA-256 на инструкциях SHA-NI. Состояние хранится парами ABEF/CDGH,
+ * как того требует SHA256RNDS2; каждая группа - четыре раунда (две
+ * инструкции по два раунда), расписание сообщения идет на группу вперед.
+ */
+void sha256BlocksShaNi(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);    // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);         // CDGH
+    __m128i msg;
+    __m128i m0, m1, m2, m3;
+
+#define SHA256_ROUNDS(mc, g)                                                                         \
+    msg = _mm_add_epi32(mc, _mm_load_si128(reinterpret_cast<const __m128i*>(SHA256_K + 4 * (g)))); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);                                             \
+    msg = _mm_shuffle_epi32(msg, 0x0E);                                                              \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg)
+#define SHA256_MSG2(mn, mc, mp)                          \
+    mn = _mm_add_epi32(mn, _mm_alignr_epi8(mc, mp, 4));  \
+    mn = _mm_sha256msg2_epu32(mn, mc)
+#define SHA256_MSG1(mp, mc) mp = _mm_sha256msg1_epu32(mp, mc)
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abefSave = state0;
+        const __m128i cdghSave = state1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), MASK);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), MASK);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), MASK);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), MASK);
+
+        SHA256_ROUNDS(m0, 0);
+        SHA256_ROUNDS(m1, 1); SHA256_MSG1(m0, m1);
+        SHA256_ROUNDS(m2, 2); SHA256_MSG1(m1, m2);
+        SHA256_ROUNDS(m3, 3); SHA256_MSG2(m0, m3, m2); SHA256_MSG1(m2, m3);
+        SHA256_ROUNDS(m0, 4); SHA256_MSG2(m1, m0, m3); SHA256_MSG1(m3, m0);
+        SHA256_ROUNDS(m1, 5); SHA256_MSG2(m2, m1, m0); SHA256_MSG1(m0, m1);
+        SHA256_ROUNDS(m2, 6); SHA256_MSG2(m3, m2, m1); SHA256_MSG1(m1, m2);
+        SHA256_ROUNDS(m3, 7); SHA256_MSG2(m0, m3, m2); SHA256_MSG1(m2, m3);
+        SHA256_ROUNDS(m0, 8); SHA256_MSG2(m1, m0, m3); SHA256_MSG1(m3, m0);
+        SHA256_ROUNDS(m1, 9); SHA256_MSG2(m2, m1, m0); SHA256_MSG1(m0, m1);
+        SHA256_ROUNDS(m2, 10); SHA256_MSG2(m3, m2, m1); SHA256_MSG1(m1, m2);
+        SHA256_ROUNDS(m3, 11); SHA256_MSG2(m0, m3, m2); SHA256_MSG1(m2, m3);
+        SHA256_ROUNDS(m0, 12); SHA256_MSG2(m1, m0, m3); SHA256_MSG1(m3, m0);
+        SHA256_ROUNDS(m1, 13); SHA256_MSG2(m2, m1, m0);
+        SHA256_ROUNDS(m2, 14); SHA256_MSG2(m3, m2, m1);
+        SHA256_ROUNDS(m3, 15);
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+#undef SHA256_ROUNDS
+#undef SHA256_MSG2
+#undef SHA256_MSG1
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);               // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);            // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);         // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);            // HGFE
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "signature_base.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+bool keyLess(const SignatureIndex::Key& a, const SignatureIndex::Key& b) {
+    return a.lo != b.lo ? a.lo < b.lo : a.hi < b.hi;
+}
+
+bool keyEqual(const SignatureIndex::Key& a, const SignatureIndex::Key& b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+MD5Digest digestOf(const SignatureIndex::Key& key) {
+    MD5Digest digest;
+    std::memcpy(digest.data(), &key.lo, 8);
+    std::memcpy(digest.data() + 8, &key.hi, 8);
+    return digest;
+}
+
+std::unique_ptr<SignatureSnapshot> emptySnapshot() {
+    return std::unique_ptr<SignatureSnapshot>(new SignatureSnapshot());
+}
+
+}
+
+SignatureSnapshot::SignatureSnapshot() : index_(std::make_shared<SignatureIndex>()) {}
+
+bool SignatureSnapshot::isRemoved(const SignatureIndex::Key& key) const {
+    return std::binary_search(removed_.begin(), removed_.end(), key, keyLess);
+}
+
+SignatureBase::SignatureBase() : cell_(emptySnapshot()) {}
+
+SignatureBase::~SignatureBase() = default;
+
+void SignatureBase::publish(std::unique_ptr<SignatureSnapshot> next) {
+    next->version_ = ++version_;
+    stats_.publications++;
+    stats_.reclaimed += cell_.publish(std::move(next));
+}
+
+void SignatureBase::publishIndex(std::shared_ptr<const SignatureIndex> index) {
+    std::unique_ptr<SignatureSnapshot> next = emptySnapshot();
+    next->index_ = std::move(index);
+    publish(std::move(next));
+}
+
+void SignatureBase::replace(SignatureIndex&& index) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    publishIndex(std::make_shared<SignatureIndex>(std::move(index)));
+}
+
+size_t SignatureBase::extend(SignatureIndex&& index) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    const SignatureSnapshot& current = *cell_.current();
+    if (current.size() == 0) {
+        publishIndex(std::make_shared<SignatureIndex>(std::move(index)));
+        return 0;
+    }
+    std::unique_ptr<SignatureIndex> merged = mergedOf(current);
+    size_t before = merged->size();
+    merged->merge(index);
+    size_t replaced = before + index.size() - merged->size();
+    publishIndex(std::move(merged));
+    return replaced;
+}
+
+size_t SignatureBase::applyDelta(const SignatureIndex& added, const std::vector<MD5Digest>& removed) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    const SignatureSnapshot& current = *cell_.current();
+
+    // Новый снимок делит индекс с текущим, копируется только дельта
+    std::unique_ptr<SignatureSnapshot> next = emptySnapshot();
+    next->index_ = current.index_;
+    next->added_.setPrefixLength(current.prefixLength());
+    next->added_.merge(current.added_);
+    std::vector<SignatureIndex::Key> hidden = current.removed_;
+
+    size_t erased = 0;
+    for (const MD5Digest& digest : removed) {
+        bool wasAdded = next->added_.erase(digest);
+        SignatureIndex::Key key = SignatureIndex::toKey(digest);
+        bool inIndex = current.index_->find(digest) != nullptr;
+        bool wasHidden = current.isRemoved(key);
+        if (inIndex) {
+            hidden.push_back(key);
+        }
+        erased += (wasAdded || (inIndex && !wasHidden)) ? 1 : 0;
+    }
+    // Добавленная сигнатура, которая есть и в индексе, скрывает его запись
+    added.forEach([&](const MD5Digest& digest, const std::string&) {
+        if (current.index_->find(digest) != nullptr) {
+            hidden.push_back(SignatureIndex::toKey(digest));
+        }
+    });
+    next->added_.merge(added);
+    std::sort(hidden.begin(), hidden.end(), keyLess);
+    hidden.erase(std::unique(hidden.begin(), hidden.end(), keyEqual), hidden.end());
+    next->removed_ = std::move(hidden);
+    next->deltaBits_.assign((uint64_t(1) << (64 - SignatureSnapshot::DELTA_BITS_SHIFT)) / 64, 0);
+    next->added_.forEach([&](const MD5Digest& digest, const std::string&) {
+        next->markDelta(SignatureIndex::toKey(digest));
+    });
+    for (const SignatureIndex::Key& key : next->removed_) {
+        next->markDelta(key);
+    }
+    stats_.deltas++;
+
+    if (next->deltaSize() > std::max(COMPACT_MIN, next->index_->size() / COMPACT_FRACTION)) {
+        stats_.compactions++;
+        publishIndex(mergedOf(*next));
+    } else {
+        publish(std::move(next));
+    }
+    return erased;
+}
+
+void SignatureBase::compact() {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    const SignatureSnapshot& current = *cell_.current();
+    if (current.deltaSize() == 0) {
+        return;
+    }
+    stats_.compactions++;
+    publishIndex(mergedOf(current));
+}
+
+std::shared_ptr<const SignatureIndex> SignatureBase::merged() const {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    const SignatureSnapshot& current = *cell_.current();
+    if (current.deltaSize() == 0) {
+        return current.index_;
+    }
+    return mergedOf(current);
+}
+
+std::unique_ptr<SignatureIndex> SignatureBase::mergedOf(const SignatureSnapshot& snapshot) {
+    std::unique_ptr<SignatureIndex> merged(new SignatureIndex());
+    merged->setPrefixLength(snapshot.prefixLength());
+    merged->merge(*snapshot.index_);
+    for (const SignatureIndex::Key& key : snapshot.removed_) {
+        merged->erase(digestOf(key));
+    }
+    merged->merge(snapshot.added_);
+    return merged;
+}
+
+SignatureBase::Stats SignatureBase::stats() const {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    Stats stats = stats_;
+    stats.version = version_;
+    stats.retired = cell_.retired();
+    return stats;
+}
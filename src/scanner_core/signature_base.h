@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "digest_set.h"
+#include "md5.h"
+#include "scanner_api.h"
+#include "signature_index.h"
+#include "snapshot_cell.h"
+
+/**
+ * Опубликованное состояние базы: общий неизменяемый индекс и небольшая
+ * дельта поверх него - добавленные сигнатуры и удаленные дайджесты.
+ * Все ключи дельты отмечены в битовой карте на 8 КиБ по старшим битам
+ * дайджеста: почти все поиски ее минуют одной проверкой бита в L1 и идут
+ * прямо в индекс, как без дельты.
+ *
+ * Фильтры по размеру и префиксу объединяют индекс и дельту: файл
+ * отсеивается, только если не подходит ни к тому, ни к другому.
+ */
+class SCANNER_API SignatureSnapshot {
+public:
+    SignatureSnapshot();
+
+    // Вердикт сигнатуры или nullptr, если дайджеста нет в базе
+    const std::string* find(const MD5Digest& digest) const {
+        SignatureIndex::Key key = SignatureIndex::toKey(digest);
+        if (deltaBits_.empty() || !inDelta(key)) {
+            return index_->find(digest);
+        }
+        const std::string* verdict = added_.find(digest);
+        if (verdict) {
+            return verdict;
+        }
+        verdict = index_->find(digest);
+        return verdict && isRemoved(key) ? nullptr : verdict;
+    }
+
+    // Алгоритмы сигнатур базы: их дайджесты нужно считать для каждого файла
+    DigestMask algorithms() const { return index_->algorithms() | added_.algorithms(); }
+
+    // Вердикт по дайджестам файла: проверяются все посчитанные алгоритмы,
+    // для которых в базе есть сигнатуры; matched - совпавший алгоритм
+    const std::string* find(const FileDigests& digests, HashAlgorithm* matched = nullptr) const {
+        const DigestMask algorithms = this->algorithms() | DIGEST_MD5;
+        for (HashAlgorithm algorithm : {HashAlgorithm::MD5, HashAlgorithm::SHA1, HashAlgorithm::SHA256}) {
+            if (!digests.has(algorithm) || !(algorithms & digestBit(algorithm))) {
+                continue;
+            }
+            const std::string* verdict = algorithm == HashAlgorithm::MD5
+                ? find(digests.md5)
+                : find(SignatureIndex::keyDigest(algorithm, digests.bytes(algorithm)));
+            if (verdict) {
+                if (matched) *matched = algorithm;
+                return verdict;
+            }
+        }
+        return nullptr;
+    }
+
+    bool hasSizeFilter() const {
+        return index_->hasSizeFilter() && (added_.size() == 0 || added_.hasSizeFilter());
+    }
+    bool mayMatchSize(uint64_t fileSize) const {
+        return !hasSizeFilter() || index_->mayMatchSize(fileSize) ||
+               (added_.size() != 0 && added_.mayMatchSize(fileSize));
+    }
+
+    // Различных размеров файлов и ключей префикса в базе и дельте вместе
+    size_t fileSizeCount() const { return index_->fileSizeCount(added_); }
+    size_t prefixKeyCount() const { return index_->prefixKeyCount(added_); }
+
+    uint64_t prefixLength() const { return index_->prefixLength(); }
+    bool hasPrefixKeys() const { return index_->prefixKeyCount() != 0 || added_.prefixKeyCount() != 0; }
+    // Файл можно отсеять по префиксу, если так можно и в индексе, и в дельте
+    // (там, где у этого размера вообще есть сигнатуры)
+    bool usesPrefixKey(uint64_t fileSize) const {
+        if (added_.size() == 0) {
+            return index_->usesPrefixKey(fileSize);
+        }
+        if (fileSize <= prefixLength() || !hasSizeFilter()) {
+            return false;
+        }
+        bool inIndex = index_->mayMatchSize(fileSize);
+        bool inAdded = added_.mayMatchSize(fileSize);
+        return (!inIndex || index_->usesPrefixKey(fileSize)) && (!inAdded || added_.usesPrefixKey(fileSize));
+    }
+    bool mayMatchPrefix(uint64_t fileSize, const MD5Digest& prefix) const {
+        return index_->mayMatchPrefix(fileSize, prefix) ||
+               (added_.prefixKeyCount() != 0 && added_.mayMatchPrefix(fileSize, prefix));
+    }
+
+    size_t size() const { return index_->size() + added_.size() - removed_.size(); }
+    // Номер публикации: растет с каждой заменой базы и дельтой
+    uint64_t version() const { return version_; }
+    // Сигнатур в дельте: добавленных и удаленных
+    size_t deltaSize() const { return added_.size() + removed_.size(); }
+    const SignatureIndex& index() const { return *index_; }
+    const SignatureIndex& added() const { return added_; }
+
+private:
+    friend class SignatureBase;
+
+    static constexpr unsigned DELTA_BITS_SHIFT = 48;    // 2^16 бит карты
+
+    bool inDelta(const SignatureIndex::Key& key) const {
+        uint64_t bit = key.lo >> DELTA_BITS_SHIFT;
+        return (deltaBits_[bit >> 6] >> (bit & 63)) & 1;
+    }
+    void markDelta(const SignatureIndex::Key& key) {
+        uint64_t bit = key.lo >> DELTA_BITS_SHIFT;
+        deltaBits_[bit >> 6] |= uint64_t(1) << (bit & 63);
+    }
+    bool isRemoved(const SignatureIndex::Key& key) const;
+
+    std::shared_ptr<const SignatureIndex> index_;
+    SignatureIndex added_;
+    // Скрытые сигнатуры индекса, отсортированы: удаленные и перекрытые дельтой
+    std::vector<SignatureIndex::Key> removed_;
+    std::vector<uint64_t> deltaBits_;       // пусто - дельты нет
+    uint64_t version_ = 0;
+};
+
+/**
+ * База сигнатур, которую можно менять на ходу. Сканеры берут снимок
+ * (acquire) без блокировок и держат его на время пачки файлов; писатель
+ * строит новый снимок в своем потоке и публикует его атомарно, старый
+ * освобождается после того, как его отпустит последний читатель.
+ *
+ * Дельта не перестраивает индекс: новый снимок делит индекс со старым
+ * и копирует только дельту. Когда дельта дорастает до доли индекса,
+ * снимок сжимается в новый индекс (тоже в потоке писателя).
+ */
+class SCANNER_API SignatureBase {
+public:
+    using Reader = SnapshotCell<SignatureSnapshot>::Guard;
+
+    struct Stats {
+        uint64_t version = 0;
+        uint64_t publications = 0;  // замены базы, дельты и сжатия
+        uint64_t deltas = 0;
+        uint64_t compactions = 0;
+        uint64_t reclaimed = 0;     // освобожденные снимки
+        uint64_t retired = 0;       // ждут, пока их отпустят читатели
+    };
+
+    // Дельта сжимается в индекс, когда в ней больше COMPACT_MIN сигнатур
+    // и больше 1/COMPACT_FRACTION индекса
+    static constexpr size_t COMPACT_MIN = 64 * 1024;
+    static constexpr size_t COMPACT_FRACTION = 16;
+
+    SignatureBase();
+    ~SignatureBase();
+    SignatureBase(const SignatureBase&) = delete;
+    SignatureBase& operator=(const SignatureBase&) = delete;
+
+    // Закрепляет текущий снимок; без блокировок
+    Reader acquire() const { return cell_.pin(); }
+
+    // Заменяет базу целиком, дельта сбрасывается
+    void replace(SignatureIndex&& index);
+    // Добавляет сигнатуры к базе, при совпадении побеждает index.
+    // Пустая база заменяется без копирования (отображенный индекс остается
+    // отображенным). Возвращает число сигнатур, заменивших вердикт
+    size_t extend(SignatureIndex&& index);
+    // Удаляет removed, затем добавляет added. Возвращает число удаленных
+    size_t applyDelta(const SignatureIndex& added, const std::vector<MD5Digest>& removed);
+    // Сливает дельту в новый индекс
+    void compact();
+    // Индекс со всеми изменениями дельты (для сохранения в файл)
+    std::shared_ptr<const SignatureIndex> merged() const;
+
+    Stats stats() const;
+
+private:
+    static std::unique_ptr<SignatureIndex> mergedOf(const SignatureSnapshot& snapshot);
+    void publish(std::unique_ptr<SignatureSnapshot> next);
+    void publishIndex(std::shared_ptr<const SignatureIndex> index);
+
+    mutable std::mutex writerMutex_;
+    SnapshotCell<SignatureSnapshot> cell_;
+    uint64_t version_ = 0;
+    Stats stats_;
+};
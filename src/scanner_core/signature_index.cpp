@@ -0,0 +1,847 @@
+#include "signature_index.h"
+#include "checksum.h"
+#include "file_io.h"
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIGNATURE_INDEX_SSE2 1
+#endif
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool parseHexScalar(const char* text, size_t size, uint8_t* digest, bool& upper) {
+    for (size_t i = 0; i < size; ++i) {
+        int high = hexValue(text[2 * i]);
+        int low = hexValue(text[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        upper |= (text[2 * i] >= 'A' && text[2 * i] <= 'F') || (text[2 * i + 1] >= 'A' && text[2 * i + 1] <= 'F');
+        digest[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return true;
+}
+
+#ifdef SIGNATURE_INDEX_SSE2
+// 32 символа (16 байт дайджеста) за две загрузки: классификация диапазонов сравнениями
+// со сдвигом на 0x80 (в SSE2 нет беззнаковых сравнений байт), затем склейка полубайт
+bool parseHex16(const char* text, uint8_t* digest, bool& upper) {
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    __m128i values[2];
+    uint32_t valid = 0;
+    int upperMask = 0;
+    for (int half = 0; half < 2; ++half) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * half));
+        __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+        __m128i lower = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        __m128i isDigit = _mm_cmplt_epi8(_mm_xor_si128(digit, bias), _mm_set1_epi8(static_cast<char>(0x80 + 10)));
+        __m128i isLetter = _mm_cmplt_epi8(_mm_xor_si128(lower, bias), _mm_set1_epi8(static_cast<char>(0x80 + 6)));
+        __m128i isUpper = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8(0x20)),
+                                           isLetter);
+        valid |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter))) << (16 * half);
+        upperMask |= _mm_movemask_epi8(isUpper);
+
+        __m128i letterValue = _mm_add_epi8(lower, _mm_set1_epi8(10));
+        __m128i value = _mm_or_si128(_mm_and_si128(isDigit, digit), _mm_andnot_si128(isDigit, letterValue));
+        // Пара символов в 16-битном слове: старший полубайт - первый символ
+        __m128i high = _mm_slli_epi16(_mm_and_si128(value, _mm_set1_epi16(0x00ff)), 4);
+        __m128i low = _mm_srli_epi16(value, 8);
+        values[half] = _mm_or_si128(high, low);
+    }
+    if (valid != 0xffffffffu) {
+        return false;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digest), _mm_packus_epi16(values[0], values[1]));
+    upper |= upperMask != 0;
+    return true;
+}
+#endif
+
+// Соль ключей SHA в общей таблице: ключи разных алгоритмов не совпадают
+const uint64_t SHA1_KEY_SALT[2] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full};
+const uint64_t SHA256_KEY_SALT[2] = {0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull};
+
+// Размер таблицы, при котором count ключей не превышают MAX_LOAD_PERCENT
+size_t capacityFor(size_t count) {
+    return std::max<size_t>(16, count * 100 / SignatureIndex::MAX_LOAD_PERCENT + 1);
+}
+
+/**
+ * Заголовок двоичной базы. За ним идут секции, каждая выровнена на 64 байта:
+ * таблица вердиктов (uint32 смещения строк, count + 1 штук, затем символы),
+ * ключи таблицы (capacity * 16 байт), номера вердиктов (capacity * 4 байта)
+ * и, начиная с версии 2, блоки фильтра Блума, с версии 3 - отсортированные
+ * размеры файлов сигнатур (uint64), с версии 4 - отсортированные ключи
+ * префикса (по 24 байта) и размеры сигнатур без ключа префикса.
+ * Версия 5 меняет только заголовок: в нем маска алгоритмов сигнатур.
+ * Все поля little-endian.
+ */
+struct DatabaseHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t signatureCount;    // ключей в таблице, без нулевого дайджеста
+    uint64_t capacity;
+    uint32_t verdictCount;
+    uint32_t flags;
+    uint32_t zeroVerdict;
+    uint32_t algorithms;        // с версии 5: маска алгоритмов сигнатур, раньше 0 (только MD5)
+    uint64_t verdictsOffset;
+    uint64_t verdictsSize;
+    uint64_t keysOffset;
+    uint64_t verdictIdsOffset;
+    uint64_t payloadChecksum;
+    uint64_t headerChecksum;    // по всем полям заголовка, кроме самой суммы
+    // версия 2
+    uint64_t filterOffset;
+    uint64_t filterBlocks;
+    // версия 3
+    uint64_t sizesOffset;
+    uint64_t sizesCount;
+    uint64_t unsizedCount;      // сигнатуры без размера: если есть, фильтр по размеру не работает
+    // версия 4
+    uint64_t prefixLength;
+    uint64_t prefixKeysOffset;
+    uint64_t prefixKeysCount;
+    uint64_t unprefixedOffset;
+    uint64_t unprefixedCount;
+};
+const uint32_t HEADER_SIZE_V1 = 104;
+const uint32_t HEADER_SIZE_V2 = 120;
+const uint32_t HEADER_SIZE_V3 = 144;
+static_assert(offsetof(DatabaseHeader, filterOffset) == HEADER_SIZE_V1, "version 1 header layout must not change");
+static_assert(offsetof(DatabaseHeader, sizesOffset) == HEADER_SIZE_V2, "version 2 header layout must not change");
+static_assert(offsetof(DatabaseHeader, prefixLength) == HEADER_SIZE_V3, "version 3 header layout must not change");
+static_assert(sizeof(DatabaseHeader) == 184, "database header layout must not change");
+static_assert(sizeof(SignatureIndex::PrefixKey) == 24, "prefix key layout must not change");
+
+const char DATABASE_MAGIC[8] = {'S', 'C', 'A', 'N', 'S', 'I', 'G', '\x1a'};
+const uint32_t FLAG_ZERO_KEY = 1;
+const size_t SECTION_ALIGNMENT = 64;
+
+size_t alignSection(size_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+}
+
+// Пустая секция не выравнивается: иначе в конце файла осталось бы выравнивание без данных
+size_t placeSection(size_t offset, size_t size) {
+    return size ? alignSection(offset) : offset;
+}
+
+uint64_t headerChecksum(const DatabaseHeader& header) {
+    // Поля новых версий дописаны после суммы, так что заголовок версии 1 считается как раньше
+    uint64_t checksum = checksum64(&header, offsetof(DatabaseHeader, headerChecksum), 0);
+    if (header.headerSize > HEADER_SIZE_V1) {
+        const uint8_t* tail = reinterpret_cast<const uint8_t*>(&header) + HEADER_SIZE_V1;
+        checksum = checksum64(tail, header.headerSize - HEADER_SIZE_V1, checksum);
+    }
+    return checksum;
+}
+
+uint32_t headerSizeFor(uint32_t version) {
+    switch (version) {
+    case 1: return HEADER_SIZE_V1;
+    case 2: return HEADER_SIZE_V2;
+    case 3: return HEADER_SIZE_V3;
+    case 4:
+    case 5: return sizeof(DatabaseHeader);
+    default: return 0;
+    }
+}
+
+bool fail(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+}
+
+SignatureIndex::SignatureIndex() = default;
+SignatureIndex::~SignatureIndex() = default;
+
+SignatureIndex::SignatureIndex(SignatureIndex&& other) noexcept {
+    *this = std::move(other);
+}
+
+SignatureIndex& SignatureIndex::operator=(SignatureIndex&& other) noexcept {
+    if (this != &other) {
+        // Буферы векторов и отображение переезжают вместе с указателями на них
+        keys_ = other.keys_;
+        verdictIds_ = other.verdictIds_;
+        capacity_ = other.capacity_;
+        size_ = other.size_;
+        hasZeroKey_ = other.hasZeroKey_;
+        zeroVerdict_ = other.zeroVerdict_;
+        ownedKeys_ = std::move(other.ownedKeys_);
+        ownedVerdictIds_ = std::move(other.ownedVerdictIds_);
+        mapping_ = std::move(other.mapping_);
+        filter_ = std::move(other.filter_);
+        sizes_ = std::move(other.sizes_);
+        unprefixedSizes_ = std::move(other.unprefixedSizes_);
+        prefixKeys_ = std::move(other.prefixKeys_);
+        prefixLength_ = other.prefixLength_;
+        unsizedCount_ = other.unsizedCount_;
+        algorithms_ = other.algorithms_;
+        verdicts_ = std::move(other.verdicts_);
+        verdictLookup_ = std::move(other.verdictLookup_);
+
+        other.keys_ = nullptr;
+        other.verdictIds_ = nullptr;
+        other.capacity_ = 0;
+        other.size_ = 0;
+        other.hasZeroKey_ = false;
+        other.unsizedCount_ = 0;
+        other.algorithms_ = 0;
+    }
+    return *this;
+}
+
+void SignatureIndex::reserve(size_t count) {
+    size_t needed = capacityFor(count);
+    if (needed > capacity_) {
+        rehash(needed);
+    }
+}
+
+bool SignatureIndex::insert(const MD5Digest& digest, const std::string& verdict) {
+    unsizedCount_++;
+    algorithms_ |= DIGEST_MD5;
+    return insertSignature(digest, verdict);
+}
+
+bool SignatureIndex::insert(const MD5Digest& digest, const std::string& verdict, uint64_t fileSize) {
+    algorithms_ |= DIGEST_MD5;
+    sizes_.add(fileSize);
+    unprefixedSizes_.add(fileSize);
+    return insertSignature(digest, verdict);
+}
+
+bool SignatureIndex::insert(const MD5Digest& digest, const std::string& verdict, uint64_t fileSize,
+                            const MD5Digest& prefix) {
+    Key key = toKey(prefix);
+    PrefixKey prefixKey;
+    prefixKey.fileSize = fileSize;
+    prefixKey.lo = key.lo;
+    prefixKey.hi = key.hi;
+    algorithms_ |= DIGEST_MD5;
+    sizes_.add(fileSize);
+    prefixKeys_.add(prefixKey);
+    return insertSignature(digest, verdict);
+}
+
+void SignatureIndex::addFileSizes(const std::vector<uint64_t>& sizes) {
+    sizes_.add(sizes.data(), sizes.size());
+    unprefixedSizes_.add(sizes.data(), sizes.size());
+}
+
+void SignatureIndex::addPrefixKeys(const std::vector<PrefixKey>& keys) {
+    std::vector<uint64_t> sizes;
+    sizes.reserve(keys.size());
+    for (const PrefixKey& key : keys) {
+        sizes.push_back(key.fileSize);
+    }
+    sizes_.add(sizes.data(), sizes.size());
+    prefixKeys_.add(keys.data(), keys.size());
+}
+
+bool SignatureIndex::setPrefixLength(uint64_t length) {
+    if (length == prefixLength_) {
+        return true;
+    }
+    if (length == 0 || !prefixKeys_.empty()) {
+        return false;
+    }
+    prefixLength_ = length;
+    return true;
+}
+
+bool SignatureIndex::insertSignature(const MD5Digest& digest, const std::string& verdict) {
+    uint32_t verdictId = internVerdict(verdict);
+    Key key = toKey(digest);
+    if ((key.lo | key.hi) == 0) {
+        bool added = !hasZeroKey_;
+        hasZeroKey_ = true;
+        zeroVerdict_ = verdictId;
+        return added;
+    }
+
+    if ((size_ + 1) * 100 > capacity_ * MAX_LOAD_PERCENT) {
+        rehash(std::max(capacityFor(size_ + 1), capacity_ * 2));
+    } else if (mapping_) {
+        detachMapping();
+    }
+    return insertKey(key, verdictId);
+}
+
+size_t SignatureIndex::insertBulk(const std::vector<std::vector<BulkEntry>>& batches, WorkStealingPool& pool) {
+    size_t total = 0;
+    for (const auto& batch : batches) {
+        total += batch.size();
+    }
+    if (total == 0) {
+        return 0;
+    }
+    reserve(size_ + total);
+    if (mapping_) {
+        detachMapping();
+    }
+
+    // Таблица делится на диапазоны слотов; все повторы дайджеста попадают в один
+    // диапазон, и его поток вставляет их в порядке файла. Запись, чье пробирование
+    // вышло за конец диапазона, откладывается и вставляется после всех потоков.
+    const size_t partitions = std::min(capacity_, pool.ThreadCount() * 8);
+    auto partitionOf = [&](const Key& key) { return homeSlot(key.lo) * partitions / capacity_; };
+    auto partitionBegin = [&](size_t p) { return p * capacity_ / partitions; };
+
+    // Номера записей каждой пачки по диапазонам; нулевые дайджесты - отдельно
+    std::vector<std::vector<std::vector<uint32_t>>> buckets(batches.size());
+    std::vector<std::vector<uint32_t>> zeroKeys(batches.size());
+    for (size_t b = 0; b < batches.size(); ++b) {
+        pool.PushTask([&, b]() {
+            const auto& batch = batches[b];
+            auto& batchBuckets = buckets[b];
+            batchBuckets.resize(partitions);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const Key& key = batch[i].key;
+                if ((key.lo | key.hi) == 0) {
+                    zeroKeys[b].push_back(static_cast<uint32_t>(i));
+                } else {
+                    batchBuckets[partitionOf(key)].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        });
+    }
+    pool.WaitIdle();
+
+    struct PartitionResult {
+        size_t inserted = 0;
+        size_t duplicates = 0;
+        std::vector<const BulkEntry*> deferred;
+    };
+    std::vector<PartitionResult> results(partitions);
+    for (size_t p = 0; p < partitions; ++p) {
+        pool.PushTask([&, p]() {
+            const size_t end = partitionBegin(p + 1);
+            PartitionResult& result = results[p];
+            for (size_t b = 0; b < batches.size(); ++b) {
+                for (uint32_t index : buckets[b][p]) {
+                    const BulkEntry& entry = batches[b][index];
+                    size_t i = homeSlot(entry.key.lo);
+                    while (true) {
+                        if (i == end) {
+                            result.deferred.push_back(&entry);
+                            break;
+                        }
+                        Key& slot = ownedKeys_[i];
+                        if ((slot.lo | slot.hi) == 0) {
+                            slot = entry.key;
+                            ownedVerdictIds_[i] = entry.verdictId;
+                            result.inserted++;
+                            break;
+                        }
+                        if (slot.lo == entry.key.lo && slot.hi == entry.key.hi) {
+                            ownedVerdictIds_[i] = entry.verdictId;
+                            result.duplicates++;
+                            break;
+                        }
+                        ++i;
+                    }
+                }
+            }
+        });
+    }
+    pool.WaitIdle();
+
+    size_t duplicates = 0;
+    for (const auto& result : results) {
+        size_ += result.inserted;
+        duplicates += result.duplicates;
+    }
+    for (const auto& result : results) {
+        for (const BulkEntry* entry : result.deferred) {
+            if (!insertKey(entry->key, entry->verdictId)) {
+                duplicates++;
+            }
+        }
+    }
+    for (size_t b = 0; b < batches.size(); ++b) {
+        for (uint32_t index : zeroKeys[b]) {
+            duplicates += hasZeroKey_ ? 1 : 0;
+            hasZeroKey_ = true;
+            zeroVerdict_ = batches[b][index].verdictId;
+        }
+    }
+
+    rebuildFilter();
+    return duplicates;
+}
+
+void SignatureIndex::merge(const SignatureIndex& other) {
+    reserve(size_ + other.size_);
+    for (size_t i = 0; i < other.capacity_; ++i) {
+        const Key& key = other.keys_[i];
+        if ((key.lo | key.hi) == 0) continue;
+        uint32_t id = other.verdictIds_[i];
+        if (id >= other.verdicts_.size()) continue;
+        MD5Digest digest;
+        std::memcpy(digest.data(), &key.lo, 8);
+        std::memcpy(digest.data() + 8, &key.hi, 8);
+        insertSignature(digest, other.verdicts_[id]);
+    }
+    if (other.hasZeroKey_) {
+        insertSignature(MD5Digest{}, other.verdicts_[other.zeroVerdict_]);
+    }
+    sizes_.add(other.sizes_.data(), other.sizes_.size());
+    unprefixedSizes_.add(other.unprefixedSizes_.data(), other.unprefixedSizes_.size());
+    // Ключи префикса другой длины несравнимы с нашими: такие сигнатуры
+    // проверяются полным хешем, как сигнатуры без ключа
+    if (setPrefixLength(other.prefixLength_)) {
+        prefixKeys_.add(other.prefixKeys_.data(), other.prefixKeys_.size());
+    } else {
+        for (size_t i = 0; i < other.prefixKeys_.size(); ++i) {
+            unprefixedSizes_.add(other.prefixKeys_.data()[i].fileSize);
+        }
+    }
+    unsizedCount_ += other.unsizedCount_;
+    algorithms_ |= other.algorithms_;
+}
+
+bool SignatureIndex::erase(const MD5Digest& digest) {
+    Key key = toKey(digest);
+    if ((key.lo | key.hi) == 0) {
+        bool erased = hasZeroKey_;
+        hasZeroKey_ = false;
+        return erased;
+    }
+    if (size_ == 0 || probe(key) == nullptr) {
+        return false;
+    }
+    if (mapping_) {
+        detachMapping();
+    }
+    size_t i = homeSlot(key.lo);
+    while (ownedKeys_[i].lo != key.lo || ownedKeys_[i].hi != key.hi) {
+        if (++i == capacity_) i = 0;
+    }
+    // Сдвиг назад: ключи цепочки за дыркой, чей домашний слот не между
+    // дыркой и ними, переезжают в дырку, чтобы поиск не обрывался на ней
+    size_t hole = i;
+    size_t j = i;
+    while (true) {
+        if (++j == capacity_) j = 0;
+        const Key& next = ownedKeys_[j];
+        if ((next.lo | next.hi) == 0) {
+            break;
+        }
+        size_t home = homeSlot(next.lo);
+        bool staysBehind = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!staysBehind) {
+            ownedKeys_[hole] = next;
+            ownedVerdictIds_[hole] = ownedVerdictIds_[j];
+            hole = j;
+        }
+    }
+    ownedKeys_[hole] = Key();
+    ownedVerdictIds_[hole] = 0;
+    size_--;
+    return true;
+}
+
+bool SignatureIndex::insertKey(const Key& key, uint32_t verdictId) {
+    size_t i = homeSlot(key.lo);
+    while (true) {
+        Key& slot = ownedKeys_[i];
+        if ((slot.lo | slot.hi) == 0) {
+            slot = key;
+            ownedVerdictIds_[i] = verdictId;
+            filter_.add(key.lo, key.hi);
+            size_++;
+            return true;
+        }
+        if (slot.lo == key.lo && slot.hi == key.hi) {
+            ownedVerdictIds_[i] = verdictId;
+            return false;
+        }
+        if (++i == capacity_) i = 0;
+    }
+}
+
+void SignatureIndex::rehash(size_t newCapacity) {
+    std::vector<Key> oldKeys(keys_, keys_ + capacity_);
+    std::vector<uint32_t> oldVerdicts(verdictIds_, verdictIds_ + capacity_);
+    sizes_.detach();
+    unprefixedSizes_.detach();
+    prefixKeys_.detach();
+    mapping_.reset();
+
+    ownedKeys_.assign(newCapacity, Key());
+    ownedVerdictIds_.assign(newCapacity, 0);
+    // Фильтр рассчитан на наибольшее число ключей до следующей перестройки
+    filter_.init(newCapacity * MAX_LOAD_PERCENT / 100);
+    keys_ = ownedKeys_.data();
+    verdictIds_ = ownedVerdictIds_.data();
+    capacity_ = newCapacity;
+
+    size_ = 0;
+    for (size_t i = 0; i < oldKeys.size(); ++i) {
+        if ((oldKeys[i].lo | oldKeys[i].hi) != 0) {
+            insertKey(oldKeys[i], oldVerdicts[i]);
+        }
+    }
+}
+
+void SignatureIndex::detachMapping() {
+    ownedKeys_.assign(keys_, keys_ + capacity_);
+    ownedVerdictIds_.assign(verdictIds_, verdictIds_ + capacity_);
+    keys_ = ownedKeys_.data();
+    verdictIds_ = ownedVerdictIds_.data();
+    rebuildFilter();
+    sizes_.detach();
+    unprefixedSizes_.detach();
+    prefixKeys_.detach();
+    mapping_.reset();
+}
+
+void SignatureIndex::rebuildFilter() {
+    filter_.init(capacity_ * MAX_LOAD_PERCENT / 100);
+    for (size_t i = 0; i < capacity_; ++i) {
+        if ((keys_[i].lo | keys_[i].hi) != 0) {
+            filter_.add(keys_[i].lo, keys_[i].hi);
+        }
+    }
+}
+
+uint32_t SignatureIndex::internVerdict(const std::string& verdict) {
+    auto it = verdictLookup_.find(verdict);
+    if (it != verdictLookup_.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(verdicts_.size());
+    verdicts_.push_back(verdict);
+    verdictLookup_.emplace(verdict, id);
+    return id;
+}
+
+size_t SignatureIndex::memoryUsage() const {
+    size_t bytes = mapping_ ? mapping_->size()
+                            : ownedKeys_.capacity() * sizeof(Key) + ownedVerdictIds_.capacity() * sizeof(uint32_t) +
+                                  filter_.sizeBytes() + sizes_.sizeBytes() + unprefixedSizes_.sizeBytes() +
+                                  prefixKeys_.sizeBytes();
+    for (const auto& verdict : verdicts_) {
+        bytes += sizeof(std::string) + verdict.capacity();
+    }
+    return bytes;
+}
+
+void SignatureIndex::clear() {
+    std::vector<Key>().swap(ownedKeys_);
+    std::vector<uint32_t>().swap(ownedVerdictIds_);
+    mapping_.reset();
+    filter_.clear();
+    sizes_.clear();
+    unprefixedSizes_.clear();
+    prefixKeys_.clear();
+    prefixLength_ = DEFAULT_PREFIX_LENGTH;
+    unsizedCount_ = 0;
+    algorithms_ = 0;
+    keys_ = nullptr;
+    verdictIds_ = nullptr;
+    capacity_ = 0;
+    size_ = 0;
+    hasZeroKey_ = false;
+    zeroVerdict_ = 0;
+    verdicts_.clear();
+    verdictLookup_.clear();
+}
+
+bool SignatureIndex::save(const std::string& path, std::string* error) const {
+    // Таблица вердиктов: смещения строк, затем сами строки подряд
+    std::string verdictTable((verdicts_.size() + 1) * sizeof(uint32_t), '\0');
+    uint32_t offset = 0;
+    for (size_t i = 0; i <= verdicts_.size(); ++i) {
+        std::memcpy(&verdictTable[i * sizeof(uint32_t)], &offset, sizeof(offset));
+        if (i < verdicts_.size()) {
+            offset += static_cast<uint32_t>(verdicts_[i].size());
+        }
+    }
+    for (const auto& verdict : verdicts_) {
+        verdictTable += verdict;
+    }
+
+    DatabaseHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, DATABASE_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.headerSize = sizeof(DatabaseHeader);
+    header.signatureCount = size_;
+    header.capacity = capacity_;
+    header.verdictCount = static_cast<uint32_t>(verdicts_.size());
+    header.flags = hasZeroKey_ ? FLAG_ZERO_KEY : 0;
+    header.zeroVerdict = zeroVerdict_;
+    header.algorithms = algorithms_;
+    header.verdictsOffset = alignSection(sizeof(DatabaseHeader));
+    header.verdictsSize = verdictTable.size();
+    header.keysOffset = alignSection(header.verdictsOffset + header.verdictsSize);
+    header.verdictIdsOffset = alignSection(header.keysOffset + capacity_ * sizeof(Key));
+    header.filterOffset = alignSection(header.verdictIdsOffset + capacity_ * sizeof(uint32_t));
+    header.filterBlocks = filter_.blockCount();
+    header.sizesOffset = placeSection(header.filterOffset + filter_.sizeBytes(), sizes_.sizeBytes());
+    header.sizesCount = sizes_.size();
+    header.unsizedCount = unsizedCount_;
+    header.prefixLength = prefixLength_;
+    header.prefixKeysOffset = placeSection(header.sizesOffset + sizes_.sizeBytes(), prefixKeys_.sizeBytes());
+    header.prefixKeysCount = prefixKeys_.size();
+    header.unprefixedOffset = placeSection(header.prefixKeysOffset + prefixKeys_.sizeBytes(),
+                                           unprefixedSizes_.sizeBytes());
+    header.unprefixedCount = unprefixedSizes_.size();
+    header.fileSize = header.unprefixedOffset + unprefixedSizes_.sizeBytes();
+
+    uint64_t checksum = checksum64(verdictTable.data(), verdictTable.size(), 0);
+    checksum = checksum64(keys_, capacity_ * sizeof(Key), checksum);
+    checksum = checksum64(verdictIds_, capacity_ * sizeof(uint32_t), checksum);
+    checksum = checksum64(filter_.blocks(), filter_.sizeBytes(), checksum);
+    checksum = checksum64(sizes_.data(), sizes_.sizeBytes(), checksum);
+    checksum = checksum64(prefixKeys_.data(), prefixKeys_.sizeBytes(), checksum);
+    checksum = checksum64(unprefixedSizes_.data(), unprefixedSizes_.sizeBytes(), checksum);
+    header.payloadChecksum = checksum;
+    header.headerChecksum = headerChecksum(header);
+
+    // База пишется рядом и подменяет старую только целиком записанной: старый файл
+    // может быть отображен этим или другим процессом (и быть источником этого индекса),
+    // а запись поверх него дала бы SIGBUS или оставила бы обрезанную базу
+    std::string tempPath = path + ".tmp";
+    OutputFile file;
+    if (!file.open(tempPath, true)) {
+        return fail(error, "Cannot create file: " + tempPath);
+    }
+
+    const char padding[SECTION_ALIGNMENT] = {};
+    uint64_t position = 0;
+    auto writeSection = [&](uint64_t sectionOffset, const void* data, size_t size) {
+        bool ok = file.write(padding, static_cast<size_t>(sectionOffset - position)) && file.write(data, size);
+        position = sectionOffset + size;
+        return ok;
+    };
+    bool written = writeSection(0, &header, sizeof(header)) &&
+                   writeSection(header.verdictsOffset, verdictTable.data(), verdictTable.size()) &&
+                   writeSection(header.keysOffset, keys_, capacity_ * sizeof(Key)) &&
+                   writeSection(header.verdictIdsOffset, verdictIds_, capacity_ * sizeof(uint32_t)) &&
+                   writeSection(header.filterOffset, filter_.blocks(), filter_.sizeBytes()) &&
+                   writeSection(header.sizesOffset, sizes_.data(), sizes_.sizeBytes()) &&
+                   writeSection(header.prefixKeysOffset, prefixKeys_.data(), prefixKeys_.sizeBytes()) &&
+                   writeSection(header.unprefixedOffset, unprefixedSizes_.data(), unprefixedSizes_.sizeBytes()) &&
+                   file.sync();
+    file.close();
+    if (!written || !OutputFile::replace(tempPath, path)) {
+        std::remove(tempPath.c_str());
+        return fail(error, "File write error: " + path);
+    }
+    return true;
+}
+
+bool SignatureIndex::openMapped(const std::string& path, bool verifyPayload, std::string* error) {
+    std::unique_ptr<MappedFile> mapping(new MappedFile());
+    if (!mapping->open(path)) {
+        return fail(error, "Cannot open file: " + path);
+    }
+
+    const uint8_t* data = mapping->data();
+    const uint64_t fileSize = mapping->size();
+    DatabaseHeader header;
+    std::memset(&header, 0, sizeof(header));
+    if (fileSize < HEADER_SIZE_V1) {
+        return fail(error, "File is too small for a signature database");
+    }
+    std::memcpy(&header, data, HEADER_SIZE_V1);
+
+    if (std::memcmp(header.magic, DATABASE_MAGIC, sizeof(header.magic)) != 0) {
+        return fail(error, "Not a signature database");
+    }
+    const uint32_t headerSize = headerSizeFor(header.version);
+    if (headerSize == 0 || header.headerSize != headerSize || fileSize < headerSize) {
+        return fail(error, "Unsupported signature database version " + std::to_string(header.version));
+    }
+    std::memcpy(&header, data, headerSize);
+    if (header.headerChecksum != headerChecksum(header)) {
+        return fail(error, "Signature database header is corrupted");
+    }
+
+    // Секции проверяются до обращения к данным, с защитой от переполнения
+    const uint64_t capacity = header.capacity;
+    bool layoutOk = header.fileSize == fileSize &&
+                    capacity <= fileSize / sizeof(Key) &&
+                    (capacity == 0 ? header.signatureCount == 0 : header.signatureCount < capacity) &&
+                    header.verdictsOffset >= headerSize &&
+                    header.verdictsOffset <= fileSize &&
+                    header.verdictsSize <= fileSize - header.verdictsOffset &&
+                    header.keysOffset % alignof(Key) == 0 &&
+                    header.keysOffset <= fileSize &&
+                    capacity * sizeof(Key) <= fileSize - header.keysOffset &&
+                    header.verdictIdsOffset % alignof(uint32_t) == 0 &&
+                    header.verdictIdsOffset <= fileSize &&
+                    capacity * sizeof(uint32_t) <= fileSize - header.verdictIdsOffset &&
+                    header.verdictCount < header.verdictsSize / sizeof(uint32_t) &&
+                    (!(header.flags & FLAG_ZERO_KEY) || header.zeroVerdict < header.verdictCount) &&
+                    header.filterOffset % alignof(BlockedBloomFilter::Block) == 0 &&
+                    header.filterOffset <= fileSize &&
+                    header.filterBlocks <= (fileSize - header.filterOffset) / sizeof(BlockedBloomFilter::Block) &&
+                    header.sizesOffset % alignof(uint64_t) == 0 &&
+                    header.sizesOffset <= fileSize &&
+                    header.sizesCount <= (fileSize - header.sizesOffset) / sizeof(uint64_t) &&
+                    header.prefixKeysOffset % alignof(PrefixKey) == 0 &&
+                    header.prefixKeysOffset <= fileSize &&
+                    header.prefixKeysCount <= (fileSize - header.prefixKeysOffset) / sizeof(PrefixKey) &&
+                    header.unprefixedOffset % alignof(uint64_t) == 0 &&
+                    header.unprefixedOffset <= fileSize &&
+                    header.unprefixedCount <= (fileSize - header.unprefixedOffset) / sizeof(uint64_t) &&
+                    (header.version < 4 || header.prefixLength > 0);
+    if (!layoutOk) {
+        return fail(error, "Signature database layout is corrupted");
+    }
+
+    const uint8_t* verdictTable = data + header.verdictsOffset;
+    const uint8_t* keys = data + header.keysOffset;
+    const uint8_t* verdictIds = data + header.verdictIdsOffset;
+    const uint8_t* filter = data + header.filterOffset;
+    const size_t filterSize = header.filterBlocks * sizeof(BlockedBloomFilter::Block);
+    const uint8_t* sizes = data + header.sizesOffset;
+    const uint8_t* prefixKeys = data + header.prefixKeysOffset;
+    const uint8_t* unprefixed = data + header.unprefixedOffset;
+
+    if (verifyPayload) {
+        uint64_t checksum = checksum64(verdictTable, header.verdictsSize, 0);
+        checksum = checksum64(keys, capacity * sizeof(Key), checksum);
+        checksum = checksum64(verdictIds, capacity * sizeof(uint32_t), checksum);
+        if (header.version >= 2) {
+            checksum = checksum64(filter, filterSize, checksum);
+        }
+        if (header.version >= 3) {
+            checksum = checksum64(sizes, header.sizesCount * sizeof(uint64_t), checksum);
+        }
+        if (header.version >= 4) {
+            checksum = checksum64(prefixKeys, header.prefixKeysCount * sizeof(PrefixKey), checksum);
+            checksum = checksum64(unprefixed, header.unprefixedCount * sizeof(uint64_t), checksum);
+        }
+        if (checksum != header.payloadChecksum) {
+            return fail(error, "Signature database checksum mismatch");
+        }
+    }
+
+    // Вердиктов немного, их строки материализуются сразу
+    const size_t offsetsSize = (header.verdictCount + 1) * sizeof(uint32_t);
+    const size_t textSize = header.verdictsSize - offsetsSize;
+    std::vector<std::string> verdicts;
+    verdicts.reserve(header.verdictCount);
+    uint32_t begin;
+    std::memcpy(&begin, verdictTable, sizeof(begin));
+    for (uint32_t i = 0; i < header.verdictCount; ++i) {
+        uint32_t end;
+        std::memcpy(&end, verdictTable + (i + 1) * sizeof(uint32_t), sizeof(end));
+        if (begin > end || end > textSize) {
+            return fail(error, "Signature database verdict table is corrupted");
+        }
+        verdicts.emplace_back(reinterpret_cast<const char*>(verdictTable + offsetsSize + begin), end - begin);
+        begin = end;
+    }
+
+    clear();
+    for (uint32_t i = 0; i < verdicts.size(); ++i) {
+        verdictLookup_.emplace(verdicts[i], i);
+    }
+    verdicts_ = std::move(verdicts);
+    keys_ = reinterpret_cast<const Key*>(keys);
+    verdictIds_ = reinterpret_cast<const uint32_t*>(verdictIds);
+    capacity_ = static_cast<size_t>(capacity);
+    size_ = static_cast<size_t>(header.signatureCount);
+    hasZeroKey_ = (header.flags & FLAG_ZERO_KEY) != 0;
+    zeroVerdict_ = header.zeroVerdict;
+    mapping_ = std::move(mapping);
+    // База версии 1 без фильтра: пустой фильтр пропускает все запросы к таблице
+    filter_.attach(reinterpret_cast<const BlockedBloomFilter::Block*>(filter),
+                   static_cast<size_t>(header.filterBlocks));
+    // До версии 3 размеры не хранились: ни одна сигнатура не считается с размером
+    if (header.version >= 3) {
+        sizes_.attach(reinterpret_cast<const uint64_t*>(sizes), static_cast<size_t>(header.sizesCount));
+        unsizedCount_ = header.unsizedCount;
+    } else {
+        unsizedCount_ = size();
+    }
+    // До версии 4 ключей префикса нет: все размеры - сигнатур без ключа
+    if (header.version >= 4) {
+        prefixKeys_.attach(reinterpret_cast<const PrefixKey*>(prefixKeys), static_cast<size_t>(header.prefixKeysCount));
+        unprefixedSizes_.attach(reinterpret_cast<const uint64_t*>(unprefixed),
+                                static_cast<size_t>(header.unprefixedCount));
+        prefixLength_ = header.prefixLength;
+    } else {
+        unprefixedSizes_.attach(sizes_.data(), sizes_.size());
+    }
+    // До версии 5 в базе были только сигнатуры MD5
+    algorithms_ = header.version >= 5 ? header.algorithms : DIGEST_MD5;
+    return true;
+}
+
+bool SignatureIndex::isDatabaseFile(const std::string& path) {
+    InputFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    char magic[sizeof(DATABASE_MAGIC)];
+    return file.read(magic, sizeof(magic)) == static_cast<int64_t>(sizeof(magic)) &&
+           std::memcmp(magic, DATABASE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool SignatureIndex::parseHex(const char* text, size_t length, MD5Digest& digest, bool* uppercase) {
+    return parseHex(text, length, digest.data(), digest.size(), uppercase);
+}
+
+bool SignatureIndex::parseHex(const char* text, size_t length, uint8_t* digest, size_t size, bool* uppercase) {
+    if (length != 2 * size) {
+        return false;
+    }
+    bool upper = false;
+    size_t done = 0;
+#ifdef SIGNATURE_INDEX_SSE2
+    for (; done + 16 <= size; done += 16) {
+        if (!parseHex16(text + 2 * done, digest + done, upper)) {
+            return false;
+        }
+    }
+#endif
+    if (!parseHexScalar(text + 2 * done, size - done, digest + done, upper)) {
+        return false;
+    }
+    if (uppercase) *uppercase = upper;
+    return true;
+}
+
+MD5Digest SignatureIndex::keyDigest(HashAlgorithm algorithm, const uint8_t* digest) {
+    MD5Digest key;
+    std::memcpy(key.data(), digest, key.size());
+    const uint64_t* salt = nullptr;
+    if (algorithm == HashAlgorithm::SHA1) {
+        salt = SHA1_KEY_SALT;
+    } else if (algorithm == HashAlgorithm::SHA256) {
+        salt = SHA256_KEY_SALT;
+    }
+    if (salt) {
+        Key value = toKey(key);
+        value.lo ^= salt[0];
+        value.hi ^= salt[1];
+        std::memcpy(key.data(), &value.lo, 8);
+        std::memcpy(key.data() + 8, &value.hi, 8);
+    }
+    return key;
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bloom_filter.h"
+#include "digest_set.h"
+#include "md5.h"
+#include "scanner_api.h"
+#include "sorted_set.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+class MappedFile;
+class WorkStealingPool;
+
+/**
+ * Индекс сигнатур: двоичные 16-байтные дайджесты в плоской таблице
+ * с открытой адресацией (линейное пробирование), вердикты интернированы
+ * и хранятся отдельным массивом номеров - он читается только при попадании.
+ * Пустой слот - нулевой ключ; нулевой дайджест хранится отдельно.
+ *
+ * Перед таблицей стоит блочный фильтр Блума: почти все проверяемые файлы
+ * чистые, и для них поиск заканчивается одним обращением к компактному
+ * фильтру вместо промаха по большой таблице.
+ *
+ * Таблица сохраняется в двоичный файл базы (save) и открывается из него
+ * через mmap без разбора (openMapped): поиск идет прямо по страницам файла.
+ *
+ * Если у каждой сигнатуры известен размер файла, индекс хранит множество
+ * этих размеров: файл другого размера сканер не хеширует (mayMatchSize).
+ *
+ * Сигнатура может нести и ключ префикса: размер файла и MD5 его первых
+ * prefixLength() байт. Крупный файл, у размера которого все сигнатуры с
+ * ключами (usesPrefixKey), сканер сначала проверяет по префиксу и читает
+ * целиком, только если ключ префикса совпал (mayMatchPrefix).
+ *
+ * Кроме MD5 база может хранить сигнатуры SHA-1 и SHA-256 в той же таблице:
+ * их ключ - первые 16 байт дайджеста с солью алгоритма (keyDigest), чтобы
+ * ключи разных алгоритмов не пересекались. Маска algorithms() говорит
+ * сканеру, какие дайджесты считать для файла.
+ */
+class SCANNER_API SignatureIndex {
+public:
+    struct Key {
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+    };
+
+    // Ключ префикса: размер файла и MD5 его первых prefixLength() байт
+    struct PrefixKey {
+        uint64_t fileSize = 0;
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+
+        bool operator<(const PrefixKey& other) const {
+            if (fileSize != other.fileSize) return fileSize < other.fileSize;
+            if (lo != other.lo) return lo < other.lo;
+            return hi < other.hi;
+        }
+        bool operator==(const PrefixKey& other) const {
+            return fileSize == other.fileSize && lo == other.lo && hi == other.hi;
+        }
+    };
+
+    // Запись для пакетной вставки: вердикт уже интернирован (internVerdict)
+    struct BulkEntry {
+        Key key;
+        uint32_t verdictId;
+    };
+
+    // Максимальная заполненность таблицы, в процентах
+    static constexpr size_t MAX_LOAD_PERCENT = 70;
+    // Версия формата двоичной базы (1 - без фильтра, 2 - без размеров,
+    // 3 - без ключей префикса, 4 - только MD5; читаются для совместимости)
+    static constexpr uint32_t FORMAT_VERSION = 5;
+    // Длина префикса по умолчанию
+    static constexpr uint64_t DEFAULT_PREFIX_LENGTH = 64 * 1024;
+
+    SignatureIndex();
+    ~SignatureIndex();
+    SignatureIndex(SignatureIndex&&) noexcept;
+    SignatureIndex& operator=(SignatureIndex&&) noexcept;
+    SignatureIndex(const SignatureIndex&) = delete;
+    SignatureIndex& operator=(const SignatureIndex&) = delete;
+
+    void reserve(size_t count);
+
+    // Добавляет сигнатуру; для повторного дайджеста остается последний вердикт.
+    // Отображенная из файла таблица перед изменением копируется в память.
+    // false, если дайджест уже был в базе. Без размера файла фильтр по размеру отключается.
+    bool insert(const MD5Digest& digest, const std::string& verdict);
+    bool insert(const MD5Digest& digest, const std::string& verdict, uint64_t fileSize);
+    // Сигнатура с ключом префикса длиной prefixLength()
+    bool insert(const MD5Digest& digest, const std::string& verdict, uint64_t fileSize, const MD5Digest& prefix);
+
+    // Параллельная вставка: пачки и записи в них идут в порядке файла, результат
+    // тот же, что у последовательных insert. Возвращает число повторных дайджестов.
+    // Размеры файлов передаются отдельно: addFileSizes, addPrefixKeys и addUnsizedSignatures.
+    size_t insertBulk(const std::vector<std::vector<BulkEntry>>& batches, WorkStealingPool& pool);
+
+    // Размеры файлов сигнатур без ключа префикса
+    void addFileSizes(const std::vector<uint64_t>& sizes);
+    // Ключи префикса длиной prefixLength() вместе с размерами их файлов
+    void addPrefixKeys(const std::vector<PrefixKey>& keys);
+    // Сигнатуры без размера: файл любого размера может совпасть
+    void addUnsizedSignatures(uint64_t count) { unsizedCount_ += count; }
+
+    // Номер вердикта в таблице вердиктов, новый вердикт добавляется
+    uint32_t internVerdict(const std::string& verdict);
+
+    // Добавляет все сигнатуры другого индекса, при совпадении побеждает other
+    void merge(const SignatureIndex& other);
+
+    // Удаляет сигнатуру; false, если ее не было. Размеры и ключи префикса
+    // остаются (фильтры только пропускают лишнее), ключ остается в фильтре Блума
+    bool erase(const MD5Digest& digest);
+
+    // Сигнатура SHA-1/SHA-256 вставляется через insert с keyDigest; маска
+    // алгоритмов базы дополняется отдельно
+    void addAlgorithms(DigestMask mask) { algorithms_ |= mask; }
+    // Алгоритмы, дайджесты которых есть в базе (DIGEST_MD5 и т.д.)
+    DigestMask algorithms() const { return algorithms_; }
+
+    // Ключ таблицы для дайджеста алгоритма: MD5 как есть, SHA-1 и SHA-256 -
+    // первые 16 байт с солью алгоритма. XXH3 сигнатурой быть не может.
+    static MD5Digest keyDigest(HashAlgorithm algorithm, const uint8_t* digest);
+
+    // Вердикт сигнатуры или nullptr; digest - digestSize(algorithm) байт
+    const std::string* find(HashAlgorithm algorithm, const uint8_t* digest) const {
+        // MD5 - основной алгоритм: его сигнатуры ищутся всегда
+        if (algorithm == HashAlgorithm::XXH3 ||
+            (algorithm != HashAlgorithm::MD5 && !(algorithms_ & digestBit(algorithm)))) {
+            return nullptr;
+        }
+        return find(keyDigest(algorithm, digest));
+    }
+
+    // Вердикт сигнатуры или nullptr, если дайджеста нет в базе
+    const std::string* find(const MD5Digest& digest) const {
+        Key key = toKey(digest);
+        if ((key.lo | key.hi) == 0) {
+            return hasZeroKey_ ? &verdicts_[zeroVerdict_] : nullptr;
+        }
+        if (size_ == 0 || !filter_.mayContain(key.lo, key.hi)) {
+            return nullptr;
+        }
+        return probe(key);
+    }
+
+    // Поиск только по таблице, без фильтра (для сравнения в бенчмарках)
+    const std::string* findUnfiltered(const MD5Digest& digest) const {
+        Key key = toKey(digest);
+        if ((key.lo | key.hi) == 0) {
+            return hasZeroKey_ ? &verdicts_[zeroVerdict_] : nullptr;
+        }
+        return size_ == 0 ? nullptr : probe(key);
+    }
+
+    bool contains(const MD5Digest& digest) const { return find(digest) != nullptr; }
+
+    // Обходит все сигнатуры: f(digest, verdict)
+    template <class F>
+    void forEach(F&& f) const {
+        if (hasZeroKey_) {
+            f(MD5Digest{}, verdicts_[zeroVerdict_]);
+        }
+        for (size_t i = 0; i < capacity_; ++i) {
+            const Key& key = keys_[i];
+            uint32_t id = verdictIds_[i];
+            if ((key.lo | key.hi) == 0 || id >= verdicts_.size()) continue;
+            MD5Digest digest;
+            std::memcpy(digest.data(), &key.lo, 8);
+            std::memcpy(digest.data() + 8, &key.hi, 8);
+            f(digest, verdicts_[id]);
+        }
+    }
+
+    // Размер известен у всех сигнатур, и файлы можно отсеивать по нему
+    bool hasSizeFilter() const { return unsizedCount_ == 0 && !sizes_.empty(); }
+    // false - файл такого размера не совпадет ни с одной сигнатурой
+    bool mayMatchSize(uint64_t fileSize) const { return !hasSizeFilter() || sizes_.contains(fileSize); }
+    size_t fileSizeCount() const { return sizes_.size(); }
+    // Различных размеров здесь и в other вместе (база и ее дельта)
+    size_t fileSizeCount(const SignatureIndex& other) const { return sizes_.unionSize(other.sizes_); }
+
+    // Длину префикса можно поменять, пока в индексе нет ключей префикса
+    bool setPrefixLength(uint64_t length);
+    uint64_t prefixLength() const { return prefixLength_; }
+    size_t prefixKeyCount() const { return prefixKeys_.size(); }
+    size_t prefixKeyCount(const SignatureIndex& other) const { return prefixKeys_.unionSize(other.prefixKeys_); }
+
+    // true - у всех сигнатур с таким размером есть ключ префикса, и файл
+    // длиннее префикса можно отсеять, прочитав только префикс
+    bool usesPrefixKey(uint64_t fileSize) const {
+        return fileSize > prefixLength_ && hasSizeFilter() && !prefixKeys_.empty() &&
+               !unprefixedSizes_.contains(fileSize);
+    }
+    // false - файл с таким размером и дайджестом префикса не совпадет ни с одной сигнатурой
+    bool mayMatchPrefix(uint64_t fileSize, const MD5Digest& prefix) const {
+        Key key = toKey(prefix);
+        PrefixKey prefixKey;
+        prefixKey.fileSize = fileSize;
+        prefixKey.lo = key.lo;
+        prefixKey.hi = key.hi;
+        return prefixKeys_.contains(prefixKey);
+    }
+
+    size_t size() const { return size_ + (hasZeroKey_ ? 1 : 0); }
+    size_t capacity() const { return capacity_; }
+    size_t verdictCount() const { return verdicts_.size(); }
+    bool isMapped() const { return mapping_ != nullptr; }
+    size_t filterBytes() const { return filter_.sizeBytes(); }
+
+    // Память, занятая таблицей и вердиктами, в байтах (для отображенной базы - размер файла)
+    size_t memoryUsage() const;
+
+    void clear();
+
+    // Записывает таблицу в двоичный файл базы
+    bool save(const std::string& path, std::string* error = nullptr) const;
+
+    // Открывает двоичную базу через mmap. Заголовок, его контрольная сумма и
+    // границы секций проверяются всегда; контрольная сумма данных - только
+    // при verifyPayload, потому что требует прочитать весь файл.
+    bool openMapped(const std::string& path, bool verifyPayload = false, std::string* error = nullptr);
+
+    // true, если файл начинается с сигнатуры двоичной базы
+    static bool isDatabaseFile(const std::string& path);
+
+    // Разбирает 32 hex-символа (регистр не важен); false при неверном формате.
+    // uppercase сообщает, встретились ли заглавные буквы.
+    static bool parseHex(const char* text, size_t length, MD5Digest& digest, bool* uppercase = nullptr);
+    // То же для дайджеста из size байт (2 * size символов)
+    static bool parseHex(const char* text, size_t length, uint8_t* digest, size_t size, bool* uppercase = nullptr);
+
+    static Key toKey(const MD5Digest& digest) {
+        Key key;
+        std::memcpy(&key.lo, digest.data(), 8);
+        std::memcpy(&key.hi, digest.data() + 8, 8);
+        return key;
+    }
+
+private:
+    // Таблица либо своя (ownedKeys_), либо смотрит в отображенный файл
+    const Key* keys_ = nullptr;
+    const uint32_t* verdictIds_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    bool hasZeroKey_ = false;
+    uint32_t zeroVerdict_ = 0;
+
+    std::vector<Key> ownedKeys_;
+    std::vector<uint32_t> ownedVerdictIds_;
+    std::unique_ptr<MappedFile> mapping_;
+    BlockedBloomFilter filter_;
+    FileSizeSet sizes_;
+    FileSizeSet unprefixedSizes_;       // размеры сигнатур без ключа префикса
+    SortedSet<PrefixKey> prefixKeys_;
+    uint64_t prefixLength_ = DEFAULT_PREFIX_LENGTH;
+    uint64_t unsizedCount_ = 0;
+    DigestMask algorithms_ = 0;
+
+    std::vector<std::string> verdicts_;
+    std::unordered_map<std::string, uint32_t> verdictLookup_;
+
+    const std::string* probe(const Key& key) const {
+        size_t i = homeSlot(key.lo);
+        // Ограничение числа проб защищает от поврежденного файла без пустых слотов
+        for (size_t probes = 0; probes < capacity_; ++probes) {
+            const Key& slot = keys_[i];
+            if (slot.lo == key.lo && slot.hi == key.hi) {
+                uint32_t id = verdictIds_[i];
+                return id < verdicts_.size() ? &verdicts_[id] : nullptr;
+            }
+            if ((slot.lo | slot.hi) == 0) {
+                return nullptr;
+            }
+            if (++i == capacity_) i = 0;
+        }
+        return nullptr;
+    }
+
+    // Дайджест MD5 уже равномерно распределен: отображаем старшие биты
+    // произведения на размер таблицы, который не обязан быть степенью двойки
+    size_t homeSlot(uint64_t hash) const {
+        uint64_t n = capacity_;
+#if defined(__SIZEOF_INT128__)
+        __extension__ typedef unsigned __int128 Wide;
+        return static_cast<size_t>((static_cast<Wide>(hash) * n) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<size_t>(__umulh(hash, n));
+#else
+        return static_cast<size_t>(hash % n);
+#endif
+    }
+
+    bool insertSignature(const MD5Digest& digest, const std::string& verdict);
+    void rehash(size_t newCapacity);
+    bool insertKey(const Key& key, uint32_t verdictId);
+    void detachMapping();
+    void rebuildFilter();
+};
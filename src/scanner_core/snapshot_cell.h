@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Ячейка с неизменяемым снимком: многие потоки читают его без блокировок,
+ * редкий писатель заменяет целиком (в духе RCU).
+ *
+ * Читатель (pin) занимает свободный слот эпох через CAS, записывает в него
+ * текущую эпоху и только затем берет указатель на снимок. Писатель меняет
+ * указатель, сдвигает эпоху и откладывает старый снимок с эпохой, в которую
+ * его сняли. Снимок освобождается, когда ни один слот не держит эпоху
+ * не новее этой: читатель, закрепившийся позже, уже видит новый указатель.
+ * Все операции - seq_cst, на этом и держится порядок "слот, затем указатель".
+ *
+ * Слоты не привязаны к потокам, поэтому вложенные pin в одном потоке
+ * допустимы; поток начинает поиск слота со своего прошлого. Если все SLOTS
+ * заняты, читатель ждет, уступая процессор.
+ *
+ * publish, reclaim и current вызываются писателями по очереди: сериализация
+ * на владельце ячейки. Отложенные снимки освобождаются в publish и reclaim.
+ */
+template <class T>
+class SnapshotCell {
+public:
+    static constexpr size_t SLOTS = 256;
+
+    // Закрепленный снимок: живет, пока жив Guard
+    class Guard {
+    public:
+        Guard() = default;
+        Guard(Guard&& other) noexcept : slot_(other.slot_), value_(other.value_) {
+            other.slot_ = nullptr;
+            other.value_ = nullptr;
+        }
+        Guard& operator=(Guard&& other) noexcept {
+            if (this != &other) {
+                release();
+                slot_ = other.slot_;
+                value_ = other.value_;
+                other.slot_ = nullptr;
+                other.value_ = nullptr;
+            }
+            return *this;
+        }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        ~Guard() { release(); }
+
+        const T* get() const { return value_; }
+        const T& operator*() const { return *value_; }
+        const T* operator->() const { return value_; }
+
+        void release() {
+            if (slot_) {
+                slot_->store(0);
+                slot_ = nullptr;
+                value_ = nullptr;
+            }
+        }
+
+    private:
+        friend class SnapshotCell;
+        Guard(std::atomic<uint64_t>* slot, const T* value) : slot_(slot), value_(value) {}
+
+        std::atomic<uint64_t>* slot_ = nullptr;
+        const T* value_ = nullptr;
+    };
+
+    explicit SnapshotCell(std::unique_ptr<T> initial) : current_(initial.release()) {}
+
+    // Читателей к этому моменту быть не должно
+    ~SnapshotCell() {
+        delete current_.load();
+    }
+
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    Guard pin() const {
+        thread_local size_t hint = nextHint();
+        for (size_t attempt = 0;; ++attempt) {
+            size_t index = (hint + attempt) % SLOTS;
+            std::atomic<uint64_t>& slot = slots_[index].epoch;
+            uint64_t expected = 0;
+            if (slot.load(std::memory_order_relaxed) == 0 && slot.compare_exchange_strong(expected, epoch_.load())) {
+                hint = index;
+                return Guard(&slot, current_.load());
+            }
+            if (attempt % SLOTS == SLOTS - 1) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Текущий снимок для писателя: пока писатель не вызвал publish, снимок не освободится
+    const T* current() const { return current_.load(); }
+
+    // Публикует next; старый снимок освобождается, когда его отпустят все читатели.
+    // Возвращает число освобожденных снимков
+    size_t publish(std::unique_ptr<T> next) {
+        T* old = current_.exchange(next.release());
+        uint64_t retiredAt = epoch_.fetch_add(1);
+        retired_.emplace_back(retiredAt, std::unique_ptr<T>(old));
+        return reclaim();
+    }
+
+    size_t reclaim() {
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+        for (const Slot& slot : slots_) {
+            uint64_t epoch = slot.epoch.load();
+            if (epoch != 0 && epoch < oldest) {
+                oldest = epoch;
+            }
+        }
+        size_t freed = 0;
+        for (size_t i = 0; i < retired_.size();) {
+            if (retired_[i].first < oldest) {
+                retired_[i] = std::move(retired_.back());
+                retired_.pop_back();
+                freed++;
+            } else {
+                ++i;
+            }
+        }
+        return freed;
+    }
+
+    // Снимков, ждущих освобождения
+    size_t retired() const { return retired_.size(); }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};     // 0 - слот свободен
+    };
+
+    // Потоки начинают с разных слотов, чтобы не толкаться на одном
+    static size_t nextHint() {
+        static std::atomic<size_t> next{0};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<T*> current_;
+    std::atomic<uint64_t> epoch_{1};
+    mutable Slot slots_[SLOTS];
+    std::vector<std::pair<uint64_t, std::unique_ptr<T>>> retired_;
+};
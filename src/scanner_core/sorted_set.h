@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Множество в виде отсортированного массива без повторов с двоичным поиском.
+ * Индекс сигнатур хранит так размеры файлов и ключи префиксов: проверка нужна
+ * один раз на файл, а массив можно записать в двоичную базу как есть.
+ *
+ * Как и фильтр Блума, массив либо свой, либо смотрит в отображенный файл базы.
+ */
+template <typename T>
+class SortedSet {
+public:
+    SortedSet() = default;
+    SortedSet(const SortedSet&) = delete;
+    SortedSet& operator=(const SortedSet&) = delete;
+
+    SortedSet(SortedSet&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    SortedSet& operator=(SortedSet&& other) noexcept {
+        if (this != &other) {
+            // Буфер вектора переезжает вместе с указателем на него
+            owned_ = std::move(other.owned_);
+            items_ = other.items_;
+            count_ = other.count_;
+            other.items_ = nullptr;
+            other.count_ = 0;
+        }
+        return *this;
+    }
+
+    void add(const T& item) {
+        detach();
+        auto it = std::lower_bound(owned_.begin(), owned_.end(), item);
+        if (it == owned_.end() || !(*it == item)) {
+            owned_.insert(it, item);
+        }
+        sync();
+    }
+
+    // Пакетное добавление в любом порядке и с повторами
+    void add(const T* items, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        detach();
+        owned_.insert(owned_.end(), items, items + count);
+        std::sort(owned_.begin(), owned_.end());
+        owned_.erase(std::unique(owned_.begin(), owned_.end()), owned_.end());
+        sync();
+    }
+
+    // Смотрит во внешний отсортированный массив (отображенный файл базы)
+    void attach(const T* items, size_t count) {
+        std::vector<T>().swap(owned_);
+        items_ = items;
+        count_ = count;
+    }
+
+    // Копирует массив из файла в память (перед закрытием отображения)
+    void detach() {
+        if (items_ != owned_.data()) {
+            owned_.assign(items_, items_ + count_);
+            sync();
+        }
+    }
+
+    void clear() {
+        std::vector<T>().swap(owned_);
+        items_ = nullptr;
+        count_ = 0;
+    }
+
+    bool contains(const T& item) const {
+        return std::binary_search(items_, items_ + count_, item);
+    }
+
+    bool empty() const { return count_ == 0; }
+    size_t size() const { return count_; }
+    // Число элементов в объединении с other: общие считаются один раз
+    size_t unionSize(const SortedSet& other) const {
+        size_t common = 0;
+        const T* a = items_;
+        const T* b = other.items_;
+        const T* aEnd = items_ + count_;
+        const T* bEnd = other.items_ + other.count_;
+        while (a != aEnd && b != bEnd) {
+            if (*a < *b) {
+                ++a;
+            } else if (*b < *a) {
+                ++b;
+            } else {
+                ++common;
+                ++a;
+                ++b;
+            }
+        }
+        return count_ + other.count_ - common;
+    }
+    const T* data() const { return items_; }
+    size_t sizeBytes() const { return count_ * sizeof(T); }
+
+private:
+    const T* items_ = nullptr;
+    size_t count_ = 0;
+    std::vector<T> owned_;
+
+    void sync() {
+        items_ = owned_.data();
+        count_ = owned_.size();
+    }
+};
+
+// Размеры файлов, для которых в базе есть сигнатуры
+using FileSizeSet = SortedSet<uint64_t>;
@@ -0,0 +1,102 @@
+#include "storage_profile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+namespace {
+
+#ifdef __linux__
+// Сигнатуры statfs.f_type файловых систем, где каждый запрос идет по сети
+bool isRemoteFilesystem(long type) {
+    switch (static_cast<unsigned long>(type) & 0xFFFFFFFFul) {
+    case 0x6969:        // NFS
+    case 0x517B:        // SMB
+    case 0xFF534D42:    // CIFS
+    case 0xFE534D42:    // SMB2
+    case 0x65735546:    // FUSE (и virtiofs)
+    case 0x00C36400:    // Ceph
+    case 0x5346414F:    // AFS
+    case 0x01021997:    // 9p
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool readNumber(const std::string& path, unsigned long& value) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> value);
+}
+#endif
+
+}
+
+StorageProfile StorageProfile::probe(const std::string& path) {
+    StorageProfile profile;
+#if defined(__linux__)
+    struct statfs fs;
+    if (statfs(path.c_str(), &fs) == 0 && isRemoteFilesystem(static_cast<long>(fs.f_type))) {
+        profile.kind = Kind::Remote;
+        return profile;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return profile;
+    }
+    // Раздел описан каталогом внутри диска: очередь у родителя
+    std::string device = "/sys/dev/block/" + std::to_string(major(st.st_dev)) + ":" +
+                         std::to_string(minor(st.st_dev));
+    std::string queue = device + "/queue";
+    unsigned long rotational;
+    if (!readNumber(queue + "/rotational", rotational)) {
+        queue = device + "/../queue";
+        if (!readNumber(queue + "/rotational", rotational)) {
+            return profile;
+        }
+    }
+    profile.kind = rotational ? Kind::Rotational : Kind::SolidState;
+    unsigned long requests;
+    if (readNumber(queue + "/nr_requests", requests)) {
+        profile.queueDepth = static_cast<uint32_t>(std::min<unsigned long>(requests, UINT32_MAX));
+    }
+#elif defined(_WIN32)
+    char root[MAX_PATH];
+    if (GetVolumePathNameA(path.c_str(), root, MAX_PATH) && GetDriveTypeA(root) == DRIVE_REMOTE) {
+        profile.kind = Kind::Remote;
+    }
+#else
+    (void)path;
+#endif
+    return profile;
+}
+
+size_t StorageProfile::initialIoThreads(size_t cores, size_t maxThreads) const {
+    cores = std::max<size_t>(1, cores);
+    size_t threads;
+    switch (kind) {
+    case Kind::Remote:
+        threads = std::max(REMOTE_IO_THREADS, 2 * cores);
+        break;
+    case Kind::Rotational:
+        threads = ROTATIONAL_IO_THREADS;
+        break;
+    case Kind::SolidState:
+        threads = queueDepth ? std::min(4 * cores, std::max<size_t>(cores, queueDepth / QUEUE_SHARE)) : 2 * cores;
+        break;
+    default:
+        threads = 2 * cores;
+        break;
+    }
+    return std::max<size_t>(1, std::min(threads, maxThreads));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "scanner_api.h"
+
+/**
+ * Что известно о хранилище каталога до чтения файлов: вращающийся диск,
+ * твердотельный с глубокой очередью или сетевая файловая система (и FUSE),
+ * у которой каждое открытие и чтение - обмен с сервером. По профилю
+ * выбирается начальное число потоков чтения, дальше его подстраивает
+ * ThreadController по измеренной задержке.
+ */
+struct SCANNER_API StorageProfile {
+    enum class Kind {
+        Unknown,        // нет блочного устройства (tmpfs, overlay) или платформа не сообщает
+        Rotational,
+        SolidState,
+        Remote
+    };
+
+    // Потоков чтения на сетевой ФС: задержка в сети, а не в устройстве
+    static constexpr size_t REMOTE_IO_THREADS = 16;
+    // Вращающемуся диску хватает нескольких запросов для сортировки по дорожкам
+    static constexpr size_t ROTATIONAL_IO_THREADS = 2;
+    // Доля очереди SSD, которую занимают синхронные чтения
+    static constexpr uint32_t QUEUE_SHARE = 8;
+
+    Kind kind = Kind::Unknown;
+    uint32_t queueDepth = 0;        // nr_requests блочного устройства; 0 - неизвестна
+
+    // Профиль файловой системы, на которой лежит path
+    static StorageProfile probe(const std::string& path);
+
+    // Начальное число потоков чтения для cores ядер, от 1 до maxThreads
+    size_t initialIoThreads(size_t cores, size_t maxThreads) const;
+};
@@ -0,0 +1,99 @@
+#include "thread_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+size_t clampThreads(size_t value, size_t low, size_t high) {
+    return std::max(low, std::min(value, high));
+}
+
+}
+
+ThreadController::ThreadController(const Limits& limits, size_t ioThreads, size_t hashThreads)
+    : limits_(limits),
+      io_(clampThreads(ioThreads, limits.minIo, limits.maxIo)),
+      hash_(clampThreads(hashThreads, limits.minHash, limits.maxHash)) {
+}
+
+bool ThreadController::update(const Sample& sample) {
+    if (!hasPrevious_ || sample.elapsedNs <= previous_.elapsedNs) {
+        previous_ = sample;
+        hasPrevious_ = true;
+        return false;
+    }
+    uint64_t interval = sample.elapsedNs - previous_.elapsedNs;
+    uint64_t done = sample.filesDone - previous_.filesDone;
+    uint64_t files = sample.filesRead - previous_.filesRead;
+    uint64_t readNs = sample.readNs - previous_.readNs;
+    uint64_t hashed = sample.filesHashed - previous_.filesHashed;
+    uint64_t hashNs = sample.hashNs - previous_.hashNs;
+    previous_ = sample;
+    // Файлов за интервал не было: идет обход каталогов или сканирование кончается
+    if (done == 0) {
+        return false;
+    }
+    double rate = static_cast<double>(done) * 1e9 / static_cast<double>(interval);
+
+    if (checking_) {
+        checking_ = false;
+        if (rate < checkRate_ * (1.0 + MIN_GAIN)) {
+            io_ = checkIo_;
+            adjustments_++;
+            cooldown_ = COOLDOWN_INTERVALS;
+            return true;
+        }
+    }
+    if (cooldown_ > 0) {
+        cooldown_--;
+        return false;
+    }
+
+    // Хеширование - узкое место, если его очередь заполнена хотя бы наполовину
+    bool hashBound = sample.hashCapacity > 0 && sample.hashBacklog * 2 >= sample.hashCapacity;
+    double busy = static_cast<double>(hashNs) / (static_cast<double>(hash_) * static_cast<double>(interval));
+    size_t hash = hash_;
+    if (hashBound || busy > BUSY_HIGH) {
+        hash = limits_.maxHash;
+    } else if (busy < BUSY_LOW) {
+        // Занятые потоки в пересчете на целые, с запасом до BUSY_TARGET
+        double needed = busy * static_cast<double>(hash_) / BUSY_TARGET;
+        hash = clampThreads(static_cast<size_t>(std::ceil(needed)), limits_.minHash, limits_.maxHash);
+    }
+
+    size_t io = ioTarget(sample, files, readNs, hashed, hashNs, hash, hashBound);
+    if (io > io_) {
+        checking_ = true;
+        checkRate_ = rate;
+        checkIo_ = io_;
+    }
+    bool changed = io != io_ || hash != hash_;
+    io_ = io;
+    hash_ = hash;
+    adjustments_ += changed ? 1 : 0;
+    return changed;
+}
+
+size_t ThreadController::ioTarget(const Sample& sample, uint64_t files, uint64_t readNs, uint64_t hashed,
+                                  uint64_t hashNs, size_t hashThreads, bool hashBound) const {
+    size_t target = io_;
+    if (files > 0 && hashed > 0 && hashNs > 0) {
+        double latency = static_cast<double>(readNs) / static_cast<double>(files);
+        double cost = static_cast<double>(hashNs) / static_cast<double>(hashed);
+        double needed = static_cast<double>(hashThreads) * latency / cost * HEADROOM;
+        target = static_cast<size_t>(std::min(std::ceil(needed), static_cast<double>(limits_.maxIo)));
+    }
+    if (hashBound) {
+        // Читатели обгоняют хеширование: шаг вниз, даже если расчет просит больше
+        target = std::min(target, io_ - std::max<size_t>(1, io_ / 4));
+    } else if (sample.readBacklog == 0) {
+        // Работы, ждущей читателя, нет: новые потоки ее не найдут
+        target = std::min(target, io_);
+    }
+    // Не больше чем вдвое за интервал и с гистерезисом в восьмую часть
+    target = clampThreads(target, std::max<size_t>(1, io_ / 2), io_ * 2);
+    target = clampThreads(target, limits_.minIo, limits_.maxIo);
+    size_t distance = target > io_ ? target - io_ : io_ - target;
+    return distance >= std::max<size_t>(1, io_ / 8) ? target : io_;
+}
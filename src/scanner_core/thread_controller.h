@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "scanner_api.h"
+
+/**
+ * Подбирает число активных потоков чтения и хеширования по метрикам стадий.
+ * Раз в интервал контроллер получает накопленные счетчики и по приращениям
+ * считает задержку чтения файла и цену его хеширования. Потоков чтения
+ * ставится столько, чтобы чтение поспевало за хешированием (закон Литтла:
+ * одновременно читается столько файлов, сколько хешируется за время чтения
+ * одного). Если хеширование не успевает, лишние читатели только копят
+ * буферы, и их становится меньше; простаивающие потоки хеширования
+ * освобождают ядра для системных вызовов чтения.
+ *
+ * Каждый рост числа читателей проверяется следующим замером: если пропускная
+ * способность не выросла хотя бы на MIN_GAIN, шаг откатывается и контроллер
+ * несколько интервалов не трогает потоки.
+ */
+class SCANNER_API ThreadController {
+public:
+    struct Limits {
+        size_t minIo = 1;
+        size_t maxIo = 1;
+        size_t minHash = 1;
+        size_t maxHash = 1;
+    };
+
+    // Счетчики с начала сканирования и глубины очередей в момент замера
+    struct Sample {
+        uint64_t elapsedNs = 0;
+        uint64_t filesDone = 0;     // файлов с вердиктом: пропускная способность
+        uint64_t filesRead = 0;     // файлов, прошедших стадию чтения
+        uint64_t readNs = 0;        // время потоков чтения на них
+        uint64_t filesHashed = 0;   // файлов, захешированных потоками хеширования
+        uint64_t hashNs = 0;        // время потоков хеширования на них
+        size_t readBacklog = 0;     // задач, ждущих потока чтения
+        size_t hashBacklog = 0;     // пачек, ждущих потока хеширования
+        size_t hashCapacity = 0;    // сколько пачек вмещает очередь хеширования
+    };
+
+    static constexpr double HEADROOM = 1.25;        // запас читателей сверх расчетного
+    static constexpr double BUSY_HIGH = 0.9;        // доля занятости хеширования, при которой оно растет
+    static constexpr double BUSY_LOW = 0.5;         // и при которой сокращается
+    static constexpr double BUSY_TARGET = 0.75;
+    static constexpr double MIN_GAIN = 0.05;
+    static constexpr int COOLDOWN_INTERVALS = 5;
+
+    ThreadController(const Limits& limits, size_t ioThreads, size_t hashThreads);
+
+    // Очередной замер; true - число потоков изменилось
+    bool update(const Sample& sample);
+
+    size_t ioThreads() const { return io_; }
+    size_t hashThreads() const { return hash_; }
+    // Сколько раз менялось число потоков, включая откаты
+    uint64_t adjustments() const { return adjustments_; }
+
+private:
+    size_t ioTarget(const Sample& sample, uint64_t files, uint64_t readNs, uint64_t hashed, uint64_t hashNs,
+                    size_t hashThreads, bool hashBound) const;
+
+    Limits limits_;
+    size_t io_;
+    size_t hash_;
+    uint64_t adjustments_ = 0;
+    Sample previous_;
+    bool hasPrevious_ = false;
+    // Рост читателей ждет проверки следующим замером
+    bool checking_ = false;
+    double checkRate_ = 0.0;
+    size_t checkIo_ = 0;
+    int cooldown_ = 0;
+};
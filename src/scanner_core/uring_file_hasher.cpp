@@ -0,0 +1,608 @@
+#include "uring_file_hasher.h"
+#include "scan_metrics.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// linux/fs.h из linux/io_uring.h определяет макрос BLOCK_SIZE, который ломает MD5::BLOCK_SIZE
+#undef BLOCK_SIZE
+#endif
+
+namespace {
+
+const uint32_t MD5_INIT[4] = {0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u};
+
+// Запас за буфером чтения: остаток неполного блока перед ним и MD5-паддинг после
+constexpr size_t SLOT_EXTRA = 4096;
+constexpr size_t SLOT_STRIDE = UringFileHasher::READ_BUFFER_SIZE + SLOT_EXTRA;
+
+// user_data запроса: номер слота и операция
+enum Operation : uint64_t { OP_OPEN = 0, OP_READ = 1, OP_CLOSE = 2 };
+
+uint64_t userData(uint32_t slot, Operation op) {
+    return (static_cast<uint64_t>(slot) << 2) | op;
+}
+
+#ifdef __linux__
+int uringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int uringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+#endif
+
+}
+
+/**
+ * Слот - файл в полете: дескриптор, буфер с еще не захешированными байтами
+ * и состояние MD5. У слота всегда не больше одного запроса в кольце.
+ */
+struct UringFileHasher::Slot {
+    uint8_t* buffer = nullptr;
+    size_t index = 0;
+    int fd = -1;
+    size_t pos = 0;
+    size_t end = 0;
+    uint64_t length = 0;
+    uint32_t state[4] = {};
+    bool final = false;
+    uint64_t queuedAt = 0;      // когда поставлен текущий запрос (при замерах времени)
+    FileTiming timing;
+    DigestSet digests;          // алгоритмы сверх MD5
+
+    size_t availableBlocks() const { return (end - pos) / MD5::BLOCK_SIZE; }
+
+    void appendPadding() {
+        uint64_t bitLength = length * 8;
+        buffer[end++] = 0x80;
+        while (end % MD5::BLOCK_SIZE != MD5::BLOCK_SIZE - 8) {
+            buffer[end++] = 0;
+        }
+        for (int i = 0; i < 8; ++i) {
+            buffer[end++] = static_cast<uint8_t>(bitLength >> (8 * i));
+        }
+        final = true;
+    }
+};
+
+#ifdef __linux__
+
+/**
+ * Кольца io_uring, отображенные в память процесса. Запросы пишутся в SQ
+ * и публикуются сдвигом хвоста; завершения читаются из CQ.
+ */
+struct UringFileHasher::Ring {
+    int fd = -1;
+    uint8_t* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    uint8_t* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned localTail = 0;
+    unsigned toSubmit = 0;
+
+    ~Ring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing) munmap(sqRing, sqRingSize);
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = uringSetup(entries, &params);
+        if (fd < 0) {
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        void* sq = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq == MAP_FAILED) {
+            return false;
+        }
+        sqRing = static_cast<uint8_t*>(sq);
+        if (singleMap) {
+            cqRing = sqRing;
+        } else {
+            void* cq = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cq == MAP_FAILED) {
+                return false;
+            }
+            cqRing = static_cast<uint8_t*>(cq);
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) {
+            sqes = nullptr;
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(s);
+
+        sqHead = reinterpret_cast<unsigned*>(sqRing + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+        // Массив индексов SQ один раз заполняется тождественно: запись i - это sqes[i]
+        unsigned* array = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        for (unsigned i = 0; i < sqEntries; ++i) {
+            array[i] = i;
+        }
+        localTail = *sqTail;
+        return true;
+    }
+
+    // Свободная запись SQ или nullptr, если очередь заполнена
+    io_uring_sqe* nextSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= sqEntries) {
+            return nullptr;
+        }
+        io_uring_sqe* sqe = &sqes[localTail & sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        localTail++;
+        toSubmit++;
+        return sqe;
+    }
+
+    // Отправляет подготовленные запросы и ждет minComplete завершений
+    bool submit(unsigned minComplete) {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (true) {
+            int ret = uringEnter(fd, toSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0);
+            if (ret >= 0) {
+                toSubmit -= std::min<unsigned>(toSubmit, static_cast<unsigned>(ret));
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            // Нехватка ресурсов ядра: запросы остаются в SQ до следующего вызова
+            return errno == EAGAIN || errno == EBUSY;
+        }
+    }
+
+    template <typename Handler>
+    void reap(Handler&& handle) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            uint64_t data = cqe.user_data;
+            int32_t res = cqe.res;
+            handle(data, res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+};
+
+bool UringFileHasher::supported() {
+    static const bool result = []() {
+        Ring ring;
+        if (!ring.init(4)) {
+            return false;
+        }
+        const unsigned maxOps = 256;
+        std::vector<uint8_t> storage(sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op));
+        io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (uringRegister(ring.fd, IORING_REGISTER_PROBE, probe, maxOps) < 0) {
+            return false;
+        }
+        for (unsigned op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_CLOSE}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }();
+    return result;
+}
+
+#else
+
+struct UringFileHasher::Ring {};
+
+bool UringFileHasher::supported() {
+    return false;
+}
+
+#endif
+
+UringFileHasher::UringFileHasher(const MD5MultiBufferKernel& kernel, size_t queueDepth)
+    : kernel_(kernel),
+      state_(4 * kernel.lanes),
+      data_(kernel.lanes) {
+#ifdef __linux__
+    if (queueDepth > 0 && supported()) {
+        std::unique_ptr<Ring> ring(new Ring());
+        void* buffers = MAP_FAILED;
+        if (ring->init(static_cast<unsigned>(queueDepth))) {
+            queueDepth = std::min<size_t>(queueDepth, ring->sqEntries);
+            buffers = mmap(nullptr, queueDepth * SLOT_STRIDE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (buffers != MAP_FAILED) {
+            buffers_ = static_cast<uint8_t*>(buffers);
+            buffersSize_ = queueDepth * SLOT_STRIDE;
+            slots_.resize(queueDepth);
+            std::vector<iovec> iovecs(queueDepth);
+            for (size_t i = 0; i < queueDepth; ++i) {
+                slots_[i].buffer = buffers_ + i * SLOT_STRIDE;
+                iovecs[i].iov_base = slots_[i].buffer;
+                iovecs[i].iov_len = SLOT_STRIDE;
+                freeSlots_.push_back(static_cast<uint32_t>(queueDepth - 1 - i));
+            }
+            // Регистрация закрепляет страницы и упирается в RLIMIT_MEMLOCK; без нее обычные чтения
+            registered_ = uringRegister(ring->fd, IORING_REGISTER_BUFFERS, iovecs.data(),
+                                        static_cast<unsigned>(queueDepth)) == 0;
+            readySlots_.reserve(queueDepth);
+            group_.reserve(kernel_.lanes);
+            ring_ = std::move(ring);
+        }
+    }
+#else
+    (void)queueDepth;
+#endif
+    if (!ring_) {
+        fallback_.reset(new MultiBufferFileHasher(kernel_, readOptions_));
+    }
+}
+
+UringFileHasher::~UringFileHasher() {
+    // Кольцо закрывается раньше, чем освобождаются буферы его запросов
+    ring_.reset();
+#ifdef __linux__
+    if (buffers_) {
+        munmap(buffers_, buffersSize_);
+    }
+#endif
+}
+
+size_t UringFileHasher::queueDepth() const {
+    return slots_.size();
+}
+
+int UringFileHasher::lastError() const {
+    // Без кольца файлы читает запасной хешер, ошибка хранится у него
+    return ring_ ? lastError_ : fallback_->lastError();
+}
+
+uint64_t UringFileHasher::lastLength() const {
+    return ring_ ? lastLength_ : fallback_->lastLength();
+}
+
+const FileTiming& UringFileHasher::lastTiming() const {
+    return ring_ ? lastTiming_ : fallback_->lastTiming();
+}
+
+const FileDigests& UringFileHasher::lastDigests() const {
+    return ring_ ? lastDigests_ : fallback_->lastDigests();
+}
+
+void UringFileHasher::setDigests(DigestMask extra) {
+    extraDigests_ = extra & ~DIGEST_MD5;
+    if (fallback_) {
+        fallback_->setDigests(extraDigests_);
+    }
+}
+
+void UringFileHasher::setReadOptions(const ReadOptions& readOptions) {
+    readOptions_ = readOptions;
+    if (fallback_) {
+        fallback_->setReadOptions(readOptions);
+    }
+}
+
+void UringFileHasher::setTiming(bool enabled) {
+    timing_ = enabled;
+    if (fallback_) {
+        fallback_->setTiming(enabled);
+    }
+}
+
+void UringFileHasher::hashFiles(const std::string* paths, size_t count, const Callback& callback) {
+#ifdef __linux__
+    if (!ring_) {
+        fallback_->hashFiles(paths, count, callback);
+        return;
+    }
+
+    size_t next = 0;
+    size_t busy = 0;
+    while (true) {
+        if (timing_) {
+            now_ = monotonicNs();
+        }
+        while (next < count && !freeSlots_.empty()) {
+            uint32_t s = freeSlots_.back();
+            freeSlots_.pop_back();
+            slots_[s].index = next;
+            queueOpen(s, paths[next]);
+            next++;
+            busy++;
+        }
+        if (busy == 0) {
+            break;
+        }
+
+        // Ждем сразу несколько завершений, чтобы было из чего собрать группу для SIMD-ядра
+        unsigned wait = static_cast<unsigned>(std::min(busy, kernel_.lanes));
+        if (!ring_->submit(wait)) {
+            // Кольцо отказало: файлы в полете считаются ошибкой, остальные читаются блокирующе.
+            // Открытия, уже завершенные в CQ, тоже дают дескрипторы, которые надо закрыть
+            ring_->reap([&](uint64_t data, int32_t res) {
+                if ((data & 3) == OP_OPEN && res >= 0) {
+                    slots_[data >> 2].fd = res;
+                }
+            });
+            for (size_t s = 0; s < slots_.size(); ++s) {
+                if (std::find(freeSlots_.begin(), freeSlots_.end(), static_cast<uint32_t>(s)) == freeSlots_.end()) {
+                    Slot& slot = slots_[s];
+                    if (slot.fd >= 0) {
+                        ::close(slot.fd);
+                        slot.fd = -1;
+                    }
+                    slot.pos = 0;
+                    slot.end = 0;
+                    slot.length = 0;
+                    slot.final = false;
+                    slot.digests.reset(0);
+                    lastError_ = EIO;
+                    callback(slot.index, nullptr);
+                    freeSlots_.push_back(static_cast<uint32_t>(s));
+                }
+            }
+            readySlots_.clear();
+            fallback_.reset(new MultiBufferFileHasher(kernel_, readOptions_));
+            fallback_->setTiming(timing_);
+            fallback_->setDigests(extraDigests_);
+            ring_.reset();
+            fallback_->hashFiles(paths + next, count - next, [&](size_t index, const MD5Digest* digest) {
+                callback(next + index, digest);
+            });
+            return;
+        }
+
+        if (timing_) {
+            now_ = monotonicNs();
+        }
+        ring_->reap([&](uint64_t data, int32_t res) {
+            uint32_t s = static_cast<uint32_t>(data >> 2);
+            Slot& slot = slots_[s];
+            switch (data & 3) {
+            case OP_OPEN:
+                if (res < 0) {
+                    lastError_ = -res;
+                    callback(slot.index, nullptr);
+                    freeSlots_.push_back(s);
+                    busy--;
+                    return;
+                }
+                if (timing_) {
+                    slot.timing.openNs = now_ - slot.queuedAt;
+                }
+                slot.fd = res;
+                slot.pos = 0;
+                slot.end = 0;
+                slot.length = 0;
+                slot.final = false;
+                slot.digests.reset(extraDigests_);
+                std::memcpy(slot.state, MD5_INIT, sizeof(MD5_INIT));
+                queueRead(s);
+                return;
+            case OP_READ:
+                if (timing_) {
+                    slot.timing.readNs += now_ - slot.queuedAt;
+                }
+                if (res == -EINTR || res == -EAGAIN) {
+                    queueRead(s);
+                } else if (res < 0) {
+                    lastError_ = -res;
+                    callback(slot.index, nullptr);
+                    queueClose(s);
+                } else {
+                    if (res == 0) {
+                        slot.appendPadding();
+                    } else {
+                        if (extraDigests_) {
+                            uint64_t hashStart = timing_ ? monotonicNs() : 0;
+                            slot.digests.update(slot.buffer + slot.end, static_cast<size_t>(res));
+                            if (timing_) {
+                                slot.timing.hashNs += monotonicNs() - hashStart;
+                            }
+                        }
+                        slot.end += static_cast<size_t>(res);
+                        slot.length += static_cast<uint64_t>(res);
+                    }
+                    if (slot.availableBlocks() > 0) {
+                        readySlots_.push_back(s);
+                    } else {
+                        queueRead(s);
+                    }
+                }
+                return;
+            default:
+                slot.fd = -1;
+                freeSlots_.push_back(s);
+                busy--;
+                return;
+            }
+        });
+        hashReady(callback);
+    }
+#else
+    fallback_->hashFiles(paths, count, callback);
+#endif
+}
+
+// Хеширует готовые слоты группами по числу дорожек ядра; опустевший слот
+// уходит дочитывать файл или завершается, его место в группе занимает следующий
+void UringFileHasher::hashReady(const Callback& callback) {
+    const size_t n = kernel_.lanes;
+    size_t taken = 0;
+    group_.clear();
+    while (true) {
+        while (group_.size() < n && taken < readySlots_.size()) {
+            group_.push_back(readySlots_[taken++]);
+        }
+        if (group_.empty()) {
+            break;
+        }
+
+        uint64_t hashStart = timing_ ? monotonicNs() : 0;
+        if (group_.size() == 1) {
+            Slot& slot = slots_[group_[0]];
+            size_t blocks = slot.availableBlocks();
+            MD5::transform(slot.state, slot.buffer + slot.pos, blocks);
+            slot.pos += blocks * MD5::BLOCK_SIZE;
+        } else {
+            size_t blocks = SIZE_MAX;
+            for (size_t l = 0; l < n; ++l) {
+                // Пустые дорожки считают данные первого слота, результат отбрасывается
+                const Slot& slot = slots_[group_[l < group_.size() ? l : 0]];
+                blocks = std::min(blocks, slot.availableBlocks());
+                data_[l] = slot.buffer + slot.pos;
+                for (size_t w = 0; w < 4; ++w) {
+                    state_[w * n + l] = slot.state[w];
+                }
+            }
+            kernel_.process(state_.data(), data_.data(), blocks);
+            for (size_t l = 0; l < group_.size(); ++l) {
+                Slot& slot = slots_[group_[l]];
+                for (size_t w = 0; w < 4; ++w) {
+                    slot.state[w] = state_[w * n + l];
+                }
+                slot.pos += blocks * MD5::BLOCK_SIZE;
+            }
+        }
+        if (timing_) {
+            uint64_t share = (monotonicNs() - hashStart) / group_.size();
+            for (uint32_t s : group_) {
+                slots_[s].timing.hashNs += share;
+            }
+        }
+
+        for (size_t l = 0; l < group_.size();) {
+            if (slots_[group_[l]].availableBlocks() > 0) {
+                ++l;
+                continue;
+            }
+            finishSlot(group_[l], callback);
+            group_[l] = group_.back();
+            group_.pop_back();
+        }
+    }
+    readySlots_.clear();
+}
+
+void UringFileHasher::finishSlot(uint32_t s, const Callback& callback) {
+    Slot& slot = slots_[s];
+    if (!slot.final) {
+        queueRead(s);
+        return;
+    }
+    MD5Digest digest;
+    for (size_t w = 0; w < 4; ++w) {
+        for (size_t i = 0; i < 4; ++i) {
+            digest[4 * w + i] = static_cast<uint8_t>(slot.state[w] >> (8 * i));
+        }
+    }
+    lastLength_ = slot.length;
+    lastTiming_ = slot.timing;
+    lastDigests_.mask = DIGEST_MD5;
+    lastDigests_.md5 = digest;
+    slot.digests.finalize(lastDigests_);
+    callback(slot.index, &digest);
+    queueClose(s);
+}
+
+#ifdef __linux__
+
+void UringFileHasher::queueOpen(uint32_t s, const std::string& path) {
+    io_uring_sqe* sqe = ring_->nextSqe();
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(path.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = userData(s, OP_OPEN);
+    if (timing_) {
+        slots_[s].timing = FileTiming();
+        slots_[s].queuedAt = now_;
+    }
+}
+
+void UringFileHasher::queueRead(uint32_t s) {
+    Slot& slot = slots_[s];
+    // Неполный блок переносится в начало буфера, чтение дописывает за ним
+    size_t rest = slot.end - slot.pos;
+    std::memmove(slot.buffer, slot.buffer + slot.pos, rest);
+    slot.pos = 0;
+    slot.end = rest;
+
+    io_uring_sqe* sqe = ring_->nextSqe();
+    sqe->opcode = registered_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = slot.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(slot.buffer + slot.end);
+    sqe->len = static_cast<uint32_t>(READ_BUFFER_SIZE);
+    sqe->off = slot.length;
+    if (registered_) {
+        sqe->buf_index = static_cast<uint16_t>(s);
+    }
+    sqe->user_data = userData(s, OP_READ);
+    if (timing_) {
+        slot.queuedAt = now_;
+    }
+}
+
+void UringFileHasher::queueClose(uint32_t s) {
+    io_uring_sqe* sqe = ring_->nextSqe();
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = slots_[s].fd;
+    sqe->user_data = userData(s, OP_CLOSE);
+    // Дескриптор уже отдан кольцу: при отказе кольца его нельзя закрыть второй раз
+    slots_[s].fd = -1;
+}
+
+#else
+
+void UringFileHasher::queueOpen(uint32_t, const std::string&) {}
+void UringFileHasher::queueRead(uint32_t) {}
+void UringFileHasher::queueClose(uint32_t) {}
+
+#endif
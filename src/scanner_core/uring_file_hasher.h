@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "md5_multibuffer.h"
+#include "scanner_api.h"
+
+/**
+ * Хеширование файлов через io_uring (Linux 5.6+, без liburing - прямые
+ * системные вызовы). Один поток держит в полете до queueDepth файлов:
+ * open, чтения и close идут асинхронно, а прочитанные блоки файлов
+ * собираются в группы и хешируются тем же multi-buffer ядром MD5.
+ *
+ * Буферы чтения регистрируются в ядре (READ_FIXED), если позволяет
+ * RLIMIT_MEMLOCK; иначе используются обычные чтения. Если io_uring
+ * недоступен (старое ядро, seccomp), хешер работает через блокирующий
+ * MultiBufferFileHasher - isReady() сообщает, какой путь выбран.
+ */
+class SCANNER_API UringFileHasher {
+public:
+    using Callback = MultiBufferFileHasher::Callback;
+
+    static constexpr size_t DEFAULT_QUEUE_DEPTH = 128;
+    static constexpr size_t READ_BUFFER_SIZE = 32 * 1024;
+
+    explicit UringFileHasher(const MD5MultiBufferKernel& kernel = MD5MultiBuffer::best(),
+                             size_t queueDepth = DEFAULT_QUEUE_DEPTH);
+    ~UringFileHasher();
+
+    UringFileHasher(const UringFileHasher&) = delete;
+    UringFileHasher& operator=(const UringFileHasher&) = delete;
+
+    // true - работает io_uring, false - блокирующий запасной путь
+    bool isReady() const { return ring_ != nullptr; }
+    bool registeredBuffers() const { return registered_; }
+    size_t queueDepth() const;
+    const MD5MultiBufferKernel& kernel() const { return kernel_; }
+
+    // Код ошибки (errno) последнего файла, отданного callback с nullptr
+    int lastError() const;
+    // Число байт последнего файла, отданного callback с дайджестом
+    uint64_t lastLength() const;
+    // Время стадий того же файла, если включен setTiming. Открытие и чтения
+    // считаются от постановки запроса в очередь до его завершения
+    const FileTiming& lastTiming() const;
+    void setTiming(bool enabled);
+    // Дайджесты того же файла; остальные алгоритмы считаются по завершении
+    // каждого чтения, пока прочитанные байты в кеше
+    const FileDigests& lastDigests() const;
+    void setDigests(DigestMask extra);
+    // Способ чтения блокирующего запасного пути (io_uring читает файлы сам)
+    void setReadOptions(const ReadOptions& readOptions);
+
+    void hashFiles(const std::string* paths, size_t count, const Callback& callback);
+
+    void hashFiles(const std::vector<std::string>& paths, const Callback& callback) {
+        hashFiles(paths.data(), paths.size(), callback);
+    }
+
+    // Поддерживает ли ядро io_uring с нужными операциями; проверяется один раз
+    static bool supported();
+
+private:
+    struct Ring;
+    struct Slot;
+
+    MD5MultiBufferKernel kernel_;
+    std::unique_ptr<Ring> ring_;
+    std::unique_ptr<MultiBufferFileHasher> fallback_;
+    std::vector<Slot> slots_;
+    uint8_t* buffers_ = nullptr;
+    size_t buffersSize_ = 0;
+    bool registered_ = false;
+    int lastError_ = 0;
+    uint64_t lastLength_ = 0;
+    bool timing_ = false;
+    FileTiming lastTiming_;
+    DigestMask extraDigests_ = 0;
+    FileDigests lastDigests_;
+    ReadOptions readOptions_;
+    uint64_t now_ = 0;          // часы читаются раз за проход цикла, а не на каждый запрос
+
+    std::vector<uint32_t> freeSlots_;
+    std::vector<uint32_t> readySlots_;
+    std::vector<uint32_t> group_;
+    std::vector<uint32_t> state_;
+    std::vector<const uint8_t*> data_;
+
+    void queueOpen(uint32_t slot, const std::string& path);
+    void queueRead(uint32_t slot);
+    void queueClose(uint32_t slot);
+    void hashReady(const Callback& callback);
+    void finishSlot(uint32_t slot, const Callback& callback);
+};
@@ -0,0 +1,631 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Задача пула: вызываемый объект хранится прямо в узле (small-buffer),
+ * без type-erasure аллокации std::function. Узлы переиспользуются через
+ * списки свободных узлов, так что в установившемся режиме задачи не аллоцируются.
+ */
+class PoolTask {
+public:
+    static constexpr size_t INLINE_SIZE = 64;
+
+    template <class F>
+    void emplace(F&& f) {
+        using Fn = typename std::decay<F>::type;
+        constexpr bool fits = sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t);
+        emplaceImpl<Fn>(std::forward<F>(f), std::integral_constant<bool, fits>());
+    }
+
+    void run() { invoke_(storage_, true); }
+    void discard() { invoke_(storage_, false); }
+
+    PoolTask* next = nullptr;
+
+private:
+    template <class Fn, class F>
+    void emplaceImpl(F&& f, std::true_type) {
+        new (storage_) Fn(std::forward<F>(f));
+        invoke_ = [](void* p, bool run) {
+            Fn* fn = static_cast<Fn*>(p);
+            if (run) (*fn)();
+            fn->~Fn();
+        };
+    }
+
+    // Крупные объекты - редкий случай, храним указатель
+    template <class Fn, class F>
+    void emplaceImpl(F&& f, std::false_type) {
+        Fn* heap = new Fn(std::forward<F>(f));
+        std::memcpy(storage_, &heap, sizeof(heap));
+        invoke_ = [](void* p, bool run) {
+            Fn* fn;
+            std::memcpy(&fn, p, sizeof(fn));
+            if (run) (*fn)();
+            delete fn;
+        };
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+    void (*invoke_)(void*, bool) = nullptr;
+};
+
+/**
+ * Дек Chase-Lev фиксированной емкости (Lê, Pop, Cohen, Zappa Nardelli, 2013).
+ * push/pop вызывает только поток-владелец, steal - любой поток.
+ */
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(size_t capacity)
+        : mask_(capacity - 1),
+          buffer_(new std::atomic<PoolTask*>[capacity]) {
+    }
+
+    bool push(PoolTask* task) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask_)) {
+            return false;
+        }
+        buffer_[static_cast<size_t>(b) & mask_].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    PoolTask* pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        PoolTask* task = buffer_[static_cast<size_t>(b) & mask_].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Последний элемент: соревнуемся с ворами
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    PoolTask* steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+        PoolTask* task = buffer_[static_cast<size_t>(t) & mask_].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        int64_t size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+        return size > 0 ? static_cast<size_t>(size) : 0;
+    }
+
+    // Только для владельца: кражи могут лишь освободить место
+    bool full() const {
+        return bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_acquire) >
+               static_cast<int64_t>(mask_);
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    size_t mask_;
+    std::unique_ptr<std::atomic<PoolTask*>[]> buffer_;
+};
+
+/**
+ * Пул потоков с work stealing: у каждого воркера свой дек Chase-Lev,
+ * задачи из внешних потоков попадают в общую очередь внедрения и
+ * разбираются воркерами пачками. Простаивающий воркер сначала крадет
+ * у соседей, потом недолго крутится и засыпает.
+ *
+ * maxQueueSize > 0 ограничивает общую очередь (PushTask из внешнего потока
+ * ждет места) и емкость деков воркеров (TryPushTask возвращает false).
+ *
+ * Потоки создаются сразу все, но задачи берут только первые ActiveThreads():
+ * остальные спят, пока предел не поднимут (SetActiveThreads). onThreadStart
+ * вызывается в каждом воркере до первой задачи, например для привязки к ядрам.
+ */
+class WorkStealingPool {
+public:
+    using ThreadStart = std::function<void(size_t index)>;
+
+    explicit WorkStealingPool(size_t threadCount, size_t maxQueueSize = 0, ThreadStart onThreadStart = nullptr)
+        : threadCount_(threadCount == 0 ? 1 : threadCount),
+          maxQueueSize_(maxQueueSize),
+          activeThreads_(threadCount_),
+          onThreadStart_(std::move(onThreadStart)) {
+        size_t capacity = maxQueueSize > 0 ? maxQueueSize : DEFAULT_DEQUE_CAPACITY;
+        size_t pow2 = MIN_DEQUE_CAPACITY;
+        while (pow2 < capacity) pow2 <<= 1;
+
+        for (size_t i = 0; i < threadCount_; ++i) {
+            workers_.emplace_back(new Worker(pow2, static_cast<uint32_t>(i * 0x9E3779B9u + 1)));
+        }
+        for (size_t i = 0; i < threadCount_; ++i) {
+            threads_.emplace_back([this, i]() { WorkerLoop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        if (!terminated_) {
+            Terminate(true);
+        }
+        for (PoolTask* node : allNodes_) {
+            delete node;
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Ставит задачу; из внешнего потока ждет места в ограниченной очереди,
+    // из воркера при полном деке выполняет задачу сразу
+    template <class F>
+    void PushTask(F&& f) {
+        CheckActive();
+        if (Worker* self = CurrentWorker()) {
+            PoolTask* task = AllocateLocal(*self, std::forward<F>(f));
+            if (!PushLocal(*self, task)) {
+                RunTask(*self, task);
+            }
+            return;
+        }
+
+        PoolTask* task;
+        {
+            std::unique_lock<std::mutex> lock(injectionMutex_);
+            if (maxQueueSize_ > 0) {
+                injectionSpace_.wait(lock, [this]() { return injection_.size() < maxQueueSize_; });
+            }
+            task = AllocateShared(std::forward<F>(f));
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            injection_.push_back(task);
+            injectionSize_.store(injection_.size(), std::memory_order_relaxed);
+        }
+        WakeWorkers(1);
+    }
+
+    // Неблокирующая постановка: false, если очередь (или дек воркера) заполнена.
+    // Задачи, которые сами порождают задачи, должны пользоваться ей.
+    // При отказе f не перемещается, и вызывающий может выполнить его сам.
+    template <class F>
+    bool TryPushTask(F&& f) {
+        CheckActive();
+        if (Worker* self = CurrentWorker()) {
+            // Дек заполняет только владелец, поэтому проверка не устаревает
+            if (self->deque.full()) {
+                return false;
+            }
+            PushLocal(*self, AllocateLocal(*self, std::forward<F>(f)));
+            return true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(injectionMutex_);
+            if (maxQueueSize_ > 0 && injection_.size() >= maxQueueSize_) {
+                return false;
+            }
+            pending_.fetch_add(1, std::memory_order_relaxed);
+            injection_.push_back(AllocateShared(std::forward<F>(f)));
+            injectionSize_.store(injection_.size(), std::memory_order_relaxed);
+        }
+        WakeWorkers(1);
+        return true;
+    }
+
+    // Пакетная постановка из внешнего потока: одна блокировка на всю пачку
+    template <class It>
+    void PushTasks(It first, It last) {
+        CheckActive();
+        if (CurrentWorker()) {
+            for (; first != last; ++first) {
+                PushTask(*first);
+            }
+            return;
+        }
+
+        size_t count = 0;
+        {
+            std::unique_lock<std::mutex> lock(injectionMutex_);
+            for (; first != last; ++first, ++count) {
+                if (maxQueueSize_ > 0 && injection_.size() >= maxQueueSize_) {
+                    injectionSize_.store(injection_.size(), std::memory_order_relaxed);
+                    lock.unlock();
+                    WakeWorkers(count);
+                    count = 0;
+                    lock.lock();
+                    injectionSpace_.wait(lock, [this]() { return injection_.size() < maxQueueSize_; });
+                }
+                pending_.fetch_add(1, std::memory_order_relaxed);
+                injection_.push_back(AllocateShared(*first));
+            }
+            injectionSize_.store(injection_.size(), std::memory_order_relaxed);
+        }
+        WakeWorkers(count);
+    }
+
+    // Ждет, пока все поставленные задачи (и порожденные ими) завершатся
+    void WaitIdle() {
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idle_.wait(lock, [this]() { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+    size_t ThreadCount() const {
+        return threadCount_;
+    }
+
+    // Сколько воркеров берут задачи: от 1 до ThreadCount(). Лишние воркеры
+    // дорабатывают текущую задачу и засыпают, их деки разбирают остальные
+    void SetActiveThreads(size_t count) {
+        count = std::max<size_t>(1, std::min(count, threadCount_));
+        size_t previous = activeThreads_.exchange(count, std::memory_order_relaxed);
+        if (count > previous) {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            parkCv_.notify_all();
+        }
+    }
+
+    size_t ActiveThreads() const {
+        return activeThreads_.load(std::memory_order_relaxed);
+    }
+
+    bool IsActive() const {
+        return !stopping_.load(std::memory_order_relaxed);
+    }
+
+    // Приблизительное число задач, ожидающих выполнения
+    size_t QueueSize() const {
+        size_t size = injectionSize_.load(std::memory_order_relaxed);
+        for (const auto& worker : workers_) {
+            size += worker->deque.size();
+        }
+        return size;
+    }
+
+    void Terminate(bool wait) {
+        if (terminated_) return;
+        if (wait) {
+            WaitIdle();
+        }
+
+        stopping_.store(true, std::memory_order_seq_cst);
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            sleepCv_.notify_all();
+            parkCv_.notify_all();
+        }
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+        terminated_ = true;
+
+        // Невыполненные задачи (Terminate(false)) уничтожаются без запуска
+        for (auto& worker : workers_) {
+            while (PoolTask* task = worker->deque.pop()) {
+                task->discard();
+                worker->Release(task);
+            }
+        }
+        for (PoolTask* task : injection_) {
+            task->discard();
+        }
+        injection_.clear();
+    }
+
+private:
+    static constexpr size_t DEFAULT_DEQUE_CAPACITY = 4096;
+    static constexpr size_t MIN_DEQUE_CAPACITY = 16;
+    static constexpr size_t LOCAL_FREE_LIMIT = 256;
+    static constexpr size_t LOCAL_FREE_KEEP = 16;
+    static constexpr size_t INJECTION_GRAB = 32;
+    static constexpr int SPIN_ROUNDS = 64;
+
+    struct Worker {
+        Worker(size_t capacity, uint32_t seed) : deque(capacity), rng(seed) {}
+
+        ChaseLevDeque deque;
+        PoolTask* freeList = nullptr;
+        size_t freeCount = 0;
+        uint32_t rng;
+
+        void Release(PoolTask* task) {
+            task->next = freeList;
+            freeList = task;
+            freeCount++;
+        }
+    };
+
+    struct CurrentContext {
+        const WorkStealingPool* pool = nullptr;
+        Worker* worker = nullptr;
+    };
+
+    static CurrentContext& Current() {
+        static thread_local CurrentContext context;
+        return context;
+    }
+
+    size_t threadCount_;
+    size_t maxQueueSize_;
+    std::atomic<size_t> activeThreads_;
+    ThreadStart onThreadStart_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex injectionMutex_;
+    std::condition_variable injectionSpace_;
+    std::deque<PoolTask*> injection_;
+    std::atomic<size_t> injectionSize_{0};
+    PoolTask* sharedFree_ = nullptr;          // под injectionMutex_
+    std::vector<PoolTask*> allNodes_;         // под injectionMutex_
+    std::atomic<bool> sharedShort_{false};    // внешним потокам не хватило свободных узлов
+
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCv_;
+    std::condition_variable parkCv_;          // воркеры сверх активного предела
+    std::atomic<int> sleepers_{0};
+
+    std::mutex idleMutex_;
+    std::condition_variable idle_;
+    std::atomic<size_t> pending_{0};
+
+    std::atomic<bool> stopping_{false};
+    bool terminated_ = false;
+
+    void CheckActive() const {
+        if (stopping_.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("WorkStealingPool is finished");
+        }
+    }
+
+    Worker* CurrentWorker() const {
+        const CurrentContext& context = Current();
+        return context.pool == this ? context.worker : nullptr;
+    }
+
+    template <class F>
+    PoolTask* AllocateLocal(Worker& worker, F&& f) {
+        PoolTask* task = worker.freeList;
+        if (task) {
+            worker.freeList = task->next;
+            worker.freeCount--;
+        } else {
+            std::lock_guard<std::mutex> lock(injectionMutex_);
+            task = TakeSharedNode();
+        }
+        task->emplace(std::forward<F>(f));
+        return task;
+    }
+
+    // Вызывается под injectionMutex_
+    template <class F>
+    PoolTask* AllocateShared(F&& f) {
+        PoolTask* task = TakeSharedNode();
+        task->emplace(std::forward<F>(f));
+        return task;
+    }
+
+    // Вызывается под injectionMutex_
+    PoolTask* TakeSharedNode() {
+        PoolTask* task = sharedFree_;
+        if (task) {
+            sharedFree_ = task->next;
+            return task;
+        }
+        task = new PoolTask();
+        allNodes_.push_back(task);
+        sharedShort_.store(true, std::memory_order_relaxed);
+        return task;
+    }
+
+    // pending_ увеличивается до того, как задачу увидят другие воркеры,
+    // иначе ее могут выполнить раньше и счетчик временно уйдет в минус
+    bool PushLocal(Worker& worker, PoolTask* task) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        if (!worker.deque.push(task)) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        WakeWorkers(1);
+        return true;
+    }
+
+    void WakeWorkers(size_t count) {
+        if (count == 0) return;
+        // Парный fence к воркеру, который засыпает: либо он увидит задачу,
+        // либо мы увидим его в sleepers_
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            if (count > 1) {
+                sleepCv_.notify_all();
+            } else {
+                sleepCv_.notify_one();
+            }
+        }
+    }
+
+    void RunTask(Worker& worker, PoolTask* task) {
+        task->run();
+        worker.Release(task);
+
+        // Узлы, пришедшие из общей очереди, возвращаются внешним потокам:
+        // излишек - всегда, остальное - когда внешним потокам их не хватило.
+        // Пул, в который задачи ставят только извне, так не выделяет новых узлов
+        bool starved = worker.freeCount > LOCAL_FREE_KEEP && sharedShort_.load(std::memory_order_relaxed);
+        if (worker.freeCount > LOCAL_FREE_LIMIT || starved) {
+            size_t keep = starved ? LOCAL_FREE_KEEP : LOCAL_FREE_LIMIT / 2;
+            std::lock_guard<std::mutex> lock(injectionMutex_);
+            while (worker.freeCount > keep) {
+                PoolTask* node = worker.freeList;
+                worker.freeList = node->next;
+                worker.freeCount--;
+                node->next = sharedFree_;
+                sharedFree_ = node;
+            }
+            sharedShort_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void Completed(size_t count) {
+        if (pending_.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            std::lock_guard<std::mutex> lock(idleMutex_);
+            idle_.notify_all();
+        }
+    }
+
+    // Забирает часть общей очереди в свой дек, одну задачу возвращает для выполнения
+    PoolTask* TakeInjected(Worker& worker) {
+        if (injectionSize_.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+
+        PoolTask* first = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(injectionMutex_);
+            if (injection_.empty()) {
+                return nullptr;
+            }
+            size_t grab = std::min(INJECTION_GRAB, (injection_.size() + threadCount_ - 1) / threadCount_);
+            first = injection_.front();
+            injection_.pop_front();
+            // pending_ уже учтен при внедрении, перенос в дек его не меняет
+            for (size_t i = 1; i < grab && !injection_.empty(); ++i) {
+                if (!worker.deque.push(injection_.front())) break;
+                injection_.pop_front();
+            }
+            injectionSize_.store(injection_.size(), std::memory_order_relaxed);
+        }
+        if (maxQueueSize_ > 0) {
+            injectionSpace_.notify_all();
+        }
+        return first;
+    }
+
+    PoolTask* StealTask(Worker& self) {
+        if (threadCount_ < 2) return nullptr;
+        self.rng ^= self.rng << 13;
+        self.rng ^= self.rng >> 17;
+        self.rng ^= self.rng << 5;
+        size_t start = self.rng % threadCount_;
+        for (size_t i = 0; i < threadCount_; ++i) {
+            Worker& victim = *workers_[(start + i) % threadCount_];
+            if (&victim == &self) continue;
+            if (PoolTask* task = victim.deque.steal()) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    PoolTask* FindTask(Worker& self) {
+        if (PoolTask* task = self.deque.pop()) return task;
+        if (PoolTask* task = TakeInjected(self)) return task;
+        return StealTask(self);
+    }
+
+    bool HasVisibleWork() const {
+        if (injectionSize_.load(std::memory_order_relaxed) > 0) return true;
+        for (const auto& worker : workers_) {
+            if (!worker->deque.empty()) return true;
+        }
+        return false;
+    }
+
+    // Воркер сверх активного предела ждет его увеличения или остановки пула.
+    // Видимые задачи будят спящих соседей: в его деке их иначе некому украсть,
+    // а пробуждение из PushTask могло достаться ему, а не активному воркеру
+    void Park(Worker& self, size_t index) {
+        if (HasVisibleWork()) {
+            WakeWorkers(std::max<size_t>(1, self.deque.size()));
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        parkCv_.wait(lock, [&]() {
+            return index < activeThreads_.load(std::memory_order_relaxed) ||
+                   stopping_.load(std::memory_order_relaxed);
+        });
+    }
+
+    void WorkerLoop(size_t index) {
+        Worker& self = *workers_[index];
+        Current().pool = this;
+        Current().worker = &self;
+        if (onThreadStart_) {
+            onThreadStart_(index);
+        }
+
+        int idleRounds = 0;
+        while (true) {
+            if (index >= activeThreads_.load(std::memory_order_relaxed) &&
+                !stopping_.load(std::memory_order_acquire)) {
+                Park(self, index);
+                idleRounds = 0;
+                continue;
+            }
+            if (PoolTask* task = FindTask(self)) {
+                idleRounds = 0;
+                RunTask(self, task);
+                Completed(1);
+                continue;
+            }
+
+            if (stopping_.load(std::memory_order_acquire) && !HasVisibleWork()) {
+                break;
+            }
+
+            if (++idleRounds < SPIN_ROUNDS) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepers_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!HasVisibleWork() && !stopping_.load(std::memory_order_relaxed)) {
+                sleepCv_.wait(lock);
+            }
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+            idleRounds = 0;
+        }
+
+        Current() = CurrentContext();
+    }
+};
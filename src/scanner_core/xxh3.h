@@ -0,0 +1,322 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Потоковый XXH3-64 (xxHash 0.8, seed 0, секрет по умолчанию) без внешних
+ * зависимостей. Некриптографический хеш: годится как быстрый ключ
+ * содержимого для кеша и результатов, но не для сверки с базой сигнатур.
+ * Цикл накопления по 64-байтным полосам векторизуется компилятором.
+ * Результат совпадает с XXH3_64bits() эталонной библиотеки.
+ */
+class XXH3 {
+public:
+    static constexpr size_t STRIPE_LEN = 64;
+    static constexpr size_t SECRET_SIZE = 192;
+    static constexpr size_t BUFFER_SIZE = 256;
+
+    XXH3() { reset(); }
+
+    void reset() {
+        acc_[0] = PRIME32_3;
+        acc_[1] = PRIME64_1;
+        acc_[2] = PRIME64_2;
+        acc_[3] = PRIME64_3;
+        acc_[4] = PRIME64_4;
+        acc_[5] = PRIME32_2;
+        acc_[6] = PRIME64_5;
+        acc_[7] = PRIME32_1;
+        totalLength_ = 0;
+        bufferSize_ = 0;
+        stripesSoFar_ = 0;
+    }
+
+    void update(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        totalLength_ += size;
+
+        if (bufferSize_ + size <= BUFFER_SIZE) {
+            if (size > 0) {
+                std::memcpy(buffer_ + bufferSize_, bytes, size);
+            }
+            bufferSize_ += size;
+            return;
+        }
+
+        // Буфер сбрасывается, только когда за ним есть еще данные:
+        // последняя полоса всегда обрабатывается в digest()
+        if (bufferSize_ > 0) {
+            size_t take = BUFFER_SIZE - bufferSize_;
+            std::memcpy(buffer_ + bufferSize_, bytes, take);
+            bytes += take;
+            size -= take;
+            consumeStripes(acc_, stripesSoFar_, buffer_, BUFFER_SIZE / STRIPE_LEN);
+            bufferSize_ = 0;
+        }
+
+        if (size > BUFFER_SIZE) {
+            do {
+                consumeStripes(acc_, stripesSoFar_, bytes, BUFFER_SIZE / STRIPE_LEN);
+                bytes += BUFFER_SIZE;
+                size -= BUFFER_SIZE;
+            } while (size > BUFFER_SIZE);
+            // Предыдущая полоса нужна digest(), если в буфере окажется меньше полосы
+            std::memcpy(buffer_ + BUFFER_SIZE - STRIPE_LEN, bytes - STRIPE_LEN, STRIPE_LEN);
+        }
+
+        std::memcpy(buffer_, bytes, size);
+        bufferSize_ = size;
+    }
+
+    // Состояние не меняется: можно продолжать update()
+    uint64_t digest() const {
+        if (totalLength_ <= MIDSIZE_MAX) {
+            return hashShort(buffer_, static_cast<size_t>(totalLength_));
+        }
+
+        uint64_t acc[ACC_NB];
+        std::memcpy(acc, acc_, sizeof(acc));
+        const uint8_t* lastStripe;
+        uint8_t catchup[STRIPE_LEN];
+        if (bufferSize_ >= STRIPE_LEN) {
+            size_t stripes = (bufferSize_ - 1) / STRIPE_LEN;
+            size_t soFar = stripesSoFar_;
+            consumeStripes(acc, soFar, buffer_, stripes);
+            lastStripe = buffer_ + bufferSize_ - STRIPE_LEN;
+        } else {
+            size_t tail = STRIPE_LEN - bufferSize_;
+            std::memcpy(catchup, buffer_ + BUFFER_SIZE - tail, tail);
+            std::memcpy(catchup + tail, buffer_, bufferSize_);
+            lastStripe = catchup;
+        }
+        accumulate512(acc, lastStripe, SECRET + SECRET_LIMIT - LAST_STRIPE_OFFSET);
+        return mergeAccs(acc, SECRET + MERGE_OFFSET, totalLength_ * PRIME64_1);
+    }
+
+    static uint64_t hash(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        if (size <= MIDSIZE_MAX) {
+            return hashShort(bytes, size);
+        }
+
+        uint64_t acc[ACC_NB] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                                PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+        const size_t blockLength = STRIPE_LEN * STRIPES_PER_BLOCK;
+        size_t blocks = (size - 1) / blockLength;
+        for (size_t n = 0; n < blocks; ++n) {
+            accumulate(acc, bytes + n * blockLength, SECRET, STRIPES_PER_BLOCK);
+            scramble(acc, SECRET + SECRET_LIMIT);
+        }
+        size_t stripes = ((size - 1) - blockLength * blocks) / STRIPE_LEN;
+        accumulate(acc, bytes + blocks * blockLength, SECRET, stripes);
+        accumulate512(acc, bytes + size - STRIPE_LEN, SECRET + SECRET_LIMIT - LAST_STRIPE_OFFSET);
+        return mergeAccs(acc, SECRET + MERGE_OFFSET, static_cast<uint64_t>(size) * PRIME64_1);
+    }
+
+private:
+    static constexpr uint64_t PRIME32_1 = 0x9E3779B1u;
+    static constexpr uint64_t PRIME32_2 = 0x85EBCA77u;
+    static constexpr uint64_t PRIME32_3 = 0xC2B2AE3Du;
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+    static constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ull;
+    static constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ull;
+
+    static constexpr size_t ACC_NB = 8;
+    static constexpr size_t MIDSIZE_MAX = 240;
+    static constexpr size_t SECRET_CONSUME_RATE = 8;
+    static constexpr size_t SECRET_LIMIT = SECRET_SIZE - STRIPE_LEN;
+    static constexpr size_t STRIPES_PER_BLOCK = SECRET_LIMIT / SECRET_CONSUME_RATE;
+    static constexpr size_t LAST_STRIPE_OFFSET = 7;
+    static constexpr size_t MERGE_OFFSET = 11;
+
+    static constexpr uint8_t SECRET[SECRET_SIZE] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    static uint32_t read32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    static uint64_t read64(const uint8_t* p) {
+        return static_cast<uint64_t>(read32(p)) | (static_cast<uint64_t>(read32(p + 4)) << 32);
+    }
+
+    static uint64_t rotl64(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+    static uint64_t swap64(uint64_t x) {
+        x = ((x & 0x00000000FFFFFFFFull) << 32) | (x >> 32);
+        x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull);
+        x = ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull);
+        return x;
+    }
+
+    // Младшая и старшая половины 128-битного произведения, сложенные XOR
+    static uint64_t mulFold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        __extension__ typedef unsigned __int128 Wide;
+        Wide product = static_cast<Wide>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t loLo = (a & 0xFFFFFFFFu) * (b & 0xFFFFFFFFu);
+        uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFFu);
+        uint64_t loHi = (a & 0xFFFFFFFFu) * (b >> 32);
+        uint64_t hiHi = (a >> 32) * (b >> 32);
+        uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFFu) + loHi;
+        uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+        uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFFu);
+        return lower ^ upper;
+#endif
+    }
+
+    static uint64_t avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= PRIME_MX1;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t avalancheXXH64(uint64_t h) {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t rrmxmx(uint64_t h, uint64_t length) {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= PRIME_MX2;
+        h ^= (h >> 35) + length;
+        h *= PRIME_MX2;
+        h ^= h >> 28;
+        return h;
+    }
+
+    static uint64_t mix16(const uint8_t* input, const uint8_t* secret) {
+        return mulFold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+    }
+
+    // Входы до 240 байт хешируются целиком, без полос и аккумуляторов
+    static uint64_t hashShort(const uint8_t* input, size_t length) {
+        const uint64_t len = length;
+        if (length == 0) {
+            return avalancheXXH64(read64(SECRET + 56) ^ read64(SECRET + 64));
+        }
+        if (length <= 3) {
+            uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+                                (static_cast<uint32_t>(input[length >> 1]) << 24) |
+                                static_cast<uint32_t>(input[length - 1]) | (static_cast<uint32_t>(length) << 8);
+            uint64_t bitflip = read32(SECRET) ^ read32(SECRET + 4);
+            return avalancheXXH64(combined ^ bitflip);
+        }
+        if (length <= 8) {
+            uint64_t input64 = read32(input + length - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+            uint64_t bitflip = read64(SECRET + 8) ^ read64(SECRET + 16);
+            return rrmxmx(input64 ^ bitflip, len);
+        }
+        if (length <= 16) {
+            uint64_t lo = read64(input) ^ (read64(SECRET + 24) ^ read64(SECRET + 32));
+            uint64_t hi = read64(input + length - 8) ^ (read64(SECRET + 40) ^ read64(SECRET + 48));
+            return avalanche(len + swap64(lo) + hi + mulFold64(lo, hi));
+        }
+        uint64_t acc = len * PRIME64_1;
+        if (length <= 128) {
+            if (length > 32) {
+                if (length > 64) {
+                    if (length > 96) {
+                        acc += mix16(input + 48, SECRET + 96);
+                        acc += mix16(input + length - 64, SECRET + 112);
+                    }
+                    acc += mix16(input + 32, SECRET + 64);
+                    acc += mix16(input + length - 48, SECRET + 80);
+                }
+                acc += mix16(input + 16, SECRET + 32);
+                acc += mix16(input + length - 32, SECRET + 48);
+            }
+            acc += mix16(input, SECRET);
+            acc += mix16(input + length - 16, SECRET + 16);
+            return avalanche(acc);
+        }
+        size_t rounds = length / 16;
+        for (size_t i = 0; i < 8; ++i) {
+            acc += mix16(input + 16 * i, SECRET + 16 * i);
+        }
+        acc = avalanche(acc);
+        for (size_t i = 8; i < rounds; ++i) {
+            acc += mix16(input + 16 * i, SECRET + 16 * (i - 8) + 3);
+        }
+        acc += mix16(input + length - 16, SECRET + 136 - 17);
+        return avalanche(acc);
+    }
+
+    static void accumulate512(uint64_t* acc, const uint8_t* input, const uint8_t* secret) {
+        for (size_t i = 0; i < ACC_NB; ++i) {
+            uint64_t value = read64(input + 8 * i);
+            uint64_t key = value ^ read64(secret + 8 * i);
+            acc[i ^ 1] += value;
+            acc[i] += (key & 0xFFFFFFFFu) * (key >> 32);
+        }
+    }
+
+    static void accumulate(uint64_t* acc, const uint8_t* input, const uint8_t* secret, size_t stripes) {
+        for (size_t n = 0; n < stripes; ++n) {
+            accumulate512(acc, input + n * STRIPE_LEN, secret + n * SECRET_CONSUME_RATE);
+        }
+    }
+
+    static void scramble(uint64_t* acc, const uint8_t* secret) {
+        for (size_t i = 0; i < ACC_NB; ++i) {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= read64(secret + 8 * i);
+            acc[i] = value * PRIME32_1;
+        }
+    }
+
+    // Полосы потока: после STRIPES_PER_BLOCK полос аккумуляторы перемешиваются
+    static void consumeStripes(uint64_t* acc, size_t& soFar, const uint8_t* input, size_t stripes) {
+        if (STRIPES_PER_BLOCK - soFar <= stripes) {
+            size_t toEnd = STRIPES_PER_BLOCK - soFar;
+            accumulate(acc, input, SECRET + soFar * SECRET_CONSUME_RATE, toEnd);
+            scramble(acc, SECRET + SECRET_LIMIT);
+            accumulate(acc, input + toEnd * STRIPE_LEN, SECRET, stripes - toEnd);
+            soFar = stripes - toEnd;
+        } else {
+            accumulate(acc, input, SECRET + soFar * SECRET_CONSUME_RATE, stripes);
+            soFar += stripes;
+        }
+    }
+
+    static uint64_t mergeAccs(const uint64_t* acc, const uint8_t* secret, uint64_t start) {
+        uint64_t result = start;
+        for (size_t i = 0; i < 4; ++i) {
+            result += mulFold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+        }
+        return avalanche(result);
+    }
+
+    uint64_t acc_[ACC_NB];
+    uint64_t totalLength_ = 0;
+    uint8_t buffer_[BUFFER_SIZE];
+    size_t bufferSize_ = 0;
+    size_t stripesSoFar_ = 0;
+};
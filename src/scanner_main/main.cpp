@@ -1,17 +1,50 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <windows.h>
 #include <filesystem>
 #include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <chrono>
+#include <thread>
 #include "scanner_core.h"
+#include "scan_result_stream.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 
 
 namespace fs = std::filesystem;
 
+#ifdef _WIN32
+using LibraryHandle = HMODULE;
+static const char* const SCANNER_LIBRARY = "scanner_core.dll";
+#else
+using LibraryHandle = void*;
+static const char* const SCANNER_LIBRARY = "libscanner_core.so";
+#endif
+
+// Режим наблюдения идет до SIGINT/SIGTERM, SIGHUP перечитывает базу
+static volatile std::sig_atomic_t stopRequested = 0;
+static volatile std::sig_atomic_t reloadRequested = 0;
+
+static void requestStop(int) {
+    stopRequested = 1;
+}
+
+static void requestReload(int) {
+    reloadRequested = 1;
+}
+
 class ScannerApp {
 private:
-    HMODULE dllHandle;
+    LibraryHandle dllHandle;
     IScannerCore* scanner;
     
     typedef IScannerCore* (*CreateScannerFunc)();
@@ -28,14 +61,14 @@ public:
     }
 
     bool initialize() {
-        dllHandle = LoadLibraryA("scanner_core.dll");
+        dllHandle = loadLibrary();
         if (!dllHandle) {
-            std::cerr << "Failed to load scanner_core.dll" << std::endl;
+            std::cerr << "Failed to load " << SCANNER_LIBRARY << std::endl;
             return false;
         }
 
-        createScanner = (CreateScannerFunc)GetProcAddress(dllHandle, "createScanner");
-        destroyScanner = (DestroyScannerFunc)GetProcAddress(dllHandle, "destroyScanner");
+        createScanner = (CreateScannerFunc)getSymbol("createScanner");
+        destroyScanner = (DestroyScannerFunc)getSymbol("destroyScanner");
 
         if (!createScanner || !destroyScanner) {
             std::cerr << "Failed to get function pointers from DLL" << std::endl;
@@ -52,33 +85,391 @@ public:
             scanner = nullptr;
         }
         if (dllHandle) {
+#ifdef _WIN32
             FreeLibrary(dllHandle);
+#else
+            dlclose(dllHandle);
+#endif
             dllHandle = nullptr;
         }
     }
 
+    // Библиотека ищется рядом с исполняемым файлом (туда ее копирует сборка)
+    LibraryHandle loadLibrary() {
+#ifdef _WIN32
+        return LoadLibraryA(SCANNER_LIBRARY);
+#else
+        std::error_code ec;
+        fs::path exeDir = fs::read_symlink("/proc/self/exe", ec).parent_path();
+        void* handle = nullptr;
+        if (!ec) {
+            handle = dlopen((exeDir / SCANNER_LIBRARY).c_str(), RTLD_NOW);
+        }
+        if (!handle) {
+            handle = dlopen(SCANNER_LIBRARY, RTLD_NOW);
+        }
+        return handle;
+#endif
+    }
+
+    void* getSymbol(const char* name) {
+#ifdef _WIN32
+        return reinterpret_cast<void*>(GetProcAddress(dllHandle, name));
+#else
+        return dlsym(dllHandle, name);
+#endif
+    }
+
     void printUsage() {
-        std::cout << "Usage: scanner.exe --base base.csv --log report.log --path c:\\folder" << std::endl;
+        std::cout << "Usage: scanner.exe --base base.csv [--delta delta.csv ...] --log report.log --path c:\\folder [--path ...]"
+                  << " [--max-depth N] [--follow-symlinks] [--io-engine uring|blocking] [--direct-io] [--mmap]"
+                  << " [--threads split|shared] [--io-threads N] [--hash-threads N] [--fixed-threads]"
+                  << " [--cache scan.cache [--cache-revalidate] [--cache-prune]] [--no-size-filter]"
+                  << " [--prefix-length BYTES] [--no-prefix-check] [--dedup] [--dedup-extents]"
+                  << " [--log-flush-ms N] [--log-durability buffered|interval|always]"
+                  << " [--results results.bin [--results-format binary|ndjson]] [--digests md5,sha1,sha256,xxh3]"
+                  << " [--timings] [--metrics-file scanner.prom] [--progress] [--progress-ms N]"
+                  << " [--watch [--watch-backend auto|fanotify|inotify] [--debounce-us N] [--watch-initial]]"
+                  << std::endl;
+        std::cout << "       scanner.exe --base base.csv --compile base.sigdb" << std::endl;
+    }
+
+    // Итоги загрузки базы: сколько сигнатур принято и сколько строк пропущено
+    void printLoadStats() {
+        BaseLoadStats stats = scanner->getLoadStats();
+        std::cout << "Signatures loaded: " << stats.signatures;
+        if (stats.duplicates || stats.malformed) {
+            std::cout << " (duplicates: " << stats.duplicates << ", malformed lines: " << stats.malformed << ")";
+        }
+        std::cout << std::endl;
+        if (stats.algorithms & ~DIGEST_MD5) {
+            std::cout << "Hash types: " << formatDigestMask(stats.algorithms) << std::endl;
+        }
+        if (stats.fileSizes) {
+            std::cout << "Size filter: " << stats.fileSizes << " distinct file sizes" << std::endl;
+        }
+        if (stats.prefixKeys) {
+            std::cout << "Prefix keys: " << stats.prefixKeys << " (first " << stats.prefixLength
+                      << " bytes)" << std::endl;
+        }
+        if (stats.removed) {
+            std::cout << "Removed by deltas: " << stats.removed << std::endl;
+        }
+    }
+
+    // Дельты применяются поверх загруженной базы по порядку
+    bool applyDeltas(const std::vector<std::string>& deltaPaths) {
+        for (const std::string& deltaPath : deltaPaths) {
+            if (!scanner->applyBaseDelta(deltaPath)) {
+                std::cerr << "Failed to apply base delta from: " << deltaPath << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Строка гистограммы: число замеров, медиана, p99 и среднее в микросекундах
+    static void printLatency(const char* name, const LatencyHistogram& histogram) {
+        if (!histogram.count) {
+            return;
+        }
+        std::printf("  %-14s %10llu  p50 %9.1f  p99 %9.1f  mean %9.1f us\n", name,
+                    static_cast<unsigned long long>(histogram.count),
+                    static_cast<double>(histogram.quantileNs(0.5)) / 1000.0,
+                    static_cast<double>(histogram.quantileNs(0.99)) / 1000.0,
+                    histogram.meanNs() / 1000.0);
+    }
+
+    void printMetrics(const ScanMetrics& metrics) {
+        std::cout << "Throughput: " << static_cast<uint64_t>(metrics.filesPerSecond()) << " files/s, "
+                  << metrics.bytesPerSecond() / (1024 * 1024) << " MiB/s" << std::endl;
+        std::cout << "Directories: " << metrics.directories << ", batches: " << metrics.batches
+                  << ", queue depth avg " << metrics.averageQueueDepth() << " max " << metrics.queueDepthMax
+                  << std::endl;
+        if (metrics.ioThreads) {
+            std::cout << "Threads: " << metrics.ioThreads << " I/O, " << metrics.hashThreads << " hash, "
+                      << metrics.threadAdjustments << " adjustments" << std::endl;
+        }
+        for (size_t i = 0; i < SIZE_CLASSES; ++i) {
+            const FileStageMetrics& stage = metrics.bySize[i];
+            if (stage.files) {
+                std::cout << "Files under " << sizeClassName(static_cast<SizeClass>(i)) << ": " << stage.files
+                          << " (" << stage.bytes / (1024 * 1024) << " MiB)" << std::endl;
+            }
+        }
+        if (!metrics.timings) {
+            return;
+        }
+        std::cout << "Stage latencies (traversal " << static_cast<double>(metrics.listNs) / 1e9 << " s):"
+                  << std::endl;
+        for (size_t i = 0; i < SIZE_CLASSES; ++i) {
+            const FileStageMetrics& stage = metrics.bySize[i];
+            std::string suffix = std::string(" <") + sizeClassName(static_cast<SizeClass>(i));
+            printLatency(("open" + suffix).c_str(), stage.open);
+            printLatency(("read" + suffix).c_str(), stage.read);
+            printLatency(("hash" + suffix).c_str(), stage.hash);
+        }
+        printLatency("stat", metrics.stat);
+        printLatency("cache", metrics.cache);
+        printLatency("prefix", metrics.prefix);
+        printLatency("lookup", metrics.lookup);
+        printLatency("log", metrics.log);
+    }
+
+    static const char* backendName(WatchBackend backend) {
+        switch (backend) {
+        case WatchBackend::Fanotify: return "fanotify";
+        case WatchBackend::Inotify: return "inotify";
+        default: return "auto";
+        }
+    }
+
+    // Режим наблюдения: файлы проверяются по событиям изменения до сигнала
+    // остановки, вердикты по вредоносным файлам печатаются сразу
+    int watch(const std::vector<std::string>& roots, const std::string& logPath,
+              const std::string& basePath, const std::vector<std::string>& deltaPaths,
+              const WatchOptions& watchOptions, bool progress, uint32_t progressMs) {
+        scanner->setWatchCallback([](const FileRecord& record, uint64_t latencyNs) {
+            if (record.status != FileStatus::Malware) {
+                return;
+            }
+            std::printf("%.*s: %.*s (%.1f ms)\n", static_cast<int>(record.path.size()), record.path.data(),
+                        static_cast<int>(record.verdict.size()), record.verdict.data(),
+                        static_cast<double>(latencyNs) / 1e6);
+            std::fflush(stdout);
+        });
+        if (!scanner->startWatch(roots, logPath, watchOptions)) {
+            std::cerr << "Failed to start watching: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+#ifdef SIGHUP
+        std::signal(SIGHUP, requestReload);
+#endif
+        std::cout << "Watching with " << backendName(scanner->getWatchStats().backend)
+                  << ", press Ctrl+C to stop" << std::endl;
+
+        auto nextProgress = std::chrono::steady_clock::now();
+        while (!stopRequested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            // Новая база подменяется на ходу, проверки файлов не останавливаются
+            if (reloadRequested) {
+                reloadRequested = 0;
+                if (scanner->reloadMalwareBase(basePath) && applyDeltas(deltaPaths)) {
+                    std::cout << "Base reloaded, version " << scanner->getLoadStats().version << std::endl;
+                    printLoadStats();
+                } else {
+                    std::cerr << "Failed to reload malware base from: " << basePath << std::endl;
+                }
+            }
+            if (progress && std::chrono::steady_clock::now() >= nextProgress) {
+                nextProgress += std::chrono::milliseconds(progressMs ? progressMs : 1000);
+                WatchStats current = scanner->getWatchStats();
+                std::fprintf(stderr, "%llu events, %llu files checked, %llu pending, p99 %.1f ms\n",
+                             static_cast<unsigned long long>(current.events),
+                             static_cast<unsigned long long>(current.filesScanned),
+                             static_cast<unsigned long long>(current.pending),
+                             static_cast<double>(current.latency.quantileNs(0.99)) / 1e6);
+            }
+        }
+        WatchStats stats = scanner->stopWatch();
+
+        std::cout << "\n=== Watch Report ===" << std::endl;
+        std::cout << "Events: " << stats.events << " (coalesced " << stats.coalesced << ", cancelled "
+                  << stats.cancelled << ", overflows " << stats.overflows << ")" << std::endl;
+        std::cout << "Files checked: " << stats.filesScanned << std::endl;
+        std::cout << "Malware files found: " << stats.malwareFiles << std::endl;
+        std::cout << "Errors: " << stats.errors << " (vanished before check: " << stats.vanished << ")"
+                  << std::endl;
+        printLatency("event->verdict", stats.latency);
+        if (progress) {
+            printMetrics(stats.metrics);
+        }
+        return 0;
+    }
+
+    // Режим компиляции: CSV-база переводится в двоичную для загрузки через mmap
+    int compile(const std::string& basePath, const std::vector<std::string>& deltaPaths,
+                const std::string& outputPath, const ScanOptions& options) {
+        if (basePath.empty()) {
+            printUsage();
+            return 1;
+        }
+        if (!initialize()) {
+            return 1;
+        }
+        scanner->setScanOptions(options);
+        if (!scanner->loadMalwareBase(basePath)) {
+            std::cerr << "Failed to load malware base from: " << basePath << std::endl;
+            return 1;
+        }
+        if (!applyDeltas(deltaPaths)) {
+            return 1;
+        }
+        printLoadStats();
+        if (!scanner->compileMalwareBase(outputPath)) {
+            std::cerr << "Failed to write compiled base to: " << outputPath << std::endl;
+            return 1;
+        }
+        std::cout << "Compiled " << basePath << " -> " << outputPath << std::endl;
+        return 0;
     }
 
     int run(int argc, char* argv[]) {
-        std::string basePath, logPath, scanPath;
+        std::string basePath, logPath, compilePath;
+        std::vector<std::string> scanPaths, deltaPaths;
+        ScanOptions options;
+        bool progress = false;
+        bool watchMode = false;
+        WatchOptions watchOptions;
 
         for (int i = 1; i < argc; ++i) {
             std::string arg = argv[i];
             if (arg == "--base" && i + 1 < argc) {
                 basePath = argv[++i];
+            } else if (arg == "--delta" && i + 1 < argc) {
+                deltaPaths.push_back(argv[++i]);
             } else if (arg == "--log" && i + 1 < argc) {
                 logPath = argv[++i];
             } else if (arg == "--path" && i + 1 < argc) {
-                scanPath = argv[++i];
+                scanPaths.push_back(argv[++i]);
+            } else if (arg == "--max-depth" && i + 1 < argc) {
+                options.maxDepth = std::atoi(argv[++i]);
+            } else if (arg == "--follow-symlinks") {
+                options.followSymlinks = true;
+            } else if (arg == "--io-engine" && i + 1 < argc) {
+                std::string engine = argv[++i];
+                if (engine == "blocking") {
+                    options.ioEngine = IoEngine::Blocking;
+                } else if (engine == "uring") {
+                    options.ioEngine = IoEngine::Uring;
+                } else {
+                    std::cerr << "Unknown I/O engine: " << engine << std::endl;
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--direct-io") {
+                options.directIo = true;
+            } else if (arg == "--mmap") {
+                options.mapLargeFiles = true;
+            } else if (arg == "--threads" && i + 1 < argc) {
+                std::string model = argv[++i];
+                if (model == "split") {
+                    options.threadModel = ThreadModel::Split;
+                } else if (model == "shared") {
+                    options.threadModel = ThreadModel::Shared;
+                } else {
+                    std::cerr << "Unknown thread model: " << model << std::endl;
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--io-threads" && i + 1 < argc) {
+                options.ioThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--hash-threads" && i + 1 < argc) {
+                options.hashThreads = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--fixed-threads") {
+                options.adaptiveThreads = false;
+            } else if (arg == "--cache" && i + 1 < argc) {
+                options.cachePath = argv[++i];
+            } else if (arg == "--cache-revalidate") {
+                options.revalidateCache = true;
+            } else if (arg == "--cache-prune") {
+                options.pruneCache = true;
+            } else if (arg == "--no-size-filter") {
+                options.sizeFilter = false;
+            } else if (arg == "--prefix-length" && i + 1 < argc) {
+                options.prefixLength = std::strtoull(argv[++i], nullptr, 10);
+                if (options.prefixLength == 0) {
+                    std::cerr << "Prefix length must be positive" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "--no-prefix-check") {
+                options.prefixCheck = false;
+            } else if (arg == "--log-flush-ms" && i + 1 < argc) {
+                options.logFlushIntervalMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--log-durability" && i + 1 < argc) {
+                std::string durability = argv[++i];
+                if (durability == "buffered") {
+                    options.logDurability = LogDurability::Buffered;
+                } else if (durability == "interval") {
+                    options.logDurability = LogDurability::Interval;
+                } else if (durability == "always") {
+                    options.logDurability = LogDurability::EveryWrite;
+                } else {
+                    std::cerr << "Unknown log durability: " << durability << std::endl;
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--results" && i + 1 < argc) {
+                options.resultPath = argv[++i];
+            } else if (arg == "--results-format" && i + 1 < argc) {
+                std::string format = argv[++i];
+                if (format == "binary") {
+                    options.resultFormat = ResultFormat::Binary;
+                } else if (format == "ndjson") {
+                    options.resultFormat = ResultFormat::Ndjson;
+                } else {
+                    std::cerr << "Unknown results format: " << format << std::endl;
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--digests" && i + 1 < argc) {
+                std::string list = argv[++i];
+                DigestMask digests = 0;
+                if (!parseDigestMask(list, digests)) {
+                    std::cerr << "Unknown digest list: " << list << std::endl;
+                    printUsage();
+                    return 1;
+                }
+                options.digests = digests;
+            } else if (arg == "--dedup") {
+                options.dedupHardLinks = true;
+            } else if (arg == "--dedup-extents") {
+                options.dedupExtents = true;
+            } else if (arg == "--timings") {
+                options.collectTimings = true;
+            } else if (arg == "--metrics-file" && i + 1 < argc) {
+                options.metricsPath = argv[++i];
+            } else if (arg == "--progress") {
+                progress = true;
+            } else if (arg == "--progress-ms" && i + 1 < argc) {
+                options.progressIntervalMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--watch") {
+                watchMode = true;
+            } else if (arg == "--watch-backend" && i + 1 < argc) {
+                std::string backend = argv[++i];
+                if (backend == "auto") {
+                    watchOptions.backend = WatchBackend::Auto;
+                } else if (backend == "fanotify") {
+                    watchOptions.backend = WatchBackend::Fanotify;
+                } else if (backend == "inotify") {
+                    watchOptions.backend = WatchBackend::Inotify;
+                } else {
+                    printUsage();
+                    return 1;
+                }
+            } else if (arg == "--debounce-us" && i + 1 < argc) {
+                watchOptions.debounceUs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            } else if (arg == "--watch-initial") {
+                watchOptions.initialScan = true;
+            } else if (arg == "--compile" && i + 1 < argc) {
+                compilePath = argv[++i];
             }
         }
+        if (!options.resultPath.empty() && options.resultFormat == ResultFormat::None) {
+            options.resultFormat = ResultFormat::Binary;
+        }
+        if (!compilePath.empty()) {
+            return compile(basePath, deltaPaths, compilePath, options);
+        }
         std::cout << "Arguments" << std::endl;
         std::cout << basePath << std::endl;
         std::cout << logPath << std::endl;
-        std::cout << scanPath << std::endl;
-        if (basePath.empty() || logPath.empty() || scanPath.empty()) {
+        for (const std::string& scanPath : scanPaths) {
+            std::cout << scanPath << std::endl;
+        }
+        if (basePath.empty() || logPath.empty() || scanPaths.empty()) {
             printUsage();
             return 1;
         }
@@ -87,22 +478,99 @@ public:
             return 1;
         }
 
+        // Параметры нужны уже при загрузке: длина префикса для ключей CSV-базы
+        scanner->setScanOptions(options);
+
         // Загрузка базы вредоносных хешей
         if (!scanner->loadMalwareBase(basePath)) {
             std::cerr << "Failed to load malware base from: " << basePath << std::endl;
             return 1;
         }
+        if (!applyDeltas(deltaPaths)) {
+            return 1;
+        }
+        printLoadStats();
 
-        std::cout << "Starting scan of directory: " << scanPath << std::endl;
+        if (watchMode) {
+            std::cout << "Log file: " << logPath << std::endl;
+            return watch(scanPaths, logPath, basePath, deltaPaths, watchOptions, progress, options.progressIntervalMs);
+        }
+
+        for (const std::string& scanPath : scanPaths) {
+            std::cout << "Starting scan of directory: " << scanPath << std::endl;
+        }
         std::cout << "Log file: " << logPath << std::endl;
 
-        ScanResult result = scanner->scanDirectory(scanPath, logPath);
+        // Ход сканирования идет в stderr, чтобы не смешиваться с отчетом
+        if (progress) {
+            scanner->setProgressCallback([](const ScanProgress& current) {
+                if (current.finished) {
+                    return;
+                }
+                std::fprintf(stderr, "[%7.1f s] %llu/%llu files, %.0f files/s, %.1f MiB/s, queue %llu",
+                             current.metrics.elapsed,
+                             static_cast<unsigned long long>(current.metrics.filesDone),
+                             static_cast<unsigned long long>(current.metrics.filesFound),
+                             current.filesPerSecond, current.bytesPerSecond / (1024 * 1024),
+                             static_cast<unsigned long long>(current.metrics.queueDepth));
+                if (current.metrics.ioThreads) {
+                    std::fprintf(stderr, ", threads %llu/%llu",
+                                 static_cast<unsigned long long>(current.metrics.ioThreads),
+                                 static_cast<unsigned long long>(current.metrics.hashThreads));
+                }
+                std::fputc('\n', stderr);
+            });
+        }
+
+        // Несколько каталогов сканируются одним пакетом в общем пуле
+        ScanResult result;
+        if (scanPaths.size() == 1) {
+            result = scanner->scanDirectory(scanPaths[0], logPath);
+        } else {
+            std::vector<ScanTarget> targets(scanPaths.size());
+            for (size_t t = 0; t < scanPaths.size(); ++t) {
+                targets[t].root = scanPaths[t];
+            }
+            BatchScanResult batch = scanner->scanBatch(targets, logPath);
+            std::cout << "\n=== Directories ===" << std::endl;
+            for (size_t t = 0; t < scanPaths.size(); ++t) {
+                const ScanResult& target = batch.targets[t];
+                std::cout << scanPaths[t] << ": " << target.totalFiles << " files, " << target.malwareFiles
+                          << " malware, " << target.errors << " errors, " << target.duration << " s" << std::endl;
+            }
+            result = batch.total;
+        }
 
         std::cout << "\n=== Scan Report ===" << std::endl;
         std::cout << "Total files processed: " << result.totalFiles << std::endl;
         std::cout << "Malware files found: " << result.malwareFiles << std::endl;
         std::cout << "Errors: " << result.errors << std::endl;
+        if (result.sizeSkippedFiles) {
+            std::cout << "Skipped by size: " << result.sizeSkippedFiles << " files ("
+                      << result.sizeSkippedBytes / (1024 * 1024) << " MiB not read)" << std::endl;
+        }
+        if (result.linkedFiles) {
+            std::cout << "Shared content: " << result.linkedFiles << " files ("
+                      << result.linkedBytes / (1024 * 1024) << " MiB not read)" << std::endl;
+        }
+        if (result.prefixRejectedFiles) {
+            std::cout << "Rejected by prefix: " << result.prefixRejectedFiles << " files ("
+                      << result.prefixSkippedBytes / (1024 * 1024) << " MiB not read)" << std::endl;
+        }
+        if (!options.cachePath.empty()) {
+            std::cout << "Files from cache: " << result.cachedFiles << std::endl;
+            if (options.revalidateCache) {
+                std::cout << "Cache mismatches: " << result.cacheMismatches << std::endl;
+            }
+        }
+        if (result.resultRecords) {
+            std::cout << "Results: " << result.resultRecords << " records, " << result.resultBytes << " bytes ("
+                      << result.resultBytes / result.resultRecords << " bytes per record)" << std::endl;
+        }
         std::cout << "Time elapsed: " << result.duration << " seconds" << std::endl;
+        if (options.collectTimings || progress) {
+            printMetrics(result.metrics);
+        }
 
         return 0;
     }
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include "bloom_filter.h"
+#include <random>
+#include <vector>
+
+TEST(BlockedBloomFilterTest, NoFalseNegatives) {
+    BlockedBloomFilter filter;
+    filter.init(100000);
+
+    std::mt19937_64 rng(1);
+    std::vector<std::pair<uint64_t, uint64_t>> keys;
+    for (int i = 0; i < 100000; ++i) {
+        keys.emplace_back(rng(), rng());
+        filter.add(keys.back().first, keys.back().second);
+    }
+    for (const auto& key : keys) {
+        ASSERT_TRUE(filter.mayContain(key.first, key.second));
+    }
+}
+
+TEST(BlockedBloomFilterTest, FalsePositiveRate) {
+    const int count = 200000;
+    BlockedBloomFilter filter;
+    filter.init(count);
+    EXPECT_LE(filter.sizeBytes() * 8, count * BlockedBloomFilter::BITS_PER_KEY + 256);
+
+    std::mt19937_64 rng(2);
+    for (int i = 0; i < count; ++i) {
+        filter.add(rng(), rng());
+    }
+    int falsePositives = 0;
+    for (int i = 0; i < count; ++i) {
+        falsePositives += filter.mayContain(rng(), rng()) ? 1 : 0;
+    }
+    // При 10 битах на ключ ожидается около 1%
+    EXPECT_LT(falsePositives, count / 50);
+}
+
+TEST(BlockedBloomFilterTest, EmptyFilterPassesEverything) {
+    BlockedBloomFilter filter;
+    EXPECT_TRUE(filter.empty());
+    EXPECT_TRUE(filter.mayContain(1, 2));
+
+    filter.init(10);
+    EXPECT_FALSE(filter.empty());
+    EXPECT_FALSE(filter.mayContain(1, 2));
+}
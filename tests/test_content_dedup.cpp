@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "content_dedup.h"
+#include "test_utils.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+ContentKey inodeKey(uint64_t inode) {
+    FileStamp stamp;
+    stamp.device = 1;
+    stamp.inode = inode;
+    stamp.size = 100;
+    stamp.links = 2;
+    ContentKey key;
+    EXPECT_TRUE(ContentDedup::inodeKeyOf(stamp, key));
+    return key;
+}
+
+}
+
+TEST(ContentDedupTest, InodeKeyOnlyForLinkedFiles) {
+    FileStamp stamp;
+    stamp.device = 1;
+    stamp.inode = 42;
+    ContentKey key;
+    EXPECT_FALSE(ContentDedup::inodeKeyOf(stamp, key));
+    stamp.links = 3;
+    EXPECT_TRUE(ContentDedup::inodeKeyOf(stamp, key));
+    EXPECT_EQ(key.inode, 42u);
+    EXPECT_TRUE(key.extents.empty());
+}
+
+// Первый путь читает файл, остальные получают его итог
+TEST(ContentDedupTest, WaitersGetOwnerResult) {
+    ContentDedup dedup;
+    ContentKey key = inodeKey(7);
+    int calls = 0;
+    ContentDedup::Result seen;
+    auto waiter = [&](const ContentDedup::Result& result) {
+        calls++;
+        seen = result;
+    };
+
+    EXPECT_TRUE(dedup.claim(key, waiter));
+    EXPECT_FALSE(dedup.claim(key, waiter));
+    EXPECT_FALSE(dedup.claim(key, waiter));
+    EXPECT_EQ(calls, 0);
+    // Другое содержимое не ждет
+    EXPECT_TRUE(dedup.claim(inodeKey(8), waiter));
+
+    ContentDedup::Result result;
+    result.outcome = ContentDedup::Outcome::Digest;
+    result.digests.mask = DIGEST_MD5 | DIGEST_XXH3;
+    result.digests.md5 = MD5::hash("hello", 5);
+    result.digests.xxh3 = XXH3::hash("hello", 5);
+    dedup.complete(key, result);
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(seen.outcome, ContentDedup::Outcome::Digest);
+    EXPECT_EQ(seen.digests.mask, result.digests.mask);
+    EXPECT_EQ(seen.digests.md5, result.digests.md5);
+    EXPECT_EQ(seen.digests.xxh3, result.digests.xxh3);
+
+    // После завершения итог отдается сразу
+    EXPECT_FALSE(dedup.claim(key, waiter));
+    EXPECT_EQ(calls, 3);
+}
+
+// Без обработчика: ждать приходится только, пока первый путь не сообщил итог
+TEST(ContentDedupTest, TryClaimThenWait) {
+    ContentDedup dedup;
+    ContentKey key = inodeKey(9);
+    ContentDedup::Result seen;
+    EXPECT_EQ(dedup.tryClaim(key, seen), ContentDedup::Claim::Owner);
+    EXPECT_EQ(dedup.tryClaim(key, seen), ContentDedup::Claim::Busy);
+
+    int calls = 0;
+    dedup.wait(key, [&](const ContentDedup::Result& result) {
+        calls++;
+        seen = result;
+    });
+    EXPECT_EQ(calls, 0);
+    ContentDedup::Result result;
+    result.outcome = ContentDedup::Outcome::Error;
+    result.error = 5;
+    dedup.complete(key, result);
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(seen.error, 5);
+
+    ContentDedup::Result known;
+    EXPECT_EQ(dedup.tryClaim(key, known), ContentDedup::Claim::Done);
+    EXPECT_EQ(known.outcome, ContentDedup::Outcome::Error);
+    EXPECT_EQ(known.error, 5);
+    // Итог появился между tryClaim и wait: обработчик вызывается сразу
+    dedup.wait(key, [&](const ContentDedup::Result&) { calls++; });
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(ContentDedupTest, ConcurrentClaimsHaveOneOwner) {
+    const int THREADS = 8;
+    const int KEYS = 1000;
+    ContentDedup dedup;
+    std::atomic<int> owners{0};
+    std::atomic<int> waited{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&]() {
+            for (int k = 0; k < KEYS; ++k) {
+                ContentKey key = inodeKey(static_cast<uint64_t>(k + 1));
+                if (dedup.claim(key, [&](const ContentDedup::Result&) { waited++; })) {
+                    owners++;
+                    dedup.complete(key, ContentDedup::Result());
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(owners, KEYS);
+    EXPECT_EQ(waited, (THREADS - 1) * KEYS);
+}
+
+// Обычный файл без общих экстентов ключа по экстентам не получает
+TEST(ContentDedupTest, ExtentKeyNeedsSharedExtents) {
+    std::string path = test_utils::createTempFile(std::string(ContentDedup::EXTENT_MIN_SIZE * 2, 'x'), ".bin");
+    FileStamp stamp;
+    ASSERT_TRUE(ScanCache::stampOf(path, stamp));
+    ContentKey key;
+    EXPECT_FALSE(ContentDedup::extentKeyOf(path, stamp, key));
+    test_utils::cleanup(path);
+}
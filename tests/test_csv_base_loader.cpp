@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+#include "csv_base_loader.h"
+#include "md5_calculator.h"
+#include "test_utils.h"
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+MD5Digest fromHex(const char* hex) {
+    MD5Digest digest{};
+    EXPECT_TRUE(SignatureIndex::parseHex(hex, std::strlen(hex), digest));
+    return digest;
+}
+
+// Файл пишется в двоичном режиме, чтобы \r\n сохранились как есть
+std::string writeBase(const std::string& content) {
+    std::string path = test_utils::createTempFile("", ".csv");
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+    return path;
+}
+
+const char* const HASH_A = "d41d8cd98f00b204e9800998ecf8427e";
+const char* const HASH_B = "5d41402abc4b2a76b9719d911017c592";
+const char* const HASH_C = "9f86d081884c7d659a2feaa0c55ad015";
+
+}
+
+TEST(CsvBaseLoaderTest, CrLfBomAndEmptyLines) {
+    std::string path = writeBase(std::string("\xEF\xBB\xBF") + HASH_A + ";Trojan\r\n\r\n" +
+                                 HASH_B + ";Worm\n\n" + HASH_C + ";Exploit");
+
+    SignatureIndex index;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+
+    EXPECT_EQ(index.size(), 3u);
+    EXPECT_EQ(*index.find(fromHex(HASH_A)), "Trojan");
+    EXPECT_EQ(*index.find(fromHex(HASH_B)), "Worm");
+    // Последняя строка без перевода строки тоже загружается
+    EXPECT_EQ(*index.find(fromHex(HASH_C)), "Exploit");
+
+    EXPECT_EQ(stats.lines, 5u);
+    EXPECT_EQ(stats.emptyLines, 2u);
+    EXPECT_EQ(stats.signatures, 3u);
+    EXPECT_EQ(stats.malformed, 0u);
+
+    test_utils::cleanup(path);
+}
+
+TEST(CsvBaseLoaderTest, CountsMalformedUppercaseAndDuplicates) {
+    std::string path = writeBase(std::string(HASH_A) + ";Trojan\n" +
+                                 "no delimiter\n" +
+                                 "d41d8cd98f00b204e9800998ecf8427;Short\n" +
+                                 "z41d8cd98f00b204e9800998ecf8427e;BadHex\n" +
+                                 "5D41402ABC4B2A76B9719D911017C592;Worm\n" +
+                                 HASH_A + ";Dropper\n" +
+                                 HASH_C + ";\n");
+
+    SignatureIndex index;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+
+    EXPECT_EQ(stats.lines, 7u);
+    EXPECT_EQ(stats.signatures, 4u);
+    EXPECT_EQ(stats.malformed, 3u);
+    EXPECT_EQ(stats.uppercase, 1u);
+    EXPECT_EQ(stats.duplicates, 1u);
+
+    EXPECT_EQ(index.size(), 3u);
+    // Для повторного дайджеста побеждает последняя строка
+    EXPECT_EQ(*index.find(fromHex(HASH_A)), "Dropper");
+    EXPECT_EQ(*index.find(fromHex(HASH_B)), "Worm");
+    EXPECT_EQ(*index.find(fromHex(HASH_C)), "");
+
+    test_utils::cleanup(path);
+}
+
+TEST(CsvBaseLoaderTest, MissingAndEmptyFiles) {
+    SignatureIndex index;
+    EXPECT_FALSE(CsvBaseLoader::load("nonexistent_base.csv", index));
+
+    std::string path = writeBase("");
+    CsvBaseLoader::Stats stats;
+    EXPECT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(stats.lines, 0u);
+
+    test_utils::cleanup(path);
+}
+
+TEST(CsvBaseLoaderTest, ResultDoesNotDependOnThreadsAndChunks) {
+    // Много повторов и мелкие куски: повторы одного дайджеста попадают в разные
+    // куски и разные диапазоны таблицы
+    std::mt19937_64 rng(3);
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 2000; ++i) {
+        MD5Digest digest;
+        uint64_t words[2] = {rng(), rng()};
+        std::memcpy(digest.data(), words, 16);
+        digests.push_back(digest);
+    }
+    // Ожидаемый вердикт - из последней строки с дайджестом
+    std::vector<std::string> expected(digests.size());
+    std::ostringstream csv;
+    for (int i = 0; i < 20000; ++i) {
+        size_t d = rng() % digests.size();
+        expected[d] = "Family" + std::to_string(i % 37);
+        csv << MD5Calculator::bytesToHexString(digests[d].data(), 16) << ";" << expected[d];
+        csv << (i % 5 == 0 ? "\r\n" : "\n");
+        if (i % 101 == 0) csv << "broken line\n";
+    }
+    std::string path = writeBase(csv.str());
+
+    SignatureIndex serial;
+    CsvBaseLoader::Stats serialStats;
+    CsvLoadOptions serialOptions;
+    serialOptions.threads = 1;
+    serialOptions.chunkSize = 1 << 30;
+    ASSERT_TRUE(CsvBaseLoader::load(path, serial, serialOptions, &serialStats));
+
+    SignatureIndex parallel;
+    CsvBaseLoader::Stats parallelStats;
+    CsvLoadOptions parallelOptions;
+    parallelOptions.threads = 8;
+    parallelOptions.chunkSize = 4096;
+    ASSERT_TRUE(CsvBaseLoader::load(path, parallel, parallelOptions, &parallelStats));
+
+    EXPECT_EQ(parallelStats.lines, serialStats.lines);
+    EXPECT_EQ(parallelStats.signatures, 20000u);
+    EXPECT_EQ(parallelStats.malformed, serialStats.malformed);
+    EXPECT_EQ(parallelStats.duplicates, serialStats.duplicates);
+    EXPECT_EQ(parallel.size(), serial.size());
+    EXPECT_EQ(parallel.verdictCount(), serial.verdictCount());
+    EXPECT_EQ(serialStats.signatures - serialStats.duplicates, serial.size());
+
+    for (size_t d = 0; d < digests.size(); ++d) {
+        for (const SignatureIndex* index : {&serial, &parallel}) {
+            const std::string* verdict = index->find(digests[d]);
+            if (expected[d].empty()) {
+                EXPECT_EQ(verdict, nullptr);
+            } else {
+                ASSERT_NE(verdict, nullptr);
+                EXPECT_EQ(*verdict, expected[d]);
+            }
+        }
+    }
+
+    test_utils::cleanup(path);
+}
+
+// Третья колонка - размер файла; вердикт с ';' без числа в хвосте остается целым
+TEST(CsvBaseLoaderTest, OptionalFileSizeColumn) {
+    std::string path = writeBase(std::string(HASH_A) + ";Trojan;0\n" +
+                                 HASH_B + ";Worm;5\r\n" +
+                                 HASH_C + ";Exploit;1048576\n");
+    SignatureIndex index;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+    EXPECT_EQ(stats.signatures, 3u);
+    EXPECT_EQ(stats.sized, 3u);
+    EXPECT_EQ(*index.find(fromHex(HASH_B)), "Worm");
+    EXPECT_TRUE(index.hasSizeFilter());
+    EXPECT_EQ(index.fileSizeCount(), 3u);
+    EXPECT_TRUE(index.mayMatchSize(5));
+    EXPECT_TRUE(index.mayMatchSize(1048576));
+    EXPECT_FALSE(index.mayMatchSize(6));
+    test_utils::cleanup(path);
+
+    // Одна сигнатура без размера - файл любого размера может совпасть
+    path = writeBase(std::string(HASH_A) + ";Trojan;0\n" +
+                     HASH_B + ";Worm;Variant A\n" +
+                     HASH_C + ";Exploit;12x\n");
+    SignatureIndex mixed;
+    ASSERT_TRUE(CsvBaseLoader::load(path, mixed, CsvLoadOptions(), &stats));
+    EXPECT_EQ(stats.sized, 1u);
+    EXPECT_EQ(*mixed.find(fromHex(HASH_B)), "Worm;Variant A");
+    EXPECT_EQ(*mixed.find(fromHex(HASH_C)), "Exploit;12x");
+    EXPECT_FALSE(mixed.hasSizeFilter());
+    EXPECT_TRUE(mixed.mayMatchSize(6));
+    test_utils::cleanup(path);
+}
+
+// Четвертая колонка - ключ префикса: MD5 первых байт файла, длина задается при загрузке
+TEST(CsvBaseLoaderTest, PrefixKeyColumn) {
+    const char* PREFIX = "0123456789abcdef0123456789ABCDEF";
+    std::string path = writeBase(std::string(HASH_A) + ";Trojan;200000;" + PREFIX + "\n" +
+                                 HASH_B + ";Worm;300000\n" +
+                                 HASH_C + ";Note;" + PREFIX + "\n");
+    SignatureIndex index;
+    CsvLoadOptions options;
+    options.prefixLength = 1024;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, options, &stats));
+    EXPECT_EQ(stats.signatures, 3u);
+    EXPECT_EQ(stats.sized, 2u);
+    EXPECT_EQ(stats.prefixed, 1u);
+    EXPECT_EQ(*index.find(fromHex(HASH_A)), "Trojan");
+    EXPECT_EQ(*index.find(fromHex(HASH_C)), std::string("Note;") + PREFIX);
+    EXPECT_EQ(index.prefixLength(), 1024u);
+    EXPECT_EQ(index.prefixKeyCount(), 1u);
+    EXPECT_TRUE(index.mayMatchPrefix(200000, fromHex(PREFIX)));
+    // Сигнатура HASH_C без размера: ни размер, ни префикс файлы не отсеивают
+    EXPECT_FALSE(index.usesPrefixKey(200000));
+    test_utils::cleanup(path);
+
+    // Вторая база с другой длиной префикса: ее ключи не смешиваются с уже загруженными
+    path = writeBase(std::string(HASH_C) + ";Exploit;400000;" + PREFIX + "\n");
+    options.prefixLength = 4096;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, options, &stats));
+    EXPECT_EQ(stats.prefixed, 0u);
+    EXPECT_EQ(index.prefixLength(), 1024u);
+    EXPECT_EQ(index.prefixKeyCount(), 1u);
+    EXPECT_TRUE(index.mayMatchSize(400000));
+    test_utils::cleanup(path);
+}
+
+// В дельте "-hash" удаляет сигнатуру; в обычной базе такая строка неверна
+TEST(CsvBaseLoaderTest, DeltaRemovals) {
+    std::string path = writeBase(std::string("-") + HASH_A + "\n" +
+                                 HASH_B + ";Worm;120\n" +
+                                 "-not a hash\n" +
+                                 "-" + HASH_C + "\r\n");
+
+    SignatureIndex added;
+    std::vector<MD5Digest> removed;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::loadDelta(path, added, removed, CsvLoadOptions(), &stats));
+    EXPECT_EQ(added.size(), 1u);
+    EXPECT_EQ(*added.find(fromHex(HASH_B)), "Worm");
+    EXPECT_TRUE(added.hasSizeFilter());
+    ASSERT_EQ(removed.size(), 2u);
+    EXPECT_EQ(removed[0], fromHex(HASH_A));
+    EXPECT_EQ(removed[1], fromHex(HASH_C));
+    EXPECT_EQ(stats.removals, 2u);
+    EXPECT_EQ(stats.malformed, 1u);
+
+    SignatureIndex index;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+    EXPECT_EQ(index.size(), 1u);
+    EXPECT_EQ(stats.removals, 0u);
+    EXPECT_EQ(stats.malformed, 3u);
+
+    test_utils::cleanup(path);
+}
+
+// Хеши SHA-1 и SHA-256 узнаются по длине или по колонке типа перед хешем
+TEST(CsvBaseLoaderTest, HashTypeColumn) {
+    const char* SHA1_HELLO = "aaf4c61ddcc5e8a2dabede0f3b482cd9aea9434d";
+    const char* SHA256_HELLO = "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824";
+    std::string path = writeBase(std::string("SHA256;") + SHA256_HELLO + ";Trojan.Sha;5\n" +
+                                 SHA1_HELLO + ";Worm.Sha\n" +
+                                 "md5;" + HASH_A + ";Typed\n" +
+                                 "sha1;" + HASH_B + ";WrongLength\n" +
+                                 "sha512;" + SHA256_HELLO + ";UnknownType\n");
+    SignatureIndex index;
+    CsvBaseLoader::Stats stats;
+    ASSERT_TRUE(CsvBaseLoader::load(path, index, CsvLoadOptions(), &stats));
+    EXPECT_EQ(stats.signatures, 3u);
+    EXPECT_EQ(stats.sha1, 1u);
+    EXPECT_EQ(stats.sha256, 1u);
+    EXPECT_EQ(stats.malformed, 2u);
+    EXPECT_EQ(stats.sized, 1u);
+    EXPECT_EQ(index.algorithms(), DIGEST_MD5 | DIGEST_SHA1 | DIGEST_SHA256);
+
+    const SHA256Digest sha256 = SHA256::hash("hello", 5);
+    const SHA1Digest sha1 = SHA1::hash("hello", 5);
+    ASSERT_NE(index.find(HashAlgorithm::SHA256, sha256.data()), nullptr);
+    EXPECT_EQ(*index.find(HashAlgorithm::SHA256, sha256.data()), "Trojan.Sha");
+    ASSERT_NE(index.find(HashAlgorithm::SHA1, sha1.data()), nullptr);
+    EXPECT_EQ(*index.find(HashAlgorithm::SHA1, sha1.data()), "Worm.Sha");
+    EXPECT_EQ(*index.find(fromHex(HASH_A)), "Typed");
+    EXPECT_TRUE(index.mayMatchSize(5));
+    test_utils::cleanup(path);
+
+    // В дельте тип тоже можно указать
+    path = writeBase(std::string("-sha256;") + SHA256_HELLO + "\n-" + SHA1_HELLO + "\n");
+    SignatureIndex added;
+    std::vector<MD5Digest> removed;
+    ASSERT_TRUE(CsvBaseLoader::loadDelta(path, added, removed, CsvLoadOptions(), &stats));
+    ASSERT_EQ(removed.size(), 2u);
+    EXPECT_EQ(removed[0], SignatureIndex::keyDigest(HashAlgorithm::SHA256, sha256.data()));
+    EXPECT_EQ(removed[1], SignatureIndex::keyDigest(HashAlgorithm::SHA1, sha1.data()));
+    test_utils::cleanup(path);
+}
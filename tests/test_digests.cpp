@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include "digest_set.h"
+#include "md5_calculator.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const ShaKernels::Isa ALL_ISAS[] = {
+    ShaKernels::Isa::Scalar,
+    ShaKernels::Isa::ShaNi,
+};
+
+template <class Digest>
+std::string toHex(const Digest& digest) {
+    return MD5Calculator::bytesToHexString(digest.data(), digest.size());
+}
+
+// Те же данные, что и в эталонных значениях, посчитанных xxhsum
+std::vector<uint8_t> patternData(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    return data;
+}
+
+std::vector<uint8_t> randomData(size_t size, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = static_cast<uint8_t>(rng());
+    }
+    return data;
+}
+
+// Размеры вокруг границ блоков SHA (64), полос и блоков XXH3 (64, 240, 1024) и среза DigestSet
+const size_t SIZES[] = {0, 1, 3, 4, 8, 9, 16, 17, 55, 56, 63, 64, 65, 119, 120, 127, 128, 129, 240, 241,
+                        255, 256, 257, 1023, 1024, 1025, 2048, 5000, DigestSet::SLICE + 1, 100000};
+
+}
+
+TEST(ShaTest, KnownVectors) {
+    for (ShaKernels::Isa isa : ALL_ISAS) {
+        ShaKernel kernel = ShaKernels::get(isa);
+        SCOPED_TRACE(kernel.name);
+        SHA1 sha1(kernel);
+        SHA256 sha256(kernel);
+
+        EXPECT_EQ(toHex(sha1.finalize()), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+        EXPECT_EQ(toHex(sha256.finalize()), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+        sha1.update("abc", 3);
+        sha256.update("abc", 3);
+        EXPECT_EQ(toHex(sha1.finalize()), "a9993e364706816aba3e25717850c26c9cd0d89d");
+        EXPECT_EQ(toHex(sha256.finalize()), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+        // Паддинг не помещается в последний блок
+        const std::string twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+        sha1.update(twoBlocks.data(), twoBlocks.size());
+        sha256.update(twoBlocks.data(), twoBlocks.size());
+        EXPECT_EQ(toHex(sha1.finalize()), "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+        EXPECT_EQ(toHex(sha256.finalize()), "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+        const std::string million(1000000, 'a');
+        sha1.update(million.data(), million.size());
+        sha256.update(million.data(), million.size());
+        EXPECT_EQ(toHex(sha1.finalize()), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+        EXPECT_EQ(toHex(sha256.finalize()), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+}
+
+TEST(ShaTest, KernelsAgreeOnAnyChunking) {
+    ShaKernel scalar = ShaKernels::get(ShaKernels::Isa::Scalar);
+    for (ShaKernels::Isa isa : ALL_ISAS) {
+        if (!ShaKernels::supported(isa)) {
+            continue;
+        }
+        ShaKernel kernel = ShaKernels::get(isa);
+        SCOPED_TRACE(kernel.name);
+        unsigned int seed = 1;
+        for (size_t size : SIZES) {
+            std::vector<uint8_t> data = randomData(size, seed++);
+            SHA1 expected1(scalar);
+            SHA256 expected256(scalar);
+            expected1.update(data.data(), data.size());
+            expected256.update(data.data(), data.size());
+            SHA1Digest digest1 = expected1.finalize();
+            SHA256Digest digest256 = expected256.finalize();
+
+            // Куски неровной длины: хвосты блоков копятся в буфере
+            SHA1 sha1(kernel);
+            SHA256 sha256(kernel);
+            std::mt19937 rng(seed);
+            for (size_t pos = 0; pos < size;) {
+                size_t take = std::min<size_t>(size - pos, rng() % 200);
+                sha1.update(data.data() + pos, take);
+                sha256.update(data.data() + pos, take);
+                pos += take;
+            }
+            EXPECT_EQ(sha1.finalize(), digest1) << "size " << size;
+            EXPECT_EQ(sha256.finalize(), digest256) << "size " << size;
+        }
+    }
+}
+
+TEST(ShaTest, BestIsSupported) {
+    EXPECT_TRUE(ShaKernels::supported(ShaKernels::Isa::Scalar));
+    const ShaKernel& best = ShaKernels::best();
+    EXPECT_NE(best.sha1, nullptr);
+    EXPECT_NE(best.sha256, nullptr);
+    if (ShaKernels::supported(ShaKernels::Isa::ShaNi)) {
+        EXPECT_STREQ(best.name, "sha-ni");
+    }
+}
+
+TEST(XXH3Test, KnownValues) {
+    const std::pair<size_t, uint64_t> expected[] = {
+        {0, 0x2d06800538d394c2ull},      {1, 0x4c5cca45d0f4811full},    {3, 0x15f7093b173d005cull},
+        {4, 0xdca012f95811b6b9ull},      {8, 0xdec6a9a43575982eull},    {9, 0xcbe393399f17ffbdull},
+        {16, 0x7e484c18d74895d0ull},     {17, 0x208bde5ee2bed407ull},   {128, 0xf92b70eaa21a6288ull},
+        {129, 0xf8f76713f2bb60faull},    {240, 0xccc7375172c41f03ull},  {241, 0x0b3b630948ce4a00ull},
+        {1024, 0x23bc880ebf0d29c6ull},   {1025, 0xc09fdfbc398c7d82ull}, {100000, 0xccf90df7e7e37036ull},
+    };
+    for (const auto& item : expected) {
+        std::vector<uint8_t> data = patternData(item.first);
+        EXPECT_EQ(XXH3::hash(data.data(), data.size()), item.second) << "size " << item.first;
+
+        XXH3 stream;
+        stream.update(data.data(), data.size());
+        EXPECT_EQ(stream.digest(), item.second) << "size " << item.first;
+    }
+}
+
+TEST(XXH3Test, StreamingMatchesOneShot) {
+    unsigned int seed = 7;
+    for (size_t size : SIZES) {
+        std::vector<uint8_t> data = randomData(size, seed++);
+        uint64_t expected = XXH3::hash(data.data(), data.size());
+        for (size_t chunk : {size_t(1), size_t(63), size_t(64), size_t(255), size_t(256), size_t(4097)}) {
+            XXH3 stream;
+            for (size_t pos = 0; pos < size; pos += chunk) {
+                stream.update(data.data() + pos, std::min(chunk, size - pos));
+            }
+            EXPECT_EQ(stream.digest(), expected) << "size " << size << ", chunk " << chunk;
+        }
+        // digest() не меняет состояние: поток можно продолжить
+        XXH3 stream;
+        stream.update(data.data(), size / 2);
+        stream.digest();
+        stream.update(data.data() + size / 2, size - size / 2);
+        EXPECT_EQ(stream.digest(), expected) << "size " << size;
+    }
+}
+
+TEST(DigestSetTest, MatchesSeparateAlgorithms) {
+    DigestSet set;
+    unsigned int seed = 11;
+    for (size_t size : SIZES) {
+        std::vector<uint8_t> data = randomData(size, seed++);
+        set.reset(DIGEST_ALL);
+        for (size_t pos = 0; pos < size; pos += 7000) {
+            set.update(data.data() + pos, std::min<size_t>(7000, size - pos));
+        }
+        FileDigests digests;
+        set.finalize(digests);
+
+        EXPECT_EQ(digests.mask, DIGEST_ALL);
+        EXPECT_EQ(digests.md5, MD5::hash(data.data(), data.size())) << "size " << size;
+        EXPECT_EQ(digests.sha1, SHA1::hash(data.data(), data.size())) << "size " << size;
+        EXPECT_EQ(digests.sha256, SHA256::hash(data.data(), data.size())) << "size " << size;
+        EXPECT_EQ(digests.xxh3, XXH3::hash(data.data(), data.size())) << "size " << size;
+    }
+}
+
+TEST(DigestSetTest, OnlyMaskedAlgorithms) {
+    const std::string data = "hello";
+    DigestSet set;
+    set.reset(DIGEST_SHA256);
+    set.update(data.data(), data.size());
+
+    // Уже посчитанный MD5 остается, к маске добавляется SHA-256
+    FileDigests digests;
+    digests.mask = DIGEST_MD5;
+    digests.md5 = MD5::hash(data.data(), data.size());
+    set.finalize(digests);
+    EXPECT_EQ(digests.mask, DIGEST_MD5 | DIGEST_SHA256);
+    EXPECT_TRUE(digests.has(HashAlgorithm::SHA256));
+    EXPECT_FALSE(digests.has(HashAlgorithm::SHA1));
+    EXPECT_EQ(digests.sha256, SHA256::hash(data.data(), data.size()));
+    EXPECT_EQ(digests.sha1, SHA1Digest{});
+    EXPECT_EQ(digests.bytes(HashAlgorithm::SHA256), digests.sha256.data());
+    EXPECT_EQ(digests.bytes(HashAlgorithm::XXH3), nullptr);
+
+    // Пустая маска ничего не считает
+    set.reset(0);
+    set.update(data.data(), data.size());
+    FileDigests empty;
+    set.finalize(empty);
+    EXPECT_EQ(empty.mask, 0u);
+}
+
+TEST(DigestMaskTest, ParseAndFormat) {
+    DigestMask mask = 0;
+    ASSERT_TRUE(parseDigestMask("sha256,xxh3", mask));
+    EXPECT_EQ(mask, DIGEST_SHA256 | DIGEST_XXH3);
+    EXPECT_EQ(formatDigestMask(mask), "sha256,xxh3");
+
+    ASSERT_TRUE(parseDigestMask("md5,sha1,sha256,xxh3", mask));
+    EXPECT_EQ(mask, DIGEST_ALL);
+    EXPECT_EQ(formatDigestMask(DIGEST_ALL), "md5,sha1,sha256,xxh3");
+
+    EXPECT_FALSE(parseDigestMask("sha512", mask));
+    EXPECT_FALSE(parseDigestMask("md5,,sha1", mask));
+    EXPECT_FALSE(parseDigestMask("", mask));
+    EXPECT_EQ(formatDigestMask(0), "");
+
+    EXPECT_EQ(digestSize(HashAlgorithm::SHA1), 20u);
+    EXPECT_EQ(digestBit(HashAlgorithm::SHA1), DIGEST_SHA1);
+    EXPECT_STREQ(digestName(HashAlgorithm::XXH3), "xxh3");
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "directory_walker.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+
+namespace fs = std::filesystem;
+
+class DirectoryWalkerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+
+        // root/f0, root/a/f1, root/a/b/f2, root/a/b/c/f3 и широкий каталог root/wide
+        std::ofstream(testDir + "/f0.txt") << "0";
+        fs::create_directories(testDir + "/a/b/c");
+        std::ofstream(testDir + "/a/f1.txt") << "1";
+        std::ofstream(testDir + "/a/b/f2.txt") << "2";
+        std::ofstream(testDir + "/a/b/c/f3.txt") << "3";
+        fs::create_directories(testDir + "/wide");
+        for (int i = 0; i < 100; ++i) {
+            std::ofstream(testDir + "/wide/w" + std::to_string(i)) << i;
+        }
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    std::set<std::string> walk(const WalkOptions& options, size_t threads = 4, uint64_t* errors = nullptr) {
+        WorkStealingPool pool(threads, threads * 2);
+        std::mutex mutex;
+        std::set<std::string> found;
+
+        ParallelDirectoryWalker walker(pool, options, 8, [&](PathBatch& paths) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& path : paths) {
+                found.insert(fs::path(path).filename().string());
+            }
+        });
+        walker.run(testDir);
+        pool.Terminate(true);
+
+        EXPECT_EQ(walker.stats().files, found.size());
+        if (errors) *errors = walker.stats().errors;
+        return found;
+    }
+
+    std::string testDir;
+};
+
+TEST_F(DirectoryWalkerTest, FindsAllFiles) {
+    auto found = walk(WalkOptions());
+    EXPECT_EQ(found.size(), 104u);
+    EXPECT_TRUE(found.count("f0.txt"));
+    EXPECT_TRUE(found.count("f3.txt"));
+    EXPECT_TRUE(found.count("w99"));
+}
+
+TEST_F(DirectoryWalkerTest, SingleThreadWithSmallQueue) {
+    auto found = walk(WalkOptions(), 1);
+    EXPECT_EQ(found.size(), 104u);
+}
+
+TEST_F(DirectoryWalkerTest, MaxDepth) {
+    WalkOptions options;
+    options.maxDepth = 0;
+    EXPECT_EQ(walk(options), std::set<std::string>({"f0.txt"}));
+
+    options.maxDepth = 2;
+    auto found = walk(options);
+    EXPECT_TRUE(found.count("f2.txt"));
+    EXPECT_FALSE(found.count("f3.txt"));
+}
+
+TEST_F(DirectoryWalkerTest, NonExistentRoot) {
+    WorkStealingPool pool(2);
+    ParallelDirectoryWalker walker(pool, WalkOptions(), 8, [](PathBatch&) {});
+    walker.run(testDir + "/missing");
+    pool.Terminate(true);
+
+    EXPECT_EQ(walker.stats().files, 0u);
+    EXPECT_EQ(walker.stats().errors, 1u);
+}
+
+// Цикл из символических ссылок не приводит к бесконечному обходу
+TEST_F(DirectoryWalkerTest, SymlinkLoop) {
+    std::error_code ec;
+    fs::create_directory_symlink(testDir, testDir + "/a/b/c/loop", ec);
+    if (ec) {
+        GTEST_SKIP() << "symlinks are not available: " << ec.message();
+    }
+    fs::create_symlink(testDir + "/f0.txt", testDir + "/a/link_to_f0", ec);
+
+    // Без followSymlinks ссылка на каталог пропускается, ссылка на файл сканируется
+    auto found = walk(WalkOptions());
+    EXPECT_EQ(found.size(), 105u);
+    EXPECT_TRUE(found.count("link_to_f0"));
+
+    WalkOptions options;
+    options.followSymlinks = true;
+    found = walk(options);
+    EXPECT_EQ(found.size(), 105u);
+}
+
+// Несколько обходов в одном пуле идут одновременно и считаются порознь
+TEST_F(DirectoryWalkerTest, SharedPoolWalkersAndFileLists) {
+    WorkStealingPool pool(4, 8);
+    std::mutex mutex;
+    std::set<std::string> found;
+    auto collect = [&](PathBatch& paths) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& path : paths) {
+            found.insert(fs::path(path).filename().string());
+        }
+    };
+
+    ParallelDirectoryWalker wide(pool, WalkOptions(), 8, collect);
+    ParallelDirectoryWalker deep(pool, WalkOptions(), 8, collect);
+    ParallelDirectoryWalker files(pool, WalkOptions(), 2, collect);
+    wide.start(testDir + "/wide");
+    deep.start(testDir + "/a");
+    files.startFiles({testDir + "/f0.txt", testDir + "/a/f1.txt", testDir + "/wide/w0"});
+    pool.WaitIdle();
+
+    EXPECT_EQ(wide.stats().files, 100u);
+    EXPECT_EQ(deep.stats().files, 3u);
+    EXPECT_EQ(files.stats().files, 3u);
+    EXPECT_EQ(files.stats().directories, 0u);
+    EXPECT_EQ(found.size(), 104u);
+    // Каждый обход отмечает время своей последней задачи
+    EXPECT_NE(wide.stats().finishedNs, 0u);
+    EXPECT_NE(deep.stats().finishedNs, 0u);
+    EXPECT_NE(files.stats().finishedNs, 0u);
+    pool.Terminate(true);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "file_watcher.h"
+#include "scan_metrics.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+class FileWatcherTest : public ::testing::TestWithParam<WatchBackend> {
+protected:
+    void SetUp() override {
+        testDir = FileWatcher::canonicalRoot(test_utils::createTempDir());
+        if (!watcher.open({testDir}, GetParam())) {
+            GTEST_SKIP() << "watch backend unavailable, errno " << watcher.lastError();
+        }
+        ASSERT_EQ(watcher.backend(), GetParam());
+    }
+
+    void TearDown() override {
+        watcher.close();
+        test_utils::cleanup(testDir);
+    }
+
+    static void writeFile(const std::string& path, const std::string& content) {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    }
+
+    // Собирает события, пока не появится нужное или не выйдет время
+    bool waitFor(FileEvent::Type type, const std::string& path) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            for (const FileEvent& event : events) {
+                if (event.type == type && event.path == path) {
+                    return true;
+                }
+            }
+            if (!watcher.read(events, 50 * 1000 * 1000)) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    std::string testDir;
+    FileWatcher watcher;
+    std::vector<FileEvent> events;
+};
+
+TEST_P(FileWatcherTest, CloseAfterWrite) {
+    std::string path = testDir + "/upload.bin";
+    uint64_t before = monotonicNs();
+    writeFile(path, "payload");
+    ASSERT_TRUE(waitFor(FileEvent::Type::Changed, path));
+    auto found = std::find_if(events.begin(), events.end(), [&](const FileEvent& e) { return e.path == path; });
+    EXPECT_GE(found->timeNs, before);
+}
+
+// Запись во временный файл и перенос на место: Removed для временного, Changed для итогового
+TEST_P(FileWatcherTest, RenameIntoPlace) {
+    std::string temp = testDir + "/.upload.part";
+    std::string path = testDir + "/upload.bin";
+    writeFile(temp, "payload");
+    fs::rename(temp, path);
+    ASSERT_TRUE(waitFor(FileEvent::Type::Changed, path));
+    EXPECT_TRUE(waitFor(FileEvent::Type::Removed, temp));
+}
+
+// Каталог, перенесенный в дерево готовым, сообщает свои файлы
+TEST_P(FileWatcherTest, DirectoryMovedIn) {
+    std::string outside = test_utils::createTempDir();
+    fs::create_directories(outside + "/batch/nested");
+    writeFile(outside + "/batch/a.bin", "a");
+    writeFile(outside + "/batch/nested/b.bin", "b");
+    fs::rename(outside + "/batch", testDir + "/batch");
+    EXPECT_TRUE(waitFor(FileEvent::Type::Changed, testDir + "/batch/a.bin"));
+    EXPECT_TRUE(waitFor(FileEvent::Type::Changed, testDir + "/batch/nested/b.bin"));
+
+    // Новые каталоги тоже под наблюдением
+    writeFile(testDir + "/batch/nested/c.bin", "c");
+    EXPECT_TRUE(waitFor(FileEvent::Type::Changed, testDir + "/batch/nested/c.bin"));
+    test_utils::cleanup(outside);
+}
+
+TEST_P(FileWatcherTest, NewSubdirectory) {
+    fs::create_directories(testDir + "/a/b");
+    writeFile(testDir + "/a/b/file.bin", "x");
+    EXPECT_TRUE(waitFor(FileEvent::Type::Changed, testDir + "/a/b/file.bin"));
+}
+
+TEST_P(FileWatcherTest, Delete) {
+    std::string path = testDir + "/gone.bin";
+    writeFile(path, "x");
+    fs::remove(path);
+    EXPECT_TRUE(waitFor(FileEvent::Type::Removed, path));
+}
+
+// События вне корня не приходят, хотя fanotify метит всю файловую систему
+TEST_P(FileWatcherTest, IgnoresOutsideRoot) {
+    std::string outside = test_utils::createTempDir();
+    writeFile(outside + "/other.bin", "x");
+    std::string path = testDir + "/inside.bin";
+    writeFile(path, "x");
+    ASSERT_TRUE(waitFor(FileEvent::Type::Changed, path));
+    for (const FileEvent& event : events) {
+        EXPECT_EQ(event.path.compare(0, testDir.size(), testDir), 0) << event.path;
+    }
+    test_utils::cleanup(outside);
+}
+
+// wake прерывает ожидание без событий
+TEST_P(FileWatcherTest, Wake) {
+    std::thread waker([this]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        watcher.wake();
+    });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(watcher.read(events, -1));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    waker.join();
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, FileWatcherTest,
+                         ::testing::Values(WatchBackend::Fanotify, WatchBackend::Inotify),
+                         [](const ::testing::TestParamInfo<WatchBackend>& info) {
+                             return info.param == WatchBackend::Fanotify ? "Fanotify" : "Inotify";
+                         });
+
+TEST(FileWatcherOpenTest, MissingRoot) {
+    FileWatcher watcher;
+    EXPECT_FALSE(watcher.open({"/nonexistent/watch/root"}));
+    EXPECT_FALSE(watcher.isOpen());
+    EXPECT_NE(watcher.lastError(), 0);
+}
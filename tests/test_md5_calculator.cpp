@@ -2,6 +2,9 @@
 #include "md5_calculator.h"
 #include "test_utils.h"
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 
 class MD5CalculatorTest : public ::testing::Test {
 protected:
@@ -67,4 +70,194 @@ TEST_F(MD5CalculatorTest, HexCharacters) {
     for (char c : hash) {
         EXPECT_TRUE(std::isxdigit(c)) << "Character '" << c << "' is not hex";
     }
+}
+
+// Тестовые векторы RFC 1321 для потоковой реализации
+TEST(MD5Test, Rfc1321Vectors) {
+    const std::pair<std::string, std::string> vectors[] = {
+        {"", "d41d8cd98f00b204e9800998ecf8427e"},
+        {"a", "0cc175b9c0f1b6a831c399e269772661"},
+        {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+        {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+        {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+        {"12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+         "57edf4a22be3c955ac49da2e2107b67a"},
+    };
+
+    for (const auto& v : vectors) {
+        MD5Digest digest = MD5::hash(v.first.data(), v.first.size());
+        EXPECT_EQ(MD5Calculator::bytesToHexString(digest.data(), digest.size()), v.second) << v.first;
+    }
+}
+
+// Порционная подача данных дает тот же результат, что и однократная
+TEST(MD5Test, StreamingMatchesOneShot) {
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += static_cast<char>(i * 31 + 7);
+    }
+
+    MD5Digest expected = MD5::hash(data.data(), data.size());
+    for (size_t chunk : {1u, 3u, 63u, 64u, 65u, 500u}) {
+        MD5 md5;
+        for (size_t pos = 0; pos < data.size(); pos += chunk) {
+            md5.update(data.data() + pos, std::min(chunk, data.size() - pos));
+        }
+        EXPECT_EQ(md5.finalize(), expected) << "chunk " << chunk;
+    }
+}
+
+// Файл больше буфера чтения
+TEST_F(MD5CalculatorTest, LargeFile) {
+    std::string content(3 * MD5Calculator::BUFFER_SIZE + 17, 'z');
+    std::string largeFile = test_utils::createTempFile(content, ".bin");
+
+    MD5Digest expected = MD5::hash(content.data(), content.size());
+    EXPECT_EQ(MD5Calculator::calculateFileDigest(largeFile), expected);
+
+    test_utils::cleanup(largeFile);
+}
+
+// Каждая стратегия чтения дает тот же дайджест; крупные пороги занижены,
+// чтобы отображение и O_DIRECT проверялись на небольших файлах
+TEST_F(MD5CalculatorTest, ReadStrategiesMatch) {
+    ReadOptions options;
+    options.bufferSize = 4096;
+    options.largeFileSize = 64 * 1024;
+    options.directBufferSize = 64 * 1024;
+
+    for (size_t size : {size_t(0), size_t(1), size_t(4096), size_t(4097), size_t(100000), size_t(300000)}) {
+        std::string content(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            content[i] = static_cast<char>(i * 131 + size);
+        }
+        std::string file = test_utils::createTempFile("", ".bin");
+        std::ofstream(file, std::ios::binary).write(content.data(), content.size());
+        MD5Digest expected = MD5::hash(content.data(), content.size());
+
+        for (ReadStrategy strategy : {ReadStrategy::Auto, ReadStrategy::Stream, ReadStrategy::SingleRead,
+                                      ReadStrategy::Mapped, ReadStrategy::Direct}) {
+            options.strategy = strategy;
+            options.directIo = strategy == ReadStrategy::Auto && size > 200000;
+            EXPECT_EQ(MD5Calculator::calculateFileDigest(file, options), expected)
+                << "size " << size << " strategy " << static_cast<int>(strategy);
+        }
+        test_utils::cleanup(file);
+    }
+}
+
+// Маленький файл: open, fstat, один read и close - без чтения, подтверждающего конец файла
+TEST_F(MD5CalculatorTest, SmallFileSingleRead) {
+    FileReader reader;
+    ASSERT_TRUE(reader.open(helloFile));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::SingleRead);
+    EXPECT_EQ(reader.size(), 5u);
+
+    const uint8_t* data = nullptr;
+    ASSERT_EQ(reader.next(data), 5);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(data), 5), "hello");
+    EXPECT_EQ(reader.next(data), 0);
+    reader.close();
+    EXPECT_EQ(reader.syscalls(), 4u);
+
+    ReadOptions options;
+    EXPECT_EQ(options.choose(0), ReadStrategy::SingleRead);
+    EXPECT_EQ(options.choose(options.bufferSize + 1), ReadStrategy::Stream);
+    // Крупный файл по умолчанию читается потоково, отображается только по явному выбору
+    EXPECT_EQ(options.choose(options.largeFileSize), ReadStrategy::Stream);
+    options.mapLargeFiles = true;
+    EXPECT_EQ(options.choose(options.largeFileSize), ReadStrategy::Mapped);
+    options.directIo = true;
+    EXPECT_EQ(options.choose(options.largeFileSize), ReadStrategy::Direct);
+}
+
+// Файл, который может меняться, не отображается и при mapLargeFiles
+TEST_F(MD5CalculatorTest, ChangingFilesAreNotMapped) {
+    ReadOptions options;
+    options.largeFileSize = 128 * 1024;
+    options.mapLargeFiles = true;
+    std::string content(300000, 'x');
+    std::string file = test_utils::createTempFile("", ".bin");
+    std::ofstream(file, std::ios::binary).write(content.data(), content.size());
+
+    FileReader reader(options);
+    ASSERT_TRUE(reader.open(file));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::Mapped);
+
+    // Изменен после начала обхода - не отображается, до - отображается
+    options.stableBeforeNs = 1;
+    reader.setOptions(options);
+    ASSERT_TRUE(reader.open(file));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::Stream);
+    options.stableBeforeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        (std::chrono::system_clock::now() + std::chrono::minutes(1)).time_since_epoch()).count();
+    reader.setOptions(options);
+    ASSERT_TRUE(reader.open(file));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::Mapped);
+    reader.close();
+
+    options.filesMayChange = true;
+    reader.setOptions(options);
+    ASSERT_TRUE(reader.open(file));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::Stream);
+    reader.close();
+    test_utils::cleanup(file);
+}
+
+// Крупный файл, укороченный во время хеширования, дает короткий результат,
+// а не SIGBUS: по умолчанию он читается крупными кусками, а не отображается
+TEST_F(MD5CalculatorTest, TruncatedWhileHashing) {
+    ReadOptions options;
+    std::string content(4 * options.largeFileSize, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 13 + i / 4093);
+    }
+    std::string file = test_utils::createTempFile("", ".bin");
+    std::ofstream(file, std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+
+    FileReader reader(options);
+    ASSERT_TRUE(reader.open(file));
+    EXPECT_EQ(reader.strategy(), ReadStrategy::Stream);
+    MD5 md5;
+    const uint8_t* data = nullptr;
+    int64_t got = reader.next(data);
+    ASSERT_EQ(got, static_cast<int64_t>(options.largeBufferSize));
+    md5.update(data, static_cast<size_t>(got));
+
+    const uint64_t truncated = options.largeFileSize + 12345;
+    std::filesystem::resize_file(file, truncated);
+    uint64_t total = static_cast<uint64_t>(got);
+    while ((got = reader.next(data)) > 0) {
+        md5.update(data, static_cast<size_t>(got));
+        total += static_cast<uint64_t>(got);
+    }
+    EXPECT_EQ(got, 0);
+    EXPECT_EQ(total, truncated);
+    EXPECT_EQ(reader.size(), truncated);
+    EXPECT_EQ(md5.finalize(), MD5::hash(content.data(), static_cast<size_t>(truncated)));
+    reader.close();
+    test_utils::cleanup(file);
+}
+
+// Дайджест префикса - MD5 первых N байт; у файла короче префикса - MD5 всего файла
+TEST_F(MD5CalculatorTest, PrefixDigest) {
+    std::string content(300000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 7 + i / 251);
+    }
+    std::string file = test_utils::createTempFile("", ".bin");
+    std::ofstream(file, std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+
+    for (uint64_t length : {1ull, 4096ull, 65536ull, 100000ull}) {
+        EXPECT_EQ(MD5Calculator::calculatePrefixDigest(file, length),
+                  MD5::hash(content.data(), static_cast<size_t>(length)))
+            << "prefix " << length;
+    }
+    EXPECT_EQ(MD5Calculator::calculatePrefixDigest(file, 1 << 20), MD5::hash(content.data(), content.size()));
+    // Огромный префикс читается тем же буфером, а не буфером в его длину
+    EXPECT_EQ(MD5Calculator::calculatePrefixDigest(file, 4000000000ull), MD5::hash(content.data(), content.size()));
+    EXPECT_EQ(MD5Calculator::calculatePrefixDigest(helloFile, 65536), MD5Calculator::calculateFileDigest(helloFile));
+    EXPECT_THROW(MD5Calculator::calculatePrefixDigest("nonexistent_file.txt", 65536), std::runtime_error);
+
+    test_utils::cleanup(file);
 }
\ No newline at end of file
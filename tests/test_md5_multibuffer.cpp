@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+#include "md5_multibuffer.h"
+#include "md5_calculator.h"
+#include "test_utils.h"
+#include <cerrno>
+#include <iterator>
+#include <random>
+
+namespace {
+
+const MD5MultiBuffer::Isa ALL_ISAS[] = {
+    MD5MultiBuffer::Isa::Scalar,
+    MD5MultiBuffer::Isa::SSE2,
+    MD5MultiBuffer::Isa::AVX2,
+    MD5MultiBuffer::Isa::AVX512,
+};
+
+std::string randomData(size_t size, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(rng());
+    }
+    return data;
+}
+
+}
+
+class MD5MultiBufferTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+
+        // Размеры вокруг границ блока и паддинга, плюс файлы больше буфера дорожки
+        const size_t sizes[] = {0, 1, 5, 55, 56, 63, 64, 65, 119, 120, 128, 1000, 4096,
+                                MultiBufferFileHasher::LANE_BUFFER_SIZE - 1,
+                                MultiBufferFileHasher::LANE_BUFFER_SIZE + 70,
+                                100000, 3, 777, 64 * 1024, 17};
+        unsigned int seed = 1;
+        for (size_t size : sizes) {
+            std::string path = testDir + "/file_" + std::to_string(seed) + ".bin";
+            std::string content = randomData(size, seed++);
+            std::ofstream(path, std::ios::binary).write(content.data(), content.size());
+            paths.push_back(path);
+            expected.push_back(MD5::hash(content.data(), content.size()));
+            FileDigests all;
+            all.mask = DIGEST_ALL;
+            all.md5 = expected.back();
+            all.sha1 = SHA1::hash(content.data(), content.size());
+            all.sha256 = SHA256::hash(content.data(), content.size());
+            all.xxh3 = XXH3::hash(content.data(), content.size());
+            expectedAll.push_back(all);
+        }
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    std::string testDir;
+    std::vector<std::string> paths;
+    std::vector<MD5Digest> expected;
+    std::vector<FileDigests> expectedAll;   // все алгоритмы, посчитанные по отдельности
+};
+
+// Дайджесты файла совпадают с посчитанными по отдельности
+void expectDigests(const FileDigests& actual, const FileDigests& expected, const std::string& path) {
+    EXPECT_EQ(actual.mask, expected.mask) << path;
+    EXPECT_EQ(actual.md5, expected.md5) << path;
+    EXPECT_EQ(actual.sha1, expected.sha1) << path;
+    EXPECT_EQ(actual.sha256, expected.sha256) << path;
+    EXPECT_EQ(actual.xxh3, expected.xxh3) << path;
+}
+
+// Каждое доступное ядро совпадает со скалярным MD5 на всех дорожках
+TEST(MD5MultiBufferKernelTest, MatchesScalarTransform) {
+    for (auto isa : ALL_ISAS) {
+        MD5MultiBufferKernel kernel = MD5MultiBuffer::get(isa);
+        if (!kernel.isVector()) continue;
+
+        const size_t blocks = 3;
+        std::vector<std::string> data;
+        std::vector<const uint8_t*> pointers;
+        std::vector<uint32_t> state(4 * kernel.lanes);
+        for (size_t l = 0; l < kernel.lanes; ++l) {
+            data.push_back(randomData(blocks * MD5::BLOCK_SIZE, static_cast<unsigned int>(100 + l)));
+            for (size_t w = 0; w < 4; ++w) {
+                state[w * kernel.lanes + l] = static_cast<uint32_t>(l * 4 + w + 1);
+            }
+        }
+        for (const auto& d : data) {
+            pointers.push_back(reinterpret_cast<const uint8_t*>(d.data()));
+        }
+
+        std::vector<uint32_t> initial = state;
+        kernel.process(state.data(), pointers.data(), blocks);
+
+        for (size_t l = 0; l < kernel.lanes; ++l) {
+            uint32_t scalar[4];
+            for (size_t w = 0; w < 4; ++w) scalar[w] = initial[w * kernel.lanes + l];
+            MD5::transform(scalar, pointers[l], blocks);
+            for (size_t w = 0; w < 4; ++w) {
+                EXPECT_EQ(state[w * kernel.lanes + l], scalar[w]) << kernel.name << " lane " << l;
+            }
+        }
+    }
+}
+
+TEST(MD5MultiBufferKernelTest, BestIsSupported) {
+    const MD5MultiBufferKernel& best = MD5MultiBuffer::best();
+    EXPECT_GE(best.lanes, 1u);
+    EXPECT_EQ(best.isVector(), best.lanes > 1);
+}
+
+// Хешер дает те же дайджесты для файлов разных размеров на каждом ядре
+TEST_F(MD5MultiBufferTest, HashFilesMatchesScalar) {
+    for (auto isa : ALL_ISAS) {
+        if (!MD5MultiBuffer::supported(isa)) continue;
+        MultiBufferFileHasher hasher(MD5MultiBuffer::get(isa));
+
+        std::vector<int> seen(paths.size(), 0);
+        hasher.hashFiles(paths, [&](size_t index, const MD5Digest* digest) {
+            ASSERT_LT(index, paths.size());
+            ASSERT_NE(digest, nullptr);
+            EXPECT_EQ(*digest, expected[index]) << hasher.kernel().name << " " << paths[index];
+            seen[index]++;
+        });
+
+        for (int count : seen) {
+            EXPECT_EQ(count, 1);
+        }
+    }
+}
+
+// Отображение и потоковое чтение с мелким буфером: блоки собираются на стыках кусков
+TEST_F(MD5MultiBufferTest, ReadStrategiesMatchScalar) {
+    for (ReadStrategy strategy : {ReadStrategy::Stream, ReadStrategy::Mapped, ReadStrategy::Direct}) {
+        ReadOptions options;
+        options.strategy = strategy;
+        options.bufferSize = 1000;
+        options.directBufferSize = 8192;
+        MultiBufferFileHasher hasher(MD5MultiBuffer::best(), options);
+
+        size_t calls = 0;
+        hasher.hashFiles(paths, [&](size_t index, const MD5Digest* digest) {
+            ASSERT_NE(digest, nullptr);
+            EXPECT_EQ(*digest, expected[index]) << static_cast<int>(strategy) << " " << paths[index];
+            calls++;
+        });
+        EXPECT_EQ(calls, paths.size());
+    }
+}
+
+// Меньше файлов, чем дорожек
+TEST_F(MD5MultiBufferTest, FewerFilesThanLanes) {
+    MultiBufferFileHasher hasher;
+    std::vector<std::string> two(paths.begin() + 3, paths.begin() + 5);
+
+    size_t calls = 0;
+    hasher.hashFiles(two, [&](size_t index, const MD5Digest* digest) {
+        ASSERT_NE(digest, nullptr);
+        EXPECT_EQ(*digest, expected[3 + index]);
+        calls++;
+    });
+    EXPECT_EQ(calls, 2u);
+}
+
+// Недоступный файл не мешает остальным дорожкам
+TEST_F(MD5MultiBufferTest, MissingFileReportsError) {
+    MultiBufferFileHasher hasher;
+    std::vector<std::string> mixed = {paths[0], testDir + "/missing.bin", paths[12]};
+
+    std::vector<bool> failed(mixed.size(), false);
+    int missingError = 0;
+    hasher.hashFiles(mixed, [&](size_t index, const MD5Digest* digest) {
+        failed[index] = digest == nullptr;
+        if (!digest) {
+            missingError = hasher.lastError();
+        }
+        if (index == 0) {
+            EXPECT_EQ(*digest, expected[0]);
+        }
+        if (index == 2) {
+            EXPECT_EQ(*digest, expected[12]);
+        }
+    });
+
+    EXPECT_FALSE(failed[0]);
+    EXPECT_TRUE(failed[1]);
+    EXPECT_FALSE(failed[2]);
+    EXPECT_EQ(missingError, ENOENT);
+}
+
+// Дополнительные дайджесты считаются из тех же кусков, что и MD5, на каждом ядре
+TEST_F(MD5MultiBufferTest, ExtraDigestsFromSameRead) {
+    for (auto isa : ALL_ISAS) {
+        if (!MD5MultiBuffer::supported(isa)) continue;
+        ReadOptions options;
+        options.bufferSize = 1000;
+        MultiBufferFileHasher hasher(MD5MultiBuffer::get(isa), options);
+        hasher.setDigests(DIGEST_ALL);
+        EXPECT_EQ(hasher.digests(), DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3);
+
+        size_t calls = 0;
+        hasher.hashFiles(paths, [&](size_t index, const MD5Digest* digest) {
+            ASSERT_NE(digest, nullptr);
+            expectDigests(hasher.lastDigests(), expectedAll[index], hasher.kernel().name + (" " + paths[index]));
+            calls++;
+        });
+        EXPECT_EQ(calls, paths.size());
+    }
+}
+
+TEST_F(MD5MultiBufferTest, ExtraDigestsFromBuffers) {
+    std::vector<std::string> contents;
+    for (const std::string& path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        contents.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::vector<const uint8_t*> data;
+    std::vector<size_t> sizes;
+    for (const std::string& content : contents) {
+        data.push_back(reinterpret_cast<const uint8_t*>(content.data()));
+        sizes.push_back(content.size());
+    }
+
+    for (auto isa : ALL_ISAS) {
+        if (!MD5MultiBuffer::supported(isa)) continue;
+        MultiBufferFileHasher hasher(MD5MultiBuffer::get(isa));
+        hasher.setDigests(DIGEST_ALL);
+        hasher.hashBuffers(data.data(), sizes.data(), data.size(), [&](size_t index, const MD5Digest*) {
+            expectDigests(hasher.lastDigests(), expectedAll[index], hasher.kernel().name + (" " + paths[index]));
+        });
+
+        // Без дополнительных алгоритмов в lastDigests только MD5
+        hasher.setDigests(0);
+        hasher.hashBuffers(data.data(), sizes.data(), data.size(), [&](size_t index, const MD5Digest*) {
+            EXPECT_EQ(hasher.lastDigests().mask, DIGEST_MD5);
+            EXPECT_EQ(hasher.lastDigests().md5, expected[index]);
+        });
+    }
+}
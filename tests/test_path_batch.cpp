@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+#include "path_batch.h"
+#include "directory_walker.h"
+#include "scanner_core.h"
+#include "test_utils.h"
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// Счетчик выделений памяти: operator new заменен на весь процесс, включая
+// библиотеку сканера (на Linux символ из исполняемого файла перекрывает libstdc++)
+namespace {
+
+std::atomic<bool> countAllocations{false};
+std::atomic<uint64_t> allocations{0};
+
+}
+
+void* operator new(std::size_t size) {
+    if (countAllocations.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// Повторное заполнение пачки идет в те же строки
+TEST(PathBatchTest, ReusesStrings) {
+    PathBatch batch;
+    batch.append("/data/uploads", '/', "setup.exe");
+    batch.push_back(std::string_view("/data/readme.txt"));
+    ASSERT_EQ(batch.size(), 2u);
+    EXPECT_EQ(batch[0], "/data/uploads/setup.exe");
+    EXPECT_EQ(batch[1], "/data/readme.txt");
+    EXPECT_STREQ(batch.data()[0].c_str(), "/data/uploads/setup.exe");
+    const char* buffer = batch[0].data();
+
+    batch.clear();
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(batch.capacity(), 2u);
+    batch.append("/data/uploads", '/', "setup2.exe");
+    EXPECT_EQ(batch[0], "/data/uploads/setup2.exe");
+    // Путь длиннее на символ помещается в прежний буфер
+    EXPECT_EQ(batch[0].data(), buffer);
+
+    size_t count = 0;
+    for (const std::string& path : batch) {
+        EXPECT_FALSE(path.empty());
+        count++;
+    }
+    EXPECT_EQ(count, 1u);
+}
+
+TEST(PathBatchTest, MoveLeavesEmptyBatch) {
+    PathBatch batch;
+    batch.push_back(std::string("/data/a"));
+    batch.push_back(std::string("/data/b"));
+    PathBatch moved = std::move(batch);
+    EXPECT_EQ(moved.size(), 2u);
+    EXPECT_EQ(moved[1], "/data/b");
+    EXPECT_TRUE(batch.empty());
+    batch.push_back(std::string_view("/data/c"));
+    EXPECT_EQ(batch[0], "/data/c");
+
+    PathBatchPool pool;
+    pool.give(std::move(moved));
+    EXPECT_EQ(pool.size(), 1u);
+    PathBatch taken = pool.take();
+    EXPECT_TRUE(taken.empty());
+    EXPECT_EQ(taken.capacity(), 2u);
+    EXPECT_EQ(pool.size(), 0u);
+}
+
+// Пачки обхода возвращаются в общий запас и берутся из него следующим обходом
+TEST(PathBatchTest, WalkerReturnsBatchesToPool) {
+    std::string dir = test_utils::createTempDir();
+    for (int i = 0; i < 100; ++i) {
+        std::ofstream(dir + "/f" + std::to_string(i)) << i;
+    }
+    WorkStealingPool pool(2, 4);
+    PathBatchPool batches;
+    std::atomic<size_t> found{0};
+    for (int walk = 0; walk < 2; ++walk) {
+        found = 0;
+        ParallelDirectoryWalker walker(pool, WalkOptions(), 8, [&](PathBatch& paths) {
+            found += paths.size();
+        }, &batches);
+        walker.run(dir);
+        EXPECT_EQ(found, 100u);
+        EXPECT_GT(batches.size(), 0u);
+    }
+    pool.Terminate(true);
+    test_utils::cleanup(dir);
+}
+
+class ScanAllocationsTest : public ::testing::Test {
+protected:
+    static constexpr int DIRECTORIES = 16;
+    static constexpr int FILES_PER_DIRECTORY = 250;
+    // Разброс между сканированиями: очереди пула и буферы потоков растут по-разному
+    // в зависимости от того, как легли задачи. Выделение на файл добавило бы 12000
+    static constexpr uint64_t ALLOWED_GROWTH = 128;
+
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+        for (int d = 0; d < DIRECTORIES; ++d) {
+            fs::create_directories(directory(d));
+        }
+        addFiles(FILES_PER_DIRECTORY);
+        logFile = test_utils::createTempFile("", ".log");
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+        test_utils::cleanup(logFile);
+        test_utils::cleanup(baseFile);
+    }
+
+    // Длинные имена: путь не помещается в короткую строку std::string
+    std::string directory(int d) const {
+        return testDir + "/directory_with_a_long_name_" + std::to_string(d);
+    }
+
+    // Дополняет каждый каталог до filesPerDirectory файлов
+    void addFiles(int filesPerDirectory) {
+        for (int d = 0; d < DIRECTORIES; ++d) {
+            for (int f = filesPerDirectory_; f < filesPerDirectory; ++f) {
+                std::ofstream(directory(d) + "/file_with_a_long_name_" + std::to_string(f) + ".bin")
+                    << "content" << f % 10;
+            }
+        }
+        filesPerDirectory_ = filesPerDirectory;
+    }
+
+    // Выделений на третье сканирование того же дерева: пул, буферы потоков
+    // и пачки путей остаются от первых двух
+    uint64_t steadyStateAllocations(const std::string& base, const ScanOptions& options) {
+        baseFile = test_utils::createTempFile(base, ".csv");
+        IScannerCore* scanner = createScanner();
+        scanner->setScanOptions(options);
+        EXPECT_TRUE(scanner->loadMalwareBase(baseFile));
+        for (int i = 0; i < 2; ++i) {
+            ScanResult warmup = scanner->scanDirectory(testDir, logFile);
+            EXPECT_EQ(warmup.totalFiles, DIRECTORIES * filesPerDirectory_);
+        }
+
+        allocations = 0;
+        countAllocations = true;
+        ScanResult result = scanner->scanDirectory(testDir, logFile);
+        countAllocations = false;
+        EXPECT_EQ(result.totalFiles, DIRECTORIES * filesPerDirectory_);
+        EXPECT_EQ(result.errors, 0);
+        destroyScanner(scanner);
+        test_utils::cleanup(baseFile);
+        return allocations;
+    }
+
+    // Выделений на файл нет: дерево вчетверо больше с теми же каталогами
+    // сканируется с тем же числом выделений (на сканирование и на каталог)
+    void expectNoAllocationPerFile(const std::string& base, const ScanOptions& options) {
+        uint64_t small = steadyStateAllocations(base, options);
+        addFiles(4 * FILES_PER_DIRECTORY);
+        uint64_t large = steadyStateAllocations(base, options);
+        EXPECT_LE(large, small + ALLOWED_GROWTH) << "scan of " << DIRECTORIES * FILES_PER_DIRECTORY
+                                                  << " files: " << small << ", of four times as many: " << large;
+    }
+
+    std::string testDir;
+    std::string logFile;
+    std::string baseFile;
+    int filesPerDirectory_ = 0;
+};
+
+// Путь файла не выделяет памяти ни при обходе, ни при хешировании
+TEST_F(ScanAllocationsTest, NoAllocationPerFile) {
+#ifdef _WIN32
+    GTEST_SKIP() << "operator new is not replaced inside the DLL";
+#endif
+    ScanOptions options;
+    options.ioEngine = IoEngine::Blocking;
+    expectNoAllocationPerFile("9f86d081884c7d659a2feaa0c55ad015;TestMalware\n", options);
+}
+
+// То же с фильтром по размеру: пути, которые придется прочитать, копируются в пачку потока
+TEST_F(ScanAllocationsTest, NoAllocationPerFileWithSizeFilter) {
+#ifdef _WIN32
+    GTEST_SKIP() << "operator new is not replaced inside the DLL";
+#endif
+    ScanOptions options;
+    options.ioEngine = IoEngine::Blocking;
+    expectNoAllocationPerFile("9f86d081884c7d659a2feaa0c55ad015;TestMalware;8\n", options);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "rescan_queue.h"
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t MS = 1000 * 1000;
+
+std::vector<std::string> popAll(RescanQueue& queue, uint64_t nowNs) {
+    std::vector<std::string> paths;
+    queue.popDue(nowNs, 1000, paths);
+    return paths;
+}
+
+}
+
+// Файл выдается, когда события по нему затихли на debounce
+TEST(RescanQueueTest, DebounceAfterLastEvent) {
+    RescanQueue queue(10 * MS, 1000 * MS);
+    queue.touch("/a", 100 * MS);
+    EXPECT_EQ(queue.nextDueNs(), 110 * MS);
+    queue.touch("/a", 105 * MS);
+    EXPECT_EQ(queue.nextDueNs(), 115 * MS);
+    EXPECT_EQ(queue.pending(), 1u);
+
+    EXPECT_TRUE(popAll(queue, 110 * MS).empty());
+    std::vector<std::string> due = popAll(queue, 115 * MS);
+    ASSERT_EQ(due.size(), 1u);
+    EXPECT_EQ(due[0], "/a");
+    EXPECT_EQ(queue.pending(), 0u);
+    EXPECT_EQ(queue.inFlight(), 1u);
+    EXPECT_EQ(queue.stats().coalesced, 1u);
+
+    uint64_t firstNs = 0;
+    EXPECT_FALSE(queue.finish("/a", firstNs));
+    EXPECT_EQ(firstNs, 100 * MS);
+    EXPECT_EQ(queue.inFlight(), 0u);
+    EXPECT_EQ(queue.nextDueNs(), std::numeric_limits<uint64_t>::max());
+}
+
+// Файл, события по которому не прекращаются, выдается не позже maxDelay
+TEST(RescanQueueTest, MaxDelayCapsDebounce) {
+    RescanQueue queue(10 * MS, 50 * MS);
+    for (uint64_t t = 0; t <= 100; t += 5) {
+        queue.touch("/busy", t * MS);
+        if (!popAll(queue, t * MS).empty()) {
+            EXPECT_GE(t, 50u);
+            return;
+        }
+    }
+    FAIL() << "file was never due";
+}
+
+// Файлы выдаются по сроку, не по порядку событий
+TEST(RescanQueueTest, OrderedByDueTime) {
+    RescanQueue queue(10 * MS, 1000 * MS);
+    queue.touch("/late", 0);
+    queue.touch("/early", 1 * MS);
+    queue.touch("/late", 5 * MS);
+    std::vector<std::string> due = popAll(queue, 20 * MS);
+    ASSERT_EQ(due.size(), 2u);
+    EXPECT_EQ(due[0], "/early");
+    EXPECT_EQ(due[1], "/late");
+
+    queue.touch("/x", 30 * MS);
+    queue.touch("/y", 30 * MS);
+    std::vector<std::string> one;
+    EXPECT_EQ(queue.popDue(40 * MS, 1, one), 1u);
+    EXPECT_EQ(queue.pending(), 1u);
+}
+
+TEST(RescanQueueTest, CancelDropsPending) {
+    RescanQueue queue(10 * MS, 1000 * MS);
+    queue.touch("/tmp.part", 0);
+    queue.touch("/keep", 0);
+    queue.cancel("/tmp.part");
+    queue.cancel("/unknown");
+    EXPECT_EQ(queue.pending(), 1u);
+    EXPECT_EQ(queue.stats().cancelled, 1u);
+
+    // Путь, снова появившийся после отмены, ставится заново
+    queue.touch("/tmp.part", 20 * MS);
+    std::vector<std::string> due = popAll(queue, 15 * MS);
+    ASSERT_EQ(due.size(), 1u);
+    EXPECT_EQ(due[0], "/keep");
+    due = popAll(queue, 30 * MS);
+    ASSERT_EQ(due.size(), 1u);
+    EXPECT_EQ(due[0], "/tmp.part");
+}
+
+// События во время проверки возвращают файл в очередь после нее, а не параллельно ей
+TEST(RescanQueueTest, EventsDuringScanRequeue) {
+    RescanQueue queue(10 * MS, 1000 * MS);
+    queue.touch("/f", 1 * MS);
+    ASSERT_EQ(popAll(queue, 11 * MS).size(), 1u);
+
+    queue.touch("/f", 12 * MS);
+    queue.touch("/f", 14 * MS);
+    EXPECT_EQ(queue.pending(), 0u);
+    EXPECT_TRUE(popAll(queue, 100 * MS).empty());
+
+    uint64_t firstNs = 0;
+    EXPECT_TRUE(queue.finish("/f", firstNs));
+    EXPECT_EQ(firstNs, 1 * MS);
+    EXPECT_EQ(queue.pending(), 1u);
+    EXPECT_EQ(queue.nextDueNs(), 24 * MS);
+    ASSERT_EQ(popAll(queue, 24 * MS).size(), 1u);
+    EXPECT_FALSE(queue.finish("/f", firstNs));
+    EXPECT_EQ(firstNs, 12 * MS);
+    EXPECT_EQ(queue.stats().requeued, 1u);
+
+    // Файл не из очереди (пересканирование) ничего не меняет
+    EXPECT_FALSE(queue.finish("/other", firstNs));
+    EXPECT_EQ(firstNs, 0u);
+}
@@ -0,0 +1,413 @@
+#include <gtest/gtest.h>
+#include "scan_cache.h"
+#include "checksum.h"
+#include "test_utils.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Отметки заведомо старше окна гонки относительно OBSERVED_AT
+const int64_t OBSERVED_AT = 2000000000000000000ll;
+const int64_t OLD_TIME = 1000000000000000000ll;
+
+FileStamp makeStamp(uint64_t inode, uint64_t size = 100) {
+    FileStamp stamp;
+    stamp.device = 42;
+    stamp.inode = inode;
+    stamp.size = size;
+    stamp.mtimeNs = OLD_TIME + static_cast<int64_t>(inode);
+    stamp.ctimeNs = OLD_TIME + static_cast<int64_t>(inode) + 7;
+    return stamp;
+}
+
+MD5Digest makeDigest(uint64_t seed) {
+    MD5Digest digest;
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = static_cast<uint8_t>(seed * 31 + i);
+    }
+    return digest;
+}
+
+FileDigests makeDigests(uint64_t seed, DigestMask mask) {
+    FileDigests digests;
+    digests.mask = mask;
+    digests.md5 = makeDigest(seed);
+    for (size_t i = 0; i < digests.sha1.size(); ++i) {
+        digests.sha1[i] = static_cast<uint8_t>(seed * 7 + i);
+    }
+    for (size_t i = 0; i < digests.sha256.size(); ++i) {
+        digests.sha256[i] = static_cast<uint8_t>(seed * 13 + i);
+    }
+    digests.xxh3 = seed * 0x9E3779B97F4A7C15ull;
+    return digests;
+}
+
+// Файлы кэша версии 1, как их писали прошлые сборки: запись - метаданные и MD5
+struct RecordV1 {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeNs;
+    int64_t ctimeNs;
+    uint8_t digest[16];
+};
+
+struct SnapshotHeaderV1 {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;
+    uint64_t recordCount;
+    uint64_t payloadChecksum;
+    uint64_t headerChecksum;
+};
+
+struct JournalHeaderV1 {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t generation;
+    uint64_t headerChecksum;
+};
+
+RecordV1 makeRecordV1(uint64_t inode) {
+    FileStamp stamp = makeStamp(inode);
+    RecordV1 record = {stamp.device, stamp.inode, stamp.size, stamp.mtimeNs, stamp.ctimeNs, {}};
+    MD5Digest digest = makeDigest(inode);
+    std::memcpy(record.digest, digest.data(), sizeof(record.digest));
+    return record;
+}
+
+// Снимок с inode [0, snapshotFiles) и журнал с inode [snapshotFiles, totalFiles)
+void writeCacheV1(const std::string& path, uint64_t snapshotFiles, uint64_t totalFiles) {
+    const uint64_t generation = 5;
+    std::vector<RecordV1> records;
+    for (uint64_t inode = 0; inode < snapshotFiles; ++inode) {
+        records.push_back(makeRecordV1(inode));
+    }
+    SnapshotHeaderV1 snapshot = {{'S', 'C', 'A', 'N', 'C', 'A', 'C', '\x1a'}, 1, sizeof(RecordV1), generation,
+                                 records.size(), 0, 0};
+    snapshot.payloadChecksum = checksum64(records.data(), records.size() * sizeof(RecordV1), generation);
+    snapshot.headerChecksum = checksum64(&snapshot, offsetof(SnapshotHeaderV1, headerChecksum), 0);
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&snapshot), sizeof(snapshot));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(RecordV1));
+
+    JournalHeaderV1 journal = {{'S', 'C', 'A', 'N', 'J', 'R', 'N', '\x1a'}, 1, sizeof(RecordV1), generation, 0};
+    journal.headerChecksum = checksum64(&journal, offsetof(JournalHeaderV1, headerChecksum), 0);
+    std::ofstream journalFile(path + ".journal", std::ios::binary);
+    journalFile.write(reinterpret_cast<const char*>(&journal), sizeof(journal));
+    for (uint64_t inode = snapshotFiles; inode < totalFiles; ++inode) {
+        RecordV1 record = makeRecordV1(inode);
+        uint64_t checksum = checksum64(&record, sizeof(record), generation);
+        journalFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        journalFile.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+    }
+}
+
+uint32_t fileVersion(const std::string& path) {
+    char header[12] = {};
+    std::ifstream(path, std::ios::binary).read(header, sizeof(header));
+    uint32_t version;
+    std::memcpy(&version, header + 8, sizeof(version));
+    return version;
+}
+
+}
+
+class ScanCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+        cachePath = testDir + "/scan.cache";
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    // Сколько из inode [first, last) находится в кэше с дайджестом makeDigest(inode + shift)
+    size_t countHits(ScanCache& cache, uint64_t first, uint64_t last, uint64_t shift = 0) {
+        size_t hits = 0;
+        for (uint64_t inode = first; inode < last; ++inode) {
+            MD5Digest digest;
+            if (cache.lookup(makeStamp(inode), digest) && digest == makeDigest(inode + shift)) {
+                hits++;
+            }
+        }
+        return hits;
+    }
+
+    std::string testDir;
+    std::string cachePath;
+};
+
+TEST_F(ScanCacheTest, LookupRequiresSameMetadata) {
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    FileStamp stamp = makeStamp(1);
+    EXPECT_TRUE(cache.store(stamp, makeDigest(1), OBSERVED_AT));
+
+    MD5Digest digest;
+    EXPECT_TRUE(cache.lookup(stamp, digest));
+    EXPECT_EQ(digest, makeDigest(1));
+
+    FileStamp changed = stamp;
+    changed.size++;
+    EXPECT_FALSE(cache.lookup(changed, digest));
+    changed = stamp;
+    changed.mtimeNs++;
+    EXPECT_FALSE(cache.lookup(changed, digest));
+    changed = stamp;
+    changed.ctimeNs++;
+    EXPECT_FALSE(cache.lookup(changed, digest));
+    EXPECT_FALSE(cache.lookup(makeStamp(2), digest));
+
+    ScanCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.stale, 3u);
+    EXPECT_EQ(stats.misses, 1u);
+}
+
+// Файл, измененный в пределах окна до stat, не кэшируется
+TEST_F(ScanCacheTest, RecentlyChangedFileNotStored) {
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    FileStamp stamp = makeStamp(1);
+    stamp.ctimeNs = OBSERVED_AT - ScanCache::RACY_WINDOW_NS / 2;
+    EXPECT_FALSE(cache.store(stamp, makeDigest(1), OBSERVED_AT));
+
+    MD5Digest digest;
+    EXPECT_FALSE(cache.lookup(stamp, digest));
+    EXPECT_EQ(cache.stats().racy, 1u);
+}
+
+TEST_F(ScanCacheTest, JournalSurvivesReopen) {
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 5000; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.commit());
+        // Повторное сохранение не меняет журнал
+        for (uint64_t inode = 0; inode < 10; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.commit());
+        EXPECT_EQ(cache.stats().journalRecords, 5000u);
+    }
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.size(), 5000u);
+    EXPECT_EQ(countHits(cache, 0, 5000), 5000u);
+}
+
+// Оборванная при сбое запись журнала отбрасывается, следующие пишутся за последней целой
+TEST_F(ScanCacheTest, TornJournalTailIsDropped) {
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 100; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.flush());
+    }
+    std::ofstream(cachePath + ".journal", std::ios::binary | std::ios::app) << "torn record";
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        EXPECT_EQ(cache.stats().droppedRecords, 1u);
+        EXPECT_EQ(countHits(cache, 0, 100), 100u);
+        for (uint64_t inode = 100; inode < 150; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.flush());
+    }
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.stats().droppedRecords, 0u);
+    EXPECT_EQ(countHits(cache, 0, 150), 150u);
+}
+
+TEST_F(ScanCacheTest, CompactionDropsUnseenFiles) {
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 100; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.compact(false));
+        EXPECT_EQ(cache.stats().journalRecords, 0u);
+    }
+    {
+        // Встречены только первые 60 файлов
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        EXPECT_EQ(countHits(cache, 0, 60), 60u);
+        ASSERT_TRUE(cache.commit(true));
+        EXPECT_EQ(cache.size(), 60u);
+    }
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.size(), 60u);
+    EXPECT_EQ(countHits(cache, 0, 100), 60u);
+}
+
+// Сжатие прервано после подмены снимка: журнал прошлого поколения не применяется
+TEST_F(ScanCacheTest, JournalOfOldGenerationIgnored) {
+    std::string oldJournal = testDir + "/old.journal";
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 10; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.flush());
+        std::filesystem::copy_file(cachePath + ".journal", oldJournal);
+        for (uint64_t inode = 0; inode < 10; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode + 1), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.compact(false));
+    }
+    std::filesystem::copy_file(oldJournal, cachePath + ".journal",
+                               std::filesystem::copy_options::overwrite_existing);
+
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.stats().journalRecords, 0u);
+    EXPECT_EQ(countHits(cache, 0, 10, 1), 10u);
+}
+
+TEST_F(ScanCacheTest, CorruptSnapshotIsRebuilt) {
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 10; ++inode) {
+            cache.store(makeStamp(inode), makeDigest(inode), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.compact(false));
+    }
+    {
+        std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(100);
+        file.put('\x55');
+    }
+    {
+        ScanCache cache;
+        std::string error;
+        EXPECT_FALSE(cache.open(cachePath, &error));
+        EXPECT_FALSE(error.empty());
+        EXPECT_EQ(cache.size(), 0u);
+        cache.store(makeStamp(3), makeDigest(3), OBSERVED_AT);
+        ASSERT_TRUE(cache.commit());
+    }
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(countHits(cache, 3, 4), 1u);
+}
+
+TEST_F(ScanCacheTest, StampOfRegularFile) {
+    std::string path = testDir + "/file.bin";
+    std::ofstream(path, std::ios::binary) << "twelve bytes";
+
+    FileStamp stamp;
+    ASSERT_TRUE(ScanCache::stampOf(path, stamp));
+    EXPECT_EQ(stamp.size, 12u);
+    EXPECT_NE(stamp.inode, 0u);
+    EXPECT_LE(stamp.mtimeNs, ScanCache::now());
+    EXPECT_GT(stamp.mtimeNs, ScanCache::now() - 3600ll * 1000000000);
+
+    EXPECT_FALSE(ScanCache::stampOf(testDir, stamp));
+    EXPECT_FALSE(ScanCache::stampOf(testDir + "/missing", stamp));
+}
+
+// Запись отдает дайджесты, только если в ней есть все запрошенные алгоритмы
+TEST_F(ScanCacheTest, LookupRequiresDigests) {
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    FileStamp stamp = makeStamp(1);
+    FileDigests stored = makeDigests(1, DIGEST_MD5 | DIGEST_SHA256);
+    ASSERT_TRUE(cache.store(stamp, stored, OBSERVED_AT));
+
+    FileDigests digests;
+    ASSERT_TRUE(cache.lookup(stamp, DIGEST_MD5 | DIGEST_SHA256, digests));
+    EXPECT_EQ(digests.mask, DIGEST_MD5 | DIGEST_SHA256);
+    EXPECT_EQ(digests.md5, stored.md5);
+    EXPECT_EQ(digests.sha256, stored.sha256);
+
+    EXPECT_FALSE(cache.lookup(stamp, DIGEST_MD5 | DIGEST_SHA1, digests));
+    EXPECT_EQ(cache.stats().incomplete, 1u);
+
+    // Тот же файл с другим набором: посчитанные раньше алгоритмы остаются
+    ASSERT_TRUE(cache.store(stamp, makeDigests(1, DIGEST_MD5 | DIGEST_SHA1 | DIGEST_XXH3), OBSERVED_AT));
+    ASSERT_TRUE(cache.lookup(stamp, DIGEST_ALL, digests));
+    EXPECT_EQ(digests.sha256, stored.sha256);
+    EXPECT_EQ(digests.sha1, stored.sha1);
+    EXPECT_EQ(digests.xxh3, stored.xxh3);
+
+    // Другое содержимое: старые дайджесты к нему не относятся
+    ASSERT_TRUE(cache.store(stamp, makeDigests(2, DIGEST_MD5), OBSERVED_AT));
+    EXPECT_FALSE(cache.lookup(stamp, DIGEST_MD5 | DIGEST_SHA256, digests));
+    ASSERT_TRUE(cache.lookup(stamp, DIGEST_MD5, digests));
+    EXPECT_EQ(digests.mask, DIGEST_MD5);
+    EXPECT_EQ(digests.md5, makeDigest(2));
+}
+
+TEST_F(ScanCacheTest, DigestsSurviveReopen) {
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        for (uint64_t inode = 0; inode < 20; ++inode) {
+            cache.store(makeStamp(inode), makeDigests(inode, DIGEST_ALL), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.compact(false));
+        for (uint64_t inode = 20; inode < 30; ++inode) {
+            cache.store(makeStamp(inode), makeDigests(inode, DIGEST_ALL), OBSERVED_AT);
+        }
+        ASSERT_TRUE(cache.flush());
+    }
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.stats().journalRecords, 10u);
+    for (uint64_t inode = 0; inode < 30; ++inode) {
+        FileDigests digests;
+        ASSERT_TRUE(cache.lookup(makeStamp(inode), DIGEST_ALL, digests)) << inode;
+        FileDigests expected = makeDigests(inode, DIGEST_ALL);
+        EXPECT_EQ(digests.sha1, expected.sha1);
+        EXPECT_EQ(digests.sha256, expected.sha256);
+        EXPECT_EQ(digests.xxh3, expected.xxh3);
+    }
+}
+
+// Кэш версии 1 читается с одним MD5 и при первом commit переписывается в текущей версии
+TEST_F(ScanCacheTest, ReadsVersion1) {
+    writeCacheV1(cachePath, 8, 10);
+    {
+        ScanCache cache;
+        ASSERT_TRUE(cache.open(cachePath));
+        EXPECT_EQ(cache.size(), 10u);
+        EXPECT_EQ(cache.stats().journalRecords, 2u);
+        EXPECT_EQ(countHits(cache, 0, 10), 10u);
+        FileDigests digests;
+        EXPECT_FALSE(cache.lookup(makeStamp(0), DIGEST_MD5 | DIGEST_SHA256, digests));
+
+        cache.store(makeStamp(0), makeDigests(0, DIGEST_MD5 | DIGEST_SHA256), OBSERVED_AT);
+        ASSERT_TRUE(cache.commit());
+    }
+    EXPECT_EQ(fileVersion(cachePath), ScanCache::FORMAT_VERSION);
+    EXPECT_EQ(fileVersion(cachePath + ".journal"), ScanCache::FORMAT_VERSION);
+
+    ScanCache cache;
+    ASSERT_TRUE(cache.open(cachePath));
+    EXPECT_EQ(cache.stats().journalRecords, 0u);
+    EXPECT_EQ(countHits(cache, 0, 10), 10u);
+    FileDigests digests;
+    ASSERT_TRUE(cache.lookup(makeStamp(0), DIGEST_MD5 | DIGEST_SHA256, digests));
+    EXPECT_EQ(digests.sha256, makeDigests(0, DIGEST_SHA256).sha256);
+}
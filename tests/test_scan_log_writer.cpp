@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "scan_log_writer.h"
+#include "test_utils.h"
+#include <chrono>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> readLines(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+}
+
+class ScanLogWriterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+        logPath = testDir + "/scan.log";
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    std::string testDir;
+    std::string logPath;
+};
+
+// Строки всех потоков попадают в файл целиком, заголовок - первой строкой
+TEST_F(ScanLogWriterTest, ManyThreadsWholeLines) {
+    const int THREADS = 8;
+    const int LINES = 5000;
+    LogWriterOptions options;
+    options.blockSize = 4096;
+    ScanLogWriter log(options);
+    ASSERT_TRUE(log.open(logPath, "file_path;hash;verdict\n"));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < LINES; ++i) {
+                std::string path = "/dir" + std::to_string(t) + "/file" + std::to_string(i);
+                log.appendLine({path, "0123456789abcdef0123456789abcdef", "Trojan"});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(log.close());
+
+    std::vector<std::string> lines = readLines(logPath);
+    ASSERT_EQ(lines.size(), static_cast<size_t>(THREADS * LINES + 1));
+    EXPECT_EQ(lines[0], "file_path;hash;verdict");
+    std::set<std::string> unique(lines.begin() + 1, lines.end());
+    EXPECT_EQ(unique.size(), static_cast<size_t>(THREADS * LINES));
+    EXPECT_EQ(unique.count("/dir3/file4999;0123456789abcdef0123456789abcdef;Trojan"), 1u);
+
+    ScanLogWriter::Stats stats = log.stats();
+    EXPECT_EQ(stats.lines, static_cast<uint64_t>(THREADS * LINES));
+    // Блоки по 4 КиБ выгружаются пачками, а не по строке
+    EXPECT_LT(stats.writes, stats.lines / 50);
+}
+
+// Строка длиннее блока уходит отдельным блоком и не рвется
+TEST_F(ScanLogWriterTest, LineLongerThanBlock) {
+    LogWriterOptions options;
+    options.blockSize = 256;
+    ScanLogWriter log(options);
+    ASSERT_TRUE(log.open(logPath));
+    std::string longPath(1000, 'x');
+    log.appendLine({"short", "a"});
+    log.appendLine({longPath, "b"});
+    log.appendLine({"short", "c"});
+    ASSERT_TRUE(log.close());
+
+    std::vector<std::string> lines = readLines(logPath);
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], "short;a");
+    EXPECT_EQ(lines[1], longPath + ";b");
+    EXPECT_EQ(lines[2], "short;c");
+}
+
+// Неполный буфер потока выгружается по интервалу, не дожидаясь close
+TEST_F(ScanLogWriterTest, FlushInterval) {
+    LogWriterOptions options;
+    options.flushIntervalMs = 20;
+    options.durability = LogDurability::Interval;
+    ScanLogWriter log(options);
+    ASSERT_TRUE(log.open(logPath));
+    log.appendLine({"found", "Virus"});
+
+    std::vector<std::string> lines;
+    for (int attempt = 0; attempt < 100 && lines.empty(); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        log.poll();
+        lines = readLines(logPath);
+    }
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "found;Virus");
+    ASSERT_TRUE(log.close());
+    EXPECT_GE(log.stats().syncs, 1u);
+}
+
+// flush сдает буфер сразу, даже при долгом интервале
+TEST_F(ScanLogWriterTest, FlushNow) {
+    LogWriterOptions options;
+    options.flushIntervalMs = 60000;
+    ScanLogWriter log(options);
+    ASSERT_TRUE(log.open(logPath));
+    log.appendLine({"found", "Virus"});
+    log.flush();
+
+    std::vector<std::string> lines;
+    for (int attempt = 0; attempt < 100 && lines.empty(); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        lines = readLines(logPath);
+    }
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "found;Virus");
+    ASSERT_TRUE(log.close());
+}
+
+TEST_F(ScanLogWriterTest, EveryWriteSyncs) {
+    LogWriterOptions options;
+    options.flushIntervalMs = 0;
+    options.durability = LogDurability::EveryWrite;
+    ScanLogWriter log(options);
+    ASSERT_TRUE(log.open(logPath));
+    for (int i = 0; i < 3; ++i) {
+        log.appendLine({"line", std::to_string(i)});
+    }
+    ASSERT_TRUE(log.close());
+    EXPECT_EQ(readLines(logPath).size(), 3u);
+    EXPECT_GE(log.stats().syncs, 1u);
+    EXPECT_LE(log.stats().syncs, log.stats().writes);
+}
+
+// Писатель можно открыть заново: буферы потоков от прошлого файла не переиспользуются
+TEST_F(ScanLogWriterTest, Reopen) {
+    ScanLogWriter log;
+    ASSERT_TRUE(log.open(logPath));
+    log.appendLine({"first"});
+    ASSERT_TRUE(log.close());
+    ASSERT_TRUE(log.open(logPath, "header\n"));
+    log.appendLine({"second"});
+    ASSERT_TRUE(log.close());
+
+    std::vector<std::string> lines = readLines(logPath);
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_EQ(lines[0], "header");
+    EXPECT_EQ(lines[1], "second");
+}
+
+TEST_F(ScanLogWriterTest, OpenFails) {
+    ScanLogWriter log;
+    std::string error;
+    EXPECT_FALSE(log.open(testDir + "/missing/scan.log", "", &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(log.isOpen());
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include "scan_metrics.h"
+#include "metrics_collector.h"
+#include <thread>
+#include <vector>
+
+TEST(LatencyHistogramTest, Buckets) {
+    EXPECT_EQ(LatencyHistogram::bucketOf(0), 0u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(1), 0u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(2), 1u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(3), 2u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(1024), 10u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(1025), 11u);
+    // Все, что длиннее последней границы, попадает в последнюю корзину
+    EXPECT_EQ(LatencyHistogram::bucketOf(uint64_t(1) << 40), LatencyHistogram::BUCKETS - 1);
+    for (uint64_t ns : {1ull, 7ull, 1000ull, 123456ull}) {
+        EXPECT_LE(ns, LatencyHistogram::bucketLimitNs(LatencyHistogram::bucketOf(ns)));
+    }
+}
+
+TEST(LatencyHistogramTest, Quantiles) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(histogram.quantileNs(0.5), 0u);
+    EXPECT_EQ(histogram.meanNs(), 0.0);
+
+    // 90 быстрых замеров и 10 медленных
+    for (int i = 0; i < 90; ++i) {
+        histogram.add(1000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.add(1000000);
+    }
+    EXPECT_EQ(histogram.count, 100u);
+    EXPECT_EQ(histogram.quantileNs(0.5), 1024u);
+    EXPECT_EQ(histogram.quantileNs(0.99), uint64_t(1) << 20);
+    EXPECT_DOUBLE_EQ(histogram.meanNs(), (90 * 1000.0 + 10 * 1000000.0) / 100);
+
+    LatencyHistogram other;
+    other.add(1000);
+    histogram.merge(other);
+    EXPECT_EQ(histogram.count, 101u);
+    EXPECT_EQ(histogram.counts[LatencyHistogram::bucketOf(1000)], 91u);
+}
+
+TEST(LatencyHistogramTest, SizeClasses) {
+    EXPECT_EQ(sizeClassOf(0), SizeClass::Under4K);
+    EXPECT_EQ(sizeClassOf(4095), SizeClass::Under4K);
+    EXPECT_EQ(sizeClassOf(4096), SizeClass::Under64K);
+    EXPECT_EQ(sizeClassOf(1024 * 1024), SizeClass::Under16M);
+    EXPECT_EQ(sizeClassOf(uint64_t(1) << 32), SizeClass::Larger);
+    EXPECT_STREQ(sizeClassName(SizeClass::Larger), "inf");
+}
+
+// Снимок суммирует блоки всех потоков, включая завершившиеся
+TEST(MetricsCollectorTest, SnapshotSumsThreads) {
+    const int THREADS = 4;
+    const int FILES = 10000;
+    MetricsCollector collector(true);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            MetricsCollector::ThreadMetrics& local = collector.local();
+            EXPECT_EQ(&local, &collector.local());
+            for (int i = 0; i < FILES; ++i) {
+                local.filesDone.add(1);
+                local.bytesHashed.add(100);
+                local.bySize[0].files.add(1);
+                local.bySize[0].hash.add(50);
+                local.lookup.add(10);
+            }
+            local.queueDepthMax.max(static_cast<uint64_t>(t + 1));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ScanMetrics metrics;
+    collector.snapshot(metrics);
+    EXPECT_TRUE(metrics.timings);
+    EXPECT_EQ(metrics.filesDone, static_cast<uint64_t>(THREADS * FILES));
+    EXPECT_EQ(metrics.bytesHashed, static_cast<uint64_t>(THREADS * FILES * 100));
+    EXPECT_EQ(metrics.bySize[0].files, static_cast<uint64_t>(THREADS * FILES));
+    EXPECT_EQ(metrics.bySize[0].hash.count, static_cast<uint64_t>(THREADS * FILES));
+    EXPECT_EQ(metrics.bySize[0].hash.totalNs, static_cast<uint64_t>(THREADS * FILES * 50));
+    EXPECT_EQ(metrics.lookup.counts[LatencyHistogram::bucketOf(10)], static_cast<uint64_t>(THREADS * FILES));
+    EXPECT_EQ(metrics.queueDepthMax, static_cast<uint64_t>(THREADS));
+}
+
+// Блоки разных сборщиков в одном потоке не смешиваются
+TEST(MetricsCollectorTest, CollectorsAreIndependent) {
+    MetricsCollector first(false);
+    MetricsCollector second(false);
+    first.local().filesDone.add(3);
+    second.local().filesDone.add(5);
+
+    ScanMetrics metrics;
+    first.snapshot(metrics);
+    EXPECT_EQ(metrics.filesDone, 3u);
+    EXPECT_FALSE(metrics.timings);
+    metrics = ScanMetrics();
+    second.snapshot(metrics);
+    EXPECT_EQ(metrics.filesDone, 5u);
+}
+
+TEST(ScanMetricsTest, Prometheus) {
+    ScanMetrics metrics;
+    metrics.elapsed = 2.0;
+    metrics.directories = 7;
+    metrics.filesDone = 40;
+    metrics.bySize[1].files = 40;
+    std::string text = formatPrometheus(metrics, 2, 1);
+    EXPECT_NE(text.find("# TYPE scanner_files_done_total counter\nscanner_files_done_total 40\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_directories_total 7\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_malware_total 2\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_errors_total 1\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_files_hashed_total{size=\"64KiB\"} 40\n"), std::string::npos);
+    // Гистограммы выводятся только с замерами стадий
+    EXPECT_EQ(text.find("_bucket"), std::string::npos);
+
+    metrics.timings = true;
+    metrics.lookup.add(1000);
+    metrics.lookup.add(3000);
+    text = formatPrometheus(metrics, 0, 0);
+    EXPECT_NE(text.find("scanner_stage_seconds_bucket{stage=\"lookup\",le=\"1.024e-06\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_stage_seconds_bucket{stage=\"lookup\",le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_stage_seconds_count{stage=\"lookup\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_file_stage_seconds_count{stage=\"read\",size=\"inf\"} 0\n"), std::string::npos);
+}
@@ -0,0 +1,372 @@
+#include <gtest/gtest.h>
+#include "scan_result_stream.h"
+#include "test_utils.h"
+#include <cerrno>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+MD5Digest digestOf(uint8_t seed) {
+    MD5Digest digest;
+    for (size_t i = 0; i < digest.size(); ++i) {
+        digest[i] = static_cast<uint8_t>(seed + i);
+    }
+    return digest;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+}
+
+class ScanResultStreamTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+        resultPath = testDir + "/results.bin";
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    std::string testDir;
+    std::string resultPath;
+};
+
+// Все поля записей всех статусов переживают запись и чтение
+TEST_F(ScanResultStreamTest, BinaryRoundTrip) {
+    ScanResultWriter writer(ResultFormat::Binary);
+    ASSERT_TRUE(writer.open(resultPath));
+
+    FileRecord clean;
+    clean.path = "/data/docs/report.txt";
+    clean.hasSize = true;
+    clean.size = 123456789012ull;
+    clean.hasDigest = true;
+    clean.digest = digestOf(1);
+    clean.cached = true;
+    writer.append(clean);
+
+    FileRecord malware;
+    malware.path = "/data/docs/setup.exe";
+    malware.status = FileStatus::Malware;
+    malware.hasSize = true;
+    malware.size = 5;
+    malware.hasDigest = true;
+    malware.digest = digestOf(2);
+    malware.verdict = "Trojan.Generic";
+    writer.append(malware);
+
+    FileRecord error;
+    error.path = "/data/locked";
+    error.status = FileStatus::Error;
+    error.error = EACCES;
+    writer.append(error);
+
+    FileRecord skipped;
+    skipped.path = "/data/locked/big.iso";
+    skipped.status = FileStatus::SkippedBySize;
+    skipped.hasSize = true;
+    skipped.size = 4ull << 30;
+    writer.append(skipped);
+    ASSERT_TRUE(writer.close());
+    EXPECT_EQ(writer.stats().lines, 4u);
+    EXPECT_EQ(writer.stats().bytes, std::filesystem::file_size(resultPath));
+
+    ASSERT_TRUE(ScanResultReader::isResultFile(resultPath));
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    FileRecord record;
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.path, clean.path);
+    EXPECT_EQ(record.status, FileStatus::Clean);
+    EXPECT_TRUE(record.hasSize);
+    EXPECT_EQ(record.size, clean.size);
+    EXPECT_TRUE(record.hasDigest);
+    EXPECT_EQ(record.digest, clean.digest);
+    EXPECT_TRUE(record.cached);
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.path, malware.path);
+    EXPECT_EQ(record.status, FileStatus::Malware);
+    EXPECT_EQ(record.size, 5u);
+    EXPECT_EQ(record.digest, malware.digest);
+    EXPECT_EQ(record.verdict, "Trojan.Generic");
+    EXPECT_FALSE(record.cached);
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.path, "/data/locked");
+    EXPECT_EQ(record.status, FileStatus::Error);
+    EXPECT_FALSE(record.hasSize);
+    EXPECT_FALSE(record.hasDigest);
+    EXPECT_EQ(record.error, EACCES);
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.path, skipped.path);
+    EXPECT_EQ(record.status, FileStatus::SkippedBySize);
+    EXPECT_EQ(record.size, skipped.size);
+    EXPECT_FALSE(record.hasDigest);
+
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_TRUE(reader.error().empty());
+    EXPECT_FALSE(reader.truncated());
+    EXPECT_EQ(reader.records(), 4u);
+}
+
+// Пути одного каталога хранятся остатком после общей части
+TEST_F(ScanResultStreamTest, PathsShareDirectory) {
+    const int FILES = 1000;
+    const std::string dir = "/home/user/projects/scanner/build/objects/";
+    ScanResultWriter writer(ResultFormat::Binary);
+    ASSERT_TRUE(writer.open(resultPath));
+    std::vector<std::string> paths;
+    for (int i = 0; i < FILES; ++i) {
+        paths.push_back(dir + "file" + std::to_string(i) + ".o");
+        FileRecord record;
+        record.path = paths.back();
+        record.hasSize = true;
+        record.size = 4096;
+        record.hasDigest = true;
+        record.digest = digestOf(static_cast<uint8_t>(i));
+        writer.append(record);
+    }
+    ASSERT_TRUE(writer.close());
+
+    // Флаги, длины, пара байт остатка пути, размер и дайджест
+    uint64_t bytes = std::filesystem::file_size(resultPath);
+    EXPECT_LT(bytes / FILES, 32u);
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    FileRecord record;
+    for (int i = 0; i < FILES; ++i) {
+        ASSERT_TRUE(reader.next(record));
+        EXPECT_EQ(record.path, paths[i]);
+        EXPECT_EQ(record.digest, digestOf(static_cast<uint8_t>(i)));
+    }
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_TRUE(reader.error().empty());
+}
+
+// Кадры потоков читаются независимо: у каждого свой словарь путей
+TEST_F(ScanResultStreamTest, ManyThreads) {
+    const int THREADS = 4;
+    const int RECORDS = 3000;
+    LogWriterOptions options;
+    options.blockSize = 1024;
+    ScanResultWriter writer(ResultFormat::Binary, options);
+    ASSERT_TRUE(writer.open(resultPath));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < RECORDS; ++i) {
+                std::string path = "/thread" + std::to_string(t) + "/file" + std::to_string(i);
+                FileRecord record;
+                record.path = path;
+                record.hasSize = true;
+                record.size = static_cast<uint64_t>(i);
+                writer.append(record);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(writer.close());
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    std::set<std::string> paths;
+    FileRecord record;
+    while (reader.next(record)) {
+        std::string path(record.path);
+        std::string expected = "/file" + std::to_string(record.size);
+        ASSERT_EQ(path.substr(path.size() - expected.size()), expected);
+        paths.insert(path);
+    }
+    EXPECT_TRUE(reader.error().empty());
+    EXPECT_EQ(paths.size(), static_cast<size_t>(THREADS * RECORDS));
+}
+
+// Оборванный последний кадр - конец потока, а не повреждение
+TEST_F(ScanResultStreamTest, TruncatedLastFrame) {
+    LogWriterOptions options;
+    options.blockSize = 256;
+    ScanResultWriter writer(ResultFormat::Binary, options);
+    ASSERT_TRUE(writer.open(resultPath));
+    for (int i = 0; i < 100; ++i) {
+        std::string path = "/data/file" + std::to_string(i);
+        FileRecord record;
+        record.path = path;
+        writer.append(record);
+    }
+    ASSERT_TRUE(writer.close());
+    uint64_t size = std::filesystem::file_size(resultPath);
+    std::filesystem::resize_file(resultPath, size - 3);
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    FileRecord record;
+    uint64_t count = 0;
+    while (reader.next(record)) {
+        EXPECT_EQ(record.path, "/data/file" + std::to_string(count));
+        count++;
+    }
+    EXPECT_TRUE(reader.truncated());
+    EXPECT_TRUE(reader.error().empty());
+    EXPECT_GT(count, 0u);
+    EXPECT_LT(count, 100u);
+}
+
+TEST_F(ScanResultStreamTest, CorruptedRecord) {
+    ScanResultWriter writer(ResultFormat::Binary);
+    ASSERT_TRUE(writer.open(resultPath));
+    FileRecord record;
+    record.path = "/data/file";
+    writer.append(record);
+    ASSERT_TRUE(writer.close());
+
+    // Первый байт записи (после заголовка и кадра) - флаги с неизвестным битом
+    std::string data = readFile(resultPath);
+    data[16 + 8] = static_cast<char>(0x80);
+    std::ofstream(resultPath, std::ios::binary) << data;
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_FALSE(reader.error().empty());
+
+    std::ofstream(resultPath, std::ios::binary) << "file_path;hash;verdict\n";
+    std::string error;
+    EXPECT_FALSE(reader.open(resultPath, &error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(ScanResultReader::isResultFile(resultPath));
+}
+
+TEST_F(ScanResultStreamTest, Ndjson) {
+    std::string path = testDir + "/results.ndjson";
+    ScanResultWriter writer(ResultFormat::Ndjson);
+    ASSERT_TRUE(writer.open(path));
+    FileRecord malware;
+    malware.path = "/data/\"quoted\"\\dir\n/file";
+    malware.status = FileStatus::Malware;
+    malware.hasSize = true;
+    malware.size = 5;
+    malware.hasDigest = true;
+    malware.digest = digestOf(0);
+    malware.verdict = "Trojan";
+    writer.append(malware);
+    FileRecord error;
+    error.path = "/data/locked";
+    error.status = FileStatus::Error;
+    error.error = EACCES;
+    writer.append(error);
+    ASSERT_TRUE(writer.close());
+
+    EXPECT_EQ(readFile(path),
+              "{\"path\":\"/data/\\\"quoted\\\"\\\\dir\\u000a/file\",\"size\":5,"
+              "\"md5\":\"000102030405060708090a0b0c0d0e0f\",\"status\":\"malware\",\"verdict\":\"Trojan\"}\n"
+              "{\"path\":\"/data/locked\",\"status\":\"error\",\"error\":" + std::to_string(EACCES) + "}\n");
+    EXPECT_FALSE(ScanResultReader::isResultFile(path));
+}
+
+// Дополнительные дайджесты пишутся только для алгоритмов маски
+TEST_F(ScanResultStreamTest, ExtraDigestsRoundTrip) {
+    ScanResultWriter writer(ResultFormat::Binary);
+    ASSERT_TRUE(writer.open(resultPath));
+
+    FileRecord all;
+    all.path = "/data/a.bin";
+    all.hasDigest = true;
+    all.digest = digestOf(1);
+    all.extraDigests = DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3;
+    for (size_t i = 0; i < all.sha1.size(); ++i) all.sha1[i] = static_cast<uint8_t>(100 + i);
+    for (size_t i = 0; i < all.sha256.size(); ++i) all.sha256[i] = static_cast<uint8_t>(200 + i);
+    all.xxh3 = 0x0123456789abcdefull;
+    writer.append(all);
+
+    FileRecord sha256Only = all;
+    sha256Only.path = "/data/b.bin";
+    sha256Only.extraDigests = DIGEST_SHA256;
+    writer.append(sha256Only);
+
+    // Без дайджеста маска не пишется
+    FileRecord error;
+    error.path = "/data/c.bin";
+    error.status = FileStatus::Error;
+    error.extraDigests = DIGEST_SHA1;
+    writer.append(error);
+    ASSERT_TRUE(writer.close());
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    FileRecord record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.digest, all.digest);
+    EXPECT_EQ(record.extraDigests, all.extraDigests);
+    EXPECT_EQ(record.sha1, all.sha1);
+    EXPECT_EQ(record.sha256, all.sha256);
+    EXPECT_EQ(record.xxh3, all.xxh3);
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.path, "/data/b.bin");
+    EXPECT_EQ(record.extraDigests, DIGEST_SHA256);
+    EXPECT_EQ(record.sha256, all.sha256);
+    EXPECT_EQ(record.sha1, SHA1Digest{});
+
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.extraDigests, 0u);
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_TRUE(reader.error().empty());
+}
+
+// Поток версии 1 читается: его записи не используют бит дополнительных дайджестов
+TEST_F(ScanResultStreamTest, ReadsVersion1) {
+    ScanResultWriter writer(ResultFormat::Binary);
+    ASSERT_TRUE(writer.open(resultPath));
+    FileRecord clean;
+    clean.path = "/data/old.txt";
+    clean.hasDigest = true;
+    clean.digest = digestOf(3);
+    writer.append(clean);
+    ASSERT_TRUE(writer.close());
+    {
+        std::fstream file(resultPath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(8);
+        const uint32_t version = 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    }
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultPath));
+    FileRecord record;
+    ASSERT_TRUE(reader.next(record));
+    EXPECT_EQ(record.digest, clean.digest);
+    EXPECT_EQ(record.extraDigests, 0u);
+    EXPECT_FALSE(reader.next(record));
+    EXPECT_TRUE(reader.error().empty());
+}
+
+TEST_F(ScanResultStreamTest, NdjsonExtraDigests) {
+    FileRecord record;
+    record.path = "/data/a";
+    record.hasDigest = true;
+    record.digest = digestOf(0);
+    record.extraDigests = DIGEST_SHA1 | DIGEST_XXH3;
+    for (size_t i = 0; i < record.sha1.size(); ++i) record.sha1[i] = static_cast<uint8_t>(0xa0 + i);
+    record.xxh3 = 0x00ff00ff00ff00ffull;
+    std::string line;
+    ScanResultWriter::appendJson(record, line);
+    EXPECT_EQ(line,
+              "{\"path\":\"/data/a\",\"md5\":\"000102030405060708090a0b0c0d0e0f\","
+              "\"sha1\":\"a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3\",\"xxh3\":\"00ff00ff00ff00ff\","
+              "\"status\":\"clean\"}\n");
+}
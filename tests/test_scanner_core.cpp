@@ -1,8 +1,17 @@
 #include <gtest/gtest.h>
 #include "scanner_core.h"
+#include "md5_calculator.h"
+#include "scan_cache.h"
+#include "scan_result_stream.h"
 #include "test_utils.h"
+#include <cerrno>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 class ScannerCoreTest : public ::testing::Test {
 protected:
@@ -134,4 +143,860 @@ TEST_F(ScannerCoreTest, ScanResult_Structure) {
     EXPECT_EQ(result.malwareFiles, 2);
     EXPECT_EQ(result.errors, 1);
     EXPECT_EQ(result.duration, 1.5);
+}
+// Тест вложенного дерева: обход и хеширование идут конвейером через ограниченную очередь
+TEST_F(ScannerCoreTest, ScanDirectory_NestedTree) {
+    scanner->loadMalwareBase(malwareBase);
+
+    int expectedMalware = 0;
+    for (int d = 0; d < 10; ++d) {
+        std::string dir = testDir + "/level1_" + std::to_string(d) + "/level2";
+        std::filesystem::create_directories(dir);
+        for (int f = 0; f < 30; ++f) {
+            std::string path = dir + "/file_" + std::to_string(f) + ".txt";
+            if (f % 10 == 0) {
+                std::ofstream(path) << "hello";
+                expectedMalware++;
+            } else {
+                std::ofstream(path) << "clean " << d << " " << f;
+            }
+        }
+    }
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+
+    EXPECT_EQ(result.totalFiles, 300);
+    EXPECT_EQ(result.malwareFiles, expectedMalware);
+    EXPECT_EQ(result.errors, 0);
+
+    std::ifstream log(logFile);
+    std::string line;
+    int logged = -1;  // заголовок
+    while (std::getline(log, line)) {
+        logged++;
+    }
+    EXPECT_EQ(logged, expectedMalware);
+
+    test_utils::cleanup(logFile);
+}
+
+// Тест двоичной базы: CSV компилируется, затем загружается через mmap
+TEST_F(ScannerCoreTest, CompiledBase_SameVerdicts) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::string compiled = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(scanner->compileMalwareBase(compiled));
+
+    IScannerCore* mapped = createScanner();
+    ASSERT_TRUE(mapped->loadMalwareBase(compiled));
+
+    std::ofstream(testDir + "/malware.bin") << "hello";
+    std::ofstream(testDir + "/clean.bin") << "clean";
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    ScanResult result = mapped->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.totalFiles, 2);
+    EXPECT_EQ(result.malwareFiles, 1);
+
+    std::ifstream log(logFile);
+    std::string logContent((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+    EXPECT_NE(logContent.find("5d41402abc4b2a76b9719d911017c592;TestMalware2"), std::string::npos);
+
+    destroyScanner(mapped);
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(compiled);
+}
+
+// Оба способа чтения находят одно и то же
+TEST_F(ScannerCoreTest, IoEngines_SameResult) {
+    scanner->loadMalwareBase(malwareBase);
+    for (int f = 0; f < 50; ++f) {
+        std::ofstream(testDir + "/file_" + std::to_string(f) + ".txt") << (f % 7 == 0 ? "hello" : "clean");
+    }
+
+    for (IoEngine engine : {IoEngine::Uring, IoEngine::Blocking}) {
+        ScanOptions options;
+        options.ioEngine = engine;
+        scanner->setScanOptions(options);
+
+        std::string logFile = test_utils::createTempFile("", ".log");
+        ScanResult result = scanner->scanDirectory(testDir, logFile);
+        EXPECT_EQ(result.totalFiles, 50);
+        EXPECT_EQ(result.malwareFiles, 8);
+        EXPECT_EQ(result.errors, 0);
+        test_utils::cleanup(logFile);
+    }
+}
+
+// Раздельные пулы чтения и хеширования дают те же вердикты и дайджесты, что
+// и общий пул: и для файлов в памяти, и для крупных, читаемых потоково
+TEST_F(ScannerCoreTest, ThreadModels_SameResult) {
+    for (int f = 0; f < 60; ++f) {
+        std::ofstream(testDir + "/file_" + std::to_string(f) + ".txt") << (f % 7 == 0 ? "hello" : "clean");
+    }
+    std::ofstream(testDir + "/empty.bin");
+    for (int f = 0; f < 3; ++f) {
+        std::ofstream large(testDir + "/large_" + std::to_string(f) + ".bin", std::ios::binary);
+        large << std::string(300 * 1024 + f, static_cast<char>('a' + f));
+    }
+    std::string largeBase = test_utils::createTempFile(
+        "5d41402abc4b2a76b9719d911017c592;TestMalware2\n" +
+        MD5Calculator::calculateFileMD5(testDir + "/large_1.bin") + ";LargeMalware\n",
+        ".csv"
+    );
+    ASSERT_TRUE(scanner->loadMalwareBase(largeBase));
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    std::string resultFile = test_utils::createTempFile("", ".bin");
+    std::string cacheFile = test_utils::createTempFile("", ".cache");
+    auto scan = [&](ThreadModel model, uint32_t ioThreads, uint32_t hashThreads, bool withCache) {
+        ScanOptions options;
+        options.ioEngine = IoEngine::Blocking;
+        options.threadModel = model;
+        options.ioThreads = ioThreads;
+        options.hashThreads = hashThreads;
+        options.resultFormat = ResultFormat::Binary;
+        options.resultPath = resultFile;
+        // С кэшем файлы проходят отбор, без него уходят на чтение как есть
+        if (withCache) {
+            test_utils::cleanup(cacheFile);
+            options.cachePath = cacheFile;
+        }
+        scanner->setScanOptions(options);
+        ScanResult result = scanner->scanDirectory(testDir, logFile);
+        EXPECT_EQ(result.totalFiles, 64);
+        EXPECT_EQ(result.malwareFiles, 10);
+        EXPECT_EQ(result.errors, 0);
+        EXPECT_EQ(result.cachedFiles, 0);
+        if (model == ThreadModel::Split) {
+            EXPECT_GE(result.metrics.ioThreads, 1u);
+            EXPECT_GE(result.metrics.hashThreads, 1u);
+            EXPECT_EQ(result.metrics.filesDone, 64u);
+        }
+
+        std::map<std::string, std::string> records;
+        ScanResultReader reader;
+        EXPECT_TRUE(reader.open(resultFile));
+        FileRecord record;
+        while (reader.next(record)) {
+            std::string name = std::filesystem::path(std::string(record.path)).filename().string();
+            records[name] = std::to_string(static_cast<int>(record.status)) + ";" +
+                MD5Calculator::bytesToHexString(record.digest.data(), record.digest.size()) + ";" +
+                std::string(record.verdict);
+        }
+        return records;
+    };
+
+    std::map<std::string, std::string> expected = scan(ThreadModel::Shared, 0, 0, false);
+    ASSERT_EQ(expected.size(), 64u);
+    EXPECT_NE(expected["large_1.bin"].find("LargeMalware"), std::string::npos);
+    for (bool withCache : {false, true}) {
+        EXPECT_EQ(scan(ThreadModel::Split, 0, 0, withCache), expected);
+        EXPECT_EQ(scan(ThreadModel::Split, 3, 2, withCache), expected);
+        EXPECT_EQ(scan(ThreadModel::Split, 1, 1, withCache), expected);
+    }
+
+    test_utils::cleanup(cacheFile);
+    test_utils::cleanup(resultFile);
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(largeBase);
+}
+
+// Повторное сканирование берет дайджесты неизмененных файлов из кэша
+TEST_F(ScannerCoreTest, ScanCache_SkipsUnchangedFiles) {
+    scanner->loadMalwareBase(malwareBase);
+    for (int f = 0; f < 20; ++f) {
+        std::ofstream(testDir + "/file_" + std::to_string(f) + ".txt") << (f % 5 == 0 ? "hello" : "clean");
+    }
+    // Файлы моложе окна гонки не кэшируются
+    std::this_thread::sleep_for(std::chrono::nanoseconds(ScanCache::RACY_WINDOW_NS + 100000000));
+
+    std::string cacheDir = test_utils::createTempDir();
+    ScanOptions options;
+    options.cachePath = cacheDir + "/scan.cache";
+    scanner->setScanOptions(options);
+    std::string logFile = test_utils::createTempFile("", ".log");
+
+    ScanResult cold = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(cold.totalFiles, 20);
+    EXPECT_EQ(cold.malwareFiles, 4);
+    EXPECT_EQ(cold.cachedFiles, 0);
+    EXPECT_EQ(cold.errors, 0);
+
+    ScanResult warm = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(warm.malwareFiles, 4);
+    EXPECT_EQ(warm.cachedFiles, 20);
+
+    // Измененный файл читается заново и проверяется по новому содержимому
+    std::ofstream(testDir + "/file_1.txt") << "hello";
+    ScanResult changed = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(changed.malwareFiles, 5);
+    EXPECT_EQ(changed.cachedFiles, 19);
+
+    options.revalidateCache = true;
+    scanner->setScanOptions(options);
+    ScanResult revalidated = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(revalidated.malwareFiles, 5);
+    EXPECT_EQ(revalidated.cachedFiles, 0);
+    EXPECT_EQ(revalidated.cacheMismatches, 0);
+
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(cacheDir);
+}
+
+// Файлы размера, которого нет среди сигнатур, не читаются, но считаются просканированными
+TEST_F(ScannerCoreTest, SizeFilter_SkipsImpossibleSizes) {
+    std::string sizedBase = test_utils::createTempFile(
+        "5d41402abc4b2a76b9719d911017c592;TestMalware2;5\n"
+        "9f86d081884c7d659a2feaa0c55ad015;TestMalware3;4\n",
+        ".csv"
+    );
+    ASSERT_TRUE(scanner->loadMalwareBase(sizedBase));
+    EXPECT_EQ(scanner->getLoadStats().fileSizes, 2u);
+
+    std::ofstream(testDir + "/hello.bin") << "hello";       // 5 байт, вредоносный
+    std::ofstream(testDir + "/world.bin") << "world";       // 5 байт, хешируется
+    std::ofstream(testDir + "/long.bin") << "clean data";   // 10 байт, пропускается
+    std::ofstream(testDir + "/empty.bin");                  // 0 байт, пропускается
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.totalFiles, 4);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.errors, 0);
+    EXPECT_EQ(result.sizeSkippedFiles, 2);
+    EXPECT_EQ(result.sizeSkippedBytes, 10u);
+
+    ScanOptions options;
+    options.sizeFilter = false;
+    scanner->setScanOptions(options);
+    result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.sizeSkippedFiles, 0);
+
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(sizedBase);
+}
+
+// Крупный файл сначала сверяется по ключу префикса; целиком читается, только если ключ совпал
+TEST_F(ScannerCoreTest, PrefixKey_RejectsByPrefix) {
+    const size_t FILE_SIZE = 5000;
+    const uint64_t PREFIX_LENGTH = 1024;
+    std::string malware(FILE_SIZE, 'm');
+    std::string samePrefix = malware.substr(0, PREFIX_LENGTH) + std::string(FILE_SIZE - PREFIX_LENGTH, 'c');
+    std::string otherPrefix(FILE_SIZE, 'o');
+    std::ofstream(testDir + "/malware.bin", std::ios::binary) << malware;
+    std::ofstream(testDir + "/same_prefix.bin", std::ios::binary) << samePrefix;
+    std::ofstream(testDir + "/other_prefix.bin", std::ios::binary) << otherPrefix;
+
+    MD5Digest full = MD5::hash(malware.data(), malware.size());
+    MD5Digest prefix = MD5::hash(malware.data(), PREFIX_LENGTH);
+    std::string prefixBase = test_utils::createTempFile(
+        MD5Calculator::bytesToHexString(full.data(), full.size()) + ";PrefixMalware;" + std::to_string(FILE_SIZE) +
+        ";" + MD5Calculator::bytesToHexString(prefix.data(), prefix.size()) + "\n",
+        ".csv"
+    );
+    ScanOptions options;
+    options.prefixLength = PREFIX_LENGTH;
+    scanner->setScanOptions(options);
+    ASSERT_TRUE(scanner->loadMalwareBase(prefixBase));
+    EXPECT_EQ(scanner->getLoadStats().prefixKeys, 1u);
+    EXPECT_EQ(scanner->getLoadStats().prefixLength, PREFIX_LENGTH);
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.totalFiles, 3);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.errors, 0);
+    EXPECT_EQ(result.prefixRejectedFiles, 1);
+    EXPECT_EQ(result.prefixSkippedBytes, FILE_SIZE - PREFIX_LENGTH);
+
+    // Двоичная база хранит ключи и длину префикса
+    std::string compiled = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(scanner->compileMalwareBase(compiled));
+    IScannerCore* reloaded = createScanner();
+    ASSERT_TRUE(reloaded->loadMalwareBase(compiled));
+    result = reloaded->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.prefixRejectedFiles, 1);
+
+    options.prefixCheck = false;
+    reloaded->setScanOptions(options);
+    result = reloaded->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.prefixRejectedFiles, 0);
+    destroyScanner(reloaded);
+
+    test_utils::cleanup(compiled);
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(prefixBase);
+}
+
+// Поток результатов получает запись о каждом файле, а не только о найденных
+TEST_F(ScannerCoreTest, ResultStream_RecordsEveryFile) {
+    std::string sizedBase = test_utils::createTempFile(
+        "5d41402abc4b2a76b9719d911017c592;TestMalware2;5\n",
+        ".csv"
+    );
+    ASSERT_TRUE(scanner->loadMalwareBase(sizedBase));
+    std::ofstream(testDir + "/hello.bin") << "hello";       // вредоносный
+    std::ofstream(testDir + "/world.bin") << "world";       // чистый
+    std::ofstream(testDir + "/long.bin") << "clean data";   // пропускается по размеру
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    std::string resultFile = test_utils::createTempFile("", ".bin");
+    ScanOptions options;
+    options.resultFormat = ResultFormat::Binary;
+    options.resultPath = resultFile;
+    scanner->setScanOptions(options);
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 1);
+    EXPECT_EQ(result.errors, 0);
+    EXPECT_EQ(result.resultRecords, 3u);
+    EXPECT_EQ(result.resultBytes, std::filesystem::file_size(resultFile));
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultFile));
+    std::map<std::string, std::string> verdicts;
+    FileRecord record;
+    while (reader.next(record)) {
+        std::string name = std::filesystem::path(std::string(record.path)).filename().string();
+        EXPECT_TRUE(record.hasSize);
+        if (name == "hello.bin") {
+            EXPECT_EQ(record.status, FileStatus::Malware);
+            EXPECT_EQ(record.verdict, "TestMalware2");
+            EXPECT_EQ(MD5Calculator::bytesToHexString(record.digest.data(), record.digest.size()),
+                      "5d41402abc4b2a76b9719d911017c592");
+        } else if (name == "world.bin") {
+            EXPECT_EQ(record.status, FileStatus::Clean);
+            EXPECT_TRUE(record.hasDigest);
+            EXPECT_EQ(record.size, 5u);
+        } else if (name == "long.bin") {
+            EXPECT_EQ(record.status, FileStatus::SkippedBySize);
+            EXPECT_FALSE(record.hasDigest);
+            EXPECT_EQ(record.size, 10u);
+        }
+        verdicts[name] = std::string(record.verdict);
+    }
+    EXPECT_TRUE(reader.error().empty());
+    EXPECT_EQ(verdicts.size(), 3u);
+
+    // NDJSON: строка на файл. Без фильтра по размеру файлы не проходят
+    // через stat, и размер берется из числа прочитанных байт
+    options.resultFormat = ResultFormat::Ndjson;
+    options.sizeFilter = false;
+    scanner->setScanOptions(options);
+    result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.resultRecords, 3u);
+    std::ifstream json(resultFile);
+    std::string line;
+    int lines = 0;
+    while (std::getline(json, line)) {
+        EXPECT_EQ(line.front(), '{');
+        EXPECT_NE(line.find("\"size\":"), std::string::npos) << line;
+        lines++;
+    }
+    EXPECT_EQ(lines, 3);
+
+    test_utils::cleanup(resultFile);
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(sizedBase);
+}
+
+TEST_F(ScannerCoreTest, Metrics_CountsAndProgress) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::filesystem::create_directories(testDir + "/sub");
+    std::ofstream(testDir + "/hello.bin") << "hello";
+    std::ofstream(testDir + "/sub/world.bin") << "world";
+    std::ofstream(testDir + "/sub/big.bin") << std::string(100000, 'x');
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    std::string metricsFile = testDir + "/../scanner_metrics.prom";
+    ScanOptions options;
+    options.collectTimings = true;
+    options.metricsPath = metricsFile;
+    scanner->setScanOptions(options);
+
+    std::vector<ScanProgress> reports;
+    scanner->setProgressCallback([&](const ScanProgress& progress) { reports.push_back(progress); });
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    scanner->setProgressCallback(nullptr);
+
+    const ScanMetrics& metrics = result.metrics;
+    EXPECT_EQ(metrics.filesFound, 3u);
+    EXPECT_EQ(metrics.filesDone, 3u);
+    EXPECT_EQ(metrics.directories, 2u);
+    EXPECT_EQ(metrics.bytesHashed, 100010u);
+    EXPECT_EQ(metrics.bySize[static_cast<size_t>(SizeClass::Under4K)].files, 2u);
+    EXPECT_EQ(metrics.bySize[static_cast<size_t>(SizeClass::Under1M)].files, 1u);
+    EXPECT_GE(metrics.batches, 1u);
+    EXPECT_TRUE(metrics.timings);
+    EXPECT_EQ(metrics.lookup.count, 3u);
+    EXPECT_EQ(metrics.bySize[static_cast<size_t>(SizeClass::Under1M)].read.count, 1u);
+
+    // Последний отчет приходит по завершении и совпадает с итогом
+    ASSERT_FALSE(reports.empty());
+    EXPECT_TRUE(reports.back().finished);
+    EXPECT_EQ(reports.back().metrics.filesDone, 3u);
+    EXPECT_EQ(reports.back().malwareFiles, 1u);
+
+    std::ifstream prom(metricsFile);
+    std::string text((std::istreambuf_iterator<char>(prom)), std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("scanner_files_done_total 3\n"), std::string::npos);
+    EXPECT_NE(text.find("scanner_malware_total 1\n"), std::string::npos);
+    EXPECT_FALSE(std::filesystem::exists(metricsFile + ".tmp"));
+
+    // Без замеров счетчики остаются, гистограммы пусты
+    options = ScanOptions();
+    scanner->setScanOptions(options);
+    result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.metrics.filesDone, 3u);
+    EXPECT_FALSE(result.metrics.timings);
+    EXPECT_EQ(result.metrics.lookup.count, 0u);
+
+    test_utils::cleanup(metricsFile);
+    test_utils::cleanup(logFile);
+}
+
+TEST_F(ScannerCoreTest, ScanBatch_PerTargetResults) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::filesystem::create_directories(testDir + "/first");
+    std::filesystem::create_directories(testDir + "/second/nested");
+    std::filesystem::create_directories(testDir + "/loose");
+    std::ofstream(testDir + "/first/hello.bin") << "hello";
+    std::ofstream(testDir + "/first/clean.bin") << "clean";
+    std::ofstream(testDir + "/second/nested/empty.bin");
+    std::ofstream(testDir + "/loose/a.bin") << "hello";
+    std::ofstream(testDir + "/loose/b.bin") << "other";
+
+    std::vector<ScanTarget> targets(4);
+    targets[0].root = testDir + "/first";
+    targets[1].root = testDir + "/second";
+    targets[2].files = {testDir + "/loose/a.bin", testDir + "/loose/b.bin", testDir + "/loose/missing.bin"};
+    targets[3].root = testDir + "/missing";
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    // Два пакета подряд: пул переиспользуется, лог пишется заново
+    for (int run = 0; run < 2; ++run) {
+        BatchScanResult batch = scanner->scanBatch(targets, logFile);
+        ASSERT_EQ(batch.targets.size(), 4u);
+        EXPECT_EQ(batch.targets[0].totalFiles, 2);
+        EXPECT_EQ(batch.targets[0].malwareFiles, 1);
+        EXPECT_EQ(batch.targets[1].totalFiles, 1);
+        EXPECT_EQ(batch.targets[1].malwareFiles, 1);
+        EXPECT_EQ(batch.targets[1].metrics.directories, 2u);
+        EXPECT_EQ(batch.targets[2].totalFiles, 3);
+        EXPECT_EQ(batch.targets[2].malwareFiles, 1);
+        EXPECT_EQ(batch.targets[2].errors, 1);
+        EXPECT_EQ(batch.targets[3].totalFiles, 0);
+        EXPECT_EQ(batch.targets[3].errors, 1);
+        EXPECT_GT(batch.targets[0].duration, 0.0);
+        EXPECT_LE(batch.targets[0].duration, batch.total.duration);
+
+        EXPECT_EQ(batch.total.totalFiles, 6);
+        EXPECT_EQ(batch.total.malwareFiles, 3);
+        EXPECT_EQ(batch.total.errors, 2);
+        EXPECT_EQ(batch.total.metrics.filesDone, 6u);
+
+        std::ifstream log(logFile);
+        std::string line;
+        int lines = 0;
+        while (std::getline(log, line)) {
+            lines++;
+        }
+        EXPECT_EQ(lines, 4);    // заголовок и три найденных файла
+    }
+
+    // scanDirectory после пакета идет в том же пуле
+    ScanResult single = scanner->scanDirectory(testDir + "/first", logFile);
+    EXPECT_EQ(single.totalFiles, 2);
+    EXPECT_EQ(single.malwareFiles, 1);
+
+    test_utils::cleanup(logFile);
+}
+
+// Жесткие ссылки на один файл читаются один раз, но сообщаются все
+TEST_F(ScannerCoreTest, HardLinks_HashedOnce) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::filesystem::create_directories(testDir + "/a");
+    std::filesystem::create_directories(testDir + "/b");
+    std::ofstream(testDir + "/a/hello.bin") << "hello";
+    std::ofstream(testDir + "/a/clean.bin") << "clean";
+    std::error_code ec;
+    std::filesystem::create_hard_link(testDir + "/a/hello.bin", testDir + "/b/hello_link.bin", ec);
+    if (ec) {
+        GTEST_SKIP() << "hard links are not available: " << ec.message();
+    }
+    std::filesystem::create_hard_link(testDir + "/a/clean.bin", testDir + "/b/clean_link.bin");
+    std::filesystem::create_hard_link(testDir + "/a/clean.bin", testDir + "/b/clean_link2.bin");
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    std::string resultFile = testDir + "/../hard_links.ndjson";
+    ScanOptions options;
+    options.resultFormat = ResultFormat::Ndjson;
+    options.resultPath = resultFile;
+    options.dedupHardLinks = true;
+    scanner->setScanOptions(options);
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+
+    EXPECT_EQ(result.totalFiles, 5);
+    EXPECT_EQ(result.malwareFiles, 2);
+    EXPECT_EQ(result.linkedFiles, 3);
+    EXPECT_EQ(result.linkedBytes, 15u);
+    EXPECT_EQ(result.metrics.bytesHashed, 10u);
+    EXPECT_EQ(result.resultRecords, 5u);
+
+    // Без дедупликации каждый путь читается сам
+    options.dedupHardLinks = false;
+    scanner->setScanOptions(options);
+    result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 2);
+    EXPECT_EQ(result.linkedFiles, 0);
+    EXPECT_EQ(result.metrics.bytesHashed, 25u);
+
+    test_utils::cleanup(resultFile);
+    test_utils::cleanup(logFile);
+}
+
+// Режим наблюдения: файл проверяется после закрытия на запись, задержка считается от события
+TEST_F(ScannerCoreTest, Watch_VerdictAfterCloseWrite) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::mutex mutex;
+    std::condition_variable done;
+    std::map<std::string, std::pair<FileStatus, uint64_t>> verdicts;
+    scanner->setWatchCallback([&](const FileRecord& record, uint64_t latencyNs) {
+        std::lock_guard<std::mutex> lock(mutex);
+        verdicts[std::filesystem::path(std::string(record.path)).filename().string()] = {record.status, latencyNs};
+        done.notify_all();
+    });
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    WatchOptions watchOptions;
+    watchOptions.debounceUs = 1000;
+    if (!scanner->startWatch({testDir}, logFile, watchOptions)) {
+        GTEST_SKIP() << "file system watch is not available";
+    }
+    EXPECT_FALSE(scanner->startWatch({testDir}, logFile, watchOptions));
+
+    std::filesystem::create_directories(testDir + "/uploads");
+    std::ofstream(testDir + "/uploads/hello.bin") << "hello";
+    std::ofstream(testDir + "/clean.bin") << "clean";
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_TRUE(done.wait_for(lock, std::chrono::seconds(5), [&]() { return verdicts.size() >= 2; }));
+    }
+    WatchStats stats = scanner->stopWatch();
+
+    ASSERT_EQ(verdicts.size(), 2u);
+    EXPECT_EQ(verdicts["hello.bin"].first, FileStatus::Malware);
+    EXPECT_EQ(verdicts["clean.bin"].first, FileStatus::Clean);
+    EXPECT_GT(verdicts["hello.bin"].second, 0u);
+    EXPECT_NE(stats.backend, WatchBackend::Auto);
+    EXPECT_EQ(stats.filesScanned, 2u);
+    EXPECT_EQ(stats.malwareFiles, 1u);
+    EXPECT_EQ(stats.errors, 0u);
+    EXPECT_EQ(stats.latency.count, 2u);
+
+    std::ifstream log(logFile);
+    std::string header, line;
+    std::getline(log, header);
+    std::getline(log, line);
+    EXPECT_NE(line.find("hello.bin;5d41402abc4b2a76b9719d911017c592;TestMalware2"), std::string::npos);
+
+    // После остановки наблюдение можно начать заново
+    EXPECT_TRUE(scanner->startWatch({testDir}, logFile, watchOptions));
+    scanner->stopWatch();
+    test_utils::cleanup(logFile);
+}
+
+// Лог, который нельзя создать, не запускает наблюдение; причина - в errno
+TEST_F(ScannerCoreTest, Watch_LogOpenFailureSetsErrno) {
+    std::string logFile = test_utils::createTempFile("", ".log");
+    WatchOptions watchOptions;
+    if (!scanner->startWatch({testDir}, logFile, watchOptions)) {
+        GTEST_SKIP() << "file system watch is not available";
+    }
+    scanner->stopWatch();
+
+    errno = 0;
+    EXPECT_FALSE(scanner->startWatch({testDir}, testDir + "/missing/scan.log", watchOptions));
+    EXPECT_EQ(errno, ENOENT);
+
+    // Так же с файлом результатов
+    ScanOptions options;
+    options.resultFormat = ResultFormat::Ndjson;
+    options.resultPath = testDir + "/missing/results.ndjson";
+    scanner->setScanOptions(options);
+    errno = 0;
+    EXPECT_FALSE(scanner->startWatch({testDir}, logFile, watchOptions));
+    EXPECT_EQ(errno, ENOENT);
+
+    // Неудачный запуск не оставляет наблюдения
+    scanner->setScanOptions(ScanOptions());
+    EXPECT_TRUE(scanner->startWatch({testDir}, logFile, watchOptions));
+    scanner->stopWatch();
+    test_utils::cleanup(logFile);
+}
+
+// Кэш, открытый наблюдением, сканирование не открывает второй раз: идет без него
+TEST_F(ScannerCoreTest, Watch_CacheNotOpenedTwice) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::ofstream(testDir + "/hello.bin") << "hello";
+    std::ofstream(testDir + "/clean.bin") << "clean";
+
+    std::string cacheDir = test_utils::createTempDir();
+    std::string logFile = test_utils::createTempFile("", ".log");
+    std::string watchLog = test_utils::createTempFile("", ".log");
+    ScanOptions options;
+    options.cachePath = cacheDir + "/scan.cache";
+    scanner->setScanOptions(options);
+    WatchOptions watchOptions;
+    if (!scanner->startWatch({cacheDir}, watchLog, watchOptions)) {
+        test_utils::cleanup(cacheDir);
+        GTEST_SKIP() << "file system watch is not available";
+    }
+
+    // Тот же файл под другим написанием пути
+    options.cachePath = cacheDir + "/./scan.cache";
+    scanner->setScanOptions(options);
+    ScanResult shared = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(shared.totalFiles, 2);
+    EXPECT_EQ(shared.malwareFiles, 1);
+    EXPECT_EQ(shared.errors, 1);
+    scanner->stopWatch();
+
+    ScanResult alone = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(alone.malwareFiles, 1);
+    EXPECT_EQ(alone.errors, 0);
+
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(watchLog);
+    test_utils::cleanup(cacheDir);
+}
+
+// Начальная проверка уже лежащих файлов; stopWatch проверяет файлы, не дождавшиеся срока
+TEST_F(ScannerCoreTest, Watch_InitialScanAndStopDrains) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::ofstream(testDir + "/existing.bin") << "hello";
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    WatchOptions watchOptions;
+    watchOptions.initialScan = true;
+    watchOptions.debounceUs = 60 * 1000 * 1000;
+    watchOptions.maxDelayMs = 60 * 1000;
+    if (!scanner->startWatch({testDir}, logFile, watchOptions)) {
+        GTEST_SKIP() << "file system watch is not available";
+    }
+    auto waitFor = [&](uint64_t pending) {
+        WatchStats current;
+        for (int attempt = 0; attempt < 500; ++attempt) {
+            current = scanner->getWatchStats();
+            if (current.pending == pending && current.filesScanned == 1) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return current;
+    };
+    waitFor(0);
+    std::ofstream(testDir + "/late.bin") << "late";
+    WatchStats stats = waitFor(1);
+    EXPECT_EQ(stats.pending, 1u);
+    EXPECT_EQ(stats.filesScanned, 1u);
+    EXPECT_EQ(stats.latency.count, 0u);
+
+    stats = scanner->stopWatch();
+    EXPECT_EQ(stats.filesScanned, 2u);
+    EXPECT_EQ(stats.malwareFiles, 1u);
+    EXPECT_EQ(stats.pending, 0u);
+    EXPECT_EQ(stats.latency.count, 1u);
+    test_utils::cleanup(logFile);
+}
+
+// Дельта и перезагрузка базы меняют вердикты следующих сканирований
+TEST_F(ScannerCoreTest, BaseDeltaAndReload) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::ofstream(testDir + "/hello.bin") << "hello";
+    std::ofstream(testDir + "/world.bin") << "world";
+    std::string logFile = test_utils::createTempFile("", ".log");
+    EXPECT_EQ(scanner->scanDirectory(testDir, logFile).malwareFiles, 1);
+    uint64_t version = scanner->getLoadStats().version;
+
+    std::string delta = test_utils::createTempFile(
+        "-5d41402abc4b2a76b9719d911017c592\n"
+        "7d793037a0760186574b0282f2f435e7;Delta.Malware\n",
+        ".csv");
+    ASSERT_TRUE(scanner->applyBaseDelta(delta));
+    BaseLoadStats stats = scanner->getLoadStats();
+    EXPECT_EQ(stats.removed, 1u);
+    EXPECT_EQ(stats.signatures, 4u);
+    EXPECT_EQ(stats.version, version + 1);
+
+    EXPECT_EQ(scanner->scanDirectory(testDir, logFile).malwareFiles, 1);
+    std::ifstream log(logFile);
+    std::string header, line;
+    std::getline(log, header);
+    std::getline(log, line);
+    EXPECT_NE(line.find("world.bin;7d793037a0760186574b0282f2f435e7;Delta.Malware"), std::string::npos);
+    log.close();
+
+    // Сохраненная база включает дельту
+    std::string compiled = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(scanner->compileMalwareBase(compiled));
+
+    // Перезагрузка заменяет базу вместе с дельтой; при ошибке база остается
+    EXPECT_FALSE(scanner->reloadMalwareBase("nonexistent_base.csv"));
+    ASSERT_TRUE(scanner->reloadMalwareBase(malwareBase));
+    stats = scanner->getLoadStats();
+    EXPECT_EQ(stats.signatures, 3u);
+    EXPECT_EQ(stats.removed, 0u);
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 1);
+
+    ASSERT_TRUE(scanner->reloadMalwareBase(compiled));
+    EXPECT_EQ(scanner->getLoadStats().signatures, 3u);
+    EXPECT_EQ(scanner->scanDirectory(testDir, logFile).malwareFiles, 1);
+    std::ifstream compiledLog(logFile);
+    std::getline(compiledLog, header);
+    std::getline(compiledLog, line);
+    EXPECT_NE(line.find("world.bin"), std::string::npos);
+
+    test_utils::cleanup(compiled);
+    test_utils::cleanup(delta);
+    test_utils::cleanup(logFile);
+}
+
+// Базу можно обновлять, пока идет наблюдение: новые файлы проверяются по новой базе
+TEST_F(ScannerCoreTest, Watch_ReloadWhileWatching) {
+    ASSERT_TRUE(scanner->loadMalwareBase(malwareBase));
+    std::mutex mutex;
+    std::condition_variable done;
+    std::map<std::string, FileStatus> verdicts;
+    scanner->setWatchCallback([&](const FileRecord& record, uint64_t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        verdicts[std::filesystem::path(std::string(record.path)).filename().string()] = record.status;
+        done.notify_all();
+    });
+    std::string logFile = test_utils::createTempFile("", ".log");
+    WatchOptions watchOptions;
+    watchOptions.debounceUs = 1000;
+    if (!scanner->startWatch({testDir}, logFile, watchOptions)) {
+        GTEST_SKIP() << "file system watch is not available";
+    }
+    auto waitFor = [&](const std::string& name) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, std::chrono::seconds(5), [&]() { return verdicts.count(name) != 0; });
+    };
+
+    std::ofstream(testDir + "/before.bin") << "world";
+    ASSERT_TRUE(waitFor("before.bin"));
+    std::string delta = test_utils::createTempFile("7d793037a0760186574b0282f2f435e7;Delta.Malware\n", ".csv");
+    ASSERT_TRUE(scanner->applyBaseDelta(delta));
+    std::ofstream(testDir + "/after.bin") << "world";
+    ASSERT_TRUE(waitFor("after.bin"));
+    scanner->stopWatch();
+
+    EXPECT_EQ(verdicts["before.bin"], FileStatus::Clean);
+    EXPECT_EQ(verdicts["after.bin"], FileStatus::Malware);
+    test_utils::cleanup(delta);
+    test_utils::cleanup(logFile);
+}
+
+// Сигнатуры SHA-1 и SHA-256 проверяются дайджестами того же прохода, что и MD5
+TEST_F(ScannerCoreTest, ShaSignatures_SinglePass) {
+    const std::string sha256Hello = "2cf24dba5fb0a30e26e83b2ac5b9e29e1b161e5c1fa7425e73043362938b9824";
+    std::string shaBase = test_utils::createTempFile(
+        "sha256;" + sha256Hello + ";Sha256Malware\n"
+        "7c211433f02071597741e6ff5a8ea34789abbf43;Sha1Malware\n",
+        ".csv"
+    );
+    ASSERT_TRUE(scanner->loadMalwareBase(shaBase));
+    EXPECT_EQ(scanner->getLoadStats().algorithms, DIGEST_SHA1 | DIGEST_SHA256);
+    std::ofstream(testDir + "/hello.bin") << "hello";
+    std::ofstream(testDir + "/world.bin") << "world";
+    std::ofstream(testDir + "/clean.bin") << "clean";
+
+    std::string logFile = test_utils::createTempFile("", ".log");
+    for (ThreadModel model : {ThreadModel::Split, ThreadModel::Shared}) {
+        for (IoEngine engine : {IoEngine::Uring, IoEngine::Blocking}) {
+            ScanOptions options;
+            options.threadModel = model;
+            options.ioEngine = engine;
+            scanner->setScanOptions(options);
+            ScanResult result = scanner->scanDirectory(testDir, logFile);
+            EXPECT_EQ(result.totalFiles, 3);
+            EXPECT_EQ(result.malwareFiles, 2);
+            EXPECT_EQ(result.errors, 0);
+        }
+    }
+    // В лог пишется хеш совпавшего алгоритма
+    std::ifstream log(logFile);
+    std::string content((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+    EXPECT_NE(content.find(sha256Hello), std::string::npos);
+    EXPECT_NE(content.find("7c211433f02071597741e6ff5a8ea34789abbf43"), std::string::npos);
+
+    // Запрошенный XXH3 попадает в поток результатов вместе с дайджестами базы
+    std::string resultFile = test_utils::createTempFile("", ".bin");
+    ScanOptions options;
+    options.resultFormat = ResultFormat::Binary;
+    options.resultPath = resultFile;
+    options.digests = DIGEST_XXH3;
+    scanner->setScanOptions(options);
+    ScanResult result = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(result.malwareFiles, 2);
+
+    ScanResultReader reader;
+    ASSERT_TRUE(reader.open(resultFile));
+    FileRecord record;
+    int records = 0;
+    while (reader.next(record)) {
+        std::string name = std::filesystem::path(std::string(record.path)).filename().string();
+        std::string content = name == "hello.bin" ? "hello" : name == "world.bin" ? "world" : "clean";
+        ASSERT_TRUE(record.hasDigest);
+        EXPECT_EQ(record.extraDigests, DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3);
+        EXPECT_EQ(record.sha1, SHA1::hash(content.data(), content.size()));
+        EXPECT_EQ(record.sha256, SHA256::hash(content.data(), content.size()));
+        EXPECT_EQ(record.xxh3, XXH3::hash(content.data(), content.size()));
+        EXPECT_EQ(record.status, name == "clean.bin" ? FileStatus::Clean : FileStatus::Malware);
+        records++;
+    }
+    EXPECT_EQ(records, 3);
+
+    test_utils::cleanup(resultFile);
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(shaBase);
+}
+
+// Записи кэша без нужных алгоритмов не используются: файл читается заново
+TEST_F(ScannerCoreTest, ScanCache_RequiresDigests) {
+    scanner->loadMalwareBase(malwareBase);
+    std::ofstream(testDir + "/hello.txt") << "hello";
+    std::ofstream(testDir + "/clean.txt") << "clean";
+    std::this_thread::sleep_for(std::chrono::nanoseconds(ScanCache::RACY_WINDOW_NS + 100000000));
+
+    std::string cacheDir = test_utils::createTempDir();
+    std::string logFile = test_utils::createTempFile("", ".log");
+    ScanOptions options;
+    options.cachePath = cacheDir + "/scan.cache";
+    scanner->setScanOptions(options);
+    ScanResult cold = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(cold.cachedFiles, 0);
+
+    options.digests = DIGEST_SHA256;
+    scanner->setScanOptions(options);
+    ScanResult extended = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(extended.cachedFiles, 0);
+    EXPECT_EQ(extended.malwareFiles, 1);
+
+    // Теперь в кэше есть и SHA-256, и MD5: хватает для обоих наборов
+    ScanResult warm = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(warm.cachedFiles, 2);
+    options.digests = 0;
+    scanner->setScanOptions(options);
+    ScanResult md5Only = scanner->scanDirectory(testDir, logFile);
+    EXPECT_EQ(md5Only.cachedFiles, 2);
+    EXPECT_EQ(md5Only.malwareFiles, 1);
+
+    test_utils::cleanup(logFile);
+    test_utils::cleanup(cacheDir);
 }
\ No newline at end of file
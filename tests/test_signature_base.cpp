@@ -0,0 +1,277 @@
+#include <gtest/gtest.h>
+#include "signature_base.h"
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+MD5Digest randomDigest(std::mt19937_64& rng) {
+    MD5Digest digest;
+    uint64_t a = rng(), b = rng();
+    std::memcpy(digest.data(), &a, 8);
+    std::memcpy(digest.data() + 8, &b, 8);
+    return digest;
+}
+
+// Снимок, который считает свои уничтожения
+struct Counted {
+    explicit Counted(std::atomic<int>& destroyed, int value = 0) : destroyed(destroyed), value(value) {}
+    ~Counted() { destroyed++; }
+    std::atomic<int>& destroyed;
+    int value;
+};
+
+}
+
+// Старый снимок живет, пока его держит читатель
+TEST(SnapshotCellTest, ReaderKeepsRetiredSnapshot) {
+    std::atomic<int> destroyed{0};
+    SnapshotCell<Counted> cell(std::unique_ptr<Counted>(new Counted(destroyed, 1)));
+    {
+        SnapshotCell<Counted>::Guard reader = cell.pin();
+        EXPECT_EQ(reader->value, 1);
+        EXPECT_EQ(cell.publish(std::unique_ptr<Counted>(new Counted(destroyed, 2))), 0u);
+        EXPECT_EQ(destroyed, 0);
+        EXPECT_EQ(cell.retired(), 1u);
+        EXPECT_EQ(reader->value, 1);
+
+        // Вложенное чтение берет уже новый снимок
+        SnapshotCell<Counted>::Guard nested = cell.pin();
+        EXPECT_EQ(nested->value, 2);
+    }
+    EXPECT_EQ(cell.reclaim(), 1u);
+    EXPECT_EQ(destroyed, 1);
+    EXPECT_EQ(cell.retired(), 0u);
+
+    // Без читателей старый снимок освобождается сразу
+    EXPECT_EQ(cell.publish(std::unique_ptr<Counted>(new Counted(destroyed, 3))), 1u);
+    EXPECT_EQ(cell.pin()->value, 3);
+}
+
+TEST(SnapshotCellTest, GuardMove) {
+    std::atomic<int> destroyed{0};
+    SnapshotCell<Counted> cell(std::unique_ptr<Counted>(new Counted(destroyed, 1)));
+    SnapshotCell<Counted>::Guard first = cell.pin();
+    SnapshotCell<Counted>::Guard second = std::move(first);
+    EXPECT_EQ(first.get(), nullptr);
+    cell.publish(std::unique_ptr<Counted>(new Counted(destroyed, 2)));
+    EXPECT_EQ(destroyed, 0);
+    second.release();
+    cell.reclaim();
+    EXPECT_EQ(destroyed, 1);
+}
+
+class SignatureBaseTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937_64 rng(5);
+        for (auto& digest : digests) {
+            digest = randomDigest(rng);
+        }
+    }
+
+    MD5Digest digests[4];
+};
+
+TEST_F(SignatureBaseTest, DeltaAddsAndRemoves) {
+    SignatureBase base;
+    SignatureIndex index;
+    index.insert(digests[0], "Trojan");
+    index.insert(digests[1], "Worm");
+    base.replace(std::move(index));
+
+    SignatureBase::Reader before = base.acquire();
+    SignatureIndex added;
+    added.insert(digests[2], "Exploit");
+    added.insert(digests[1], "Worm.B");
+    EXPECT_EQ(base.applyDelta(added, {digests[0], digests[3]}), 1u);
+
+    SignatureBase::Reader after = base.acquire();
+    EXPECT_EQ(after->find(digests[0]), nullptr);
+    EXPECT_EQ(*after->find(digests[1]), "Worm.B");
+    EXPECT_EQ(*after->find(digests[2]), "Exploit");
+    EXPECT_EQ(after->find(digests[3]), nullptr);
+    EXPECT_EQ(after->size(), 2u);
+    EXPECT_EQ(after->version(), before->version() + 1);
+    // Индекс общий, копировалась только дельта
+    EXPECT_EQ(&after->index(), &before->index());
+
+    // Читатель старого снимка видит базу до дельты
+    EXPECT_EQ(*before->find(digests[0]), "Trojan");
+    EXPECT_EQ(*before->find(digests[1]), "Worm");
+    EXPECT_EQ(before->find(digests[2]), nullptr);
+
+    // Удаление добавленной дельтой сигнатуры и возврат удаленной
+    SignatureIndex back;
+    back.insert(digests[0], "Trojan.B");
+    EXPECT_EQ(base.applyDelta(back, {digests[2]}), 1u);
+    after = base.acquire();
+    EXPECT_EQ(*after->find(digests[0]), "Trojan.B");
+    EXPECT_EQ(after->find(digests[2]), nullptr);
+    EXPECT_EQ(after->size(), 2u);
+}
+
+// Фильтр по размеру пропускает размеры и индекса, и дельты
+TEST_F(SignatureBaseTest, SizeFilterCoversDelta) {
+    SignatureBase base;
+    SignatureIndex index;
+    index.insert(digests[0], "Trojan", 100);
+    base.replace(std::move(index));
+
+    SignatureIndex sized;
+    sized.insert(digests[1], "Worm", 200);
+    sized.insert(digests[3], "Worm", 100);
+    base.applyDelta(sized, {});
+    SignatureBase::Reader reader = base.acquire();
+    EXPECT_TRUE(reader->hasSizeFilter());
+    EXPECT_TRUE(reader->mayMatchSize(100));
+    EXPECT_TRUE(reader->mayMatchSize(200));
+    EXPECT_FALSE(reader->mayMatchSize(300));
+    // Размер, который есть и в базе, и в дельте, считается один раз
+    EXPECT_EQ(reader->fileSizeCount(), 2u);
+
+    // Сигнатура без размера выключает фильтр
+    SignatureIndex unsized;
+    unsized.insert(digests[2], "Exploit");
+    base.applyDelta(unsized, {});
+    reader = base.acquire();
+    EXPECT_FALSE(reader->hasSizeFilter());
+    EXPECT_TRUE(reader->mayMatchSize(300));
+}
+
+// Ключ префикса из дельты не дает отсеять файл, если у его размера есть сигнатуры без ключа
+TEST_F(SignatureBaseTest, PrefixKeysCoverDelta) {
+    const uint64_t big = SignatureIndex::DEFAULT_PREFIX_LENGTH * 2;
+    SignatureBase base;
+    SignatureIndex index;
+    index.insert(digests[0], "Trojan", big, digests[3]);
+    base.replace(std::move(index));
+    EXPECT_TRUE(base.acquire()->usesPrefixKey(big));
+
+    SignatureIndex plain;
+    plain.insert(digests[1], "Worm", big);
+    base.applyDelta(plain, {});
+    EXPECT_FALSE(base.acquire()->usesPrefixKey(big));
+
+    SignatureIndex prefixed;
+    prefixed.insert(digests[2], "Exploit", big + 1, digests[3]);
+    base.applyDelta(prefixed, {});
+    SignatureBase::Reader reader = base.acquire();
+    EXPECT_TRUE(reader->usesPrefixKey(big + 1));
+    EXPECT_TRUE(reader->mayMatchPrefix(big + 1, digests[3]));
+    EXPECT_FALSE(reader->mayMatchPrefix(big + 1, digests[0]));
+}
+
+// Сжатие дает тот же результат поиска, что и дельта поверх индекса
+TEST_F(SignatureBaseTest, CompactMatchesDelta) {
+    std::mt19937_64 rng(9);
+    std::vector<MD5Digest> all;
+    SignatureIndex index;
+    for (int i = 0; i < 2000; ++i) {
+        all.push_back(randomDigest(rng));
+        index.insert(all.back(), "Base" + std::to_string(i % 7));
+    }
+    SignatureBase base;
+    base.replace(std::move(index));
+    for (int round = 0; round < 10; ++round) {
+        SignatureIndex added;
+        std::vector<MD5Digest> removed;
+        for (int i = 0; i < 50; ++i) {
+            removed.push_back(all[rng() % all.size()]);
+            all.push_back(randomDigest(rng));
+            added.insert(all.back(), "Delta" + std::to_string(round));
+            added.insert(all[rng() % all.size()], "Override" + std::to_string(round));
+        }
+        base.applyDelta(added, removed);
+    }
+
+    SignatureBase::Reader delta = base.acquire();
+    EXPECT_GT(delta->deltaSize(), 0u);
+    std::shared_ptr<const SignatureIndex> merged = base.merged();
+    EXPECT_EQ(merged->size(), delta->size());
+    base.compact();
+    SignatureBase::Reader compacted = base.acquire();
+    EXPECT_EQ(compacted->deltaSize(), 0u);
+    EXPECT_EQ(compacted->size(), delta->size());
+    for (const MD5Digest& digest : all) {
+        const std::string* expected = delta->find(digest);
+        const std::string* actual = compacted->find(digest);
+        ASSERT_EQ(expected == nullptr, actual == nullptr);
+        if (expected) {
+            EXPECT_EQ(*expected, *actual);
+        }
+    }
+    EXPECT_EQ(base.stats().compactions, 1u);
+}
+
+// Загрузка в пустую базу не копирует индекс, в непустую - сливает
+TEST_F(SignatureBaseTest, Extend) {
+    SignatureBase base;
+    SignatureIndex first;
+    first.insert(digests[0], "Trojan");
+    first.insert(digests[1], "Worm");
+    EXPECT_EQ(base.extend(std::move(first)), 0u);
+
+    SignatureIndex second;
+    second.insert(digests[1], "Worm.B");
+    second.insert(digests[2], "Exploit");
+    EXPECT_EQ(base.extend(std::move(second)), 1u);
+    SignatureBase::Reader reader = base.acquire();
+    EXPECT_EQ(reader->size(), 3u);
+    EXPECT_EQ(*reader->find(digests[1]), "Worm.B");
+    EXPECT_EQ(reader->version(), 2u);
+}
+
+// Читатели не блокируются и не видят освобожденных снимков, пока писатель их меняет
+TEST_F(SignatureBaseTest, ConcurrentReadersAndPublications) {
+    const int PUBLICATIONS = 200;
+    SignatureBase base;
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                SignatureBase::Reader reader = base.acquire();
+                // В каждом снимке маркер с вердиктом, равным числу сигнатур
+                const std::string* marker = reader->find(digests[0]);
+                if (marker && *marker != std::to_string(reader->size())) {
+                    mismatches++;
+                }
+                reads++;
+            }
+        });
+    }
+    while (reads == 0) {
+        std::this_thread::yield();
+    }
+    std::mt19937_64 rng(3);
+    for (int p = 1; p <= PUBLICATIONS; ++p) {
+        std::this_thread::yield();
+        SignatureIndex index;
+        index.insert(digests[0], std::to_string(p % 50 + 1));
+        for (int i = 1; i < p % 50 + 1; ++i) {
+            index.insert(randomDigest(rng), "Filler");
+        }
+        base.replace(std::move(index));
+    }
+    done = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(mismatches, 0);
+    EXPECT_GT(reads, 0u);
+
+    base.compact();
+    SignatureIndex last;
+    base.replace(std::move(last));
+    SignatureBase::Stats stats = base.stats();
+    EXPECT_EQ(stats.version, static_cast<uint64_t>(PUBLICATIONS + 1));
+    EXPECT_EQ(stats.retired, 0u);
+    EXPECT_EQ(stats.reclaimed, stats.publications);
+}
@@ -0,0 +1,449 @@
+#include <gtest/gtest.h>
+#include "signature_index.h"
+#include "test_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace {
+
+MD5Digest randomDigest(std::mt19937_64& rng) {
+    MD5Digest digest;
+    uint64_t a = rng(), b = rng();
+    std::memcpy(digest.data(), &a, 8);
+    std::memcpy(digest.data() + 8, &b, 8);
+    return digest;
+}
+
+MD5Digest fromHex(const char* hex) {
+    MD5Digest digest{};
+    EXPECT_TRUE(SignatureIndex::parseHex(hex, std::strlen(hex), digest));
+    return digest;
+}
+
+}
+
+TEST(SignatureIndexTest, ParseHex) {
+    MD5Digest digest;
+    ASSERT_TRUE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf8427e", 32, digest));
+    EXPECT_EQ(digest[0], 0xd4);
+    EXPECT_EQ(digest[15], 0x7e);
+
+    bool uppercase = true;
+    ASSERT_TRUE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf8427e", 32, digest, &uppercase));
+    EXPECT_FALSE(uppercase);
+
+    MD5Digest upper;
+    ASSERT_TRUE(SignatureIndex::parseHex("D41D8CD98F00B204E9800998ECF8427E", 32, upper, &uppercase));
+    EXPECT_EQ(digest, upper);
+    EXPECT_TRUE(uppercase);
+
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf8427", 31, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("x41d8cd98f00b204e9800998ecf8427e", 32, digest));
+    // Соседние с диапазонами символы: '/', ':', '@', 'G', '`', 'g'
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf8427/", 32, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf842:e", 32, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204@9800998ecf8427e", 32, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("G41d8cd98f00b204e9800998ecf8427e", 32, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204e980`998ecf8427e", 32, digest));
+    EXPECT_FALSE(SignatureIndex::parseHex("d41d8cd98f00b204e9800998ecf8427g", 32, digest));
+}
+
+TEST(SignatureIndexTest, FindAndOverwrite) {
+    SignatureIndex index;
+    MD5Digest a = fromHex("d41d8cd98f00b204e9800998ecf8427e");
+    MD5Digest b = fromHex("5d41402abc4b2a76b9719d911017c592");
+
+    EXPECT_EQ(index.find(a), nullptr);
+    index.insert(a, "Trojan");
+    index.insert(b, "Worm");
+
+    ASSERT_NE(index.find(a), nullptr);
+    EXPECT_EQ(*index.find(a), "Trojan");
+    EXPECT_EQ(*index.find(b), "Worm");
+    EXPECT_FALSE(index.contains(fromHex("9f86d081884c7d659a2feaa0c55ad015")));
+
+    // Повторная сигнатура заменяет вердикт, как и в CSV-базе
+    index.insert(a, "Dropper");
+    EXPECT_EQ(index.size(), 2u);
+    EXPECT_EQ(*index.find(a), "Dropper");
+}
+
+// Удаление не рвет цепочки пробирования: остальные ключи находятся
+TEST(SignatureIndexTest, Erase) {
+    std::mt19937_64 rng(7);
+    SignatureIndex index;
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 20000; ++i) {
+        digests.push_back(randomDigest(rng));
+        index.insert(digests.back(), "Sig" + std::to_string(i % 10));
+    }
+    for (size_t i = 0; i < digests.size(); i += 2) {
+        EXPECT_TRUE(index.erase(digests[i]));
+    }
+    EXPECT_FALSE(index.erase(digests[0]));
+    EXPECT_FALSE(index.erase(randomDigest(rng)));
+    EXPECT_EQ(index.size(), digests.size() / 2);
+    for (size_t i = 0; i < digests.size(); ++i) {
+        ASSERT_EQ(index.contains(digests[i]), i % 2 == 1) << i;
+    }
+
+    index.insert(MD5Digest{}, "Zero");
+    EXPECT_TRUE(index.erase(MD5Digest{}));
+    EXPECT_FALSE(index.contains(MD5Digest{}));
+    index.insert(digests[0], "Back");
+    EXPECT_EQ(*index.find(digests[0]), "Back");
+}
+
+TEST(SignatureIndexTest, ZeroDigest) {
+    SignatureIndex index;
+    MD5Digest zero{};
+    EXPECT_EQ(index.find(zero), nullptr);
+
+    index.insert(zero, "Zero");
+    ASSERT_NE(index.find(zero), nullptr);
+    EXPECT_EQ(*index.find(zero), "Zero");
+    EXPECT_EQ(index.size(), 1u);
+}
+
+TEST(SignatureIndexTest, GrowsAndInternsVerdicts) {
+    SignatureIndex index;
+    std::mt19937_64 rng(42);
+    const char* verdicts[] = {"Exploit", "Dropper", "Downloader"};
+
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 100000; ++i) {
+        digests.push_back(randomDigest(rng));
+        index.insert(digests.back(), verdicts[i % 3]);
+    }
+
+    EXPECT_EQ(index.size(), digests.size());
+    EXPECT_EQ(index.verdictCount(), 3u);
+    EXPECT_LE(index.size() * 100, index.capacity() * SignatureIndex::MAX_LOAD_PERCENT);
+
+    for (size_t i = 0; i < digests.size(); ++i) {
+        const std::string* verdict = index.find(digests[i]);
+        ASSERT_NE(verdict, nullptr);
+        EXPECT_EQ(*verdict, verdicts[i % 3]);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        MD5Digest absent = randomDigest(rng);
+        EXPECT_EQ(index.find(absent), nullptr);
+        EXPECT_EQ(index.findUnfiltered(absent), nullptr);
+    }
+    EXPECT_GT(index.filterBytes(), 0u);
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0u);
+    EXPECT_EQ(index.find(digests[0]), nullptr);
+}
+
+TEST(SignatureIndexTest, ReserveAvoidsRehash) {
+    SignatureIndex index;
+    index.reserve(1000);
+    size_t capacity = index.capacity();
+
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 1000; ++i) {
+        index.insert(randomDigest(rng), "Virus");
+    }
+    EXPECT_EQ(index.capacity(), capacity);
+}
+
+TEST(SignatureIndexTest, SaveAndOpenMapped) {
+    SignatureIndex index;
+    std::mt19937_64 rng(11);
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 5000; ++i) {
+        digests.push_back(randomDigest(rng));
+        index.insert(digests.back(), i % 2 ? "Worm" : "Trojan");
+    }
+    index.insert(MD5Digest{}, "Zero");
+
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+    EXPECT_TRUE(SignatureIndex::isDatabaseFile(path));
+
+    SignatureIndex mapped;
+    std::string error;
+    ASSERT_TRUE(mapped.openMapped(path, true, &error)) << error;
+    EXPECT_TRUE(mapped.isMapped());
+    EXPECT_EQ(mapped.size(), index.size());
+    EXPECT_EQ(mapped.verdictCount(), 3u);
+    for (size_t i = 0; i < digests.size(); ++i) {
+        ASSERT_NE(mapped.find(digests[i]), nullptr);
+        EXPECT_EQ(*mapped.find(digests[i]), i % 2 ? "Worm" : "Trojan");
+    }
+    EXPECT_EQ(*mapped.find(MD5Digest{}), "Zero");
+    EXPECT_EQ(mapped.find(randomDigest(rng)), nullptr);
+    // Фильтр отображается из файла вместе с таблицей
+    EXPECT_EQ(mapped.filterBytes(), index.filterBytes());
+
+    // Изменение отображенной базы переводит таблицу в память
+    MD5Digest extra = randomDigest(rng);
+    mapped.insert(extra, "Extra");
+    EXPECT_FALSE(mapped.isMapped());
+    EXPECT_EQ(*mapped.find(extra), "Extra");
+    EXPECT_EQ(*mapped.find(digests[0]), "Trojan");
+
+    test_utils::cleanup(path);
+}
+
+// Компиляция поверх базы, из которой загружен сам индекс: файл подменяется
+// целиком, а старое отображение остается целым до закрытия
+TEST(SignatureIndexTest, SaveOverItsOwnMappedFile) {
+    SignatureIndex index;
+    std::mt19937_64 rng(13);
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 20000; ++i) {
+        digests.push_back(randomDigest(rng));
+        index.insert(digests.back(), "Virus");
+    }
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+
+    SignatureIndex mapped;
+    ASSERT_TRUE(mapped.openMapped(path, true));
+    std::string error;
+    ASSERT_TRUE(mapped.save(path, &error)) << error;
+    for (const MD5Digest& digest : digests) {
+        ASSERT_NE(mapped.find(digest), nullptr);
+    }
+
+    SignatureIndex reopened;
+    ASSERT_TRUE(reopened.openMapped(path, true, &error)) << error;
+    EXPECT_EQ(reopened.size(), digests.size());
+    EXPECT_FALSE(std::ifstream(path + ".tmp").is_open());
+    test_utils::cleanup(path);
+}
+
+// Меньшая база, записанная поверх отображенной другим индексом, не обрезает
+// его отображение: до подмены он читает старый файл без SIGBUS
+TEST(SignatureIndexTest, SaveWhileAnotherIndexHasFileMapped) {
+    SignatureIndex large;
+    std::mt19937_64 rng(17);
+    std::vector<MD5Digest> digests;
+    for (int i = 0; i < 20000; ++i) {
+        digests.push_back(randomDigest(rng));
+        large.insert(digests.back(), "Worm");
+    }
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(large.save(path));
+
+    SignatureIndex reader;
+    ASSERT_TRUE(reader.openMapped(path, true));
+
+    SignatureIndex small;
+    MD5Digest only = randomDigest(rng);
+    small.insert(only, "Trojan");
+    ASSERT_TRUE(small.save(path));
+
+    for (const MD5Digest& digest : digests) {
+        ASSERT_NE(reader.find(digest), nullptr);
+        EXPECT_EQ(*reader.find(digest), "Worm");
+    }
+    SignatureIndex reloaded;
+    ASSERT_TRUE(reloaded.openMapped(path, true));
+    EXPECT_EQ(reloaded.size(), 1u);
+    EXPECT_EQ(*reloaded.find(only), "Trojan");
+    test_utils::cleanup(path);
+}
+
+TEST(SignatureIndexTest, RejectsCorruptedDatabase) {
+    SignatureIndex index;
+    std::mt19937_64 rng(5);
+    for (int i = 0; i < 100; ++i) {
+        index.insert(randomDigest(rng), "Virus");
+    }
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+
+    std::string original;
+    {
+        std::ifstream file(path, std::ios::binary);
+        original.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+    auto rewrite = [&](const std::string& content) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+    };
+
+    SignatureIndex mapped;
+    std::string corrupted = original;
+    corrupted[12] ^= 1;  // поле заголовка
+    rewrite(corrupted);
+    EXPECT_FALSE(mapped.openMapped(path));
+
+    rewrite(original.substr(0, original.size() - 1));
+    EXPECT_FALSE(mapped.openMapped(path));
+
+    // Поврежденные данные находит только полная проверка
+    corrupted = original;
+    corrupted[original.size() - 1] ^= 1;
+    rewrite(corrupted);
+    EXPECT_TRUE(mapped.openMapped(path, false));
+    EXPECT_FALSE(mapped.openMapped(path, true));
+
+    rewrite("a9963513d093ffb2bc7ceb9807771ad4;Exploit\n");
+    EXPECT_FALSE(SignatureIndex::isDatabaseFile(path));
+    EXPECT_FALSE(mapped.openMapped(path));
+
+    test_utils::cleanup(path);
+}
+
+TEST(SignatureIndexTest, FileSizeFilter) {
+    std::mt19937_64 rng(9);
+    SignatureIndex index;
+    EXPECT_FALSE(index.hasSizeFilter());
+    EXPECT_TRUE(index.mayMatchSize(123));
+
+    std::vector<MD5Digest> digests;
+    for (uint64_t i = 0; i < 50; ++i) {
+        digests.push_back(randomDigest(rng));
+        index.insert(digests.back(), "Virus", 1000 + i * 10);
+    }
+    ASSERT_TRUE(index.hasSizeFilter());
+    EXPECT_EQ(index.fileSizeCount(), 50u);
+    EXPECT_TRUE(index.mayMatchSize(1000));
+    EXPECT_TRUE(index.mayMatchSize(1490));
+    EXPECT_FALSE(index.mayMatchSize(1001));
+    EXPECT_FALSE(index.mayMatchSize(0));
+
+    // Размеры сохраняются в двоичной базе и переживают изменение отображенной таблицы
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+    SignatureIndex mapped;
+    ASSERT_TRUE(mapped.openMapped(path, true));
+    EXPECT_TRUE(mapped.hasSizeFilter());
+    EXPECT_EQ(mapped.fileSizeCount(), 50u);
+    EXPECT_FALSE(mapped.mayMatchSize(1001));
+    mapped.insert(randomDigest(rng), "Worm", 7);
+    EXPECT_TRUE(mapped.mayMatchSize(7));
+    EXPECT_TRUE(mapped.mayMatchSize(1490));
+    EXPECT_EQ(*mapped.find(digests[3]), "Virus");
+
+    // Сигнатура без размера отключает фильтр, в том числе после слияния
+    SignatureIndex unsized;
+    unsized.insert(randomDigest(rng), "Adware");
+    mapped.merge(unsized);
+    EXPECT_FALSE(mapped.hasSizeFilter());
+    EXPECT_TRUE(mapped.mayMatchSize(1001));
+
+    test_utils::cleanup(path);
+}
+
+TEST(SignatureIndexTest, PrefixKeys) {
+    std::mt19937_64 rng(14);
+    SignatureIndex index;
+    ASSERT_TRUE(index.setPrefixLength(4096));
+
+    MD5Digest full = randomDigest(rng);
+    MD5Digest prefix = randomDigest(rng);
+    index.insert(full, "Virus", 1000000, prefix);
+    EXPECT_EQ(index.prefixKeyCount(), 1u);
+    EXPECT_FALSE(index.setPrefixLength(8192));
+    EXPECT_TRUE(index.mayMatchSize(1000000));
+    EXPECT_TRUE(index.usesPrefixKey(1000000));
+    EXPECT_TRUE(index.mayMatchPrefix(1000000, prefix));
+    EXPECT_FALSE(index.mayMatchPrefix(1000000, randomDigest(rng)));
+    EXPECT_FALSE(index.mayMatchPrefix(1000001, prefix));
+    EXPECT_EQ(*index.find(full), "Virus");
+
+    // Рядом сигнатура без ключа префикса: файлы ее размера читаются целиком,
+    // файлы не длиннее префикса - тоже
+    index.insert(randomDigest(rng), "Worm", 2000000);
+    index.insert(randomDigest(rng), "Tiny", 4096, randomDigest(rng));
+    EXPECT_TRUE(index.usesPrefixKey(1000000));
+    EXPECT_FALSE(index.usesPrefixKey(2000000));
+    EXPECT_FALSE(index.usesPrefixKey(4096));
+
+    // Ключи и размеры без ключа сохраняются в двоичной базе вместе с длиной префикса
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+    SignatureIndex mapped;
+    ASSERT_TRUE(mapped.openMapped(path, true));
+    EXPECT_EQ(mapped.prefixLength(), 4096u);
+    EXPECT_EQ(mapped.prefixKeyCount(), 2u);
+    EXPECT_TRUE(mapped.usesPrefixKey(1000000));
+    EXPECT_FALSE(mapped.usesPrefixKey(2000000));
+    EXPECT_TRUE(mapped.mayMatchPrefix(1000000, prefix));
+    mapped.insert(randomDigest(rng), "Trojan", 3000000, randomDigest(rng));
+    EXPECT_TRUE(mapped.mayMatchPrefix(1000000, prefix));
+    EXPECT_EQ(mapped.prefixKeyCount(), 3u);
+
+    // Слияние с ключами другой длины: их файлы проверяются полным хешем
+    SignatureIndex other;
+    ASSERT_TRUE(other.setPrefixLength(65536));
+    other.insert(randomDigest(rng), "Rootkit", 5000000, randomDigest(rng));
+    mapped.merge(other);
+    EXPECT_EQ(mapped.prefixLength(), 4096u);
+    EXPECT_EQ(mapped.prefixKeyCount(), 3u);
+    EXPECT_TRUE(mapped.mayMatchSize(5000000));
+    EXPECT_FALSE(mapped.usesPrefixKey(5000000));
+
+    // Сигнатура без размера совпадает с файлом любого размера: префиксу верить нельзя
+    mapped.insert(randomDigest(rng), "Adware");
+    EXPECT_FALSE(mapped.usesPrefixKey(1000000));
+
+    test_utils::cleanup(path);
+}
+
+// Сигнатуры SHA-1/SHA-256 хранятся ключами с солью алгоритма; маска алгоритмов переживает сохранение
+TEST(SignatureIndexTest, ShaSignatures) {
+    const SHA256Digest sha256 = SHA256::hash("hello", 5);
+    const SHA1Digest sha1 = SHA1::hash("hello", 5);
+    MD5Digest truncated;
+    std::copy(sha256.begin(), sha256.begin() + truncated.size(), truncated.begin());
+
+    MD5Digest key = SignatureIndex::keyDigest(HashAlgorithm::SHA256, sha256.data());
+    EXPECT_NE(key, truncated);
+    EXPECT_NE(key, SignatureIndex::keyDigest(HashAlgorithm::SHA1, sha256.data()));
+    EXPECT_EQ(SignatureIndex::keyDigest(HashAlgorithm::MD5, truncated.data()), truncated);
+
+    SignatureIndex index;
+    index.insert(fromHex("5d41402abc4b2a76b9719d911017c592"), "Md5");
+    EXPECT_EQ(index.algorithms(), DIGEST_MD5);
+    index.insert(key, "Sha256");
+    index.addAlgorithms(DIGEST_SHA256);
+    EXPECT_EQ(index.algorithms(), DIGEST_MD5 | DIGEST_SHA256);
+
+    ASSERT_NE(index.find(HashAlgorithm::SHA256, sha256.data()), nullptr);
+    EXPECT_EQ(*index.find(HashAlgorithm::SHA256, sha256.data()), "Sha256");
+    // Первые 16 байт SHA-256 как MD5 сигнатуру не находят
+    EXPECT_EQ(index.find(truncated), nullptr);
+    // SHA-1 в базе нет: поиск не идет
+    EXPECT_EQ(index.find(HashAlgorithm::SHA1, sha1.data()), nullptr);
+    EXPECT_EQ(index.find(HashAlgorithm::XXH3, sha256.data()), nullptr);
+
+    std::string path = test_utils::createTempFile("", ".sigdb");
+    ASSERT_TRUE(index.save(path));
+    SignatureIndex mapped;
+    ASSERT_TRUE(mapped.openMapped(path));
+    EXPECT_EQ(mapped.algorithms(), DIGEST_MD5 | DIGEST_SHA256);
+    ASSERT_NE(mapped.find(HashAlgorithm::SHA256, sha256.data()), nullptr);
+    EXPECT_EQ(*mapped.find(HashAlgorithm::SHA256, sha256.data()), "Sha256");
+
+    SignatureIndex merged;
+    merged.merge(mapped);
+    EXPECT_EQ(merged.algorithms(), DIGEST_MD5 | DIGEST_SHA256);
+    test_utils::cleanup(path);
+}
+
+TEST(SignatureIndexTest, ParseHexOfAnyLength) {
+    uint8_t digest[32];
+    bool uppercase = false;
+    const std::string hex = "2CF24DBA5FB0A30E26E83B2AC5B9E29E1B161E5C1FA7425E73043362938B9824";
+    ASSERT_TRUE(SignatureIndex::parseHex(hex.data(), hex.size(), digest, sizeof(digest), &uppercase));
+    EXPECT_TRUE(uppercase);
+    SHA256Digest expected = SHA256::hash("hello", 5);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), digest));
+
+    const std::string sha1 = "aaf4c61ddcc5e8a2dabede0f3b482cd9aea9434d";
+    ASSERT_TRUE(SignatureIndex::parseHex(sha1.data(), sha1.size(), digest, 20, &uppercase));
+    EXPECT_FALSE(uppercase);
+    EXPECT_FALSE(SignatureIndex::parseHex(sha1.data(), sha1.size() - 1, digest, 20));
+    EXPECT_FALSE(SignatureIndex::parseHex(sha1.data(), sha1.size(), digest, 32));
+    EXPECT_FALSE(SignatureIndex::parseHex("aaf4c61ddcc5e8a2dabede0f3b482cd9aea9434g", 40, digest, 20));
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "thread_controller.h"
+#include "storage_profile.h"
+#include "numa_topology.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t INTERVAL_NS = 100000000;    // 100 мс
+
+// Накопленные счетчики стадий: каждый шаг добавляет интервал с заданной работой
+class SampleSeries {
+public:
+    ThreadController::Sample next(uint64_t files, uint64_t readNsPerFile, uint64_t hashNsPerFile,
+                                  size_t readBacklog, size_t hashBacklog, size_t hashCapacity = 16) {
+        sample_.elapsedNs += INTERVAL_NS;
+        sample_.filesDone += files;
+        sample_.filesRead += files;
+        sample_.readNs += files * readNsPerFile;
+        sample_.filesHashed += files;
+        sample_.hashNs += files * hashNsPerFile;
+        sample_.readBacklog = readBacklog;
+        sample_.hashBacklog = hashBacklog;
+        sample_.hashCapacity = hashCapacity;
+        return sample_;
+    }
+
+    const ThreadController::Sample& current() const { return sample_; }
+
+private:
+    ThreadController::Sample sample_;
+};
+
+ThreadController::Limits limits(size_t minIo, size_t maxIo, size_t minHash, size_t maxHash) {
+    ThreadController::Limits result;
+    result.minIo = minIo;
+    result.maxIo = maxIo;
+    result.minHash = minHash;
+    result.maxHash = maxHash;
+    return result;
+}
+
+}
+
+TEST(ThreadControllerTest, StartsWithinLimits) {
+    ThreadController controller(limits(2, 8, 1, 4), 100, 0);
+    EXPECT_EQ(controller.ioThreads(), 8u);
+    EXPECT_EQ(controller.hashThreads(), 1u);
+    EXPECT_EQ(controller.adjustments(), 0u);
+}
+
+TEST(ThreadControllerTest, FirstSampleAndEmptyIntervalsOnlyRecord) {
+    ThreadController controller(limits(1, 64, 4, 4), 4, 4);
+    SampleSeries series;
+    EXPECT_FALSE(controller.update(series.current()));
+    // Обход каталогов без файлов: решать не по чему
+    EXPECT_FALSE(controller.update(series.next(0, 0, 0, 10, 0)));
+    EXPECT_EQ(controller.ioThreads(), 4u);
+}
+
+// Чтение файла в 10 раз дольше хеширования: читателей нужно втрое-вчетверо
+// больше хеширующих потоков, но за интервал их число растет не больше чем вдвое
+TEST(ThreadControllerTest, GrowsReadersTowardLittlesLaw) {
+    ThreadController controller(limits(1, 64, 4, 4), 4, 4);
+    SampleSeries series;
+    controller.update(series.current());
+    EXPECT_TRUE(controller.update(series.next(400, 1000000, 100000, 8, 0)));
+    EXPECT_EQ(controller.ioThreads(), 8u);
+    EXPECT_EQ(controller.hashThreads(), 4u);
+
+    // Пропускная способность выросла - рост подтвержден и продолжается
+    EXPECT_TRUE(controller.update(series.next(800, 1000000, 100000, 8, 0)));
+    EXPECT_EQ(controller.ioThreads(), 16u);
+    EXPECT_EQ(controller.adjustments(), 2u);
+}
+
+TEST(ThreadControllerTest, RevertsGrowthThatDidNotHelp) {
+    ThreadController controller(limits(1, 64, 4, 4), 4, 4);
+    SampleSeries series;
+    controller.update(series.current());
+    EXPECT_TRUE(controller.update(series.next(400, 1000000, 100000, 8, 0)));
+    EXPECT_EQ(controller.ioThreads(), 8u);
+
+    // Те же 400 файлов за интервал: шаг откатывается, и потоки какое-то время не трогаются
+    EXPECT_TRUE(controller.update(series.next(400, 1000000, 100000, 8, 0)));
+    EXPECT_EQ(controller.ioThreads(), 4u);
+    EXPECT_EQ(controller.adjustments(), 2u);
+    for (int i = 0; i < ThreadController::COOLDOWN_INTERVALS; ++i) {
+        EXPECT_FALSE(controller.update(series.next(400, 1000000, 100000, 8, 0)));
+        EXPECT_EQ(controller.ioThreads(), 4u);
+    }
+    EXPECT_TRUE(controller.update(series.next(400, 1000000, 100000, 8, 0)));
+    EXPECT_EQ(controller.ioThreads(), 8u);
+}
+
+TEST(ThreadControllerTest, NoGrowthWithoutReadBacklog) {
+    ThreadController controller(limits(1, 64, 4, 4), 4, 4);
+    SampleSeries series;
+    controller.update(series.current());
+    EXPECT_FALSE(controller.update(series.next(400, 1000000, 100000, 0, 0)));
+    EXPECT_EQ(controller.ioThreads(), 4u);
+}
+
+// Очередь хеширования заполнена: читатели сокращаются, хеширование растет до предела
+TEST(ThreadControllerTest, HashBoundShrinksReaders) {
+    ThreadController controller(limits(1, 64, 1, 8), 16, 4);
+    SampleSeries series;
+    controller.update(series.current());
+    EXPECT_TRUE(controller.update(series.next(400, 4000000, 1000000, 8, 12)));
+    EXPECT_EQ(controller.ioThreads(), 12u);
+    EXPECT_EQ(controller.hashThreads(), 8u);
+}
+
+TEST(ThreadControllerTest, IdleHashThreadsShrink) {
+    ThreadController controller(limits(4, 4, 1, 8), 4, 8);
+    SampleSeries series;
+    controller.update(series.current());
+    // 8 потоков заняты на 20%: хватит трех при целевой занятости 75%
+    EXPECT_TRUE(controller.update(series.next(400, 1000000, 400000, 0, 0)));
+    EXPECT_EQ(controller.hashThreads(), 3u);
+    EXPECT_EQ(controller.ioThreads(), 4u);
+}
+
+TEST(StorageProfileTest, InitialIoThreads) {
+    StorageProfile profile;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), 8u);
+
+    profile.kind = StorageProfile::Kind::Remote;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), StorageProfile::REMOTE_IO_THREADS);
+    EXPECT_EQ(profile.initialIoThreads(32, 64), 64u);
+    EXPECT_EQ(profile.initialIoThreads(4, 10), 10u);
+
+    profile.kind = StorageProfile::Kind::Rotational;
+    EXPECT_EQ(profile.initialIoThreads(16, 64), StorageProfile::ROTATIONAL_IO_THREADS);
+
+    profile.kind = StorageProfile::Kind::SolidState;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), 8u);
+    profile.queueDepth = 1023;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), 16u);
+    profile.queueDepth = 64;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), 8u);
+    profile.queueDepth = 2;
+    EXPECT_EQ(profile.initialIoThreads(4, 64), 4u);
+    EXPECT_EQ(profile.initialIoThreads(0, 64), 1u);
+}
+
+TEST(StorageProfileTest, ProbeMissingPath) {
+    StorageProfile profile = StorageProfile::probe("/nonexistent/path/for/profile");
+    EXPECT_EQ(profile.kind, StorageProfile::Kind::Unknown);
+    EXPECT_EQ(profile.queueDepth, 0u);
+}
+
+TEST(NumaTopologyTest, ParseCpuList) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(NumaTopology::parseCpuList("0-3,8,10-11\n", cpus));
+    EXPECT_EQ(cpus, (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    ASSERT_TRUE(NumaTopology::parseCpuList("", cpus));
+    EXPECT_TRUE(cpus.empty());
+    EXPECT_FALSE(NumaTopology::parseCpuList("3-1", cpus));
+    EXPECT_FALSE(NumaTopology::parseCpuList("0,x", cpus));
+}
+
+TEST(NumaTopologyTest, SystemHasCpus) {
+    const NumaTopology& topology = NumaTopology::system();
+    ASSERT_GE(topology.nodeCount(), 1u);
+    EXPECT_GE(topology.cpuCount(), 1u);
+    for (size_t i = 0; i < topology.nodeCount(); ++i) {
+        EXPECT_FALSE(topology.node(i).cpus.empty());
+    }
+}
+
+TEST(NodeBufferTest, GrowsAndKeepsPrefix) {
+    NodeBuffer buffer(0);
+    EXPECT_EQ(buffer.capacity(), 0u);
+    ASSERT_TRUE(buffer.reserve(100));
+    ASSERT_GE(buffer.capacity(), 100u);
+    std::memset(buffer.data(), 0x5A, 100);
+
+    const uint8_t* before = buffer.data();
+    ASSERT_TRUE(buffer.reserve(50, 100));
+    EXPECT_EQ(buffer.data(), before);
+
+    ASSERT_TRUE(buffer.reserve(1 << 20, 100));
+    ASSERT_GE(buffer.capacity(), static_cast<size_t>(1 << 20));
+    for (size_t i = 0; i < 100; ++i) {
+        ASSERT_EQ(buffer.data()[i], 0x5A);
+    }
+
+    NodeBuffer moved(std::move(buffer));
+    EXPECT_EQ(buffer.capacity(), 0u);
+    EXPECT_EQ(moved.node(), 0);
+    EXPECT_EQ(moved.data()[99], 0x5A);
+}
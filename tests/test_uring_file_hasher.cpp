@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "uring_file_hasher.h"
+#include "test_utils.h"
+#include <cerrno>
+#include <random>
+
+namespace {
+
+const MD5MultiBuffer::Isa ALL_ISAS[] = {
+    MD5MultiBuffer::Isa::Scalar,
+    MD5MultiBuffer::Isa::SSE2,
+    MD5MultiBuffer::Isa::AVX2,
+    MD5MultiBuffer::Isa::AVX512,
+};
+
+std::string randomData(size_t size, unsigned int seed) {
+    std::mt19937 rng(seed);
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(rng());
+    }
+    return data;
+}
+
+}
+
+class UringFileHasherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        testDir = test_utils::createTempDir();
+
+        // Размеры вокруг границ блока, паддинга и буфера чтения слота
+        const size_t sizes[] = {0, 1, 55, 56, 63, 64, 65, 120, 1000, 4096,
+                                UringFileHasher::READ_BUFFER_SIZE - 1,
+                                UringFileHasher::READ_BUFFER_SIZE,
+                                UringFileHasher::READ_BUFFER_SIZE + 70,
+                                300000, 3, 777, 17, 5000, 64, 99};
+        unsigned int seed = 1;
+        for (size_t size : sizes) {
+            std::string path = testDir + "/file_" + std::to_string(seed) + ".bin";
+            std::string content = randomData(size, seed++);
+            std::ofstream(path, std::ios::binary).write(content.data(), content.size());
+            paths.push_back(path);
+            expected.push_back(MD5::hash(content.data(), content.size()));
+            FileDigests all;
+            all.mask = DIGEST_ALL;
+            all.md5 = expected.back();
+            all.sha1 = SHA1::hash(content.data(), content.size());
+            all.sha256 = SHA256::hash(content.data(), content.size());
+            all.xxh3 = XXH3::hash(content.data(), content.size());
+            expectedAll.push_back(all);
+        }
+    }
+
+    void TearDown() override {
+        test_utils::cleanup(testDir);
+    }
+
+    // Хеширует paths и проверяет, что каждый файл пришел ровно один раз с верным дайджестом
+    void expectAllHashed(UringFileHasher& hasher) {
+        std::vector<int> seen(paths.size(), 0);
+        hasher.hashFiles(paths, [&](size_t index, const MD5Digest* digest) {
+            ASSERT_LT(index, paths.size());
+            ASSERT_NE(digest, nullptr) << paths[index];
+            EXPECT_EQ(*digest, expected[index]) << hasher.kernel().name << " " << paths[index];
+            seen[index]++;
+        });
+        for (int count : seen) {
+            EXPECT_EQ(count, 1);
+        }
+    }
+
+    std::string testDir;
+    std::vector<std::string> paths;
+    std::vector<MD5Digest> expected;
+    std::vector<FileDigests> expectedAll;   // все алгоритмы, посчитанные по отдельности
+};
+
+// Дайджесты файла совпадают с посчитанными по отдельности
+void expectDigests(const FileDigests& actual, const FileDigests& expected, const std::string& path) {
+    EXPECT_EQ(actual.mask, expected.mask) << path;
+    EXPECT_EQ(actual.md5, expected.md5) << path;
+    EXPECT_EQ(actual.sha1, expected.sha1) << path;
+    EXPECT_EQ(actual.sha256, expected.sha256) << path;
+    EXPECT_EQ(actual.xxh3, expected.xxh3) << path;
+}
+
+TEST_F(UringFileHasherTest, MatchesMD5OnEveryKernel) {
+    if (!UringFileHasher::supported()) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    for (auto isa : ALL_ISAS) {
+        if (!MD5MultiBuffer::supported(isa)) continue;
+        UringFileHasher hasher(MD5MultiBuffer::get(isa));
+        ASSERT_TRUE(hasher.isReady());
+        expectAllHashed(hasher);
+    }
+}
+
+// Очередь мельче числа файлов: слоты переиспользуются, хешер - тоже между вызовами
+TEST_F(UringFileHasherTest, ShallowQueueReusesSlots) {
+    if (!UringFileHasher::supported()) {
+        GTEST_SKIP() << "io_uring is not available";
+    }
+    UringFileHasher hasher(MD5MultiBuffer::best(), 3);
+    ASSERT_TRUE(hasher.isReady());
+    EXPECT_LE(hasher.queueDepth(), 4u);
+    expectAllHashed(hasher);
+    expectAllHashed(hasher);
+}
+
+TEST_F(UringFileHasherTest, ErrorsDoNotStopOtherFiles) {
+    UringFileHasher hasher;
+    std::vector<std::string> mixed = {paths[0], testDir + "/missing.bin", testDir, paths[12]};
+
+    std::vector<int> failed(mixed.size(), -1);
+    std::vector<int> errors(mixed.size(), 0);
+    hasher.hashFiles(mixed, [&](size_t index, const MD5Digest* digest) {
+        failed[index] = digest == nullptr;
+        if (!digest) {
+            errors[index] = hasher.lastError();
+        }
+        if (index == 0 && digest) {
+            EXPECT_EQ(*digest, expected[0]);
+        }
+        if (index == 3 && digest) {
+            EXPECT_EQ(*digest, expected[12]);
+        }
+    });
+
+    EXPECT_EQ(failed[0], 0);
+    EXPECT_EQ(failed[1], 1);
+    // Каталог открывается, но не читается
+    EXPECT_EQ(failed[2], 1);
+    EXPECT_EQ(failed[3], 0);
+    // Код ошибки доступен внутри вызова с nullptr
+    EXPECT_EQ(errors[1], ENOENT);
+    EXPECT_EQ(errors[2], EISDIR);
+}
+
+// Нулевая глубина очереди - блокирующий запасной путь с тем же результатом
+TEST_F(UringFileHasherTest, BlockingFallback) {
+    UringFileHasher hasher(MD5MultiBuffer::best(), 0);
+    EXPECT_FALSE(hasher.isReady());
+    expectAllHashed(hasher);
+}
+
+// Дополнительные дайджесты считаются из буферов тех же чтений, в том числе без io_uring
+TEST_F(UringFileHasherTest, ExtraDigestsFromSameRead) {
+    for (size_t depth : {UringFileHasher::DEFAULT_QUEUE_DEPTH, size_t(0)}) {
+        UringFileHasher hasher(MD5MultiBuffer::best(), depth);
+        hasher.setDigests(DIGEST_SHA1 | DIGEST_SHA256 | DIGEST_XXH3);
+        size_t calls = 0;
+        hasher.hashFiles(paths, [&](size_t index, const MD5Digest* digest) {
+            ASSERT_NE(digest, nullptr);
+            expectDigests(hasher.lastDigests(), expectedAll[index], paths[index]);
+            calls++;
+        });
+        EXPECT_EQ(calls, paths.size());
+    }
+}
@@ -3,15 +3,28 @@
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <ctime>
+#include <random>
 
 namespace test_utils {
+
+    /**
+     * Уникальный суффикс имени: несколько файлов, созданных в одну секунду,
+     * не должны перезаписывать друг друга
+     */
+    inline std::string uniqueSuffix() {
+        static const unsigned int processTag = std::random_device{}();
+        static int counter = 0;
+        return std::to_string(std::time(nullptr)) + "_" + std::to_string(processTag) + "_" +
+               std::to_string(counter++);
+    }
     
     /**
      * Создает временный файл с заданным содержимым
      */
     inline std::string createTempFile(const std::string& content, const std::string& extension = ".txt") {
         std::filesystem::path tempDir = std::filesystem::temp_directory_path();
-        std::filesystem::path tempFile = tempDir / ("test_" + std::to_string(std::time(nullptr)) + extension);
+        std::filesystem::path tempFile = tempDir / ("test_" + uniqueSuffix() + extension);
         
         std::ofstream file(tempFile);
         file << content;
@@ -25,7 +38,7 @@ namespace test_utils {
      */
     inline std::string createTempDir() {
         std::filesystem::path tempDir = std::filesystem::temp_directory_path();
-        std::filesystem::path testDir = tempDir / ("test_dir_" + std::to_string(std::time(nullptr)));
+        std::filesystem::path testDir = tempDir / ("test_dir_" + uniqueSuffix());
         
         std::filesystem::create_directories(testDir);
         return testDir.string();
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include "work_stealing_pool.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(WorkStealingPoolTest, RunsAllExternalTasks) {
+    WorkStealingPool pool(4);
+    std::atomic<int> counter{0};
+
+    for (int i = 0; i < 10000; ++i) {
+        pool.PushTask([&counter]() { counter++; });
+    }
+    pool.WaitIdle();
+
+    EXPECT_EQ(counter, 10000);
+    pool.Terminate(true);
+}
+
+TEST(WorkStealingPoolTest, NestedTasksAndWaitIdle) {
+    WorkStealingPool pool(4);
+    std::atomic<int> counter{0};
+
+    // Каждая задача порождает две дочерние, пока глубина не кончится:
+    // 2^11 - 1 задач, почти все ставятся из воркеров в свои деки
+    struct Spawn {
+        WorkStealingPool* pool;
+        std::atomic<int>* counter;
+        int depth;
+        void operator()() {
+            (*counter)++;
+            if (depth > 0) {
+                pool->PushTask(Spawn{pool, counter, depth - 1});
+                pool->PushTask(Spawn{pool, counter, depth - 1});
+            }
+        }
+    };
+    pool.PushTask(Spawn{&pool, &counter, 10});
+    pool.WaitIdle();
+
+    EXPECT_EQ(counter, (1 << 11) - 1);
+    pool.Terminate(true);
+}
+
+TEST(WorkStealingPoolTest, TryPushTaskFailsOnFullQueueWithoutConsuming) {
+    WorkStealingPool pool(1, 2);
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+
+    // Единственный воркер занят, очередь внедрения заполняется
+    pool.PushTask([&]() {
+        started = true;
+        while (!release) std::this_thread::yield();
+    });
+    while (!started) std::this_thread::yield();
+
+    std::atomic<int> counter{0};
+    EXPECT_TRUE(pool.TryPushTask([&counter]() { counter++; }));
+    EXPECT_TRUE(pool.TryPushTask([&counter]() { counter++; }));
+
+    auto payload = std::make_unique<int>(42);
+    auto task = [&counter, p = std::move(payload)]() { counter += *p; };
+    EXPECT_FALSE(pool.TryPushTask(std::move(task)));
+    // При отказе захваченные данные остаются у вызывающего
+    task();
+    EXPECT_EQ(counter, 42);
+
+    release = true;
+    pool.WaitIdle();
+    EXPECT_EQ(counter, 44);
+    pool.Terminate(true);
+}
+
+TEST(WorkStealingPoolTest, BatchedSubmission) {
+    WorkStealingPool pool(3, 8);
+    std::atomic<int> counter{0};
+
+    std::vector<std::function<void()>> tasks;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back([&counter, i]() { counter += i; });
+    }
+    // Пачка больше емкости очереди: PushTasks дожидается места
+    pool.PushTasks(tasks.begin(), tasks.end());
+    pool.WaitIdle();
+
+    EXPECT_EQ(counter, 99 * 100 / 2);
+    pool.Terminate(true);
+}
+
+TEST(WorkStealingPoolTest, LargeAndMoveOnlyCallables) {
+    WorkStealingPool pool(2);
+    std::atomic<int> sum{0};
+
+    // Не помещается во встроенный буфер задачи
+    std::array<int, 64> big{};
+    big.fill(1);
+    static_assert(sizeof(big) > PoolTask::INLINE_SIZE, "callable must not fit inline");
+    for (int i = 0; i < 100; ++i) {
+        pool.PushTask([&sum, big]() {
+            for (int v : big) sum += v;
+        });
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        auto value = std::make_unique<int>(i);
+        pool.PushTask([&sum, value = std::move(value)]() { sum += *value; });
+    }
+    pool.WaitIdle();
+
+    EXPECT_EQ(sum, 100 * 64 + 99 * 100 / 2);
+    pool.Terminate(true);
+}
+
+TEST(WorkStealingPoolTest, ReleasesCapturesAndRejectsAfterTerminate) {
+    auto pool = std::make_unique<WorkStealingPool>(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> started{false};
+    pool->PushTask([&]() {
+        started = true;
+        while (!release) std::this_thread::yield();
+    });
+    while (!started) std::this_thread::yield();
+
+    // Захваченные данные освобождаются сразу после выполнения задачи
+    auto tracker = std::make_shared<int>(0);
+    std::weak_ptr<int> weak = tracker;
+    pool->PushTask([tracker]() {});
+    tracker.reset();
+
+    release = true;
+    pool->Terminate(true);
+    EXPECT_FALSE(pool->IsActive());
+    EXPECT_THROW(pool->PushTask([]() {}), std::runtime_error);
+    pool.reset();
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST(WorkStealingPoolTest, ActiveThreadLimit) {
+    std::atomic<int> started{0};
+    WorkStealingPool pool(4, 16, [&started](size_t) { started++; });
+    pool.SetActiveThreads(2);
+    EXPECT_EQ(pool.ActiveThreads(), 2u);
+    // Воркер, проверивший предел до его смены, увидит его на следующем круге
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Задачи выполняют не больше двух воркеров одновременно
+    std::atomic<int> running{0};
+    std::atomic<int> peak{0};
+    auto task = [&]() {
+        int now = ++running;
+        int seen = peak.load();
+        while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        running--;
+    };
+    for (int i = 0; i < 200; ++i) {
+        pool.PushTask(task);
+    }
+    pool.WaitIdle();
+    EXPECT_LE(peak.load(), 2);
+
+    // Предел поднимается и опускается на ходу; вне диапазона он обрезается
+    pool.SetActiveThreads(100);
+    EXPECT_EQ(pool.ActiveThreads(), 4u);
+    pool.SetActiveThreads(0);
+    EXPECT_EQ(pool.ActiveThreads(), 1u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    peak = 0;
+    for (int i = 0; i < 200; ++i) {
+        pool.PushTask(task);
+    }
+    pool.WaitIdle();
+    EXPECT_EQ(peak.load(), 1);
+
+    // Все воркеры уснули, пока были активны; пробуждение от одиночной задачи
+    // может достаться лишнему воркеру, и он должен передать его дальше
+    pool.SetActiveThreads(4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    pool.SetActiveThreads(1);
+    std::atomic<int> single{0};
+    for (int i = 0; i < 50; ++i) {
+        pool.PushTask([&single]() { single++; });
+        pool.WaitIdle();
+    }
+    EXPECT_EQ(single.load(), 50);
+    EXPECT_EQ(started.load(), 4);
+    pool.Terminate(true);
+}